@@ -42,6 +42,7 @@
 #include "IlmThreadMutex.h"
 #include "IlmThreadSemaphore.h"
 #include "IlmThreadPool.h"
+#include "IlmThreadTrace.h"
 #include "Iex.h"
 #include <vector>
 #ifndef ILMBASE_FORCE_CXX03
@@ -280,7 +281,11 @@ DefaultWorkerThread::run ()
                 taskLock.release();
 
                 TaskGroup* taskGroup = task->group();
-                task->execute();
+
+                {
+                    ILMTHREAD_TRACE_SPAN ("Task::execute");
+                    task->execute();
+                }
 
                 delete task;
 
@@ -410,7 +415,10 @@ DefaultThreadPoolProvider::addTask (Task *task)
     {
         // this path shouldn't normally happen since we have the
         // NullThreadPoolProvider, but just in case...
-        task->execute ();
+        {
+            ILMTHREAD_TRACE_SPAN ("Task::execute");
+            task->execute ();
+        }
         task->group()->_data->removeTask ();
         delete task;
     }
@@ -468,7 +476,10 @@ class NullThreadPoolProvider : public ThreadPoolProvider
     }
     virtual void addTask (Task *t)
     {
-        t->execute ();
+        {
+            ILMTHREAD_TRACE_SPAN ("Task::execute");
+            t->execute ();
+        }
         t->group()->_data->removeTask ();
         delete t;
     }
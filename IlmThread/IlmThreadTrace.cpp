@@ -0,0 +1,317 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2005-2012, Industrial Light & Magic, a division of Lucas
+// Digital Ltd. LLC
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// *       Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// *       Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+// *       Neither the name of Industrial Light & Magic nor the names of
+// its contributors may be used to endorse or promote products derived
+// from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+//-----------------------------------------------------------------------------
+//
+//	class TraceSpan -- per-thread span recording and
+//	Chrome trace-event JSON output
+//
+//-----------------------------------------------------------------------------
+
+#include "IlmBaseConfig.h"
+#include "IlmThreadTrace.h"
+
+#include <cstdio>
+
+#ifndef ILMBASE_FORCE_CXX03
+#   include <atomic>
+#   include <chrono>
+#   include <mutex>
+#   include <vector>
+#endif
+
+ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_ENTER
+
+#ifndef ILMBASE_FORCE_CXX03
+
+namespace {
+
+struct TraceEvent
+{
+    const char *	name;
+    const char *	category;
+    long long		start;
+    long long		duration;
+};
+
+//
+// The spans recorded by one thread.  The mutex is only contended
+// while the trace is being written or cleared.
+//
+
+struct ThreadBuffer
+{
+    std::mutex			mutex;
+    std::vector<TraceEvent>	events;
+    unsigned			tid;
+};
+
+std::atomic<bool>	enabled (false);
+std::atomic<size_t>	maxEvents (0);
+std::atomic<size_t>	dropped (0);
+
+//
+// Buffers are never deleted, so that the spans of threads that
+// have finished are still available when the trace is written.
+//
+
+std::mutex			buffersMutex;
+std::vector<ThreadBuffer *>	buffers;
+
+thread_local ThreadBuffer *	currentBuffer = 0;
+
+
+long long
+now ()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+ThreadBuffer *
+threadBuffer ()
+{
+    if (!currentBuffer)
+    {
+        ThreadBuffer *buffer = new ThreadBuffer;
+
+        std::lock_guard<std::mutex> lock (buffersMutex);
+        buffer->tid = static_cast<unsigned> (buffers.size()) + 1;
+        buffers.push_back (buffer);
+        currentBuffer = buffer;
+    }
+
+    return currentBuffer;
+}
+
+
+void
+appendEscaped (std::string &out, const char s[])
+{
+    for (; *s; ++s)
+    {
+        unsigned char c = static_cast<unsigned char> (*s);
+
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += *s;
+        }
+        else if (c < 0x20)
+        {
+            char hex[8];
+            snprintf (hex, sizeof (hex), "\\u%04x", c);
+            out += hex;
+        }
+        else
+        {
+            out += *s;
+        }
+    }
+}
+
+} // namespace
+
+
+void
+startTrace (size_t maxEventsPerThread)
+{
+    maxEvents = maxEventsPerThread;
+    enabled = true;
+}
+
+
+void
+stopTrace ()
+{
+    enabled = false;
+}
+
+
+bool
+tracing ()
+{
+    return enabled;
+}
+
+
+void
+clearTrace ()
+{
+    std::lock_guard<std::mutex> lock (buffersMutex);
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        std::lock_guard<std::mutex> bufferLock (buffers[i]->mutex);
+        buffers[i]->events.clear();
+    }
+
+    dropped = 0;
+}
+
+
+size_t
+droppedTraceEvents ()
+{
+    return dropped;
+}
+
+
+std::string
+chromeTrace ()
+{
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    char number[128];
+
+    std::lock_guard<std::mutex> lock (buffersMutex);
+
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        std::lock_guard<std::mutex> bufferLock (buffers[i]->mutex);
+        const std::vector<TraceEvent> &events = buffers[i]->events;
+
+        if (events.empty())
+            continue;
+
+        snprintf (number, sizeof (number), "%u", buffers[i]->tid);
+
+        out += first ? "\n" : ",\n";
+        out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+        out += number;
+        out += ",\"args\":{\"name\":\"Thread ";
+        out += number;
+        out += "\"}}";
+        first = false;
+
+        for (size_t e = 0; e < events.size(); ++e)
+        {
+            out += ",\n{\"name\":\"";
+            appendEscaped (out, events[e].name);
+            out += "\",\"cat\":\"";
+            appendEscaped (out, events[e].category);
+
+            //
+            // Chrome trace times are in microseconds
+            //
+
+            snprintf (number, sizeof (number),
+                      "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                      events[e].start / 1000.0, events[e].duration / 1000.0,
+                      buffers[i]->tid);
+            out += number;
+        }
+    }
+
+    out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out;
+}
+
+
+bool
+writeChromeTrace (const char fileName[])
+{
+    std::string trace = chromeTrace();
+
+    FILE *file = fopen (fileName, "wb");
+    if (!file)
+        return false;
+
+    bool ok = fwrite (trace.data(), 1, trace.size(), file) == trace.size();
+    return (fclose (file) == 0) && ok;
+}
+
+
+TraceSpan::TraceSpan (const char name[], const char category[]):
+    _name (0), _category (category), _start (0)
+{
+    if (enabled.load (std::memory_order_relaxed))
+    {
+        _name = name;
+        _start = now();
+    }
+}
+
+
+void
+TraceSpan::end ()
+{
+    TraceEvent event;
+    event.name = _name;
+    event.category = _category;
+    event.start = _start;
+    event.duration = now() - _start;
+
+    ThreadBuffer *buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock (buffer->mutex);
+
+    if (buffer->events.size() < maxEvents.load (std::memory_order_relaxed))
+        buffer->events.push_back (event);
+    else
+        ++dropped;
+}
+
+#else
+
+//
+// Tracing is not supported without C++11
+//
+
+void startTrace (size_t) {}
+void stopTrace () {}
+bool tracing () {return false;}
+void clearTrace () {}
+size_t droppedTraceEvents () {return 0;}
+std::string chromeTrace () {return "{\"traceEvents\":[]}\n";}
+
+bool
+writeChromeTrace (const char fileName[])
+{
+    FILE *file = fopen (fileName, "wb");
+    if (!file)
+        return false;
+
+    fputs (chromeTrace().c_str(), file);
+    return fclose (file) == 0;
+}
+
+TraceSpan::TraceSpan (const char name[], const char category[]):
+    _name (0), _category (category), _start (0) {}
+
+void TraceSpan::end () {}
+
+#endif
+
+ILMTHREAD_INTERNAL_NAMESPACE_SOURCE_EXIT
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2005-2012, Industrial Light & Magic, a division of Lucas
+// Digital Ltd. LLC
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+// *       Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// *       Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+// *       Neither the name of Industrial Light & Magic nor the names of
+// its contributors may be used to endorse or promote products derived
+// from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef INCLUDED_ILM_THREAD_TRACE_H
+#define INCLUDED_ILM_THREAD_TRACE_H
+
+//-----------------------------------------------------------------------------
+//
+//	class TraceSpan, startTrace(), stopTrace(), writeChromeTrace()
+//
+//	A TraceSpan records the time between its construction and its
+//	destruction, along with the thread it ran on, while tracing is
+//	started.  Each thread records into its own buffer so threads do
+//	not contend with each other.  The recorded spans can then be
+//	written in Chrome trace-event JSON format, which can be opened
+//	directly in Perfetto or chrome://tracing.
+//
+//	The name and category of a span are not copied, so they must
+//	remain valid until the trace has been written - normally they
+//	are string literals.
+//
+//	Typical usage:
+//
+//	    startTrace ();
+//
+//	    {
+//		TraceSpan span ("readFrame");	// starts timing
+//		...
+//	    }					// records the span
+//
+//	    stopTrace ();
+//	    writeChromeTrace ("trace.json");
+//
+//	The ILMTHREAD_TRACE_SPAN macro declares a span only if
+//	ILMTHREAD_TRACE is defined, so it compiles to nothing otherwise.
+//	Libraries using IlmThread can define their own macro in the
+//	same way to control their spans separately.
+//
+//	Tracing requires C++11; if ILMBASE_FORCE_CXX03 is defined
+//	nothing is recorded.
+//
+//-----------------------------------------------------------------------------
+
+#include "IlmThreadExport.h"
+#include "IlmThreadNamespace.h"
+
+#include <string>
+#include <cstddef>
+
+ILMTHREAD_INTERNAL_NAMESPACE_HEADER_ENTER
+
+//
+// Start recording spans, keeping at most maxEventsPerThread
+// spans for each thread.  Further spans are counted as dropped.
+//
+
+ILMTHREAD_EXPORT void	startTrace (size_t maxEventsPerThread = 1000000);
+
+//
+// Stop recording spans.  Spans already recorded are kept.
+//
+
+ILMTHREAD_EXPORT void	stopTrace ();
+
+//
+// Return true if spans are being recorded
+//
+
+ILMTHREAD_EXPORT bool	tracing ();
+
+//
+// Discard all recorded spans
+//
+
+ILMTHREAD_EXPORT void	clearTrace ();
+
+//
+// Return the number of spans dropped because a thread's buffer was full
+//
+
+ILMTHREAD_EXPORT size_t	droppedTraceEvents ();
+
+//
+// Return the recorded spans as a Chrome trace-event JSON document,
+// or write them to a file.  writeChromeTrace() returns false if the
+// file could not be written.  Spans from threads that are still
+// running are included up to the point of the call.
+//
+
+ILMTHREAD_EXPORT std::string	chromeTrace ();
+ILMTHREAD_EXPORT bool		writeChromeTrace (const char fileName[]);
+
+
+class ILMTHREAD_EXPORT TraceSpan
+{
+  public:
+
+    TraceSpan (const char name[], const char category[] = "");
+    ~TraceSpan ()
+    {
+        if (_name)
+            end ();
+    }
+
+  private:
+
+    void	end ();
+
+    const char *	_name;		// 0 if tracing was stopped
+    const char *	_category;
+    long long		_start;		// nanoseconds
+
+    void operator = (const TraceSpan &);	// not implemented
+    TraceSpan (const TraceSpan &);		// not implemented
+};
+
+
+ILMTHREAD_INTERNAL_NAMESPACE_HEADER_EXIT
+
+
+#define ILMTHREAD_TRACE_CONCAT2(a, b) a ## b
+#define ILMTHREAD_TRACE_CONCAT(a, b) ILMTHREAD_TRACE_CONCAT2 (a, b)
+
+#ifdef ILMTHREAD_TRACE
+#   define ILMTHREAD_TRACE_SPAN(name) \
+	ILMTHREAD_INTERNAL_NAMESPACE::TraceSpan \
+	    ILMTHREAD_TRACE_CONCAT (ilmThreadTraceSpan, __LINE__) (name, "IlmThread")
+#else
+#   define ILMTHREAD_TRACE_SPAN(name)
+#endif
+
+#endif
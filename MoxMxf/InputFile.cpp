@@ -21,6 +21,9 @@ using namespace mxflib;
 mxflib::DataChunk &
 FramePart::getData()
 {
+	if(!_obj)
+		return *_data;
+
 	mxflib::DataChunk &data = _obj->GetData();
 
 	assert(_obj->GetLength() > 0);
@@ -39,7 +42,9 @@ FramePart::getData()
 }
 
 
-InputFile::InputFile(IOStream &infile)
+InputFile::InputFile(IOStream &infile, bool follow) :
+	_follow(follow),
+	_last_partition(-1)
 {
 	InitializeDict();
 
@@ -55,6 +60,14 @@ InputFile::InputFile(IOStream &infile)
 
 	mxflib::PartitionPtr master_partition = _file->ReadMasterPartition();
 
+	if(!master_partition && _follow)
+	{
+		// a file that is still being written may only have an open header so far
+		_file->Seek(0);
+
+		master_partition = _file->ReadPartition();
+	}
+
 	if(master_partition)
 	{
 		if( master_partition->ReadMetadata() )
@@ -108,54 +121,173 @@ InputFile::InputFile(IOStream &infile)
 		throw InputExc("Couldn't get master partition");
 
 
-	if( _file->GetRIP() )
+	if(_follow)
 	{
-		for(mxflib::RIP::iterator p = _file->FileRIP.begin(); p != _file->FileRIP.end(); ++p)
-		{
-			mxflib::PartitionInfoPtr p_info = p->second;
+		if(_file->FollowRIP() < 0)
+			throw InputExc("Couldn't follow partitions");
+	}
+	else if( !_file->GetRIP() )
+		throw InputExc("Couldn't get RIP");
 
-			assert(p->first == p_info->ByteOffset);
+	readIndexSegments( _file->FileRIP.begin() );
+}
 
+
+void
+InputFile::readIndexSegments(mxflib::RIP::iterator p)
+{
+	for(; p != _file->FileRIP.end(); ++p)
+	{
+		mxflib::PartitionInfoPtr p_info = p->second;
+
+		assert(p->first == p_info->ByteOffset);
+
+		mxflib::PartitionPtr partition = p_info->GetPartition();
+
+		if(!partition)
+		{
 			_file->Seek(p_info->ByteOffset);
 
-			mxflib::PartitionPtr partition = _file->ReadPartition();
+			partition = _file->ReadPartition();
+		}
 
-			if(partition)
-			{
-				const SID bodySID = partition->GetUInt(BodySID_UL);
-				const SID indexSID = partition->GetUInt(IndexSID_UL);
+		if(partition)
+		{
+			const SID bodySID = partition->GetUInt(BodySID_UL);
+			const SID indexSID = partition->GetUInt(IndexSID_UL);
 
-				assert(bodySID == p_info->GetBodySID());
-				assert(indexSID == p_info->GetIndexSID() || !p_info->SIDsKnown());
+			assert(bodySID == p_info->GetBodySID());
+			assert(indexSID == p_info->GetIndexSID() || !p_info->SIDsKnown());
 
-				if(indexSID != 0)
+			if(indexSID != 0)
+			{
+				if(_index_map.find(indexSID) == _index_map.end())
 				{
-					if(_index_map.find(indexSID) == _index_map.end())
-					{
-						_index_map[ indexSID ] = new mxflib::IndexTable;
-					}
+					_index_map[ indexSID ] = new mxflib::IndexTable;
+				}
 
-					mxflib::IndexTablePtr Table = _index_map[ indexSID ];
+				mxflib::IndexTablePtr Table = _index_map[ indexSID ];
 
-					mxflib::MDObjectListPtr segments = partition->ReadIndex();
+				mxflib::MDObjectListPtr segments = partition->ReadIndex();
 
-					if(segments)
-					{
-						assert(partition->GetInt64(IndexByteCount_UL) > 0);
+				if(segments)
+				{
+					assert(partition->GetInt64(IndexByteCount_UL) > 0);
 
-						for(mxflib::MDObjectList::iterator it = segments->begin(); it != segments->end(); ++it)
-						{
-							Table->AddSegment(*it);
-						}
+					for(mxflib::MDObjectList::iterator it = segments->begin(); it != segments->end(); ++it)
+					{
+						Table->AddSegment(*it);
 					}
 				}
 			}
-			else
-				assert(false); // didn't see that coming
 		}
+		else
+			assert(false); // didn't see that coming
+
+		_last_partition = p->first;
 	}
-	else
-		throw InputExc("Couldn't get RIP");
+}
+
+
+bool
+InputFile::update()
+{
+	if(!_follow)
+		return false;
+
+	const Position old_end = _file->GetFollowEnd();
+
+	const int found = _file->FollowRIP();
+
+	if(found < 0)
+		throw IoExc("Error following growing file");
+
+	// only the new partitions need to be read, the index segments before them are already in the tables
+	if(found > 0)
+		readIndexSegments( _file->FileRIP.upper_bound(_last_partition) );
+
+	return (_file->GetFollowEnd() != old_end);
+}
+
+
+Length
+InputFile::getReadableDuration() const
+{
+	if(!_follow)
+		return getDuration();
+
+	Length duration = -1;
+
+	for(IndexMap::const_iterator idx = _index_map.begin(); idx != _index_map.end(); ++idx)
+	{
+		mxflib::IndexTablePtr table = idx->second;
+
+		const Length table_duration = (table->EditUnitByteCount ? getCBRDuration(table) : table->GetDuration());
+
+		if(duration < 0 || table_duration < duration)
+			duration = table_duration;
+	}
+
+	return (duration < 0 ? 0 : duration);
+}
+
+
+Length
+InputFile::getCBRDuration(mxflib::IndexTablePtr table) const
+{
+	// A CBR index table won't have a useful IndexDuration while the file is being written,
+	// so count the edit units that fit in the essence written so far.
+
+	mxflib::MXFFilePtr file = _file;
+
+	// the last partition with this stream's essence
+	mxflib::RIP::reverse_iterator p = file->FileRIP.rbegin();
+
+	while(p != file->FileRIP.rend() && p->second->GetBodySID() != table->BodySID)
+		++p;
+
+	if(p == file->FileRIP.rend())
+		return 0;
+
+	mxflib::PartitionInfoPtr p_info = p->second;
+
+	mxflib::PartitionPtr partition = p_info->GetPartition();
+
+	if(!partition)
+	{
+		file->Seek(p_info->ByteOffset);
+
+		partition = file->ReadPartition();
+
+		if(!partition)
+			return 0;
+
+		p_info->SetPartition(partition);
+	}
+
+	Position essence_start = p_info->GetEssenceStart();
+
+	if(essence_start < 0)
+	{
+		if( !partition->SeekEssence() )
+			return 0;
+
+		essence_start = file->Tell();
+
+		p_info->SetEssenceStart(essence_start);
+	}
+
+	// the essence runs up to the next partition, or to the end of the complete KLVs in the file
+	mxflib::RIP::iterator next = p.base();
+
+	const Position essence_end = (next != file->FileRIP.end() ? next->first : file->GetFollowEnd());
+
+	if(essence_end <= essence_start)
+		return 0;
+
+	const Position stream_bytes = partition->GetInt64(BodyOffset_UL) + (essence_end - essence_start);
+
+	return (stream_bytes / table->EditUnitByteCount);
 }
 
 
@@ -177,6 +309,10 @@ InputFile::~InputFile()
 Length
 InputFile::getDuration() const
 {
+	// the metadata won't have the final duration until the file is finished
+	if(_follow)
+		return getReadableDuration();
+
 	Length duration = 0;
 
 #ifdef NDEBUG
@@ -335,6 +471,13 @@ InputFile::getFrame(Position EditUnit, SID bodySID, SID indexSID)
 	if(EditUnit < 0)
 		throw ArgExc("Can't get negative frame number");
 
+	// clip wrapped essence is read directly from the KLV holding each track
+	const ClipParts &clip_parts = getClipParts(bodySID, indexSID);
+
+	if(!clip_parts.empty())
+		return getClipFrame(EditUnit, clip_parts);
+
+
 	FramePtr the_frame = new Frame;
 
 	Frame::FrameParts &frameparts = the_frame->getFrameParts();
@@ -433,6 +576,151 @@ InputFile::getFrame(Position EditUnit, SID bodySID, SID indexSID)
 }
 
 
+const InputFile::ClipParts &
+InputFile::getClipParts(SID bodySID, SID indexSID)
+{
+	ClipMap::const_iterator found = _clip_map.find(bodySID);
+
+	if(found != _clip_map.end())
+		return found->second;
+
+	ClipParts &parts = _clip_map[bodySID];
+
+
+	// the tracks stored in this essence container
+	std::map<TrackNum, SourceTrack *> source_tracks;
+
+	for(TrackMap::const_iterator t = _tracks.begin(); t != _tracks.end(); ++t)
+	{
+		if(SourceTrack *source = dynamic_cast<SourceTrack *>(t->second))
+		{
+			if(source->getBodySID() == bodySID)
+				source_tracks[ source->getNumber() ] = source;
+		}
+	}
+
+	if(source_tracks.size() == 0)
+		return parts;
+
+
+	mxflib::IndexTablePtr index;
+
+	IndexMap::const_iterator idx = _index_map.find(indexSID);
+
+	if(idx != _index_map.end())
+		index = idx->second;
+
+
+	// find the first essence KLV of each track
+	mxflib::BodyReaderPtr reader = new mxflib::BodyReader(_file);
+
+	Position pos = reader->Seek(bodySID, 0);
+
+	if(pos < 0)
+		return parts;
+
+	std::map<TrackNum, mxflib::KLVObjectPtr> first_klvs;
+
+	while(first_klvs.size() < source_tracks.size())
+	{
+		_file->Seek(pos);
+
+		mxflib::KLVObjectPtr obj = _file->ReadKLV();
+
+		if(!obj || mxflib::IsPartitionKey(obj->GetUL()->GetValue()))
+			break;
+
+		if(obj->GetGCElementKind().IsValid)
+		{
+			const TrackNum track_num = obj->GetGCTrackNumber();
+
+			// a second KLV for a track before all the tracks have been found means frame wrapping
+			if(first_klvs.find(track_num) != first_klvs.end())
+				break;
+
+			if(source_tracks.find(track_num) != source_tracks.end())
+				first_klvs[track_num] = obj;
+		}
+
+		pos += obj->GetKLSize() + obj->GetLength();
+	}
+
+	if(first_klvs.size() < source_tracks.size())
+		return parts;
+
+
+	// the essence is clip wrapped if each track's KLV holds more than one edit unit
+	ClipParts clip_parts;
+
+	for(std::map<TrackNum, mxflib::KLVObjectPtr>::const_iterator k = first_klvs.begin(); k != first_klvs.end(); ++k)
+	{
+		SourceTrack *track = source_tracks[k->first];
+
+		mxflib::KLVObjectPtr obj = k->second;
+
+		ClipPart part;
+
+		const AudioDescriptor *audio = dynamic_cast<const AudioDescriptor *>(&track->getDescriptor());
+
+		if(audio)
+		{
+			// sound has a whole number of samples in each edit unit, with a repeating sequence such as
+			// 1602, 1601, 1602, 1601, 1602 for 48kHz at 30000/1001
+			const Rational &sampling_rate = audio->getAudioSamplingRate();
+
+			const UInt32 block_align = audio->getChannelCount() * ((audio->getBitDepth() + 7) / 8);
+
+			if(sampling_rate.Denominator == 1 && sampling_rate.Numerator > 0)
+				part.map = mxflib::ClipWrapMap(track->getEditRate(), sampling_rate.Numerator, block_align);
+		}
+		else if(index && index->EditUnitByteCount != 0)
+		{
+			part.map = mxflib::ClipWrapMap(index->EditUnitByteCount);
+		}
+
+		if(!part.map.IsValid() || part.map.GetDuration(obj->GetLength()) <= 1)
+			return parts;
+
+		part.reader = new mxflib::KLVValueReader(obj);
+
+		clip_parts[k->first] = part;
+	}
+
+	parts = clip_parts;
+
+	return parts;
+}
+
+
+FramePtr
+InputFile::getClipFrame(Position EditUnit, const ClipParts &parts)
+{
+	FramePtr the_frame = new Frame;
+
+	Frame::FrameParts &frameparts = the_frame->getFrameParts();
+
+	for(ClipParts::const_iterator p = parts.begin(); p != parts.end(); ++p)
+	{
+		const mxflib::ClipWrapMap &map = p->second.map;
+
+		mxflib::KLVValueReaderPtr reader = p->second.reader;
+
+		if(EditUnit >= map.GetDuration(reader->GetLength()))
+			throw ArgExc("Frame is beyond the end of the clip wrapped essence");
+
+		// a single positional read of just this edit unit
+		mxflib::DataChunkPtr data = reader->ReadEditUnits(map, EditUnit);
+
+		if(data->Size != map.GetSize(EditUnit))
+			throw IoExc("Error reading clip wrapped essence");
+
+		frameparts[p->first] = new FramePart(data);
+	}
+
+	return the_frame;
+}
+
+
 mxflib::PackagePtr
 InputFile::findPackage(mxflib::MetadataParent mdata, const mxflib::UMID &package_id)
 {
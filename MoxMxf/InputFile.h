@@ -25,13 +25,19 @@ namespace MoxMxf
 	{
 	  public:
 		FramePart(mxflib::KLVObjectPtr obj) : _obj(obj) {}
+		FramePart(mxflib::DataChunkPtr data) : _data(data) {} // data already read, such as one edit unit of clip wrapped essence
 		~FramePart() {}
 
 		mxflib::DataChunk & getData();
-		Length getDataSize() { return _obj->GetLength(); } // GetLength() should be const
+		Length getDataSize() { return _obj ? _obj->GetLength() : _data->Size; } // GetLength() should be const
+
+		// For parts too large to hold in memory, such as clip wrapped essence, read the data a window at a time.
+		// Returns NULL for a part whose data has already been read.
+		mxflib::KLVValueReaderPtr getReader(size_t window_size = 1024 * 1024, bool read_ahead = false) { return _obj ? new mxflib::KLVValueReader(_obj, window_size, read_ahead) : NULL; }
 
 	  private:
 		mxflib::KLVObjectPtr _obj;
+		mxflib::DataChunkPtr _data;
 	};
 
 	typedef mxflib::SmartPtr<FramePart> FramePartPtr;
@@ -67,7 +73,7 @@ namespace MoxMxf
 	class InputFile
 	{
 	  public:
-		InputFile(IOStream &infile);
+		InputFile(IOStream &infile, bool follow = false);
 		~InputFile();
 
 		typedef std::map<TrackNum, Track *> TrackMap;
@@ -77,6 +83,14 @@ namespace MoxMxf
 		Length getDuration() const;
 		Rational getEditRate() const;
 
+		// For a file that is still being written (opened with follow = true), pick up any
+		// partitions and index segments added since the last call.  Returns true if the file grew.
+		bool update();
+
+		// Number of edit units that have been completely written and can be read with getFrame().
+		// Equal to getDuration() for a finished file.
+		Length getReadableDuration() const;
+
 		FramePtr getFrame(Position EditUnit, SID bodySID, SID indexSID);
 
 		static mxflib::PackagePtr findPackage(mxflib::MetadataParent mdata, const mxflib::UMID &package_id);
@@ -90,6 +104,26 @@ namespace MoxMxf
 
 		typedef std::map<UInt32, mxflib::IndexTablePtr> IndexMap;
 		IndexMap _index_map;
+
+		bool _follow;
+		Position _last_partition; // byte offset of the last partition whose index segments have been read
+
+		void readIndexSegments(mxflib::RIP::iterator p);
+		Length getCBRDuration(mxflib::IndexTablePtr table) const;
+
+		// A track's clip wrapped essence: the single KLV holding it and the byte range of each edit unit within that KLV
+		struct ClipPart
+		{
+			mxflib::KLVValueReaderPtr reader;
+			mxflib::ClipWrapMap map;
+		};
+
+		typedef std::map<TrackNum, ClipPart> ClipParts;
+		typedef std::map<SID, ClipParts> ClipMap;
+		ClipMap _clip_map; // by BodySID, empty for frame wrapped essence
+
+		const ClipParts & getClipParts(SID bodySID, SID indexSID);
+		FramePtr getClipFrame(Position EditUnit, const ClipParts &parts);
 	};
 
 } // namespace
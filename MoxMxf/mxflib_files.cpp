@@ -52,6 +52,18 @@ UInt64 FileWrite(FileHandle file, const unsigned char *source, UInt64 size)
 }
 
 
+size_t FileWriteV(FileHandle file, const unsigned char *first, size_t firstsize, const unsigned char *second, size_t secondsize)
+{
+	MoxMxf::IOStream &stream = MoxMxf::GetIOStream(file);
+
+	// The client stream has no gather write, so write the two buffers in turn
+	size_t Ret = static_cast<size_t>(stream.FileWrite(first, firstsize));
+	if(Ret != firstsize) return Ret;
+
+	return Ret + static_cast<size_t>(stream.FileWrite(second, secondsize));
+}
+
+
 int FileGetc(FileHandle file)
 {
 	MoxMxf::IOStream &stream = MoxMxf::GetIOStream(file);
@@ -51,6 +51,14 @@
 using namespace IlmThread;
 #endif
 
+// Define LIBDPX_TRACE to record a trace span for each block read, see IlmThreadTrace.h
+#ifdef LIBDPX_TRACE
+#include <IlmThreadTrace.h>
+#define LIBDPX_TRACE_SPAN(name) IlmThread::TraceSpan ILMTHREAD_TRACE_CONCAT(libDpxTraceSpan, __LINE__)(name, "dpxlib")
+#else
+#define LIBDPX_TRACE_SPAN(name)
+#endif
+
 
 
 DPX_EXPORT dpx::Reader::Reader() : fd(0), rio(0)
@@ -176,6 +184,8 @@ class EndianSwapImageBufferTask : public Task
 
 DPX_EXPORT bool dpx::Reader::ReadBlock(void *data, const DataSize size, Block &block, const Descriptor desc)
 {
+	LIBDPX_TRACE_SPAN("dpx::Reader::ReadBlock");
+
 	int i;
 	int element;
 
@@ -0,0 +1,658 @@
+/*! \file	mxfbench.cpp
+ *	\brief	Read and write benchmarks for mxflib
+ *
+ *			Writes a synthetic MXF file (or uses an existing one) and times
+ *			opening it, reading it sequentially, reading random frames and
+ *			re-serializing its header. Results are output as JSON.
+ *
+ *			With --crypto it instead checks the AS-DCP crypto kernels against
+ *			known answers and times AES-128-CBC and HMAC-SHA1.
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "synthetic.h"
+#include "simd.h"
+#include "dumpobject.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace mxflib;
+using namespace mxfbench;
+
+#include "dict.h" // must put "using namespace mxflib" before this
+
+
+namespace
+{
+	//! Benchmark settings, from the command line
+	struct BenchOptions
+	{
+		SyntheticOptions Synthetic;			//!< Layout of the file to write
+		std::string FileName;				//!< File to write, or to read if ReadOnly
+		bool ReadOnly;						//!< Benchmark reading an existing file rather than writing one
+		bool Crypto;						//!< Test and benchmark the crypto kernels rather than a file
+		bool Keep;							//!< Don't delete the written file at the end
+		int Repeat;							//!< Number of times to repeat the open and header benchmarks
+		int RandomReads;					//!< Number of random frames to read
+		std::string JSONFile;				//!< File to write the results to, or "" for stdout
+
+		BenchOptions() : FileName("mxfbench.mxf"), ReadOnly(false), Crypto(false), Keep(false), Repeat(5), RandomReads(1000) {}
+	};
+
+
+	//! Message sink sending everything to stderr so it doesn't get mixed up with the results
+	class StderrSink : public MessageSink
+	{
+	public:
+		virtual void Message(MessageLevel Level, const char *Text)
+		{
+			fputs(MessagePrefix(Level), stderr);
+			fputs(Text, stderr);
+		}
+	};
+
+
+	//! Get the median of a set of timings, in microseconds
+	UInt64 Median(std::vector<UInt64> Times)
+	{
+		if(Times.empty()) return 0;
+
+		std::sort(Times.begin(), Times.end());
+		return Times[Times.size() / 2];
+	}
+
+
+	//! Get a percentile of a sorted set of timings
+	UInt64 Percentile(const std::vector<UInt64> &Sorted, int Percent)
+	{
+		if(Sorted.empty()) return 0;
+
+		size_t Index = (Sorted.size() * Percent) / 100;
+		if(Index >= Sorted.size()) Index = Sorted.size() - 1;
+
+		return Sorted[Index];
+	}
+
+
+	//! Get a rate in MB/s as a JSON number
+	std::string Rate(UInt64 Bytes, UInt64 Microseconds)
+	{
+		if(!Microseconds) return "0";
+
+		char Buffer[32];
+		snprintf(Buffer, sizeof(Buffer), "%.1f", static_cast<double>(Bytes) / static_cast<double>(Microseconds));
+		return Buffer;
+	}
+
+
+	//! Contents of a file after it has been opened
+	struct OpenedFile
+	{
+		MXFFilePtr File;					//!< The open file
+		PartitionPtr Master;				//!< The master partition, with its metadata read
+		MetadataPtr MData;					//!< The parsed metadata
+		IndexTablePtr Index;				//!< The index table for the essence, or NULL if none
+		UInt32 BodySID;						//!< BodySID of the essence
+	};
+
+
+	//! Open a file in the same way as a player would: RIP, then the master header metadata, then all index segments
+	bool OpenFile(const std::string &FileName, OpenedFile &Ret, bool CollectStats)
+	{
+		Ret.File = new MXFFile;
+		if(CollectStats) Ret.File->EnableStatistics();
+
+		if(!Ret.File->Open(FileName, true)) return false;
+
+		Ret.File->GetRIP();
+
+		Ret.Master = Ret.File->ReadMasterPartition();
+		if(!Ret.Master) return false;
+
+		Ret.Master->ReadMetadata();
+		Ret.MData = Ret.Master->ParseMetadata();
+		if(!Ret.MData) return false;
+
+		// Find the first essence stream
+		Ret.BodySID = 0;
+		UInt32 IndexSID = 0;
+		MDObjectPtr ContentStorage = Ret.MData[ContentStorageObject_UL];
+		if(ContentStorage) ContentStorage = ContentStorage->GetLink();
+		if(ContentStorage)
+		{
+			MDObjectPtr ECDataSets = ContentStorage[EssenceDataObjects_UL];
+			if(ECDataSets && !ECDataSets->empty())
+			{
+				MDObjectPtr ECData = ECDataSets->front().second->GetLink();
+				if(ECData)
+				{
+					Ret.BodySID = ECData->GetUInt(BodySID_UL);
+					IndexSID = ECData->GetUInt(IndexSID_UL);
+				}
+			}
+		}
+
+		if(IndexSID)
+		{
+			Ret.Index = new IndexTable;
+			Ret.Index->IndexSID = IndexSID;
+
+			RIP::iterator it = Ret.File->FileRIP.begin();
+			while(it != Ret.File->FileRIP.end())
+			{
+				Ret.File->Seek((*it).second->ByteOffset);
+				PartitionPtr ThisPartition = Ret.File->ReadPartition();
+
+				if(ThisPartition && (ThisPartition->GetUInt(IndexSID_UL) == IndexSID) && (ThisPartition->GetInt64(IndexByteCount_UL) > 0))
+				{
+					DataChunkPtr Segments = ThisPartition->ReadIndexChunk();
+					if(Segments) Ret.Index->AddSegments(Segments);
+				}
+
+				it++;
+			}
+		}
+
+		return true;
+	}
+
+
+	//! Read handler that reads the whole of each essence value, in fixed size windows
+	class CountingHandler : public GCReadHandler_Base
+	{
+	public:
+		UInt64 Bytes;						//!< Number of value bytes read
+		UInt64 KLVs;						//!< Number of KLVs read
+
+		CountingHandler() : Bytes(0), KLVs(0) {}
+
+		virtual bool HandleData(GCReaderPtr Caller, KLVObjectPtr Object)
+		{
+			UNUSED_PARAMETER(Caller);
+
+			KLVValueReader Reader(Object, 4 * 1024 * 1024);
+
+			DataChunkPtr Window;
+			while((Window = Reader.ReadNext())) Bytes += Window->Size;
+
+			KLVs++;
+			return true;
+		}
+	};
+
+
+	//! Time writing the synthetic file
+	std::string BenchWrite(const BenchOptions &Options)
+	{
+		UInt64 Start = StatisticsTimer::Now();
+		Length Size = WriteSynthetic(Options.FileName, Options.Synthetic);
+		UInt64 Time = StatisticsTimer::Now() - Start;
+
+		if(Size < 0) return "";
+
+		return "{\"Bytes\":" + Int64toString(Size) + ",\"Time\":" + UInt64toString(Time) + ",\"MBps\":" + Rate(static_cast<UInt64>(Size), Time) + "}";
+	}
+
+
+	//! Time opening the file, and report the I/O statistics of the first open
+	std::string BenchOpen(const BenchOptions &Options)
+	{
+		std::vector<UInt64> Times;
+		std::string Stats;
+
+		for(int i = 0; i < Options.Repeat; i++)
+		{
+			OpenedFile Opened;
+
+			UInt64 Start = StatisticsTimer::Now();
+			bool Result = OpenFile(Options.FileName, Opened, i == 0);
+			Times.push_back(StatisticsTimer::Now() - Start);
+
+			if(!Result) return "";
+
+			if(i == 0) Stats = Opened.File->GetStatistics().GetJSON();
+			Opened.File->Close();
+		}
+
+		return "{\"Median\":" + UInt64toString(Median(Times)) + ",\"Statistics\":" + Stats + "}";
+	}
+
+
+	//! Time reading all the essence in file order
+	std::string BenchSequential(const BenchOptions &Options)
+	{
+		OpenedFile Opened;
+		if(!OpenFile(Options.FileName, Opened, false)) return "";
+
+		CountingHandler *Handler = new CountingHandler;
+		GCReadHandlerPtr HandlerPtr(Handler);
+
+		UInt64 Start = StatisticsTimer::Now();
+
+		BodyReaderPtr Reader = new BodyReader(Opened.File);
+		Reader->Seek(0);
+		Reader->SetDefaultHandler(HandlerPtr);
+		Reader->MakeGCReader(Opened.BodySID, HandlerPtr);
+
+		for(;;)
+		{
+			Reader->ReadFromFile();
+			if(Reader->Eof()) break;
+			if(!Reader->ReSync()) break;
+		}
+
+		UInt64 Time = StatisticsTimer::Now() - Start;
+		Opened.File->Close();
+
+		std::string Ret = "{\"Bytes\":" + UInt64toString(Handler->Bytes) + ",\"KLVs\":" + UInt64toString(Handler->KLVs);
+		Ret += ",\"Time\":" + UInt64toString(Time) + ",\"MBps\":" + Rate(Handler->Bytes, Time);
+
+		// Frames per second, in edit units of the synthetic file if that is what we wrote
+		if(!Options.ReadOnly && Time) Ret += ",\"FramesPerSecond\":" + Int64toString((Options.Synthetic.Frames * 1000000) / static_cast<Int64>(Time));
+
+		return Ret + "}";
+	}
+
+
+	//! Time reading single frames in a random order, using the index table as a player's getFrame would
+	std::string BenchRandom(const BenchOptions &Options)
+	{
+		OpenedFile Opened;
+		if(!OpenFile(Options.FileName, Opened, false)) return "";
+
+		if(!Opened.Index)
+		{
+			warning("No index table in %s, so random frame reads skipped\n", Options.FileName.c_str());
+			return "";
+		}
+
+		Length Duration = Options.ReadOnly ? Opened.Index->GetDuration() : Options.Synthetic.Frames;
+		if(Duration <= 0)
+		{
+			warning("Unknown duration for %s, so random frame reads skipped\n", Options.FileName.c_str());
+			return "";
+		}
+
+		BodyReaderPtr Reader = new BodyReader(Opened.File);
+
+		// For clip wrapping locate the single essence KLV, and use the constant edit unit size to find frames within it
+		KLVValueReaderPtr ClipReader;
+		ClipWrapMap ClipMap(Opened.Index->EditUnitByteCount);
+		if(Opened.Index->EditUnitByteCount)
+		{
+			Position ClipStart = Reader->Seek(Opened.BodySID, 0);
+			if(ClipStart < 0) return "";
+
+			Opened.File->Seek(ClipStart);
+			KLVObjectPtr Clip = Opened.File->ReadKLV();
+			if(!Clip) return "";
+
+			ClipReader = new KLVValueReader(Clip);
+		}
+
+		std::vector<UInt64> Times;
+		UInt64 Bytes = 0;
+
+		UInt32 Random = 0x9e3779b9;
+		for(int i = 0; i < Options.RandomReads; i++)
+		{
+			Random ^= Random << 13;
+			Random ^= Random >> 17;
+			Random ^= Random << 5;
+			Position EditUnit = static_cast<Position>(Random % static_cast<UInt32>(Duration));
+
+			UInt64 Start = StatisticsTimer::Now();
+
+			Length FrameSize = -1;
+			if(ClipReader)
+			{
+				DataChunkPtr Frame = ClipReader->ReadEditUnits(ClipMap, EditUnit);
+				if(Frame) FrameSize = Frame->Size;
+			}
+			else
+			{
+				IndexPosPtr Pos = Opened.Index->Lookup(EditUnit);
+				Position FilePos = Pos ? Reader->Seek(Opened.BodySID, Pos->Location) : -1;
+
+				if(FilePos >= 0)
+				{
+					Opened.File->Seek(FilePos);
+					KLVObjectPtr Object = Opened.File->ReadKLV();
+					if(Object && Object->ReadData()) FrameSize = Object->GetData().Size;
+				}
+			}
+
+			Times.push_back(StatisticsTimer::Now() - Start);
+
+			if(FrameSize < 0)
+			{
+				error("Failed to read edit unit %s of %s\n", Int64toString(EditUnit).c_str(), Options.FileName.c_str());
+				return "";
+			}
+
+			Bytes += FrameSize;
+		}
+
+		Opened.File->Close();
+
+		std::sort(Times.begin(), Times.end());
+
+		std::string Ret = "{\"Reads\":" + Int64toString(Options.RandomReads) + ",\"Bytes\":" + UInt64toString(Bytes);
+		Ret += ",\"P50\":" + UInt64toString(Percentile(Times, 50));
+		Ret += ",\"P90\":" + UInt64toString(Percentile(Times, 90));
+		Ret += ",\"P99\":" + UInt64toString(Percentile(Times, 99));
+		Ret += ",\"Max\":" + UInt64toString(Times.empty() ? 0 : Times.back());
+
+		return Ret + "}";
+	}
+
+
+	//! Time serializing the header metadata to memory
+	std::string BenchHeader(const BenchOptions &Options)
+	{
+		OpenedFile Opened;
+		if(!OpenFile(Options.FileName, Opened, false)) return "";
+		Opened.File->Close();
+
+		std::vector<UInt64> Times;
+		Length Size = 0;
+
+		for(int i = 0; i < Options.Repeat; i++)
+		{
+			UInt64 Start = StatisticsTimer::Now();
+
+			PartitionPtr Header = new Partition(ClosedCompleteHeader_UL);
+			Header->AddMetadata(Opened.MData);
+
+			MXFFilePtr Memory = new MXFFile;
+			Memory->OpenMemory();
+			Memory->WritePartition(Header);
+			Size = Memory->Tell();
+
+			Times.push_back(StatisticsTimer::Now() - Start);
+
+			Memory->Close();
+		}
+
+		return "{\"Bytes\":" + Int64toString(Size) + ",\"Median\":" + UInt64toString(Median(Times)) + "}";
+	}
+
+
+	//! Add a named result to a JSON object, with null if the benchmark was not run or failed
+	void AddResult(std::string &JSON, const char *Name, const std::string &Result)
+	{
+		if(JSON.size() > 1) JSON += ",";
+		JSON += std::string("\"") + Name + "\":" + (Result.empty() ? std::string("null") : Result);
+	}
+
+
+	//! Get the size of each buffer used in the crypto benchmarks - AES-CBC only works on whole blocks
+	size_t CryptoFrameSize(const BenchOptions &Options)
+	{
+		size_t Ret = Options.Synthetic.FrameSize & ~static_cast<size_t>(15);
+		return Ret ? Ret : 16;
+	}
+
+
+	//! Time one crypto operation over the whole of a buffer, a frame at a time
+	/*! \param Op 0 to encrypt, 1 to decrypt, 2 to hash
+	 */
+	std::string BenchCryptoOp(const BenchOptions &Options, int Op, DataChunk &Buffer)
+	{
+		static const UInt8 Key[16] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+		static const UInt8 IV[16] = { 0 };
+
+		// The objects pick their kernels when constructed, so these follow the current feature mask
+		AESEncrypt Enc;
+		AESDecrypt Dec;
+		HashHMACSHA1 Hasher;
+		Enc.SetKey(16, Key);
+		Enc.SetIV(16, IV);
+		Dec.SetKey(16, Key);
+		Dec.SetIV(16, IV);
+		Hasher.SetKey(16, Key);
+
+		UInt64 Bytes = 0;
+		UInt64 Start = StatisticsTimer::Now();
+
+		for(Length i = 0; i < Options.Synthetic.Frames; i++)
+		{
+			bool Result = true;
+			if(Op == 0) Result = Enc.EncryptInPlace(Buffer.Size, Buffer.Data);
+			else if(Op == 1) Result = Dec.DecryptInPlace(Buffer.Size, Buffer.Data);
+			else
+			{
+				Hasher.HashData(Buffer.Size, Buffer.Data);
+				Hasher.GetHash();
+			}
+
+			if(!Result) return "";
+			Bytes += Buffer.Size;
+		}
+
+		UInt64 Time = StatisticsTimer::Now() - Start;
+
+		return "{\"Bytes\":" + UInt64toString(Bytes) + ",\"Time\":" + UInt64toString(Time) + ",\"MBps\":" + Rate(Bytes, Time) + "}";
+	}
+
+
+	//! Run the crypto known-answer tests and time each operation with the kernels allowed by the current feature mask
+	/*! \param Passed Cleared if any known-answer test fails
+	 */
+	std::string BenchCrypto(const BenchOptions &Options, bool &Passed)
+	{
+		std::string Ret = "{";
+
+		bool SelfTest = ASDCPCryptoSelfTest();
+		if(!SelfTest) Passed = false;
+		Ret += std::string("\"SelfTest\":") + (SelfTest ? "true" : "false");
+
+		DataChunk Buffer(CryptoFrameSize(Options));
+		memset(Buffer.Data, 0x5a, Buffer.Size);
+
+		AddResult(Ret, "Encrypt", BenchCryptoOp(Options, 0, Buffer));
+		AddResult(Ret, "Decrypt", BenchCryptoOp(Options, 1, Buffer));
+		AddResult(Ret, "HMAC", BenchCryptoOp(Options, 2, Buffer));
+
+		return Ret + "}";
+	}
+
+
+	//! Describe the synthetic file as JSON
+	std::string ConfigJSON(const BenchOptions &Options)
+	{
+		const SyntheticOptions &S = Options.Synthetic;
+
+		if(Options.Crypto)
+		{
+			return "{\"Crypto\":true,\"Frames\":" + Int64toString(S.Frames) + ",\"FrameSize\":" + UInt64toString(CryptoFrameSize(Options)) + "}";
+		}
+
+		std::string Ret = "{\"File\":";
+		DumpStringOutput Out(Ret);
+		WriteJSONString(Out, Options.FileName);
+		Out.Flush();
+		if(Options.ReadOnly) return Ret + "}";
+
+		Ret += ",\"Frames\":" + Int64toString(S.Frames);
+		Ret += ",\"FrameSize\":" + UInt64toString(S.FrameSize);
+		Ret += std::string(",\"VariableSize\":") + (S.VariableSize ? "true" : "false");
+		Ret += std::string(",\"ClipWrap\":") + (S.ClipWrap ? "true" : "false");
+		Ret += std::string(",\"Index\":") + (S.Index ? "true" : "false");
+		Ret += ",\"PartitionDuration\":" + Int64toString(S.PartitionDuration);
+		Ret += ",\"HeaderTracks\":" + Int64toString(S.HeaderTracks);
+		Ret += std::string(",\"Encrypt\":") + (S.Encrypt ? "true" : "false");
+
+		return Ret + "}";
+	}
+
+
+	//! Parse a size with an optional k, M or G suffix
+	UInt64 ParseSize(const char *Text)
+	{
+		char *End;
+		UInt64 Ret = strtoull(Text, &End, 10);
+
+		switch(*End)
+		{
+		case 'k': case 'K': Ret *= 1024; break;
+		case 'm': case 'M': Ret *= 1024 * 1024; break;
+		case 'g': case 'G': Ret *= 1024 * 1024 * 1024; break;
+		default: break;
+		}
+
+		return Ret;
+	}
+
+
+	void Usage(void)
+	{
+		fprintf(stderr, "Usage: mxfbench [options] [file]\n\n");
+		fprintf(stderr, "Writes a synthetic MXF file, then times opening, reading and re-serializing it\n\n");
+		fprintf(stderr, "  --frames N          Number of frames (default 1000)\n");
+		fprintf(stderr, "  --frame-size N      Size of each frame, with optional k, M or G suffix (default 1M)\n");
+		fprintf(stderr, "  --vbr               Vary frame sizes by up to 12.5%% either way\n");
+		fprintf(stderr, "  --clip              Clip wrap rather than frame wrap\n");
+		fprintf(stderr, "  --no-index          Don't write an index table\n");
+		fprintf(stderr, "  --partition N       Start a new body partition every N frames\n");
+		fprintf(stderr, "  --header-tracks N   Add N extra tracks to enlarge the header metadata\n");
+		fprintf(stderr, "  --encrypt           Encrypt the essence\n");
+		fprintf(stderr, "  --crypto            Check the crypto kernels against known answers, then time\n");
+		fprintf(stderr, "                      AES-128-CBC and HMAC-SHA1 over --frames buffers of --frame-size\n");
+		fprintf(stderr, "  --read              Benchmark reading the existing file rather than writing a new one\n");
+		fprintf(stderr, "  --random N          Number of random frame reads (default 1000)\n");
+		fprintf(stderr, "  --repeat N          Number of times to repeat the open and header timings (default 5)\n");
+		fprintf(stderr, "  --keep              Keep the written file\n");
+		fprintf(stderr, "  --json FILE         Write the results to FILE rather than stdout\n");
+		fprintf(stderr, "\nAll times are in microseconds\n");
+	}
+
+
+	//! Parse the command line
+	bool ParseCommandLine(int argc, char *argv[], BenchOptions &Options)
+	{
+		for(int i = 1; i < argc; i++)
+		{
+			std::string Arg = argv[i];
+			bool HasValue = (i + 1) < argc;
+
+			if(Arg == "--frames" && HasValue) Options.Synthetic.Frames = strtoll(argv[++i], NULL, 10);
+			else if(Arg == "--frame-size" && HasValue) Options.Synthetic.FrameSize = static_cast<size_t>(ParseSize(argv[++i]));
+			else if(Arg == "--vbr") Options.Synthetic.VariableSize = true;
+			else if(Arg == "--clip") Options.Synthetic.ClipWrap = true;
+			else if(Arg == "--no-index") Options.Synthetic.Index = false;
+			else if(Arg == "--partition" && HasValue) Options.Synthetic.PartitionDuration = strtoll(argv[++i], NULL, 10);
+			else if(Arg == "--header-tracks" && HasValue) Options.Synthetic.HeaderTracks = atoi(argv[++i]);
+			else if(Arg == "--encrypt") Options.Synthetic.Encrypt = true;
+			else if(Arg == "--crypto") Options.Crypto = true;
+			else if(Arg == "--read") Options.ReadOnly = true;
+			else if(Arg == "--random" && HasValue) Options.RandomReads = atoi(argv[++i]);
+			else if(Arg == "--repeat" && HasValue) Options.Repeat = atoi(argv[++i]);
+			else if(Arg == "--keep") Options.Keep = true;
+			else if(Arg == "--json" && HasValue) Options.JSONFile = argv[++i];
+			else if(Arg.size() && (Arg[0] != '-')) Options.FileName = Arg;
+			else return false;
+		}
+
+		if(Options.Repeat < 1) Options.Repeat = 1;
+		if(Options.Synthetic.Frames < 1) Options.Synthetic.Frames = 1;
+
+		return true;
+	}
+}
+
+
+int main(int argc, char *argv[])
+{
+	BenchOptions Options;
+	if(!ParseCommandLine(argc, argv, Options))
+	{
+		Usage();
+		return 1;
+	}
+
+	StderrSink Sink;
+	SetMessageSink(&Sink);
+	SetMessageLevel(MessageLevelWarning);
+
+	LoadDictionary(DictData);
+
+	std::string Results = "{";
+	bool Passed = true;
+
+	if(Options.Crypto)
+	{
+		AddResult(Results, "Accelerated", BenchCrypto(Options, Passed));
+
+		SetCPUFeatureMask(0);
+		AddResult(Results, "Portable", BenchCrypto(Options, Passed));
+		SetCPUFeatureMask(~static_cast<UInt32>(0));
+	}
+	else if(!Options.ReadOnly)
+	{
+		std::string Write = BenchWrite(Options);
+		AddResult(Results, "Write", Write);
+
+		if(Write.empty())
+		{
+			error("Failed to write %s\n", Options.FileName.c_str());
+			return 2;
+		}
+	}
+
+	if(!Options.Crypto)
+	{
+		AddResult(Results, "Open", BenchOpen(Options));
+		AddResult(Results, "Sequential", BenchSequential(Options));
+		AddResult(Results, "Random", BenchRandom(Options));
+		AddResult(Results, "Header", BenchHeader(Options));
+	}
+
+	Results += "}";
+
+	std::string JSON = "{\"Config\":" + ConfigJSON(Options) + ",\"Results\":" + Results + "}\n";
+
+	if(Options.JSONFile.empty()) fputs(JSON.c_str(), stdout);
+	else
+	{
+		FILE *Out = fopen(Options.JSONFile.c_str(), "w");
+		if(!Out)
+		{
+			error("Can't open %s for writing\n", Options.JSONFile.c_str());
+			return 2;
+		}
+		fputs(JSON.c_str(), Out);
+		fclose(Out);
+	}
+
+	if(!Options.ReadOnly && !Options.Crypto && !Options.Keep) remove(Options.FileName.c_str());
+
+	SetMessageSink(NULL);
+
+	return Passed ? 0 : 3;
+}
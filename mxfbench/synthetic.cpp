@@ -0,0 +1,288 @@
+/*! \file	synthetic.cpp
+ *	\brief	Generator for synthetic MXF files used by mxfbench
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "synthetic.h"
+
+using namespace mxflib;
+using namespace mxfbench;
+
+
+namespace
+{
+	//! Essence container label for frame wrapped uncompressed picture
+	const UInt8 FrameWrappedEC_Data[16] = { 0x06, 0x0e, 0x2b, 0x34, 0x04, 0x01, 0x01, 0x01, 0x0d, 0x01, 0x03, 0x01, 0x02, 0x05, 0x7f, 0x01 };
+
+	//! Essence container label for clip wrapped uncompressed picture
+	const UInt8 ClipWrappedEC_Data[16] = { 0x06, 0x0e, 0x2b, 0x34, 0x04, 0x01, 0x01, 0x01, 0x0d, 0x01, 0x03, 0x01, 0x02, 0x05, 0x7f, 0x02 };
+
+	//! Simple repeatable pseudo-random number generator, so that files are identical between runs
+	UInt32 NextRandom(UInt32 &State)
+	{
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	}
+
+
+	//! Essence source supplying pseudo-random frames of the sizes given by a SyntheticOptions
+	/*! The data is sliced from a single pattern buffer without copying, except when encrypting as the
+	 *  encryption may be done in place.
+	 */
+	class SyntheticSource : public EssenceSource
+	{
+	protected:
+		SyntheticOptions Options;					//!< The layout being written
+		DataChunkPtr Pattern;						//!< Pattern data from which frames are taken
+		Position Frame;								//!< The frame currently being supplied
+		size_t Remaining;							//!< Bytes of the current frame not yet supplied, 0 if between frames
+
+	public:
+		SyntheticSource(const SyntheticOptions &Options) : Options(Options), Frame(0), Remaining(0)
+		{
+			// Allow for the largest variable frame plus a varying start offset
+			size_t PatternSize = Options.FrameSize + Options.FrameSize / 8 + 4096;
+			Pattern = new DataChunk(PatternSize);
+
+			UInt32 State = 0x2545f491;
+			for(size_t i = 0; i < PatternSize; i++) Pattern->Data[i] = static_cast<UInt8>(NextRandom(State) >> 24);
+		}
+
+		virtual size_t GetEssenceDataSize(void)
+		{
+			if(Remaining) return Remaining;
+			if(Frame >= Options.Frames) return 0;
+
+			// A clip is a single item holding all remaining frames
+			if(Options.ClipWrap) return static_cast<size_t>((Options.Frames - Frame) * static_cast<Length>(Options.FrameSize));
+
+			return SyntheticFrameSize(Options, Frame);
+		}
+
+		virtual DataChunkPtr GetEssenceData(size_t Size = 0, size_t MaxSize = 0)
+		{
+			if(!Remaining)
+			{
+				if(Frame >= Options.Frames) return NULL;
+				Remaining = SyntheticFrameSize(Options, Frame);
+			}
+
+			size_t Bytes = Remaining;
+			if(Size && (Size < Bytes)) Bytes = Size;
+			if(MaxSize && (MaxSize < Bytes)) Bytes = MaxSize;
+
+			size_t Offset = static_cast<size_t>((Frame * 977) % 4096);
+
+			DataChunkPtr Ret;
+			if(Options.Encrypt) Ret = new DataChunk(Bytes, &Pattern->Data[Offset]);
+			else Ret = new DataChunkView(Pattern, Offset, Bytes);
+
+			Remaining -= Bytes;
+			if(!Remaining) Frame++;
+
+			return Ret;
+		}
+
+		virtual bool EndOfItem(void)
+		{
+			if(Remaining) return false;
+			return Options.ClipWrap ? (Frame >= Options.Frames) : true;
+		}
+
+		virtual bool EndOfData(void) { return (Frame >= Options.Frames) && !Remaining; }
+
+		virtual UInt8 GetGCEssenceType(void) { return 0x15; }
+		virtual UInt8 GetGCElementType(void) { return Options.ClipWrap ? 0x02 : 0x01; }
+		virtual Rational GetEditRate(void) { return Options.EditRate; }
+		virtual Position GetCurrentPosition(void) { return Frame; }
+		virtual int GetBERSize(void) { return Options.ClipWrap ? 8 : 4; }
+
+		//! Clip wrapped essence is CBR, with no per-frame key or length
+		virtual UInt32 GetBytesPerEditUnit(UInt32 KAGSize = 1)
+		{
+			UNUSED_PARAMETER(KAGSize);
+
+			if(Options.ClipWrap) return static_cast<UInt32>(Options.FrameSize);
+			return 0;
+		}
+	};
+
+
+	//! Build the header metadata for a synthetic file
+	MetadataPtr BuildMetadata(const SyntheticOptions &Options)
+	{
+		MetadataPtr MData = new Metadata();
+
+		UL EssenceContainer(Options.ClipWrap ? ClipWrappedEC_Data : FrameWrappedEC_Data);
+
+		MData->SetOP(MXFOP1a_UL);
+		MData->AddEssenceType(EssenceContainer);
+
+		MDObjectPtr Ident = new MDObject(Identification_UL);
+		Ident->SetString(CompanyName_UL, "mxflib");
+		Ident->SetString(ProductName_UL, "mxfbench");
+		Ident->SetString(VersionString_UL, LibraryVersion());
+		Ident->SetString(ToolkitVersion_UL, LibraryProductVersion());
+		Ident->SetString(Platform_UL, "mxfbench synthetic file");
+		MData->UpdateGenerations(Ident);
+
+		// Material package
+		PackagePtr MaterialPackage = MData->AddMaterialPackage(MakeUMID(4));
+		MData->SetPrimaryPackage(MaterialPackage);
+
+		TrackPtr MaterialTimecode = MaterialPackage->AddTimecodeTrack(Options.EditRate);
+		MaterialTimecode->AddTimecodeComponent(0, Options.Frames);
+
+		TrackPtr MaterialPicture = MaterialPackage->AddPictureTrack(Options.EditRate);
+		SourceClipPtr MaterialClip = MaterialPicture->AddSourceClip(Options.Frames);
+
+		// Extra tracks purely to give a bigger header - each adds a track, a sequence and a timecode component
+		for(int i = 0; i < Options.HeaderTracks; i++)
+		{
+			TrackPtr Extra = MaterialPackage->AddTimecodeTrack(Options.EditRate, "Extra Timecode Track " + Int2String(i + 1));
+			Extra->AddTimecodeComponent(i * 1000, Options.Frames);
+		}
+
+		// File package
+		UMIDPtr FileUMID = MakeUMID(4);
+		PackagePtr FilePackage = MData->AddFilePackage(SyntheticBodySID, "", FileUMID);
+		MData->AddEssenceContainerData(FileUMID, SyntheticBodySID, Options.Index ? SyntheticIndexSID : 0);
+
+		TrackPtr FileTimecode = FilePackage->AddTimecodeTrack(Options.EditRate);
+		FileTimecode->AddTimecodeComponent(0, Options.Frames);
+
+		TrackPtr FilePicture = FilePackage->AddPictureTrack(Options.EditRate);
+		FilePicture->AddSourceClip(Options.Frames);
+		FilePicture->SetUInt(TrackNumber_UL, 0x15010000 | (Options.ClipWrap ? 0x0200 : 0x0100) | 1);
+
+		MaterialClip->MakeLink(FilePicture);
+
+		MDObjectPtr Descriptor = new MDObject(CDCIEssenceDescriptor_UL);
+		Descriptor->AddChild(SampleRate_UL)->SetInt("Numerator", Options.EditRate.Numerator);
+		Descriptor->AddChild(SampleRate_UL)->SetInt("Denominator", Options.EditRate.Denominator);
+		Descriptor->AddChild(ContainerDuration_UL)->SetInt64(Options.Frames);
+		Descriptor->AddChild(EssenceContainer_UL)->SetValue(EssenceContainer.GetValue(), EssenceContainer.Size());
+		Descriptor->AddChild(LinkedTrackID_UL)->SetUInt(FilePicture->GetUInt(TrackID_UL));
+		Descriptor->AddChild(StoredWidth_UL)->SetUInt(1920);
+		Descriptor->AddChild(StoredHeight_UL)->SetUInt(1080);
+		Descriptor->AddChild(ComponentDepth_UL)->SetUInt(8);
+
+		FilePackage->AddChild(Descriptor_UL)->MakeLink(Descriptor);
+
+		return MData;
+	}
+}
+
+
+//! Get the size of a given frame of a synthetic file
+size_t mxfbench::SyntheticFrameSize(const SyntheticOptions &Options, Position Frame)
+{
+	if(!Options.VariableSize || Options.ClipWrap) return Options.FrameSize;
+
+	// Vary by up to 1/8th either way, repeatably for each frame
+	UInt32 State = static_cast<UInt32>(Frame * 2654435761u) | 1;
+	NextRandom(State);
+
+	size_t Range = Options.FrameSize / 4;
+	if(!Range) return Options.FrameSize;
+
+	return Options.FrameSize - Options.FrameSize / 8 + (NextRandom(State) % Range);
+}
+
+
+//! Write a synthetic MXF file
+/*! \return The number of bytes written, or -1 on error
+ */
+Length mxfbench::WriteSynthetic(const std::string &FileName, const SyntheticOptions &Options)
+{
+	if(Options.ClipWrap && (Options.VariableSize || Options.Encrypt || Options.PartitionDuration))
+	{
+		error("Synthetic clip wrapped files must be unencrypted, with fixed size frames in a single partition\n");
+		return -1;
+	}
+
+	MXFFilePtr File = new MXFFile;
+	if(!File->OpenNew(FileName))
+	{
+		error("Can't open \"%s\" for writing\n", FileName.c_str());
+		return -1;
+	}
+
+	BodyWriterPtr Writer = new BodyWriter(File);
+	Writer->SetKAG(Options.KAG);
+	Writer->SetForceBER4(true);
+
+	PartitionPtr Header = new Partition(ClosedCompleteHeader_UL);
+	Header->SetKAG(Options.KAG);
+	Header->AddMetadata(BuildMetadata(Options));
+	Writer->SetPartition(Header);
+
+	EssenceSourcePtr Source = new SyntheticSource(Options);
+	BodyStreamPtr Stream = new BodyStream(SyntheticBodySID, Source);
+	Stream->SetWrapType(Options.ClipWrap ? BodyStream::StreamWrapClip : BodyStream::StreamWrapFrame);
+
+	if(Options.Index)
+	{
+		Stream->SetIndexType(Options.ClipWrap ? BodyStream::StreamIndexCBRFooter : BodyStream::StreamIndexFullFooter);
+		Stream->SetIndexSID(SyntheticIndexSID);
+	}
+
+	Writer->AddStream(Stream);
+
+	if(Options.Encrypt)
+	{
+		// A fixed key and IV - these files are for timing, not for protecting anything
+		UInt8 Key[16], IV[16];
+		for(int i = 0; i < 16; i++) { Key[i] = static_cast<UInt8>(i * 7 + 1); IV[i] = static_cast<UInt8>(i * 13 + 3); }
+
+		AESEncrypt *Encrypt = new AESEncrypt;
+		Encrypt->SetKey(16, Key);
+		Encrypt->SetIV(16, IV, true);
+
+		HashHMACSHA1 *Hasher = new HashHMACSHA1;
+		Hasher->SetKey(16, Key);
+
+		Stream->GetWriter()->SetEncryption(Source->GetStreamID(), EncryptPtr(Encrypt), new mxflib::UUID, HashPtr(Hasher));
+	}
+
+	Writer->WriteHeader(true, true);
+
+	// WritePartition() will continue the same partition after writing the requested duration unless we end it,
+	// but don't end the last one or we would get an empty body partition before the footer
+	while(!Writer->BodyDone())
+	{
+		Writer->WritePartition(Options.PartitionDuration);
+		if(Options.PartitionDuration && !Source->EndOfData()) Writer->EndPartition();
+	}
+
+	Writer->WriteFooter(false, true);
+
+	Length Ret = File->Tell();
+	File->Close();
+
+	return Ret;
+}
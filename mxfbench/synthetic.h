@@ -0,0 +1,78 @@
+/*! \file	synthetic.h
+ *	\brief	Generator for synthetic MXF files used by mxfbench
+ *
+ *			The files hold a single picture track of pseudo-random bytes, so
+ *			the layout (wrapping, partitioning, indexing, header size and
+ *			encryption) can be varied independently of any real essence.
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#ifndef MXFBENCH__SYNTHETIC_H
+#define MXFBENCH__SYNTHETIC_H
+
+#include "mxflib.h"
+
+#include <string>
+
+namespace mxfbench
+{
+	using mxflib::Length;
+	using mxflib::Position;
+	using mxflib::Rational;
+	using mxflib::UInt32;
+
+	//! Layout of a synthetic MXF file
+	struct SyntheticOptions
+	{
+		Length Frames;						//!< Number of edit units of essence
+		size_t FrameSize;					//!< Size of each frame's essence in bytes (the average if VariableSize)
+		bool VariableSize;					//!< Vary frame sizes by up to +/- 12.5% around FrameSize (frame wrapping only)
+		bool ClipWrap;						//!< Clip wrap the essence in a single KLV, rather than one KLV per frame
+		bool Index;							//!< Write an index table in the footer (CBR for clip wrapping, VBR for frame wrapping)
+		Length PartitionDuration;			//!< Number of frames per body partition, or 0 for a single body partition
+		int HeaderTracks;					//!< Number of extra timecode tracks to add to the material package to make a bigger header
+		bool Encrypt;						//!< Write the essence as AS-DCP encrypted KLVs (frame wrapping only)
+		Rational EditRate;					//!< Edit rate of the essence
+		UInt32 KAG;							//!< KLV Alignment Grid
+
+		SyntheticOptions()
+			: Frames(1000), FrameSize(1024 * 1024), VariableSize(false), ClipWrap(false), Index(true), PartitionDuration(0),
+			  HeaderTracks(0), Encrypt(false), EditRate(25, 1), KAG(512) {}
+	};
+
+	//! Body and index SIDs used in synthetic files
+	const UInt32 SyntheticBodySID = 1;
+	const UInt32 SyntheticIndexSID = 2;
+
+	//! Get the size of a given frame of a synthetic file
+	size_t SyntheticFrameSize(const SyntheticOptions &Options, Position Frame);
+
+	//! Write a synthetic MXF file
+	/*! \return The number of bytes written, or -1 on error
+	 */
+	Length WriteSynthetic(const std::string &FileName, const SyntheticOptions &Options);
+}
+
+#endif // MXFBENCH__SYNTHETIC_H
@@ -27,6 +27,8 @@
 
 #include "mxflib.h"
 
+#include "simd.h"
+
 using namespace mxflib;
 
 
@@ -75,6 +77,474 @@ void AudioDemuxSource::CalcBytesPerEditUnit(Uint32 KAGSize)
 	}
 }
 
+namespace
+{
+	/* Portable demux kernels - one instantiation per sample size so that no size tests remain in the inner loops */
+
+	//! Read a little-endian sample of a fixed number of bytes
+	template<unsigned int Bytes> inline UInt32 ReadSample(const UInt8 *Source)
+	{
+		UInt32 Ret = Source[0];
+		if(Bytes > 1) Ret |= static_cast<UInt32>(Source[1]) << 8;
+		if(Bytes > 2) Ret |= static_cast<UInt32>(Source[2]) << 16;
+		if(Bytes > 3) Ret |= static_cast<UInt32>(Source[3]) << 24;
+		return Ret;
+	}
+
+	//! Write a little-endian sample of a fixed number of bytes
+	template<unsigned int Bytes> inline void WriteSample(UInt8 *Dest, UInt32 Sample)
+	{
+		Dest[0] = static_cast<UInt8>(Sample);
+		if(Bytes > 1) Dest[1] = static_cast<UInt8>(Sample >> 8);
+		if(Bytes > 2) Dest[2] = static_cast<UInt8>(Sample >> 16);
+		if(Bytes > 3) Dest[3] = static_cast<UInt8>(Sample >> 24);
+	}
+
+	//! Demux kernel for when the output sample size matches the source
+	template<unsigned int Bytes> void DemuxCopy(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets, size_t TargetCount)
+	{
+		DemuxTarget *TargetEnd = &Targets[TargetCount];
+
+		while(SampleCount--)
+		{
+			for(DemuxTarget *Target = Targets; Target != TargetEnd; Target++)
+			{
+				// DRAGONS: The fixed-size copy for single channels compiles to a single load and store
+				if(Target->ChannelCount == 1) memcpy(Target->Out, &Source[Target->Offset], Bytes);
+				else memcpy(Target->Out, &Source[Target->Offset], Target->Size);
+
+				Target->Out += Target->Size;
+			}
+
+			Source += SourceSampleSize;
+		}
+	}
+
+	//! Demux kernel for when the output sample size differs from the source
+	template<unsigned int InBytes, unsigned int OutBytes> void DemuxResize(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets, size_t TargetCount)
+	{
+		const int Shift = (static_cast<int>(OutBytes) - static_cast<int>(InBytes)) * 8;
+
+		DemuxTarget *TargetEnd = &Targets[TargetCount];
+
+		while(SampleCount--)
+		{
+			for(DemuxTarget *Target = Targets; Target != TargetEnd; Target++)
+			{
+				const UInt8 *In = &Source[Target->Offset];
+
+				unsigned int Channel = Target->ChannelCount;
+				while(Channel--)
+				{
+					UInt32 Sample = ReadSample<InBytes>(In);
+
+					// Adjust the bit size
+					if(Shift > 0) Sample <<= (Shift & 31); else Sample >>= ((-Shift) & 31);
+
+					WriteSample<OutBytes>(Target->Out, Sample);
+
+					In += InBytes;
+					Target->Out += OutBytes;
+				}
+			}
+
+			Source += SourceSampleSize;
+		}
+	}
+
+	//! Kernels for each sample size when not resizing, indexed by bytes per sample - 1
+	const DemuxKernel CopyKernels[4] = { DemuxCopy<1>, DemuxCopy<2>, DemuxCopy<3>, DemuxCopy<4> };
+
+	//! Kernels for each combination of sample sizes when resizing, indexed by source bytes - 1, then output bytes - 1
+	const DemuxKernel ResizeKernels[4][4] =
+	{
+		{ DemuxCopy<1>, DemuxResize<1, 2>, DemuxResize<1, 3>, DemuxResize<1, 4> },
+		{ DemuxResize<2, 1>, DemuxCopy<2>, DemuxResize<2, 3>, DemuxResize<2, 4> },
+		{ DemuxResize<3, 1>, DemuxResize<3, 2>, DemuxCopy<3>, DemuxResize<3, 4> },
+		{ DemuxResize<4, 1>, DemuxResize<4, 2>, DemuxResize<4, 3>, DemuxCopy<4> }
+	};
+
+
+#ifdef MXFLIB_X86_SIMD
+	/* Vectorized transpose kernels - each extracts a block of adjacent single channels from a run of samples
+	 * DRAGONS: Each of these loads 16 bytes from the first channel of the block in each sample processed,
+	 *          the caller must ensure that these loads are within the source buffer
+	 */
+
+	//! Transpose 8 adjacent 16-bit channels, 8 samples at a time
+	MXFLIB_TARGET("sse2") size_t Transpose16_SSE2(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets)
+	{
+		const UInt8 *In = &Source[Targets[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 8)
+		{
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(In));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize]));
+			__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 2]));
+			__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 3]));
+			__m128i r4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 4]));
+			__m128i r5 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 5]));
+			__m128i r6 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 6]));
+			__m128i r7 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 7]));
+
+			// Interleave pairs of samples: channels 0-3 and 4-7
+			__m128i a0 = _mm_unpacklo_epi16(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi16(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi16(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi16(r2, r3);
+			__m128i a4 = _mm_unpacklo_epi16(r4, r5);
+			__m128i a5 = _mm_unpackhi_epi16(r4, r5);
+			__m128i a6 = _mm_unpacklo_epi16(r6, r7);
+			__m128i a7 = _mm_unpackhi_epi16(r6, r7);
+
+			// Interleave groups of four samples: two channels in each
+			__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+			__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+			__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+			__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+			__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+			__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+			__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+			__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+			// Combine to give eight samples of each channel
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[0].Out), _mm_unpacklo_epi64(b0, b4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[1].Out), _mm_unpackhi_epi64(b0, b4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[2].Out), _mm_unpacklo_epi64(b1, b5));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[3].Out), _mm_unpackhi_epi64(b1, b5));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[4].Out), _mm_unpacklo_epi64(b2, b6));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[5].Out), _mm_unpackhi_epi64(b2, b6));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[6].Out), _mm_unpacklo_epi64(b3, b7));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[7].Out), _mm_unpackhi_epi64(b3, b7));
+
+			for(int i=0; i<8; i++) Targets[i].Out += 16;
+
+			In += SourceSampleSize * 8;
+			Done += 8;
+		}
+
+		return Done;
+	}
+
+	//! Transpose 4 adjacent 32-bit channels, 4 samples at a time
+	MXFLIB_TARGET("sse2") size_t Transpose32_SSE2(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets)
+	{
+		const UInt8 *In = &Source[Targets[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 4)
+		{
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(In));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize]));
+			__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 2]));
+			__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 3]));
+
+			__m128i a0 = _mm_unpacklo_epi32(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi32(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi32(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi32(r2, r3);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[0].Out), _mm_unpacklo_epi64(a0, a2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[1].Out), _mm_unpackhi_epi64(a0, a2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[2].Out), _mm_unpacklo_epi64(a1, a3));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[3].Out), _mm_unpackhi_epi64(a1, a3));
+
+			for(int i=0; i<4; i++) Targets[i].Out += 16;
+
+			In += SourceSampleSize * 4;
+			Done += 4;
+		}
+
+		return Done;
+	}
+
+	//! Write the low 12 bytes of a vector
+	MXFLIB_TARGET("sse2") inline void Store12(UInt8 *Dest, __m128i Value)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i *>(Dest), Value);
+
+		UInt32 Last = static_cast<UInt32>(_mm_cvtsi128_si32(_mm_srli_si128(Value, 8)));
+		memcpy(&Dest[8], &Last, 4);
+	}
+
+	//! Transpose 4 adjacent 24-bit channels, 4 samples at a time
+	/*! Each sample is widened to 32 bits with pshufb, transposed as 32-bit words and packed back to 24 bits with pshufb */
+	MXFLIB_TARGET("ssse3") size_t Transpose24_SSSE3(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets)
+	{
+		const __m128i Widen = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i Pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		const UInt8 *In = &Source[Targets[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 4)
+		{
+			__m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(In)), Widen);
+			__m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize])), Widen);
+			__m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 2])), Widen);
+			__m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 3])), Widen);
+
+			__m128i a0 = _mm_unpacklo_epi32(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi32(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi32(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi32(r2, r3);
+
+			Store12(Targets[0].Out, _mm_shuffle_epi8(_mm_unpacklo_epi64(a0, a2), Pack));
+			Store12(Targets[1].Out, _mm_shuffle_epi8(_mm_unpackhi_epi64(a0, a2), Pack));
+			Store12(Targets[2].Out, _mm_shuffle_epi8(_mm_unpacklo_epi64(a1, a3), Pack));
+			Store12(Targets[3].Out, _mm_shuffle_epi8(_mm_unpackhi_epi64(a1, a3), Pack));
+
+			for(int i=0; i<4; i++) Targets[i].Out += 12;
+
+			In += SourceSampleSize * 4;
+			Done += 4;
+		}
+
+		return Done;
+	}
+
+	//! Transpose 4 adjacent 24-bit channels, 8 samples at a time
+	/*! As Transpose24_SSSE3, but with samples n and n+4 in the two 128-bit lanes */
+	MXFLIB_TARGET("avx2") size_t Transpose24_AVX2(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets)
+	{
+		const __m256i Widen = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+											   0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i Pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+											  0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		// Moves the 12 packed bytes of the upper lane down to follow the 12 bytes of the lower lane
+		const __m256i Join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+		const UInt8 *In = &Source[Targets[0].Offset];
+		const size_t Step = SourceSampleSize * 4;
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 8)
+		{
+			__m256i r0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(In))),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[Step])), 1);
+			__m256i r1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize]))),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[Step + SourceSampleSize])), 1);
+			__m256i r2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 2]))),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[Step + SourceSampleSize * 2])), 1);
+			__m256i r3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[SourceSampleSize * 3]))),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[Step + SourceSampleSize * 3])), 1);
+
+			r0 = _mm256_shuffle_epi8(r0, Widen);
+			r1 = _mm256_shuffle_epi8(r1, Widen);
+			r2 = _mm256_shuffle_epi8(r2, Widen);
+			r3 = _mm256_shuffle_epi8(r3, Widen);
+
+			__m256i a0 = _mm256_unpacklo_epi32(r0, r1);
+			__m256i a1 = _mm256_unpackhi_epi32(r0, r1);
+			__m256i a2 = _mm256_unpacklo_epi32(r2, r3);
+			__m256i a3 = _mm256_unpackhi_epi32(r2, r3);
+
+			__m256i c[4];
+			c[0] = _mm256_unpacklo_epi64(a0, a2);
+			c[1] = _mm256_unpackhi_epi64(a0, a2);
+			c[2] = _mm256_unpacklo_epi64(a1, a3);
+			c[3] = _mm256_unpackhi_epi64(a1, a3);
+
+			for(int i=0; i<4; i++)
+			{
+				// Pack each lane to 12 bytes, then join them to give 24 contiguous bytes
+				__m256i Packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(c[i], Pack), Join);
+
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(Targets[i].Out), _mm256_castsi256_si128(Packed));
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(&Targets[i].Out[16]), _mm256_extracti128_si256(Packed, 1));
+
+				Targets[i].Out += 24;
+			}
+
+			In += Step * 2;
+			Done += 8;
+		}
+
+		return Done;
+	}
+#endif // MXFLIB_X86_SIMD
+}
+
+
+//! Select the demux kernels to use for the current sample sizes and channel groups
+void AudioDemux::SelectKernels(void)
+{
+	Kernel = NULL;
+	Transpose = NULL;
+	TransposeWidth = 0;
+
+	// What bitsize will we be using?
+	unsigned int BitSize = (OutputBitSize == 0) ? SourceChannelBitSize : OutputBitSize;
+
+	// Only whole-byte sample sizes are supported
+	if((SourceChannelBitSize % 8) || (SourceChannelBitSize < 8) || (SourceChannelBitSize > 32)) return;
+	if((BitSize % 8) || (BitSize < 8) || (BitSize > 32)) return;
+
+	unsigned int InBytes = SourceChannelBitSize / 8;
+	unsigned int OutBytes = BitSize / 8;
+
+	if(InBytes != OutBytes)
+	{
+		Kernel = ResizeKernels[InBytes - 1][OutBytes - 1];
+		return;
+	}
+
+	Kernel = CopyKernels[InBytes - 1];
+
+#ifdef MXFLIB_X86_SIMD
+	if(InBytes == 2)
+	{
+		if(CPUSupports(CPU_SSE2)) { Transpose = Transpose16_SSE2; TransposeWidth = 8; }
+	}
+	else if(InBytes == 3)
+	{
+		if(CPUSupports(CPU_AVX2)) { Transpose = Transpose24_AVX2; TransposeWidth = 4; }
+		else if(CPUSupports(CPU_SSSE3)) { Transpose = Transpose24_SSSE3; TransposeWidth = 4; }
+	}
+	else if(InBytes == 4)
+	{
+		if(CPUSupports(CPU_SSE2)) { Transpose = Transpose32_SSE2; TransposeWidth = 4; }
+	}
+#endif // MXFLIB_X86_SIMD
+
+	AUDIODEMUX_DEBUG("AudioDemux selected %s transpose kernel of width %u\n", Transpose ? "a" : "no", TransposeWidth);
+}
+
+
+//! Demultiplex a buffer for all channel groups that still require data from it, in a single pass over the buffer
+/*! \param Data The interleaved source data
+ *  \param Start The sample number of the first sample in the buffer
+ *  \param SampleCount The number of samples in the buffer
+ *  \param Planes The list of demultiplexed data for this buffer, new entries are added for each group demultiplexed
+ */
+void AudioDemux::SplitBuffer(const UInt8 *Data, Position Start, Length SampleCount, PlaneList &Planes)
+{
+	AUDIODEMUX_DEBUG("SplitBuffer(Data, %s, %s)\n", Int64toString(Start).c_str(), Int64toString(SampleCount).c_str());
+
+	// Ensure there is an entry for each group, some may have been added since this buffer was first split
+	if(Planes.size() < Groups.size()) Planes.resize(Groups.size());
+
+	// What bitsize will we be using?
+	unsigned int BitSize = (OutputBitSize == 0) ? SourceChannelBitSize : OutputBitSize;
+
+	// The group number of any single-channel group being split for each source channel, or -1 if none
+	std::vector<int> SingleGroup(SourceChannelCount, -1);
+
+	// Targets that will be handled by the general kernel
+	std::vector<DemuxTarget> Targets;
+
+	/* Allocate buffers for each group that still requires data from this buffer */
+
+	size_t GroupCount = Groups.size();
+	size_t i;
+	for(i=0; i<GroupCount; i++)
+	{
+		// Skip groups that have already been split (or have already taken all their data)
+		if(Planes[i]) continue;
+
+		// Skip groups whose source has gone, or that have already moved beyond this buffer
+		OutputData &Output = Outputs[Groups[i].Channel];
+		if(!Output.Source || (Output.Pos >= (Start + SampleCount))) continue;
+
+		DemuxTarget ThisTarget;
+		ThisTarget.Offset = (Groups[i].Channel * SourceChannelBitSize) / 8;
+		ThisTarget.ChannelCount = Groups[i].ChannelCount;
+		ThisTarget.Size = ((BitSize * Groups[i].ChannelCount) + 7) / 8;
+
+		Planes[i] = new DataChunk(static_cast<size_t>(ThisTarget.Size * SampleCount));
+		ThisTarget.Out = Planes[i]->Data;
+
+		if(!Kernel)
+		{
+			error("AudioDemux cannot convert %u-bit samples to %u-bit samples\n", SourceChannelBitSize, BitSize);
+			Planes[i]->Set(0);
+			continue;
+		}
+
+		if(Transpose && (Groups[i].ChannelCount == 1)) SingleGroup[Groups[i].Channel] = static_cast<int>(i);
+		else Targets.push_back(ThisTarget);
+	}
+
+	if(!Kernel) return;
+
+	/* Gather runs of adjacent single channels into blocks for the transpose kernel, any others go to the general kernel */
+
+	// Targets that will be handled by the transpose kernel, in blocks of TransposeWidth
+	std::vector<DemuxTarget> BlockTargets;
+
+	unsigned int Channel = 0;
+	while(Channel < SourceChannelCount)
+	{
+		if(SingleGroup[Channel] < 0)
+		{
+			Channel++;
+			continue;
+		}
+
+		// Count the adjacent single channels
+		unsigned int RunLength = 1;
+		while(((Channel + RunLength) < SourceChannelCount) && (RunLength < TransposeWidth) && (SingleGroup[Channel + RunLength] >= 0)) RunLength++;
+
+		unsigned int Last = Channel + RunLength;
+		for(; Channel < Last; Channel++)
+		{
+			DemuxTarget ThisTarget;
+			ThisTarget.Out = Planes[SingleGroup[Channel]]->Data;
+			ThisTarget.Offset = (Channel * SourceChannelBitSize) / 8;
+			ThisTarget.ChannelCount = 1;
+			ThisTarget.Size = BitSize / 8;
+
+			if(RunLength == TransposeWidth) BlockTargets.push_back(ThisTarget);
+			else Targets.push_back(ThisTarget);
+		}
+	}
+
+	/* Demux a tile of samples at a time, so each tile is only read from memory once for all groups */
+
+	// DRAGONS: Large enough to amortize the per-tile overhead, small enough for a 16-channel 32-bit tile to remain in L1 cache
+	const size_t TileSamples = 256;
+
+	size_t Total = static_cast<size_t>(SampleCount);
+	size_t TotalBytes = Total * SourceSampleSize;
+	size_t BlockCount = TransposeWidth ? (BlockTargets.size() / TransposeWidth) : 0;
+
+	size_t Done;
+	for(Done = 0; Done < Total; Done += TileSamples)
+	{
+		size_t Count = Total - Done;
+		if(Count > TileSamples) Count = TileSamples;
+
+		const UInt8 *Tile = &Data[Done * SourceSampleSize];
+
+		size_t Block;
+		for(Block = 0; Block < BlockCount; Block++)
+		{
+			DemuxTarget *ThisBlock = &BlockTargets[Block * TransposeWidth];
+
+			// The transpose kernels load 16 bytes per sample, so limit them to samples where this will not pass the end of the buffer
+			size_t SafeCount = 0;
+			if(TotalBytes >= (ThisBlock->Offset + 16)) SafeCount = ((TotalBytes - ThisBlock->Offset - 16) / SourceSampleSize) + 1;
+
+			size_t Transposed = 0;
+			if(SafeCount > Done)
+			{
+				size_t TransposeCount = SafeCount - Done;
+				if(TransposeCount > Count) TransposeCount = Count;
+
+				Transposed = Transpose(Tile, TransposeCount, SourceSampleSize, ThisBlock);
+			}
+
+			// Finish off any samples the transpose kernel could not handle
+			if(Transposed < Count) Kernel(&Tile[Transposed * SourceSampleSize], Count - Transposed, SourceSampleSize, ThisBlock, TransposeWidth);
+		}
+
+		if(!Targets.empty()) Kernel(Tile, Count, SourceSampleSize, &Targets[0], Targets.size());
+	}
+}
+
+
 //! Get data for a sub-source
 DataChunkPtr AudioDemux::GetEssenceData(AudioDemuxSource *Caller, unsigned int Channel, unsigned int ChannelCount, size_t Size /*=0*/, size_t MaxSize /*=0*/)
 {
@@ -92,6 +562,11 @@ DataChunkPtr AudioDemux::GetEssenceData(AudioDemuxSource *Caller, unsigned int C
 	// The start position of the first sample in the source buffer
 	Length Start;
 
+	// The buffer holding the source data, its sample count, and its demultiplexed data
+	UInt8 *BuffPtr;
+	Length BufferSampleCount;
+	PlaneList *Planes;
+
 	// Sanity check the channel parameters
 	if((Channel + ChannelCount) > SourceChannelCount) return Ret;
 	mxflib_assert(Outputs[Channel].Source);
@@ -107,16 +582,14 @@ DataChunkPtr AudioDemux::GetEssenceData(AudioDemuxSource *Caller, unsigned int C
 	// Work out the number of bytes per sample for this number of channels
 	unsigned int BytesPerSample = ((BitSize * ChannelCount) + 7) / 8;
 
-	// Pointer to the current position in the source buffer
-	UInt8 *BuffPtr;
-
 	if(InCurrentBuffer(Channel))
 	{
 		SamplesRemaining = CurrentSampleCount - (Outputs[Channel].Pos - CurrentStart);
 		Start = CurrentStart;
 
-		// Initialize the buffer pointer
 		BuffPtr = CurrentData->Data;
+		BufferSampleCount = CurrentSampleCount;
+		Planes = &CurrentPlanes;
 	}
 	else if(Outputs[Channel].Eof)
 	{
@@ -148,22 +621,17 @@ DataChunkPtr AudioDemux::GetEssenceData(AudioDemuxSource *Caller, unsigned int C
 		SamplesRemaining = (*it).SampleCount - (Outputs[Channel].Pos - (*it).Start);
 		Start = (*it).Start;
 
-		// Initialize the buffer pointer
 		BuffPtr = (*it).Data->Data;
+		BufferSampleCount = (*it).SampleCount;
+		Planes = &(*it).Planes;
 	}
 
-	/* Allocate the demux buffer */
-
-	if(true) // For future expansion...
-	{
-		// Initially assume that we will be demuxing all remaining samples for this chunk
-		SampleCount = SamplesRemaining;
-	}
+	// Initially assume that we will be demuxing all remaining samples for this chunk
+	SampleCount = SamplesRemaining;
 
 	if(Caller->GetLenToSend()!=-1 && SampleCount>Caller->GetLenToSend())
 		SampleCount=Caller->GetLenToSend();
 
-
 	// Calculate the total size of this data
 	size_t BufferSize = static_cast<size_t>(BytesPerSample * SampleCount);
 
@@ -180,294 +648,91 @@ DataChunkPtr AudioDemux::GetEssenceData(AudioDemuxSource *Caller, unsigned int C
 	// Ensure that the caller's end-of-item flag is set if we will demux all remaining samples for this chunk
 	Caller->SetEoi(SamplesRemaining == SampleCount);
 
+	// Demultiplex this buffer for all groups if this is the first time it has been required by this group
+	size_t Group = static_cast<size_t>(Outputs[Channel].Group);
+	if((Group >= Planes->size()) || !(*Planes)[Group]) SplitBuffer(BuffPtr, Start, BufferSampleCount, *Planes);
 
+	DataChunkPtr &Plane = (*Planes)[Group];
+	size_t Offset = static_cast<size_t>((Outputs[Channel].Pos - Start) * BytesPerSample);
 
-	// Allocate the buffer
-	Ret = new DataChunk(BufferSize);
-
-//printf("Buffer holds %d*%d samples in %d bytes\n", (int)SampleCount, (int)ChannelCount, (int)BufferSize);
+	// If we are taking the whole demultiplexed buffer, hand it over rather than copying it
+	if((Offset == 0) && (BufferSize == Plane->Size))
+	{
+		Ret = Plane;
+		Plane = NULL;
+	}
+	else
+	{
+		Ret = new DataChunk(BufferSize, &Plane->Data[Offset]);
 
-	// Pointer for output writing
-	UInt8 *OutPtr = Ret->Data;
+		// Free the demultiplexed data once it has all been taken
+		if((Offset + BufferSize) >= Plane->Size) Plane = NULL;
+	}
 
 	// Record where we will leave the output pointers
 	Position FinalPos = Outputs[Channel].Pos + SampleCount;
 
-
-	/* Demux code - optimized versions for each common sample size (and a non-optimum one for resizing) */
-
-	if((OutputBitSize != 0) && (OutputBitSize != SourceChannelBitSize))
+	// Update the positions for each channel demuxed
+	while(ChannelCount--)
 	{
-		UInt32 Sample;
-
-		// Calculate how many bytes we skip
-		unsigned int Skip = SourceSampleSize - ((ChannelCount * SourceChannelBitSize) + 7) / 8;;
+		Outputs[Channel].Pos = FinalPos;
+		Channel++;
+	}
 
-		// Move the buffer pointer forward to the current position for this output channel
-		BuffPtr += (Outputs[Channel].Pos - Start) * SourceChannelCount;
+	return Ret;
+}
 
-		// Move to the correct sub-channel in the source (as long as we step in full sample sizes this will keep correct)
-		// DRAGONS: This only works if each demux set is an exact number of bytes
-		BuffPtr += ((Channel * SourceChannelBitSize) + 7) / 8;
 
-		while(SampleCount--)
-		{
-			unsigned int Channel = ChannelCount;
-			while(Channel--)
-			{
-				if(SourceChannelBitSize == 8) Sample = *(BuffPtr++);
-				else if(SourceChannelBitSize == 16) { Sample = GetU16_LE(BuffPtr); BuffPtr += 2; }
-				else if(SourceChannelBitSize == 24) { Sample = (static_cast<UInt32>(BuffPtr[2]) << 16) + (static_cast<UInt32>(BuffPtr[1]) << 8) + *BuffPtr; BuffPtr += 3; }
-				else if(SourceChannelBitSize == 32) { Sample = GetU32_LE(BuffPtr); BuffPtr += 4; }
-				else
-				{
-					error("SourceChannelBitSize of %u not supported\n", SourceChannelBitSize);
-					mxflib_assert(0);
-				}
+//! Get the size of a sub-sources essence data in bytes
+size_t AudioDemux::GetEssenceDataSize(unsigned int Channel, unsigned int ChannelCount)
+{
+	AUDIODEMUX_DEBUG("GetEssenceDataSize(%u, %u)\n", Channel, ChannelCount);
 
-				// Adjust the bit size
-				if(OutputBitSize > SourceChannelBitSize) Sample <<= (OutputBitSize - SourceChannelBitSize);
-				else Sample >>= (SourceChannelBitSize - OutputBitSize);
+	Length SampleCount;
 
-				if(OutputBitSize == 8) *(OutPtr++) = Sample;
-				else if(OutputBitSize == 16) { PutU16_LE(static_cast<UInt16>(Sample), OutPtr); OutPtr += 2; }
-				else if(OutputBitSize == 24) { *OutPtr = static_cast<UInt8>(Sample); OutPtr[1] = static_cast<UInt8>(Sample >> 8); OutPtr[2] = static_cast<UInt8>(Sample >> 16); OutPtr += 3; }
-				else if(OutputBitSize == 32) { PutU32_LE(Sample, OutPtr); OutPtr += 4; }
-				else
-				{
-					error("OutputBitSize of %u not supported\n", OutputBitSize);
-					mxflib_assert(0);
-				}
-			}
+	// Sanity check the channel parameters
+	if((Channel + ChannelCount) > SourceChannelCount) return 0;
+	mxflib_assert(Outputs[Channel].Source);
 
-			// Skip the other channels
-			BuffPtr += Skip;
-		}
+	/* Locate the buffer with the required data and read the sample count from it */
+	if(InCurrentBuffer(Channel))
+	{
+		SampleCount = CurrentSampleCount;
 	}
-	else if(SourceChannelBitSize == 8)
+	else
 	{
-		/* Do the demux for bytes */
-
-		// Move the buffer pointer forward to the current position for this output channel
-		BuffPtr += (Outputs[Channel].Pos - Start) * SourceChannelCount;
-
-		// Move to the correct sub-channel in the source (as long as we step in full sample sizes this will keep correct)
-		BuffPtr += Channel;
-
-		if(ChannelCount == 1)
+		if(Outputs[Channel].Eof)
 		{
-			/* Single channel output */
-			while(SampleCount--)
-			{
-				*(OutPtr++) = *BuffPtr;
-				BuffPtr += SourceChannelCount;
-			}
+			SampleCount = 0;
 		}
-		else
+        else
 		{
-			/* Optimized multi-channel version - copies ChannelCount channels, then skips to the next sample.
-			 * Most compilers will make the inner loop very efficient.
-			 */
-			unsigned int ChanDiff = SourceChannelCount - ChannelCount;
-			while(SampleCount--)
-			{
-				unsigned int Chan = ChannelCount;
-				while(Chan--) *(OutPtr++) = *(BuffPtr++);
-				BuffPtr += ChanDiff;
-			}
+			OldDataList::iterator it = GetOldBuffer(Channel);
+			if(it == OldData.end()) SampleCount = 0;
+			else SampleCount = (*it).SampleCount;
 		}
 	}
-	else if (SourceChannelBitSize == 16)
-	{
-		/* Do the demux for 16-bit words */
 
-		// Move the buffer pointer forward to the current position for this output channel
-		BuffPtr += (Outputs[Channel].Pos - Start) * SourceSampleSize;
-
-		// Move to the correct sub-channel in the source (as long as we step in full sample sizes this will keep correct)
-		BuffPtr += Channel * 2;
+	// What bitsize will we be using?
+	unsigned int BitSize = (OutputBitSize == 0) ? SourceChannelBitSize : OutputBitSize;
 
-		if(ChannelCount == 1)
-		{
-			// The size of each sample in bytes  - less the number that we will have already incremented with post increment
-			register unsigned int StepSize = SourceSampleSize - 1;
+	// Work out the number of bytes per sample for this number of channels
+	Length BytesPerSample = ((BitSize * ChannelCount) + 7) / 8;
 
-			/* Single channel output */
-			while(SampleCount--)
-			{
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *BuffPtr;
-				BuffPtr += StepSize;
-			}
-		}
-		else
-		{
-			/* Optimized multi-channel version - copies ChannelCount*2 bytes (ChannelCount channels), then skips to the next sample.
-			 * Most compilers will make the inner loop very efficient.
-			 */
-			unsigned int ChanDiff = (SourceChannelCount - ChannelCount) * 2;
-			unsigned int CopySize = ChannelCount * 2;
-			while(SampleCount--)
-			{
-				unsigned int ChanSize = CopySize;
-				while(ChanSize--) *(OutPtr++) = *(BuffPtr++);
-				BuffPtr += ChanDiff;
-			}
-		}
-	}
-	else if (SourceChannelBitSize == 24)
-	{
-		/* Do the demux for 24-bit words */
+	// Return the total size of this data
+	return static_cast<size_t>(BytesPerSample * SampleCount);
+}
 
-		// Move the buffer pointer forward to the current position for this output channel
-		BuffPtr += (Outputs[Channel].Pos - Start) * SourceSampleSize;
+//! Get an essence source for reading data from the given channel number
+/*! \param Channel The number of the first channel to read with the new source (zero being the first in the outer source)
+ *  \param ChannelCount The number of channels to read at a time (e.g. ChannelCount = 2 give a stereo pair)
+ */
+EssenceSourcePtr AudioDemux::GetSource(unsigned int Channel, unsigned int ChannelCount /*=1*/)
+{
+	EssenceSourcePtr Ret;
 
-		// Move to the correct sub-channel in the source (as long as we step in full sample sizes this will keep correct)
-		BuffPtr += Channel * 3;
-
-		if(ChannelCount == 1)
-		{
-			// The size of each sample in bytes  - less the number that we will have already incremented with post increment
-			register unsigned int StepSize = SourceSampleSize - 2;
-
-			/* Single channel output */
-			while(SampleCount--)
-			{
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *BuffPtr;
-				BuffPtr += StepSize;
-			}
-		}
-		else
-		{
-			/* Optimized multi-channel version - copies ChannelCount*3 bytes (ChannelCount channels), then skips to the next sample.
-			 * Most compilers will make the inner loop very efficient.
-			 */
-			unsigned int ChanDiff = (SourceChannelCount - ChannelCount) * 3;
-			unsigned int CopySize = ChannelCount * 3;
-			while(SampleCount--)
-			{
-				unsigned int ChanSize = CopySize;
-				while(ChanSize--) *(OutPtr++) = *(BuffPtr++);
-				BuffPtr += ChanDiff;
-			}
-		}
-	}
-	else if (SourceChannelBitSize == 32)
-	{
-		/* Do the demux for 32-bit words */
-
-		// Move the buffer pointer forward to the current position for this output channel
-		BuffPtr += (Outputs[Channel].Pos - Start) * SourceSampleSize;
-
-		// Move to the correct sub-channel in the source (as long as we step in full sample sizes this will keep correct)
-		BuffPtr += Channel * 4;
-
-		if(ChannelCount == 1)
-		{
-			// The size of each sample in bytes  - less the number that we will have already incremented with post increment
-			register unsigned int StepSize = SourceSampleSize;
-
-			/* Single channel output */
-			while(SampleCount--)
-			{
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *(BuffPtr++);
-				*(OutPtr++) = *BuffPtr;
-				BuffPtr += StepSize;
-			}
-		}
-		else
-		{
-			/* Optimized multi-channel version - copies ChannelCount*4 bytes (ChannelCount channels), then skips to the next sample.
-			 * Most compilers will make the inner loop very efficient.
-			 */
-			unsigned int ChanDiff = (SourceChannelCount - ChannelCount) * 4;
-			unsigned int CopySize = ChannelCount * 4;
-			while(SampleCount--)
-			{
-				unsigned int ChanSize = CopySize;
-				while(ChanSize--) *(OutPtr++) = *(BuffPtr++);
-				BuffPtr += ChanDiff;
-			}
-		}
-	}
-	else if (SourceChannelBitSize == 12)
-	{
-		// Do the demux for other sizes
-		error("SourceChannelBitSize of %u not supported\n", SourceChannelBitSize);
-		mxflib_assert(0);
-	}
-	else
-	{
-		// Do the demux for other sizes
-		error("SourceChannelBitSize of %u not supported\n", SourceChannelBitSize);
-		mxflib_assert(0);
-	}
-
-	// Update the positions for each channel demuxed
-	while(ChannelCount--)
-	{
-		Outputs[Channel].Pos = FinalPos;
-		Channel++;
-	}
-
-	return Ret;
-}
-
-
-//! Get the size of a sub-sources essence data in bytes
-size_t AudioDemux::GetEssenceDataSize(unsigned int Channel, unsigned int ChannelCount)
-{
-	AUDIODEMUX_DEBUG("GetEssenceDataSize(%u, %u)\n", Channel, ChannelCount);
-
-	Length SampleCount;
-
-	// Sanity check the channel parameters
-	if((Channel + ChannelCount) > SourceChannelCount) return 0;
-	mxflib_assert(Outputs[Channel].Source);
-
-	/* Locate the buffer with the required data and read the sample count from it */
-	if(InCurrentBuffer(Channel))
-	{
-		SampleCount = CurrentSampleCount;
-	}
-	else
-	{
-		if(Outputs[Channel].Eof)
-		{
-			SampleCount = 0;
-		}
-        else
-		{
-			OldDataList::iterator it = GetOldBuffer(Channel);
-			if(it == OldData.end()) SampleCount = 0;
-			else SampleCount = (*it).SampleCount;
-		}
-	}
-
-	// What bitsize will we be using?
-	unsigned int BitSize = (OutputBitSize == 0) ? SourceChannelBitSize : OutputBitSize;
-
-	// Work out the number of bytes per sample for this number of channels
-	Length BytesPerSample = ((BitSize * ChannelCount) + 7) / 8;
-
-	// Return the total size of this data
-	return static_cast<size_t>(BytesPerSample * SampleCount);
-}
-
-//! Get an essence source for reading data from the given channel number
-/*! \param Channel The number of the first channel to read with the new source (zero being the first in the outer source)
- *  \param ChannelCount The number of channels to read at a time (e.g. ChannelCount = 2 give a stereo pair)
- */
-EssenceSourcePtr AudioDemux::GetSource(unsigned int Channel, unsigned int ChannelCount /*=1*/)
-{
-	EssenceSourcePtr Ret;
-
-	// Validate that Channel range
-	if((ChannelCount < 1) || ((Channel + ChannelCount) > SourceChannelCount)) return Ret;
+	// Validate that Channel range
+	if((ChannelCount < 1) || ((Channel + ChannelCount) > SourceChannelCount)) return Ret;
 
 	// Barf if we don't have the first sample any more
 	if(CurrentStart > 0)
@@ -483,6 +748,10 @@ EssenceSourcePtr AudioDemux::GetSource(unsigned int Channel, unsigned int Channe
 	Ret = new AudioDemuxSource(this, Channel, ChannelCount);
 
 	/* Set the output data for each of our channels */
+	GroupData NewGroup;
+	NewGroup.Channel = Channel;
+	NewGroup.ChannelCount = ChannelCount;
+
 	while(ChannelCount--)
 	{
 		if(Outputs[Channel].Source)
@@ -493,10 +762,14 @@ EssenceSourcePtr AudioDemux::GetSource(unsigned int Channel, unsigned int Channe
 		Outputs[Channel].Source = Ret;
 		Outputs[Channel].Pos = 0;
 		Outputs[Channel].Eof = false;
+		Outputs[Channel].Group = static_cast<int>(Groups.size());
 
 		Channel++;
 	}
 
+	// Record the new channel group
+	Groups.push_back(NewGroup);
+
 	return Ret;
 }
 
@@ -535,6 +808,9 @@ void AudioDemux::FillBuffer(void)
 			Old.SampleCount = CurrentSampleCount;
 
 			OldData.push_back(Old);
+
+			// Move any demultiplexed data with the buffer
+			OldData.back().Planes.swap(CurrentPlanes);
 		}
 
 		AUDIODEMUX_DEBUG("Lowest required sample = %s\n", Int64toString(LowestPosition).c_str());
@@ -560,6 +836,9 @@ void AudioDemux::FillBuffer(void)
 	// Update the start pointer
 	CurrentStart += CurrentSampleCount;
 
+	// Discard any demultiplexed data that has not been moved to the old list, it is no longer required
+	CurrentPlanes.clear();
+
 	// Get a new data chunk
 	size_t MaxSize=0;
 	if(VideoEditRate.Denominator!=0) //i.e.has been set
@@ -627,3 +906,798 @@ AudioDemux::OldDataList::iterator AudioDemux::GetOldBuffer(unsigned int Channel)
 	return it;
 }
 
+
+
+namespace
+{
+	/* Portable mux kernels - one instantiation per sample size so that no size tests remain in the inner loops */
+
+	//! Mux kernel for when the input sample size matches the output
+	template<unsigned int Bytes> void MuxCopy(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs, size_t InputCount)
+	{
+		MuxInput *InputEnd = &Inputs[InputCount];
+
+		while(SampleCount--)
+		{
+			for(MuxInput *Input = Inputs; Input != InputEnd; Input++)
+			{
+				// DRAGONS: The fixed-size copy for single channels compiles to a single load and store
+				if(Input->ChannelCount == 1)
+				{
+					memcpy(&Dest[Input->Offset], Input->In, Bytes);
+					Input->In += Bytes;
+				}
+				else
+				{
+					size_t Size = Bytes * Input->ChannelCount;
+					memcpy(&Dest[Input->Offset], Input->In, Size);
+					Input->In += Size;
+				}
+			}
+
+			Dest += DestSampleSize;
+		}
+	}
+
+	//! Mux kernel for when the input sample size differs from the output
+	template<unsigned int InBytes, unsigned int OutBytes> void MuxResize(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs, size_t InputCount)
+	{
+		const int Shift = (static_cast<int>(OutBytes) - static_cast<int>(InBytes)) * 8;
+
+		MuxInput *InputEnd = &Inputs[InputCount];
+
+		while(SampleCount--)
+		{
+			for(MuxInput *Input = Inputs; Input != InputEnd; Input++)
+			{
+				UInt8 *Out = &Dest[Input->Offset];
+
+				unsigned int Channel = Input->ChannelCount;
+				while(Channel--)
+				{
+					UInt32 Sample = ReadSample<InBytes>(Input->In);
+
+					// Adjust the bit size
+					if(Shift > 0) Sample <<= (Shift & 31); else Sample >>= ((-Shift) & 31);
+
+					WriteSample<OutBytes>(Out, Sample);
+
+					Input->In += InBytes;
+					Out += OutBytes;
+				}
+			}
+
+			Dest += DestSampleSize;
+		}
+	}
+
+	//! Kernels for each sample size when not resizing, indexed by bytes per sample - 1
+	const MuxKernel MuxCopyKernels[4] = { MuxCopy<1>, MuxCopy<2>, MuxCopy<3>, MuxCopy<4> };
+
+	//! Kernels for each combination of sample sizes, indexed by input bytes - 1, then output bytes - 1
+	const MuxKernel MuxResizeKernels[4][4] =
+	{
+		{ MuxCopy<1>, MuxResize<1, 2>, MuxResize<1, 3>, MuxResize<1, 4> },
+		{ MuxResize<2, 1>, MuxCopy<2>, MuxResize<2, 3>, MuxResize<2, 4> },
+		{ MuxResize<3, 1>, MuxResize<3, 2>, MuxCopy<3>, MuxResize<3, 4> },
+		{ MuxResize<4, 1>, MuxResize<4, 2>, MuxResize<4, 3>, MuxCopy<4> }
+	};
+
+
+#ifdef MXFLIB_X86_SIMD
+	/* Vectorized transpose kernels - each interleaves a block of adjacent single-channel inputs into a run of samples
+	 * These are the inverse of the demux transpose kernels, using the same transpose networks
+	 * DRAGONS: Each of these loads 16 bytes from each input at each sample position processed,
+	 *          the caller must ensure that these loads are within the input buffers
+	 */
+
+	//! Transpose 8 adjacent 16-bit inputs, 8 samples at a time
+	MXFLIB_TARGET("sse2") size_t MuxTranspose16_SSE2(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs)
+	{
+		UInt8 *Out = &Dest[Inputs[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 8)
+		{
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[0].In));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[1].In));
+			__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[2].In));
+			__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[3].In));
+			__m128i r4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[4].In));
+			__m128i r5 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[5].In));
+			__m128i r6 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[6].In));
+			__m128i r7 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[7].In));
+
+			// Interleave pairs of channels: samples 0-3 and 4-7
+			__m128i a0 = _mm_unpacklo_epi16(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi16(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi16(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi16(r2, r3);
+			__m128i a4 = _mm_unpacklo_epi16(r4, r5);
+			__m128i a5 = _mm_unpackhi_epi16(r4, r5);
+			__m128i a6 = _mm_unpacklo_epi16(r6, r7);
+			__m128i a7 = _mm_unpackhi_epi16(r6, r7);
+
+			// Interleave groups of four channels: two samples in each
+			__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+			__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+			__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+			__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+			__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+			__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+			__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+			__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+			// Combine to give all eight channels of each sample
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Out), _mm_unpacklo_epi64(b0, b4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize]), _mm_unpackhi_epi64(b0, b4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 2]), _mm_unpacklo_epi64(b1, b5));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 3]), _mm_unpackhi_epi64(b1, b5));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 4]), _mm_unpacklo_epi64(b2, b6));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 5]), _mm_unpackhi_epi64(b2, b6));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 6]), _mm_unpacklo_epi64(b3, b7));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 7]), _mm_unpackhi_epi64(b3, b7));
+
+			for(int i=0; i<8; i++) Inputs[i].In += 16;
+
+			Out += DestSampleSize * 8;
+			Done += 8;
+		}
+
+		return Done;
+	}
+
+	//! Transpose 4 adjacent 32-bit inputs, 4 samples at a time
+	MXFLIB_TARGET("sse2") size_t MuxTranspose32_SSE2(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs)
+	{
+		UInt8 *Out = &Dest[Inputs[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 4)
+		{
+			__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[0].In));
+			__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[1].In));
+			__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[2].In));
+			__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[3].In));
+
+			__m128i a0 = _mm_unpacklo_epi32(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi32(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi32(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi32(r2, r3);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Out), _mm_unpacklo_epi64(a0, a2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize]), _mm_unpackhi_epi64(a0, a2));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 2]), _mm_unpacklo_epi64(a1, a3));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(&Out[DestSampleSize * 3]), _mm_unpackhi_epi64(a1, a3));
+
+			for(int i=0; i<4; i++) Inputs[i].In += 16;
+
+			Out += DestSampleSize * 4;
+			Done += 4;
+		}
+
+		return Done;
+	}
+
+	//! Transpose 4 adjacent 24-bit inputs, 4 samples at a time
+	/*! Each sample is widened to 32 bits with pshufb, transposed as 32-bit words and packed back to 24 bits with pshufb */
+	MXFLIB_TARGET("ssse3") size_t MuxTranspose24_SSSE3(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs)
+	{
+		const __m128i Widen = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m128i Pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		UInt8 *Out = &Dest[Inputs[0].Offset];
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 4)
+		{
+			__m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[0].In)), Widen);
+			__m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[1].In)), Widen);
+			__m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[2].In)), Widen);
+			__m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Inputs[3].In)), Widen);
+
+			__m128i a0 = _mm_unpacklo_epi32(r0, r1);
+			__m128i a1 = _mm_unpackhi_epi32(r0, r1);
+			__m128i a2 = _mm_unpacklo_epi32(r2, r3);
+			__m128i a3 = _mm_unpackhi_epi32(r2, r3);
+
+			Store12(Out, _mm_shuffle_epi8(_mm_unpacklo_epi64(a0, a2), Pack));
+			Store12(&Out[DestSampleSize], _mm_shuffle_epi8(_mm_unpackhi_epi64(a0, a2), Pack));
+			Store12(&Out[DestSampleSize * 2], _mm_shuffle_epi8(_mm_unpacklo_epi64(a1, a3), Pack));
+			Store12(&Out[DestSampleSize * 3], _mm_shuffle_epi8(_mm_unpackhi_epi64(a1, a3), Pack));
+
+			for(int i=0; i<4; i++) Inputs[i].In += 12;
+
+			Out += DestSampleSize * 4;
+			Done += 4;
+		}
+
+		return Done;
+	}
+
+	//! Transpose 4 adjacent 24-bit inputs, 8 samples at a time
+	/*! As MuxTranspose24_SSSE3, but with samples n and n+4 in the two 128-bit lanes */
+	MXFLIB_TARGET("avx2") size_t MuxTranspose24_AVX2(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs)
+	{
+		const __m256i Widen = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+											   0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+		const __m256i Pack = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+											  0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+		UInt8 *Out = &Dest[Inputs[0].Offset];
+		const size_t Step = DestSampleSize * 4;
+		size_t Done = 0;
+
+		while((SampleCount - Done) >= 8)
+		{
+			__m256i r[4];
+			for(int i=0; i<4; i++)
+			{
+				const UInt8 *In = Inputs[i].In;
+				r[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(In))),
+											   _mm_loadu_si128(reinterpret_cast<const __m128i *>(&In[12])), 1);
+				r[i] = _mm256_shuffle_epi8(r[i], Widen);
+			}
+
+			__m256i a0 = _mm256_unpacklo_epi32(r[0], r[1]);
+			__m256i a1 = _mm256_unpackhi_epi32(r[0], r[1]);
+			__m256i a2 = _mm256_unpacklo_epi32(r[2], r[3]);
+			__m256i a3 = _mm256_unpackhi_epi32(r[2], r[3]);
+
+			__m256i c[4];
+			c[0] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(a0, a2), Pack);
+			c[1] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(a0, a2), Pack);
+			c[2] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(a1, a3), Pack);
+			c[3] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(a1, a3), Pack);
+
+			// The lower lane of each holds sample n, the upper lane sample n+4
+			for(int i=0; i<4; i++)
+			{
+				Store12(&Out[DestSampleSize * i], _mm256_castsi256_si128(c[i]));
+				Store12(&Out[Step + DestSampleSize * i], _mm256_extracti128_si256(c[i], 1));
+			}
+
+			for(int i=0; i<4; i++) Inputs[i].In += 24;
+
+			Out += Step * 2;
+			Done += 8;
+		}
+
+		return Done;
+	}
+#endif // MXFLIB_X86_SIMD
+
+	//! Determine if a sample size is supported by the mux kernels
+	inline bool MuxSizeSupported(unsigned int BitSize)
+	{
+		return (BitSize >= 8) && (BitSize <= 32) && ((BitSize % 8) == 0);
+	}
+}
+
+
+//! Add an input source, which will feed the next unallocated output channels
+/*! \param Source The source of interleaved audio samples for this input
+ *  \param ChannelCount The number of channels in this input (e.g. ChannelCount = 2 gives a stereo pair)
+ *  \param BitSize The size of each sample of each channel in this input, in bits, or zero if the same as the output
+ *  \return false if there are not enough unallocated output channels, or interleaving has started
+ */
+bool AudioMux::AddInput(EssenceSourcePtr Source, unsigned int InputChannelCount /*=1*/, unsigned int BitSize /*=0*/)
+{
+	if(!Source) return false;
+
+	if((CurrentPosition > 0) || (Buffer->Size > 0))
+	{
+		error("AudioMux::AddInput() called after interleaving has started\n");
+		return false;
+	}
+
+	if((InputChannelCount < 1) || ((UsedChannels + InputChannelCount) > ChannelCount))
+	{
+		error("AudioMux::AddInput() cannot add %u channels as only %u of %u output channels remain unallocated\n", InputChannelCount, ChannelCount - UsedChannels, ChannelCount);
+		return false;
+	}
+
+	if(BitSize == 0) BitSize = ChannelBitSize;
+
+	if(!MuxSizeSupported(BitSize) || !MuxSizeSupported(ChannelBitSize))
+	{
+		error("AudioMux cannot convert %u-bit samples to %u-bit samples\n", BitSize, ChannelBitSize);
+		return false;
+	}
+
+	InputData Input;
+	Input.Source = Source;
+	Input.Channel = UsedChannels;
+	Input.ChannelCount = InputChannelCount;
+	Input.BitSize = BitSize;
+	Input.SampleSize = (BitSize * InputChannelCount) / 8;
+	Input.Kernel = NULL;
+	Input.InBlock = false;
+	Input.Eof = false;
+	Input.Offset = 0;
+	Input.SampleCount = 0;
+	Input.Wanted = 0;
+	Input.Chunk = 0;
+	Input.ChunkEnd = NULL;
+
+	// DRAGONS: Reserve space for a few chunks so that buffering does not allocate once running
+	Input.Chunks.reserve(4);
+
+	Inputs.push_back(Input);
+	UsedChannels += InputChannelCount;
+
+	// Kernels will need re-selecting, and the first input may have set the edit rate
+	KernelsValid = false;
+	if(!EditRate.Denominator) SequenceValid = false;
+
+	return true;
+}
+
+
+//! Set the edit rate to use for wrapping
+/*! \return true if this rate is acceptable */
+bool AudioMux::SetEditRate(Rational NewEditRate)
+{
+	if((NewEditRate.Numerator <= 0) || (NewEditRate.Denominator <= 0)) return false;
+
+	EditRate = NewEditRate;
+
+	SequenceValid = false;
+	return CalcWrappingSequence();
+}
+
+
+//! Calculate the number of samples in each edit unit for the current edit rate, in the same way as the WAVE PCM essence parser
+/*! \return false if no sequence of less than 10000 edit units gives a whole number of samples */
+bool AudioMux::CalcWrappingSequence(void)
+{
+	ConstSamples = 0;
+	SampleSequence.clear();
+	SequencePos = 0;
+	BytesPerEditUnit = -1;
+
+	Rational UseEditRate = GetEditRate();
+
+	// Invalid edit rate!
+	if((UseEditRate.Numerator <= 0) || (UseEditRate.Denominator <= 0) || (AudioSampleRate == 0)) return false;
+
+	// The number of samples per edit unit is SamplesNum / SamplesDen
+	// DRAGONS: Integer arithmetic is used so that the sequence is exact for any rate
+	UInt64 SamplesNum = static_cast<UInt64>(UseEditRate.Denominator) * AudioSampleRate;
+	UInt64 SamplesDen = static_cast<UInt64>(UseEditRate.Numerator);
+
+	// If we can acheive the desired number then it's simple!
+	if((SamplesNum % SamplesDen) == 0)
+	{
+		ConstSamples = static_cast<UInt32>(SamplesNum / SamplesDen);
+		SequenceValid = true;
+		return true;
+	}
+
+	// Work the shortest sequence that can be used
+	UInt64 Divisor = SamplesNum;
+	UInt64 Remainder = SamplesDen;
+	while(Remainder)
+	{
+		UInt64 Temp = Divisor % Remainder;
+		Divisor = Remainder;
+		Remainder = Temp;
+	}
+	UInt64 SequenceSize = SamplesDen / Divisor;
+
+	// Put a reasonable upper limit on the sequence length
+	if(SequenceSize >= 10000)
+	{
+		error("AudioMux::CalcWrappingSequence could not find a sequence < 10000 edit units long!\n");
+		return false;
+	}
+
+	// Calculate a sequence that allocates the nearest fit - each edit unit ends at the whole sample nearest to its exact end
+	UInt64 LastEnd = 0;
+	UInt64 i;
+	for(i = 1; i <= SequenceSize; i++)
+	{
+		UInt64 End = ((2 * i * SamplesNum) + SamplesDen) / (2 * SamplesDen);
+		SampleSequence.push_back(static_cast<UInt32>(End - LastEnd));
+		LastEnd = End;
+	}
+
+	SequenceValid = true;
+	return true;
+}
+
+
+//! Select the mux kernels to use for the current inputs
+void AudioMux::SelectKernels(void)
+{
+	Transpose = NULL;
+	TransposeWidth = 0;
+	Blocks.clear();
+
+	unsigned int OutBytes = ChannelBitSize / 8;
+
+#ifdef MXFLIB_X86_SIMD
+	if(OutBytes == 2)
+	{
+		if(CPUSupports(CPU_SSE2)) { Transpose = MuxTranspose16_SSE2; TransposeWidth = 8; }
+	}
+	else if(OutBytes == 3)
+	{
+		if(CPUSupports(CPU_AVX2)) { Transpose = MuxTranspose24_AVX2; TransposeWidth = 4; }
+		else if(CPUSupports(CPU_SSSE3)) { Transpose = MuxTranspose24_SSSE3; TransposeWidth = 4; }
+	}
+	else if(OutBytes == 4)
+	{
+		if(CPUSupports(CPU_SSE2)) { Transpose = MuxTranspose32_SSE2; TransposeWidth = 4; }
+	}
+#endif // MXFLIB_X86_SIMD
+
+	Cursors.resize(Inputs.size());
+
+	size_t InputCount = Inputs.size();
+	size_t i;
+	for(i=0; i<InputCount; i++)
+	{
+		InputData &Input = Inputs[i];
+
+		unsigned int InBytes = Input.BitSize / 8;
+		Input.Kernel = MuxResizeKernels[InBytes - 1][OutBytes - 1];
+		Input.InBlock = false;
+
+		Cursors[i].In = NULL;
+		Cursors[i].Offset = (Input.Channel * ChannelBitSize) / 8;
+		Cursors[i].ChannelCount = Input.ChannelCount;
+	}
+
+	/* Gather runs of single-channel inputs that need no resizing into blocks for the transpose kernel */
+	// DRAGONS: Inputs are allocated consecutive output channels, so a run of consecutive inputs is a run of adjacent channels
+
+	if(Transpose)
+	{
+		i = 0;
+		while(i < InputCount)
+		{
+			size_t RunLength = 0;
+			while(((i + RunLength) < InputCount) && (RunLength < TransposeWidth)
+				  && (Inputs[i + RunLength].ChannelCount == 1) && (Inputs[i + RunLength].BitSize == ChannelBitSize)) RunLength++;
+
+			if(RunLength == TransposeWidth)
+			{
+				Blocks.push_back(i);
+				for(size_t j = i; j < (i + RunLength); j++) Inputs[j].InBlock = true;
+			}
+
+			i += RunLength ? RunLength : 1;
+		}
+	}
+
+	AUDIODEMUX_DEBUG("AudioMux selected %s transpose kernel of width %u for %u blocks\n", Transpose ? "a" : "no", TransposeWidth, (unsigned int)Blocks.size());
+
+	KernelsValid = true;
+}
+
+
+//! Read more data from an input
+/*! \return false if no data was available (either at the end of the input, or more data is not yet available) */
+bool AudioMux::ReadInput(InputData &Input)
+{
+	if(Input.Eof) return false;
+
+	DataChunkPtr Data = Input.Source->GetEssenceData();
+
+	if(!Data)
+	{
+		Input.Eof = true;
+		return false;
+	}
+
+	size_t Samples = Data->Size / Input.SampleSize;
+	if(Samples * Input.SampleSize != Data->Size)
+	{
+		warning("AudioMux input for channel %u supplied a partial sample - the remainder will be ignored\n", Input.Channel);
+	}
+
+	if(Samples == 0) return false;
+
+	Input.Chunks.push_back(Data);
+	Input.SampleCount += Samples;
+
+	return true;
+}
+
+
+//! Interleave the next edit unit into Buffer, if not already done
+/*! \return false if there was no more data available from any input */
+bool AudioMux::BuildEditUnit(void)
+{
+	// Still returning the last edit unit
+	if(BufferOffset < Buffer->Size) return true;
+
+	if(Inputs.empty()) return false;
+
+	if(!KernelsValid) SelectKernels();
+
+	if(!SequenceValid && !CalcWrappingSequence())
+	{
+		error("AudioMux cannot wrap at an edit rate of %d/%d\n", GetEditRate().Numerator, GetEditRate().Denominator);
+
+		// Make sure that we are at the end of the data, rather than forever waiting for more
+		InputList::iterator it = Inputs.begin();
+		while(it != Inputs.end())
+		{
+			(*it).Eof = true;
+			(*it).Chunks.clear();
+			(*it).SampleCount = 0;
+			it++;
+		}
+
+		return false;
+	}
+
+	size_t SampleCount = ConstSamples ? ConstSamples : SampleSequence[SequencePos];
+
+	/* Ensure that each input has a full edit unit buffered, if possible */
+
+	size_t Count = 0;
+	InputList::iterator it = Inputs.begin();
+	while(it != Inputs.end())
+	{
+		while((*it).SampleCount < static_cast<Length>(SampleCount))
+		{
+			if(!ReadInput(*it)) break;
+		}
+
+		// This input has more data to come, but it is not available yet
+		if((!(*it).Eof) && ((*it).SampleCount < static_cast<Length>(SampleCount))) return false;
+
+		(*it).Wanted = ((*it).SampleCount < static_cast<Length>(SampleCount)) ? static_cast<size_t>((*it).SampleCount) : SampleCount;
+		if((*it).Wanted > Count) Count = (*it).Wanted;
+
+		it++;
+	}
+
+	// All inputs have ended (if only some have ended we pad them with silence to the end of the longest)
+	if(Count == 0) return false;
+
+	Buffer->Resize(Count * SampleSize, false);
+	BufferOffset = 0;
+
+	/* Set the start of each input, and clear the buffer if it will not be entirely overwritten */
+
+	bool Silence = (UsedChannels < ChannelCount);
+
+	size_t InputCount = Inputs.size();
+	size_t i;
+	for(i=0; i<InputCount; i++)
+	{
+		InputData &Input = Inputs[i];
+
+		if(Input.Wanted < Count) Silence = true;
+		if(Input.Wanted == 0) continue;
+
+		Input.Chunk = 0;
+		Cursors[i].In = &Input.Chunks[0]->Data[Input.Offset];
+		Input.ChunkEnd = &Input.Chunks[0]->Data[Input.Chunks[0]->Size];
+	}
+
+	if(Silence) memset(Buffer->Data, 0, Buffer->Size);
+
+	/* Interleave a tile of samples at a time, limited so that no input crosses a chunk boundary within a tile */
+
+	const size_t TileSamples = 256;
+
+	UInt8 *Out = Buffer->Data;
+	size_t Done = 0;
+	while(Done < Count)
+	{
+		size_t Step = Count - Done;
+		if(Step > TileSamples) Step = TileSamples;
+
+		for(i=0; i<InputCount; i++)
+		{
+			InputData &Input = Inputs[i];
+			if(Done >= Input.Wanted) continue;
+
+			size_t Left = static_cast<size_t>(Input.ChunkEnd - Cursors[i].In) / Input.SampleSize;
+			if(Left > (Input.Wanted - Done)) Left = Input.Wanted - Done;
+			if(Left < Step) Step = Left;
+		}
+
+		std::vector<size_t>::iterator Block = Blocks.begin();
+		while(Block != Blocks.end())
+		{
+			size_t First = *Block;
+			size_t Last = First + TransposeWidth;
+
+			// The transpose kernels load 16 bytes per sample position, so limit them to samples where this will not pass the end of any input
+			size_t SafeCount = Step;
+			for(i = First; i < Last; i++)
+			{
+				// Any input that has ended makes the block unusable for this tile
+				if(Done >= Inputs[i].Wanted)
+				{
+					SafeCount = 0;
+					break;
+				}
+
+				size_t Bytes = static_cast<size_t>(Inputs[i].ChunkEnd - Cursors[i].In);
+				size_t Safe = (Bytes >= 16) ? (((Bytes - 16) / Inputs[i].SampleSize) + 1) : 0;
+				if(Safe < SafeCount) SafeCount = Safe;
+			}
+
+			size_t Transposed = 0;
+			if(SafeCount) Transposed = Transpose(Out, SafeCount, SampleSize, &Cursors[First]);
+
+			// Finish off any samples the transpose kernel could not handle
+			if(Transposed < Step)
+			{
+				UInt8 *Tail = &Out[Transposed * SampleSize];
+
+				for(i = First; i < Last; i++)
+				{
+					if(Done < Inputs[i].Wanted) Inputs[i].Kernel(Tail, Step - Transposed, SampleSize, &Cursors[i], 1);
+				}
+			}
+
+			Block++;
+		}
+
+		for(i=0; i<InputCount; i++)
+		{
+			InputData &Input = Inputs[i];
+			if(Done >= Input.Wanted) continue;
+
+			if(!Input.InBlock) Input.Kernel(Out, Step, SampleSize, &Cursors[i], 1);
+
+			// Move to the next chunk if this one is used up
+			if(((Done + Step) < Input.Wanted) && ((Input.ChunkEnd - Cursors[i].In) < static_cast<ptrdiff_t>(Input.SampleSize)))
+			{
+				Input.Chunk++;
+				Cursors[i].In = Input.Chunks[Input.Chunk]->Data;
+				Input.ChunkEnd = &Input.Chunks[Input.Chunk]->Data[Input.Chunks[Input.Chunk]->Size];
+			}
+		}
+
+		Out += Step * SampleSize;
+		Done += Step;
+	}
+
+	/* Discard the input data that has been used */
+
+	for(i=0; i<InputCount; i++)
+	{
+		InputData &Input = Inputs[i];
+		if(Input.Wanted == 0) continue;
+
+		size_t Used = Input.Chunk;
+		Input.Offset = static_cast<size_t>(Cursors[i].In - Input.Chunks[Used]->Data);
+
+		// Also discard the last chunk if there are no whole samples left in it
+		if((Input.ChunkEnd - Cursors[i].In) < static_cast<ptrdiff_t>(Input.SampleSize))
+		{
+			Used++;
+			Input.Offset = 0;
+		}
+
+		Input.Chunks.erase(Input.Chunks.begin(), Input.Chunks.begin() + Used);
+		Input.SampleCount -= Input.Wanted;
+	}
+
+	// Move to the next entry in the sequence
+	if(!ConstSamples)
+	{
+		SequencePos++;
+		if(SequencePos >= SampleSequence.size()) SequencePos = 0;
+	}
+
+	return true;
+}
+
+
+//! Get the size of the essence data in bytes
+/*! \note There is intentionally no support for an "unknown" response */
+size_t AudioMux::GetEssenceDataSize(void)
+{
+	if(!BuildEditUnit()) return 0;
+
+	return Buffer->Size - BufferOffset;
+}
+
+
+//! Get the next "installment" of essence data
+/*! This will return an entire edit unit for all channels, unless that would be larger than Size or
+ *  break the MaxSize limit, in which case it will be returned in smaller chunks.
+ *  \return Pointer to a data chunk holding the next data or a NULL pointer when no more remains
+ *	\note If there is more data to come but it is not currently available the return value will be a pointer to an empty data chunk
+ *	\note On no account will the returned chunk be larger than MaxSize (if MaxSize > 0)
+ *  DRAGONS: The returned chunk is only valid until the next call to GetEssenceData() or GetEssenceDataSize()
+ */
+DataChunkPtr AudioMux::GetEssenceData(size_t Size /*=0*/, size_t MaxSize /*=0*/)
+{
+	if(!BuildEditUnit())
+	{
+		if(EndOfData()) return NULL;
+
+		// More data to come, but not yet available
+		Part->SetBuffer(Buffer->Data, 0);
+		return Part;
+	}
+
+	size_t Bytes = Buffer->Size - BufferOffset;
+	if(Size && (Bytes > Size)) Bytes = Size;
+	if(MaxSize && (Bytes > MaxSize)) Bytes = MaxSize;
+
+	DataChunkPtr Ret;
+
+	// Return the whole buffer if we can, otherwise reference the required part of it
+	if((BufferOffset == 0) && (Bytes == Buffer->Size))
+	{
+		Ret = Buffer;
+	}
+	else
+	{
+		Part->SetBuffer(&Buffer->Data[BufferOffset], Bytes);
+		Ret = Part;
+	}
+
+	BufferOffset += Bytes;
+
+	Eoi = (BufferOffset == Buffer->Size);
+	if(Eoi) CurrentPosition++;
+
+	return Ret;
+}
+
+
+//! Is all data exhasted?
+bool AudioMux::EndOfData(void)
+{
+	if(BufferOffset < Buffer->Size) return false;
+
+	InputList::iterator it = Inputs.begin();
+	while(it != Inputs.end())
+	{
+		if((!(*it).Eof) || ((*it).SampleCount > 0)) return false;
+		it++;
+	}
+
+	return true;
+}
+
+
+//! Get BytesPerEditUnit if Constant, else 0
+UInt32 AudioMux::GetBytesPerEditUnit(UInt32 KAGSize /*=1*/)
+{
+	if(!SequenceValid) CalcWrappingSequence();
+
+	if(ConstSamples == 0) return 0;
+
+	if((BytesPerEditUnit == -1) || (BPEUKAGSize != KAGSize))
+	{
+		BPEUKAGSize = KAGSize;
+
+		// Each edit unit is wrapped in a KLV with a 4-byte BER length (as forced by GetBERSize())
+		BytesPerEditUnit = (ConstSamples * SampleSize) + 16 + 4;
+
+		// Adjust for whole KAGs if required
+		if(KAGSize > 1)
+		{
+			// Work out how much short of the next KAG boundary we would be
+			UInt32 Remainder = static_cast<UInt32>(BytesPerEditUnit) % KAGSize;
+			if(Remainder) Remainder = KAGSize - Remainder;
+
+			// Round up to the start of the next KAG
+			BytesPerEditUnit += Remainder;
+
+			// If there is not enough space to fit a filler in the remaining space an extra KAG will be required
+			// DRAGONS: For very small KAGSizes we may need to add several KAGs
+			while((Remainder > 0) && (Remainder < 17))
+			{
+				BytesPerEditUnit += KAGSize;
+				Remainder += KAGSize;
+			}
+		}
+	}
+
+	return static_cast<UInt32>(BytesPerEditUnit);
+}
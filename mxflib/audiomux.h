@@ -60,7 +60,43 @@ namespace mxflib
 	typedef ParentPtr<AudioDemuxSource> AudioDemuxSourceParent;
 
 
+	//! Details of one group of channels being extracted by an audio demux kernel
+	struct DemuxTarget
+	{
+		UInt8 *Out;							//!< Pointer to the next output byte for this group, advanced by the kernel
+		unsigned int Offset;				//!< Byte offset of the first channel of this group within each source sample
+		unsigned int ChannelCount;			//!< The number of channels in this group
+		unsigned int Size;					//!< The number of bytes written per sample for this group
+	};
+
+	//! Function that demultiplexes SampleCount samples for all given targets in a single pass over the source data
+	typedef void (*DemuxKernel)(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets, size_t TargetCount);
+
+	//! Function that transposes a block of adjacent single-channel targets (of the width it was selected for)
+	/*! \return The number of samples processed, which may be less than SampleCount - the caller must demux any remaining samples */
+	typedef size_t (*DemuxTransposeKernel)(const UInt8 *Source, size_t SampleCount, unsigned int SourceSampleSize, DemuxTarget *Targets);
+
+
+	//! Details of one input being interleaved by an audio mux kernel
+	struct MuxInput
+	{
+		const UInt8 *In;					//!< Pointer to the next input byte for this input, advanced by the kernel
+		unsigned int Offset;				//!< Byte offset of the first channel of this input within each output sample
+		unsigned int ChannelCount;			//!< The number of channels in this input
+	};
+
+	//! Function that interleaves SampleCount samples from all given inputs into a run of output samples
+	typedef void (*MuxKernel)(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs, size_t InputCount);
+
+	//! Function that transposes a block of adjacent single-channel inputs (of the width it was selected for)
+	/*! \return The number of samples processed, which may be less than SampleCount - the caller must interleave any remaining samples */
+	typedef size_t (*MuxTransposeKernel)(UInt8 *Dest, size_t SampleCount, unsigned int DestSampleSize, MuxInput *Inputs);
+
+
 	//! Audio demultiplexer class, splits a single multi-channel audio source into sources with less channels each
+	/*! Each buffer read from the source is demultiplexed for all attached AudioDemuxSource objects in a single pass, the first
+	 *  time any one of them requires data from that buffer. The demux kernels used are selected once as sources are attached.
+	 */
 	class AudioDemux : public RefCount<AudioDemux>
 	{
 	protected:
@@ -70,14 +106,26 @@ namespace mxflib
 			EssenceSourceParent Source;		//!< Parent pointers for this channel's output EssenceSource, NULL if this channel not being output
 			Position Pos;					//!< Sample position for this channel, holds the sample number for the next sample to output for this channel
 			bool Eof;						//!< True once this channel has output all that it can
+			int Group;						//!< The index of the channel group (in Groups) that outputs this channel, or -1 if not being output
 		};
 
+		//! Structure holding data relating to a group of channels output by a single AudioDemuxSource
+		struct GroupData
+		{
+			unsigned int Channel;			//!< The number of the first channel in the group
+			unsigned int ChannelCount;		//!< The number of channels in the group
+		};
+
+		//! List of demultiplexed data for each channel group, indexed by group number (NULL entries have not been demultiplexed, or have been taken)
+		typedef std::vector<DataChunkPtr> PlaneList;
+
 		//! Structure holding data relating to old, but still active, data
 		struct OldDataStruct
 		{
 			DataChunkPtr Data;				//!< The data chunk holding the data
 			Position Start;					//!< The sample number if the first sample in the data buffer
 			Length SampleCount;				//!< The number of samples in the data buffer
+			PlaneList Planes;				//!< The demultiplexed data for each channel group
 		};
 
 		//! List of OldDataStructs
@@ -95,10 +143,16 @@ namespace mxflib
 		bool Eof;							//!< The original source has ended
 
 		OutputData *Outputs;				//!< Array of data relating to each channel being output
+		std::vector<GroupData> Groups;		//!< The channel groups being output, one per AudioDemuxSource
 
 		DataChunkPtr CurrentData;			//!< Pointer to a chunk containing the current audio data
 		Position CurrentStart;				//!< The sample number of the first sample in the CurrentData buffer
 		Length CurrentSampleCount;			//!< The number of samples in the CurrentData buffer
+		PlaneList CurrentPlanes;			//!< The demultiplexed data for each channel group from the CurrentData buffer
+
+		DemuxKernel Kernel;					//!< The kernel used to demultiplex all channel groups, NULL if the sample sizes are not supported
+		DemuxTransposeKernel Transpose;		//!< The kernel used for blocks of adjacent single-channel groups, or NULL if none available
+		unsigned int TransposeWidth;		//!< The number of channels handled in each block by Transpose
 
 		OldDataList OldData;				//!< List of data about chunks containing old, but active, data
 
@@ -138,6 +192,7 @@ namespace mxflib
 
 			// Initialize list of output sources and their positions
 			Outputs = new OutputData[SourceChannelCount];
+			for(unsigned int i=0; i<SourceChannelCount; i++) Outputs[i].Group = -1;
 
 			// Clear the current start
 			CurrentStart = 0;
@@ -160,6 +215,9 @@ namespace mxflib
 			VideoEditRate.Numerator=0;
 			VideoEditRate.Denominator=0;
 			FrameCount=0;
+
+			// Select the initial demux kernels
+			SelectKernels();
 		};
 
 		//! Clean up
@@ -180,7 +238,7 @@ namespace mxflib
 		void SetMaxChunkSize(size_t Max) { MaxChunkSize = Max; }
 
 		//! Set the output bit size
-		void SetOutputBitSize(unsigned int Bits) { OutputBitSize = Bits; }
+		void SetOutputBitSize(unsigned int Bits) { OutputBitSize = Bits; SelectKernels(); }
 
 
 		void SetVideoRate( Rational ER)
@@ -246,6 +304,17 @@ namespace mxflib
 		 */
 		void FillBuffer(void);
 
+		//! Select the demux kernels to use for the current sample sizes and channel groups
+		void SelectKernels(void);
+
+		//! Demultiplex a buffer for all channel groups that still require data from it, in a single pass over the buffer
+		/*! \param Data The interleaved source data
+		 *  \param Start The sample number of the first sample in the buffer
+		 *  \param SampleCount The number of samples in the buffer
+		 *  \param Planes The list of demultiplexed data for this buffer, new entries are added for each group demultiplexed
+		 */
+		void SplitBuffer(const UInt8 *Data, Position Start, Length SampleCount, PlaneList &Planes);
+
 		//! Determine which of the old buffers to use for the given channel
 		/*! \return iterator indexing the OutputData structure for the buffer, or OutData.end() if there is a problem
 		 *  \note The caller must ensure that the channel number is valid and the channel is attached to an AudioDemuxSource before calling
@@ -395,6 +464,194 @@ namespace mxflib
 		//! Calculate BytesPerEditUnit for a given KAGSize
 		void CalcBytesPerEditUnit(Uint32 KAGSize);
 	};
+
+
+	//! Audio multiplexer class, interleaves a number of audio sources with few channels each into a single multi-channel source
+	/*! Each input is allocated the next channels of the output, in the order that the inputs are added. Any output channels
+	 *  not allocated to an input, and any samples beyond the end of an input that has ended early, are silent.
+	 *  Each edit unit is interleaved for all inputs in a single pass, using the same number of samples per edit unit as the
+	 *  WAVE PCM essence parser would use for the edit rate (such as 1602, 1601, 1602, 1601, 1602 for 48kHz at 30000/1001).
+	 *  \note All data is handed out from a single output buffer that is re-used for each edit unit, so once running no memory is
+	 *        allocated per edit unit (although the inputs may allocate memory for the data they supply).
+	 *  DRAGONS: The DataChunk returned by GetEssenceData() is only valid until the next call to GetEssenceData() or GetEssenceDataSize().
+	 *           This is fine for GCWriter, which copies or writes the data immediately, but any other caller must copy the data if it is
+	 *           to be kept.
+	 */
+	class AudioMux : public EssenceSource
+	{
+	protected:
+		//! Structure holding data relating to one input source
+		struct InputData
+		{
+			EssenceSourcePtr Source;		//!< The source supplying this input
+			unsigned int Channel;			//!< The number of the first output channel fed by this input
+			unsigned int ChannelCount;		//!< The number of channels in this input
+			unsigned int BitSize;			//!< The size of each sample of each channel in this input, in bits
+			unsigned int SampleSize;		//!< The total size of an input sample, for all channels, in bytes
+			MuxKernel Kernel;				//!< The kernel used to interleave this input, NULL if the sample sizes are not supported
+			bool InBlock;					//!< True if this input is interleaved as part of a transpose block
+			bool Eof;						//!< True once this input has supplied all its data
+			std::vector<DataChunkPtr> Chunks;	//!< Buffered data read from this input but not yet interleaved (a vector so that no list nodes are allocated)
+			size_t Offset;					//!< Byte offset of the first unused sample in the first buffered chunk
+			Length SampleCount;				//!< The number of unused samples buffered
+			size_t Wanted;					//!< The number of samples being taken from this input for the current edit unit
+			size_t Chunk;					//!< Index of the buffered chunk being read for the current edit unit
+			const UInt8 *ChunkEnd;			//!< Pointer to the end of the buffered chunk being read for the current edit unit
+		};
+
+		//! List of InputData structures
+		typedef std::vector<InputData> InputList;
+
+	protected:
+		InputList Inputs;					//!< The inputs being interleaved
+		std::vector<MuxInput> Cursors;		//!< Working state for each input while interleaving an edit unit (kept to prevent allocation)
+		std::vector<size_t> Blocks;			//!< Index of the first input in each transpose block
+
+		unsigned int ChannelCount;			//!< The number of channels in the output
+		unsigned int ChannelBitSize;		//!< The size of each output sample of each channel, in bits
+		unsigned int SampleSize;			//!< The total size of an output sample, for all channels, in bytes
+		UInt32 AudioSampleRate;				//!< The sample rate of the audio
+		unsigned int UsedChannels;			//!< The number of output channels allocated to inputs so far
+
+		Rational EditRate;					//!< The edit rate being used for wrapping, or 0/0 to use that of the first input
+		UInt32 ConstSamples;				//!< The number of samples in every edit unit, or zero if a sequence is used
+		std::vector<UInt32> SampleSequence;	//!< The number of samples in each edit unit of the sequence, empty if constant
+		size_t SequencePos;					//!< The current position in SampleSequence
+		bool SequenceValid;					//!< True once the sample counts for EditRate have been calculated
+
+		Position CurrentPosition;			//!< The number of edit units read so far
+		UInt8 ElementType;					//!< The GC element type to use, or zero to use that of the first input
+
+		MuxTransposeKernel Transpose;		//!< The kernel used for blocks of adjacent single-channel inputs, or NULL if none available
+		unsigned int TransposeWidth;		//!< The number of inputs handled in each block by Transpose
+		bool KernelsValid;					//!< True once the kernels have been selected for the current inputs
+
+		DataChunkPtr Buffer;				//!< The buffer holding the current interleaved edit unit
+		size_t BufferOffset;				//!< The number of bytes of Buffer already returned
+		DataChunkPtr Part;					//!< Chunk referencing part of Buffer, used when the MaxSize limit prevents returning the whole edit unit
+		bool Eoi;							//!< True if the last GetEssenceData() call completed a wrapping item
+
+		Length BytesPerEditUnit;			//!< The size of an edit unit, if constant, else zero. Set to -1 when not known
+		UInt32 BPEUKAGSize;					//!< The KAGSize used to calculate BytesPerEditUnit
+
+	private:
+		AudioMux();							//!< Prevent default construction
+		AudioMux(AudioMux&);				//!< Prevent copy construction
+
+	public:
+		//! Construct a new audio mux object
+		/*! \param ChannelCount The number of channels in the output
+		 *  \param ChannelBitSize The size of each output sample of each channel, in bits
+		 *  \param AudioSampleRate The sample rate of the audio (all inputs must have this sample rate)
+		 */
+		AudioMux(unsigned int ChannelCount, unsigned int ChannelBitSize, UInt32 AudioSampleRate)
+			: ChannelCount(ChannelCount), ChannelBitSize(ChannelBitSize), AudioSampleRate(AudioSampleRate)
+		{
+			SampleSize = ((ChannelBitSize * ChannelCount) + 7) / 8;
+			UsedChannels = 0;
+
+			EditRate.Numerator = 0;
+			EditRate.Denominator = 0;
+			ConstSamples = 0;
+			SequencePos = 0;
+			SequenceValid = false;
+
+			CurrentPosition = 0;
+			ElementType = 0;
+
+			Transpose = NULL;
+			TransposeWidth = 0;
+			KernelsValid = false;
+
+			Buffer = new DataChunk;
+			BufferOffset = 0;
+			Part = new DataChunk;
+			Eoi = true;
+
+			BytesPerEditUnit = -1;
+		}
+
+		//! Add an input source, which will feed the next unallocated output channels
+		/*! \param Source The source of interleaved audio samples for this input
+		 *  \param ChannelCount The number of channels in this input (e.g. ChannelCount = 2 gives a stereo pair)
+		 *  \param BitSize The size of each sample of each channel in this input, in bits, or zero if the same as the output
+		 *  \return false if there are not enough unallocated output channels, or interleaving has started
+		 */
+		bool AddInput(EssenceSourcePtr Source, unsigned int ChannelCount = 1, unsigned int BitSize = 0);
+
+		//! Set the GC element type to use (for example 0x03 for AES3 frame wrapping), rather than that of the first input
+		void SetGCElementType(UInt8 Type) { ElementType = Type; }
+
+		//! Get the size of the essence data in bytes
+		/*! \note There is intentionally no support for an "unknown" response */
+		virtual size_t GetEssenceDataSize(void);
+
+		//! Get the next "installment" of essence data
+		/*! This will return an entire edit unit for all channels, unless that would be larger than Size or
+		 *  break the MaxSize limit, in which case it will be returned in smaller chunks.
+		 *  \return Pointer to a data chunk holding the next data or a NULL pointer when no more remains
+		 *	\note If there is more data to come but it is not currently available the return value will be a pointer to an empty data chunk
+		 *	\note On no account will the returned chunk be larger than MaxSize (if MaxSize > 0)
+		 *  DRAGONS: The returned chunk is only valid until the next call to GetEssenceData() or GetEssenceDataSize()
+		 */
+		virtual DataChunkPtr GetEssenceData(size_t Size = 0, size_t MaxSize = 0);
+
+		//! Did the last call to GetEssenceData() return the end of a wrapping item
+		virtual bool EndOfItem(void) { return Eoi; }
+
+		//! Is all data exhasted?
+		virtual bool EndOfData(void);
+
+		//! Get the GCEssenceType to use when wrapping this essence in a Generic Container
+		virtual UInt8 GetGCEssenceType(void) { return 0x16; }
+
+		//! Get the GCEssenceType to use when wrapping this essence in a Generic Container
+		virtual UInt8 GetGCElementType(void)
+		{
+			if(ElementType || Inputs.empty()) return ElementType;
+			return Inputs[0].Source->GetGCElementType();
+		}
+
+		//! Get the edit rate of this wrapping of the essence
+		virtual Rational GetEditRate(void)
+		{
+			if(EditRate.Denominator || Inputs.empty()) return EditRate;
+			return Inputs[0].Source->GetEditRate();
+		}
+
+		//! Set the edit rate to use for wrapping
+		/*! \return true if this rate is acceptable */
+		virtual bool SetEditRate(Rational NewEditRate);
+
+		//! Get the preferred BER length size for essence KLVs written from this source, 0 for auto
+		/*! DRAGONS: Fixed at 4 bytes so that GetBytesPerEditUnit() is correct for frame wrapping */
+		virtual int GetBERSize(void) { return 4; }
+
+		//! Get the current position in GetEditRate() sized edit units
+		virtual Position GetCurrentPosition(void) { return CurrentPosition; }
+
+		//! Get BytesPerEditUnit if Constant, else 0
+		virtual UInt32 GetBytesPerEditUnit(UInt32 KAGSize = 1);
+
+		//! Get a human readable name for this source
+		virtual std::string Name(void) { return "AudioMux"; }
+
+	protected:
+		//! Calculate the number of samples in each edit unit for the current edit rate, in the same way as the WAVE PCM essence parser
+		/*! \return false if no sequence of less than 10000 edit units gives a whole number of samples */
+		bool CalcWrappingSequence(void);
+
+		//! Select the mux kernels to use for the current inputs
+		void SelectKernels(void);
+
+		//! Read more data from an input
+		/*! \return false if no data was available (either at the end of the input, or more data is not yet available) */
+		bool ReadInput(InputData &Input);
+
+		//! Interleave the next edit unit into Buffer, if not already done
+		/*! \return false if there was no more data available from any input */
+		bool BuildEditUnit(void);
+	};
 }
 
 #endif // MXFLIB__AUDIOMUX_H
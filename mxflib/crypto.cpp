@@ -28,9 +28,46 @@
 
 #include "mxflib.h"
 
+#ifdef MXFLIB_THREADS
+#include <IlmThread.h>
+#include <IlmThreadPool.h>
+#endif // MXFLIB_THREADS
+
 using namespace mxflib;
 
 
+//! Size of the sections used when decrypting on the thread pool, or 0 to always decrypt on the calling thread
+size_t KLVEObject::ParallelSectionSize = 0;
+
+
+#ifdef MXFLIB_THREADS
+namespace
+{
+	//! Task to decrypt one section of a chunk in place
+	class DecryptSectionTask : public IlmThread::Task
+	{
+	public:
+		DecryptSectionTask(IlmThread::TaskGroup *Group, Decrypt_Base *Decrypt, const UInt8 *SectionIV, size_t Size, UInt8 *Data, UInt8 *Result)
+			: Task(Group), Decrypt(Decrypt), SectionIV(SectionIV), Size(Size), Data(Data), Result(Result)
+		{
+		}
+
+		virtual void execute()
+		{
+			*Result = Decrypt->DecryptSectionInPlace(SectionIV, Size, Data) ? 1 : 0;
+		}
+
+	private:
+		Decrypt_Base *Decrypt;					//!< The decryption wrapper, which must support CanDecryptSections()
+		const UInt8 *SectionIV;					//!< The Initialization Vector for this section
+		size_t Size;							//!< Number of bytes in this section
+		UInt8 *Data;							//!< The start of this section
+		UInt8 *Result;							//!< Set to 1 if decrypted successfully, else 0
+	};
+}
+#endif // MXFLIB_THREADS
+
+
 //! Set a decryption Initialization Vector
 /*! \return False if Initialization Vector is rejected
  */
@@ -688,6 +725,23 @@ size_t KLVEObject::ReadChunkedCryptoDataFrom(Position Offset, size_t Size)
 	// Read the encrypted data
 	size_t NewSize = Base_ReadDataFrom(DataOffset + Offset, Size);
 
+#ifdef MXFLIB_THREADS
+	// Large chunks may be hashed and decrypted as a pipeline, with the decryption spread across the thread pool
+	if(ParallelSectionSize && (NewSize == Size) && (Size >= 2 * ParallelSectionSize) && ((Size % EncryptionGranularity) == 0)
+	   && Decrypt->CanDecryptSections())
+	{
+		if(!ParallelDecryptInPlace())
+		{
+			// Invalidate the "next" position to prevent further read attempts
+			CurrentReadOffset = Source.OuterLength;
+			Data.Resize(0);
+			return 0;
+		}
+
+		return Size;
+	}
+#endif // MXFLIB_THREADS
+
 	// Update the current hash if we are calculating one
 	if(ReadHasher) ReadHasher->HashData(Data);
 
@@ -740,6 +794,70 @@ size_t KLVEObject::ReadChunkedCryptoDataFrom(Position Offset, size_t Size)
 }
 
 
+#ifdef MXFLIB_THREADS
+//! Hash and decrypt the whole of the current DataChunk in place, spreading the decryption across the thread pool
+/*! The chunk is split into sections of ParallelSectionSize bytes. Each section must be hashed before it is overwritten by
+ *  decryption, so the calling thread hashes the sections in order and hands each to the thread pool as soon as it is hashed.
+ *  \return true if all sections decrypted successfully
+ */
+bool KLVEObject::ParallelDecryptInPlace(void)
+{
+	size_t Size = Data.Size;
+	size_t Sections = (Size + ParallelSectionSize - 1) / ParallelSectionSize;
+
+	// Each section is chained from the last cyphertext block of the section before, so these must be recorded before any are decrypted
+	DataChunkPtr FirstIV = Decrypt->GetIV();
+	if((!FirstIV) || (FirstIV->Size != EncryptionGranularity)) return false;
+
+	std::vector<UInt8> SectionIVs(Sections * EncryptionGranularity);
+	memcpy(&SectionIVs[0], FirstIV->Data, EncryptionGranularity);
+
+	size_t i;
+	for(i = 1; i < Sections; i++)
+	{
+		memcpy(&SectionIVs[i * EncryptionGranularity], &Data.Data[i * ParallelSectionSize - EncryptionGranularity], EncryptionGranularity);
+	}
+
+	// The last cyphertext block is the vector for the next read
+	UInt8 NextIV[EncryptionGranularity];
+	memcpy(NextIV, &Data.Data[Size - EncryptionGranularity], EncryptionGranularity);
+
+	std::vector<UInt8> Results(Sections, 0);
+	{
+		IlmThread::TaskGroup Group;
+
+		for(i = 0; i < Sections; i++)
+		{
+			size_t Start = i * ParallelSectionSize;
+			size_t SectionSize = Size - Start;
+			if(SectionSize > ParallelSectionSize) SectionSize = ParallelSectionSize;
+
+			// Update the current hash if we are calculating one
+			if(ReadHasher) ReadHasher->HashData(SectionSize, &Data.Data[Start]);
+
+			IlmThread::ThreadPool::addGlobalTask(new DecryptSectionTask(&Group, Decrypt.GetPtr(), &SectionIVs[i * EncryptionGranularity],
+																		SectionSize, &Data.Data[Start], &Results[i]));
+		}
+
+		// DRAGONS: The TaskGroup destructor waits for all its tasks to complete
+	}
+
+	Decrypt->SetIV(EncryptionGranularity, NextIV, true);
+
+	for(i = 0; i < Sections; i++)
+	{
+		if(!Results[i])
+		{
+			error("Failed to decrypt section %d of %d in KLVEObject::ParallelDecryptInPlace()\n", static_cast<int>(i), static_cast<int>(Sections));
+			return false;
+		}
+	}
+
+	return true;
+}
+#endif // MXFLIB_THREADS
+
+
 //! Write data from a given buffer to a given location in the destination file
 /*! \param Buffer Pointer to data to be written
  *  \param Offset The offset within the KLV value field of the first byte to write
@@ -112,6 +112,24 @@ namespace mxflib
 		 */
 		virtual bool EncryptInPlace(size_t Size, UInt8 *Data) = 0;
 
+		//! Can this encryption system encrypt independent chunks at the same time?
+		/*! If true, EncryptSectionInPlace() may be called for different chunks at the same time from different threads.
+		 */
+		virtual bool CanEncryptSections(void) { return false; }
+
+		//! Encrypt one section of data in place, starting from the given Initialization Vector
+		/*! The vector used by other encryption calls is not changed.
+		 *  \return true if the encryption is successful
+		 *  \note Must be safe to call from several threads at once
+		 */
+		virtual bool EncryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data)
+		{
+			UNUSED_PARAMETER(SectionIV);
+			UNUSED_PARAMETER(Size);
+			UNUSED_PARAMETER(Data);
+			return false;
+		}
+
 		//! Encrypt data bytes in place
 		/*! \return true if the encryption is successful
 		 */
@@ -214,6 +232,26 @@ namespace mxflib
 		 */
 		virtual bool DecryptInPlace(size_t Size, UInt8 *Data) = 0;
 
+		//! Can this decryption system decrypt separate sections of a chunk independently?
+		/*! If true, DecryptSectionInPlace() may be called for different sections of the same chunk at the same time from different threads.
+		 *  This is possible with cypher block chaining as each block depends only on the cyphertext of the block before it.
+		 */
+		virtual bool CanDecryptSections(void) { return false; }
+
+		//! Decrypt one section of a chunk in place, given the Initialization Vector for that section
+		/*! For cypher block chaining SectionIV is the cyphertext block preceeding the section (or the current vector for the first section).
+		 *  The vector used by other decryption calls is not changed, so this must be set after decrypting the last section.
+		 *  \return true if the decryption <i>appears to be</i> successful
+		 *  \note Must be safe to call from several threads at once
+		 */
+		virtual bool DecryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data)
+		{
+			UNUSED_PARAMETER(SectionIV);
+			UNUSED_PARAMETER(Size);
+			UNUSED_PARAMETER(Data);
+			return false;
+		}
+
 		//! Decrypt data bytes in place
 		/*! \return true if the decryption <i>appears to be</i> successful
 		 */
@@ -288,6 +326,12 @@ namespace mxflib
 
 		//! Get the finished hash value
 		virtual DataChunkPtr GetHash(void) = 0;
+
+		//! Make a new hasher of the same type, with the same key, ready to start a new hash
+		/*! This allows separate hashes to be calculated on different threads.
+		 *  \return NULL if not supported by this hash wrapper
+		 */
+		virtual SmartPtr<Hash_Base> MakeNew(void) { return NULL; }
 	};
 
 	// Smart pointer to a hash function wrapper object
@@ -346,6 +390,8 @@ namespace mxflib
 
 		UInt32 FooterLength;						//!< The size of the AS-DCP footer to be written for this KLVEObject
 
+		static size_t ParallelSectionSize;			//!< Size of the sections used when decrypting on the thread pool, or 0 to always decrypt on the calling thread
+
 	public:
 		//** KLVEObject Specifics **//
 
@@ -395,6 +441,18 @@ namespace mxflib
 		//! Get the plaintext offset of the encrypted data
 		Length GetPlaintextOffset(void) { return PlaintextOffset; }
 
+		//! Enable or disable parallel decryption of large encrypted values
+		/*! When enabled, any chunk of at least two sections is split into sections of SectionSize bytes. The calling thread
+		 *  hashes each section in turn then hands it to the IlmThread global thread pool for decryption, so hashing overlaps
+		 *  decryption and decryption is spread across the pool. A SectionSize of 0 disables this mode.
+		 *  \note Only available if built with MXFLIB_THREADS, and only used if the decryption wrapper supports CanDecryptSections()
+		 *  \note The size of the global thread pool is set by the application using IlmThread::ThreadPool::globalThreadPool().setNumThreads()
+		 */
+		static void SetParallelDecrypt(size_t SectionSize)
+		{
+			ParallelSectionSize = (SectionSize / EncryptionGranularity) * EncryptionGranularity;
+		}
+
 		//** Construction / desctruction **//
 		KLVEObject(ULPtr ObjectUL);				//!< Construct a new KLVEObject
 		KLVEObject(KLVObjectPtr &Object);		//!< Construct a KLVEObject linked to an encrypted KLVObject
@@ -520,6 +578,9 @@ namespace mxflib
 			return ValueLength;
 		}
 
+		//! The source file holds the encrypted value, so the plaintext value can't be read directly
+		virtual Position GetValueLocation(void) { return -1; }
+
 		//! Set the length of the value field
 		virtual void SetLength(Length NewLength) 
 		{ 
@@ -574,6 +635,13 @@ namespace mxflib
 		 *  Only encrypted parts of the value may be read using this function (i.e. Offset >= PlaintextOffset)
 		 */
 		size_t ReadChunkedCryptoDataFrom(Position Offset, size_t Size);
+
+#ifdef MXFLIB_THREADS
+		//! Hash and decrypt the whole of the current DataChunk in place, spreading the decryption across the thread pool
+		/*! \return true if all sections decrypted successfully
+		 */
+		bool ParallelDecryptInPlace(void);
+#endif // MXFLIB_THREADS
 	
 		//! Write encrypted data from a given buffer to a given location in the destination file
 		/*! \param Buffer Pointer to data to be written
@@ -0,0 +1,1225 @@
+/*! \file	crypto_asdcp.cpp
+ *	\brief	Implementation of the built-in AS-DCP encryption, decryption and hashing wrappers
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "mxflib.h"
+
+#include "simd.h"
+
+using namespace mxflib;
+
+
+namespace
+{
+	//! The AES S-box
+	const UInt8 SBox[256] =
+	{
+		0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+		0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+		0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+		0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+		0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+		0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+		0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+		0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+		0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+		0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+		0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+		0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+		0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+		0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+		0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+		0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+	};
+
+	//! Multiply two elements of GF(2^8) using the AES polynomial
+	UInt8 GFMul(UInt8 a, UInt8 b)
+	{
+		UInt8 Ret = 0;
+		while(b)
+		{
+			if(b & 1) Ret ^= a;
+			a = static_cast<UInt8>((a << 1) ^ ((a & 0x80) ? 0x1b : 0));
+			b >>= 1;
+		}
+		return Ret;
+	}
+
+	//! Rotate a 32-bit word right by the given number of bits
+	inline UInt32 RotR(UInt32 Value, int Bits) { return (Value >> Bits) | (Value << (32 - Bits)); }
+
+	//! Rotate a 32-bit word left by the given number of bits
+	inline UInt32 RotL(UInt32 Value, int Bits) { return (Value << Bits) | (Value >> (32 - Bits)); }
+
+	//! Tables used by the portable AES implementation
+	/*! Each round combines SubBytes, ShiftRows and MixColumns as four table lookups per column
+	 */
+	struct AESTables
+	{
+		UInt32 Enc[4][256];				//!< Forward round tables
+		UInt32 Dec[4][256];				//!< Inverse round tables
+		UInt8 InvSBox[256];				//!< The inverse S-box, for the last decryption round
+
+		AESTables()
+		{
+			int i;
+			for(i = 0; i < 256; i++) InvSBox[SBox[i]] = static_cast<UInt8>(i);
+
+			for(i = 0; i < 256; i++)
+			{
+				UInt8 s = SBox[i];
+				UInt32 e = (static_cast<UInt32>(GFMul(s, 2)) << 24) | (static_cast<UInt32>(s) << 16)
+						 | (static_cast<UInt32>(s) << 8) | GFMul(s, 3);
+
+				UInt8 is = InvSBox[i];
+				UInt32 d = (static_cast<UInt32>(GFMul(is, 14)) << 24) | (static_cast<UInt32>(GFMul(is, 9)) << 16)
+						 | (static_cast<UInt32>(GFMul(is, 13)) << 8) | GFMul(is, 11);
+
+				int t;
+				for(t = 0; t < 4; t++)
+				{
+					Enc[t][i] = t ? RotR(e, 8 * t) : e;
+					Dec[t][i] = t ? RotR(d, 8 * t) : d;
+				}
+			}
+		}
+	};
+
+	//! Get the tables for the portable AES implementation, building them on first use
+	const AESTables &GetAESTables(void)
+	{
+		// DRAGONS: If two threads race here they will both build identical tables, so no locking is required
+		static const AESTables Tables;
+		return Tables;
+	}
+
+	//! Apply InvMixColumns to a single column, as required for the equivalent inverse cypher key schedule
+	UInt32 InvMixColumn(const AESTables &T, UInt32 Column)
+	{
+		// The decryption tables include the inverse S-box, so undo it with the forward S-box first
+		return T.Dec[0][SBox[Column >> 24]] ^ T.Dec[1][SBox[(Column >> 16) & 0xff]]
+			 ^ T.Dec[2][SBox[(Column >> 8) & 0xff]] ^ T.Dec[3][SBox[Column & 0xff]];
+	}
+
+	//! Expand a 16-byte key into 11 round keys for encryption
+	void ExpandKey(const UInt8 *Key, UInt32 *W)
+	{
+		static const UInt8 RCon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+		int i;
+		for(i = 0; i < 4; i++) W[i] = GetU32(&Key[i * 4]);
+
+		for(i = 4; i < 44; i++)
+		{
+			UInt32 Temp = W[i - 1];
+			if((i % 4) == 0)
+			{
+				Temp = RotL(Temp, 8);
+				Temp = (static_cast<UInt32>(SBox[Temp >> 24]) << 24) | (static_cast<UInt32>(SBox[(Temp >> 16) & 0xff]) << 16)
+					 | (static_cast<UInt32>(SBox[(Temp >> 8) & 0xff]) << 8) | SBox[Temp & 0xff];
+				Temp ^= static_cast<UInt32>(RCon[i / 4 - 1]) << 24;
+			}
+			W[i] = W[i - 4] ^ Temp;
+		}
+	}
+
+	//! Store expanded key words as bytes, in the order used by both the portable code and AES-NI
+	void StoreKey(const UInt32 *W, UInt8 *RoundKeys)
+	{
+		int i;
+		for(i = 0; i < 44; i++) PutU32(W[i], &RoundKeys[i * 4]);
+	}
+
+
+	/* Portable AES-128-CBC kernels */
+
+	//! Encrypt blocks with the portable table-driven AES
+	void AESEncryptCBC(const UInt8 *RoundKeys, UInt8 *Chain, const UInt8 *Source, UInt8 *Dest, size_t Blocks)
+	{
+		const AESTables &T = GetAESTables();
+
+		UInt32 RK[44];
+		int i;
+		for(i = 0; i < 44; i++) RK[i] = GetU32(&RoundKeys[i * 4]);
+
+		UInt32 c0 = GetU32(&Chain[0]);
+		UInt32 c1 = GetU32(&Chain[4]);
+		UInt32 c2 = GetU32(&Chain[8]);
+		UInt32 c3 = GetU32(&Chain[12]);
+
+		while(Blocks--)
+		{
+			UInt32 s0 = GetU32(&Source[0]) ^ c0 ^ RK[0];
+			UInt32 s1 = GetU32(&Source[4]) ^ c1 ^ RK[1];
+			UInt32 s2 = GetU32(&Source[8]) ^ c2 ^ RK[2];
+			UInt32 s3 = GetU32(&Source[12]) ^ c3 ^ RK[3];
+
+			int Round;
+			for(Round = 1; Round < 10; Round++)
+			{
+				const UInt32 *K = &RK[Round * 4];
+				UInt32 t0 = T.Enc[0][s0 >> 24] ^ T.Enc[1][(s1 >> 16) & 0xff] ^ T.Enc[2][(s2 >> 8) & 0xff] ^ T.Enc[3][s3 & 0xff] ^ K[0];
+				UInt32 t1 = T.Enc[0][s1 >> 24] ^ T.Enc[1][(s2 >> 16) & 0xff] ^ T.Enc[2][(s3 >> 8) & 0xff] ^ T.Enc[3][s0 & 0xff] ^ K[1];
+				UInt32 t2 = T.Enc[0][s2 >> 24] ^ T.Enc[1][(s3 >> 16) & 0xff] ^ T.Enc[2][(s0 >> 8) & 0xff] ^ T.Enc[3][s1 & 0xff] ^ K[2];
+				UInt32 t3 = T.Enc[0][s3 >> 24] ^ T.Enc[1][(s0 >> 16) & 0xff] ^ T.Enc[2][(s1 >> 8) & 0xff] ^ T.Enc[3][s2 & 0xff] ^ K[3];
+				s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+			}
+
+			// The last round has no MixColumns
+			c0 = ((static_cast<UInt32>(SBox[s0 >> 24]) << 24) | (static_cast<UInt32>(SBox[(s1 >> 16) & 0xff]) << 16)
+				| (static_cast<UInt32>(SBox[(s2 >> 8) & 0xff]) << 8) | SBox[s3 & 0xff]) ^ RK[40];
+			c1 = ((static_cast<UInt32>(SBox[s1 >> 24]) << 24) | (static_cast<UInt32>(SBox[(s2 >> 16) & 0xff]) << 16)
+				| (static_cast<UInt32>(SBox[(s3 >> 8) & 0xff]) << 8) | SBox[s0 & 0xff]) ^ RK[41];
+			c2 = ((static_cast<UInt32>(SBox[s2 >> 24]) << 24) | (static_cast<UInt32>(SBox[(s3 >> 16) & 0xff]) << 16)
+				| (static_cast<UInt32>(SBox[(s0 >> 8) & 0xff]) << 8) | SBox[s1 & 0xff]) ^ RK[42];
+			c3 = ((static_cast<UInt32>(SBox[s3 >> 24]) << 24) | (static_cast<UInt32>(SBox[(s0 >> 16) & 0xff]) << 16)
+				| (static_cast<UInt32>(SBox[(s1 >> 8) & 0xff]) << 8) | SBox[s2 & 0xff]) ^ RK[43];
+
+			PutU32(c0, &Dest[0]);
+			PutU32(c1, &Dest[4]);
+			PutU32(c2, &Dest[8]);
+			PutU32(c3, &Dest[12]);
+
+			Source += 16;
+			Dest += 16;
+		}
+
+		PutU32(c0, &Chain[0]);
+		PutU32(c1, &Chain[4]);
+		PutU32(c2, &Chain[8]);
+		PutU32(c3, &Chain[12]);
+	}
+
+	//! Decrypt blocks with the portable table-driven AES
+	void AESDecryptCBC(const UInt8 *RoundKeys, UInt8 *Chain, const UInt8 *Source, UInt8 *Dest, size_t Blocks)
+	{
+		const AESTables &T = GetAESTables();
+		const UInt8 *InvSBox = T.InvSBox;
+
+		UInt32 RK[44];
+		int i;
+		for(i = 0; i < 44; i++) RK[i] = GetU32(&RoundKeys[i * 4]);
+
+		UInt32 c0 = GetU32(&Chain[0]);
+		UInt32 c1 = GetU32(&Chain[4]);
+		UInt32 c2 = GetU32(&Chain[8]);
+		UInt32 c3 = GetU32(&Chain[12]);
+
+		while(Blocks--)
+		{
+			// Keep the cyphertext as it becomes the next chaining value, and Dest may overwrite Source
+			UInt32 In0 = GetU32(&Source[0]);
+			UInt32 In1 = GetU32(&Source[4]);
+			UInt32 In2 = GetU32(&Source[8]);
+			UInt32 In3 = GetU32(&Source[12]);
+
+			UInt32 s0 = In0 ^ RK[0];
+			UInt32 s1 = In1 ^ RK[1];
+			UInt32 s2 = In2 ^ RK[2];
+			UInt32 s3 = In3 ^ RK[3];
+
+			int Round;
+			for(Round = 1; Round < 10; Round++)
+			{
+				const UInt32 *K = &RK[Round * 4];
+				UInt32 t0 = T.Dec[0][s0 >> 24] ^ T.Dec[1][(s3 >> 16) & 0xff] ^ T.Dec[2][(s2 >> 8) & 0xff] ^ T.Dec[3][s1 & 0xff] ^ K[0];
+				UInt32 t1 = T.Dec[0][s1 >> 24] ^ T.Dec[1][(s0 >> 16) & 0xff] ^ T.Dec[2][(s3 >> 8) & 0xff] ^ T.Dec[3][s2 & 0xff] ^ K[1];
+				UInt32 t2 = T.Dec[0][s2 >> 24] ^ T.Dec[1][(s1 >> 16) & 0xff] ^ T.Dec[2][(s0 >> 8) & 0xff] ^ T.Dec[3][s3 & 0xff] ^ K[2];
+				UInt32 t3 = T.Dec[0][s3 >> 24] ^ T.Dec[1][(s2 >> 16) & 0xff] ^ T.Dec[2][(s1 >> 8) & 0xff] ^ T.Dec[3][s0 & 0xff] ^ K[3];
+				s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+			}
+
+			UInt32 p0 = ((static_cast<UInt32>(InvSBox[s0 >> 24]) << 24) | (static_cast<UInt32>(InvSBox[(s3 >> 16) & 0xff]) << 16)
+					   | (static_cast<UInt32>(InvSBox[(s2 >> 8) & 0xff]) << 8) | InvSBox[s1 & 0xff]) ^ RK[40];
+			UInt32 p1 = ((static_cast<UInt32>(InvSBox[s1 >> 24]) << 24) | (static_cast<UInt32>(InvSBox[(s0 >> 16) & 0xff]) << 16)
+					   | (static_cast<UInt32>(InvSBox[(s3 >> 8) & 0xff]) << 8) | InvSBox[s2 & 0xff]) ^ RK[41];
+			UInt32 p2 = ((static_cast<UInt32>(InvSBox[s2 >> 24]) << 24) | (static_cast<UInt32>(InvSBox[(s1 >> 16) & 0xff]) << 16)
+					   | (static_cast<UInt32>(InvSBox[(s0 >> 8) & 0xff]) << 8) | InvSBox[s3 & 0xff]) ^ RK[42];
+			UInt32 p3 = ((static_cast<UInt32>(InvSBox[s3 >> 24]) << 24) | (static_cast<UInt32>(InvSBox[(s2 >> 16) & 0xff]) << 16)
+					   | (static_cast<UInt32>(InvSBox[(s1 >> 8) & 0xff]) << 8) | InvSBox[s0 & 0xff]) ^ RK[43];
+
+			PutU32(p0 ^ c0, &Dest[0]);
+			PutU32(p1 ^ c1, &Dest[4]);
+			PutU32(p2 ^ c2, &Dest[8]);
+			PutU32(p3 ^ c3, &Dest[12]);
+
+			c0 = In0; c1 = In1; c2 = In2; c3 = In3;
+
+			Source += 16;
+			Dest += 16;
+		}
+
+		PutU32(c0, &Chain[0]);
+		PutU32(c1, &Chain[4]);
+		PutU32(c2, &Chain[8]);
+		PutU32(c3, &Chain[12]);
+	}
+
+
+#ifdef MXFLIB_X86_SIMD
+	/* AES-NI kernels
+	 * DRAGONS: The round keys are stored as big-endian words, which is the same byte order as the AES state used by AES-NI
+	 */
+
+	//! Encrypt blocks with AES-NI
+	/*! CBC encryption is inherently serial, so this gains from the instructions alone
+	 */
+	MXFLIB_TARGET("aes,sse2") void AESEncryptCBC_AESNI(const UInt8 *RoundKeys, UInt8 *Chain, const UInt8 *Source, UInt8 *Dest, size_t Blocks)
+	{
+		__m128i K[11];
+		int i;
+		for(i = 0; i < 11; i++) K[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&RoundKeys[i * 16]));
+
+		__m128i State = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Chain));
+
+		while(Blocks--)
+		{
+			State = _mm_xor_si128(State, _mm_loadu_si128(reinterpret_cast<const __m128i *>(Source)));
+			State = _mm_xor_si128(State, K[0]);
+			for(i = 1; i < 10; i++) State = _mm_aesenc_si128(State, K[i]);
+			State = _mm_aesenclast_si128(State, K[10]);
+
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(Dest), State);
+
+			Source += 16;
+			Dest += 16;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(Chain), State);
+	}
+
+	//! Decrypt blocks with AES-NI
+	/*! CBC decryption of each block is independent, so 4 blocks are interleaved to hide the instruction latency.
+	 *  All 4 cyphertext blocks are loaded before any plaintext is stored to allow decryption in place.
+	 */
+	MXFLIB_TARGET("aes,sse2") void AESDecryptCBC_AESNI(const UInt8 *RoundKeys, UInt8 *Chain, const UInt8 *Source, UInt8 *Dest, size_t Blocks)
+	{
+		__m128i K[11];
+		int i;
+		for(i = 0; i < 11; i++) K[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&RoundKeys[i * 16]));
+
+		__m128i Prev = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Chain));
+
+		const __m128i *In = reinterpret_cast<const __m128i *>(Source);
+		__m128i *Out = reinterpret_cast<__m128i *>(Dest);
+
+		while(Blocks >= 4)
+		{
+			__m128i c0 = _mm_loadu_si128(&In[0]);
+			__m128i c1 = _mm_loadu_si128(&In[1]);
+			__m128i c2 = _mm_loadu_si128(&In[2]);
+			__m128i c3 = _mm_loadu_si128(&In[3]);
+
+			__m128i s0 = _mm_xor_si128(c0, K[0]);
+			__m128i s1 = _mm_xor_si128(c1, K[0]);
+			__m128i s2 = _mm_xor_si128(c2, K[0]);
+			__m128i s3 = _mm_xor_si128(c3, K[0]);
+
+			for(i = 1; i < 10; i++)
+			{
+				s0 = _mm_aesdec_si128(s0, K[i]);
+				s1 = _mm_aesdec_si128(s1, K[i]);
+				s2 = _mm_aesdec_si128(s2, K[i]);
+				s3 = _mm_aesdec_si128(s3, K[i]);
+			}
+
+			_mm_storeu_si128(&Out[0], _mm_xor_si128(_mm_aesdeclast_si128(s0, K[10]), Prev));
+			_mm_storeu_si128(&Out[1], _mm_xor_si128(_mm_aesdeclast_si128(s1, K[10]), c0));
+			_mm_storeu_si128(&Out[2], _mm_xor_si128(_mm_aesdeclast_si128(s2, K[10]), c1));
+			_mm_storeu_si128(&Out[3], _mm_xor_si128(_mm_aesdeclast_si128(s3, K[10]), c2));
+
+			Prev = c3;
+			In += 4;
+			Out += 4;
+			Blocks -= 4;
+		}
+
+		while(Blocks--)
+		{
+			__m128i c = _mm_loadu_si128(In);
+			__m128i s = _mm_xor_si128(c, K[0]);
+			for(i = 1; i < 10; i++) s = _mm_aesdec_si128(s, K[i]);
+			s = _mm_aesdeclast_si128(s, K[10]);
+
+			_mm_storeu_si128(Out, _mm_xor_si128(s, Prev));
+
+			Prev = c;
+			In++;
+			Out++;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(Chain), Prev);
+	}
+#endif // MXFLIB_X86_SIMD
+
+
+	/* SHA-1 kernels */
+
+	//! Add whole blocks to a SHA-1 hash with portable code
+	void SHA1Blocks(UInt32 *H, const UInt8 *Data, size_t Blocks)
+	{
+		while(Blocks--)
+		{
+			UInt32 W[80];
+			int i;
+			for(i = 0; i < 16; i++) W[i] = GetU32(&Data[i * 4]);
+			for(i = 16; i < 80; i++) W[i] = RotL(W[i - 3] ^ W[i - 8] ^ W[i - 14] ^ W[i - 16], 1);
+
+			UInt32 a = H[0];
+			UInt32 b = H[1];
+			UInt32 c = H[2];
+			UInt32 d = H[3];
+			UInt32 e = H[4];
+
+			for(i = 0; i < 80; i++)
+			{
+				UInt32 f, k;
+				if(i < 20) { f = (b & c) | (~b & d); k = 0x5a827999; }
+				else if(i < 40) { f = b ^ c ^ d; k = 0x6ed9eba1; }
+				else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+				else { f = b ^ c ^ d; k = 0xca62c1d6; }
+
+				UInt32 Temp = RotL(a, 5) + f + e + k + W[i];
+				e = d;
+				d = c;
+				c = RotL(b, 30);
+				b = a;
+				a = Temp;
+			}
+
+			H[0] += a;
+			H[1] += b;
+			H[2] += c;
+			H[3] += d;
+			H[4] += e;
+
+			Data += 64;
+		}
+	}
+
+#ifdef MXFLIB_X86_SIMD
+	//! Add whole blocks to a SHA-1 hash using the SHA extensions
+	/*! Each group of four rounds uses one sha1rnds4, with the message schedule for later rounds calculated alongside
+	 */
+	MXFLIB_TARGET("sha,sse4.1") void SHA1Blocks_SHA(UInt32 *H, const UInt8 *Data, size_t Blocks)
+	{
+		const __m128i ByteSwap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+
+		// The SHA instructions hold A in the most significant word
+		__m128i ABCD = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(H)), 0x1b);
+		__m128i E0 = _mm_set_epi32(static_cast<int>(H[4]), 0, 0, 0);
+
+		while(Blocks--)
+		{
+			__m128i ABCDSave = ABCD;
+			__m128i E0Save = E0;
+			__m128i E1, Msg1, Msg2, Msg3;
+
+			__m128i Msg0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&Data[0])), ByteSwap);
+
+			// Rounds 0 to 3
+			E0 = _mm_add_epi32(E0, Msg0);
+			E1 = ABCD;
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+			// Rounds 4 to 7
+			Msg1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&Data[16])), ByteSwap);
+			E1 = _mm_sha1nexte_epu32(E1, Msg1);
+			E0 = ABCD;
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+			Msg0 = _mm_sha1msg1_epu32(Msg0, Msg1);
+
+			// Rounds 8 to 11
+			Msg2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&Data[32])), ByteSwap);
+			E0 = _mm_sha1nexte_epu32(E0, Msg2);
+			E1 = ABCD;
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+			Msg1 = _mm_sha1msg1_epu32(Msg1, Msg2);
+			Msg0 = _mm_xor_si128(Msg0, Msg2);
+
+			// Rounds 12 to 15
+			Msg3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&Data[48])), ByteSwap);
+			E1 = _mm_sha1nexte_epu32(E1, Msg3);
+			E0 = ABCD;
+			Msg0 = _mm_sha1msg2_epu32(Msg0, Msg3);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 0);
+			Msg2 = _mm_sha1msg1_epu32(Msg2, Msg3);
+			Msg1 = _mm_xor_si128(Msg1, Msg3);
+
+			// Rounds 16 to 19
+			E0 = _mm_sha1nexte_epu32(E0, Msg0);
+			E1 = ABCD;
+			Msg1 = _mm_sha1msg2_epu32(Msg1, Msg0);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+			Msg3 = _mm_sha1msg1_epu32(Msg3, Msg0);
+			Msg2 = _mm_xor_si128(Msg2, Msg0);
+
+			// Rounds 20 to 23
+			E1 = _mm_sha1nexte_epu32(E1, Msg1);
+			E0 = ABCD;
+			Msg2 = _mm_sha1msg2_epu32(Msg2, Msg1);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+			Msg0 = _mm_sha1msg1_epu32(Msg0, Msg1);
+			Msg3 = _mm_xor_si128(Msg3, Msg1);
+
+			// Rounds 24 to 27
+			E0 = _mm_sha1nexte_epu32(E0, Msg2);
+			E1 = ABCD;
+			Msg3 = _mm_sha1msg2_epu32(Msg3, Msg2);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+			Msg1 = _mm_sha1msg1_epu32(Msg1, Msg2);
+			Msg0 = _mm_xor_si128(Msg0, Msg2);
+
+			// Rounds 28 to 31
+			E1 = _mm_sha1nexte_epu32(E1, Msg3);
+			E0 = ABCD;
+			Msg0 = _mm_sha1msg2_epu32(Msg0, Msg3);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+			Msg2 = _mm_sha1msg1_epu32(Msg2, Msg3);
+			Msg1 = _mm_xor_si128(Msg1, Msg3);
+
+			// Rounds 32 to 35
+			E0 = _mm_sha1nexte_epu32(E0, Msg0);
+			E1 = ABCD;
+			Msg1 = _mm_sha1msg2_epu32(Msg1, Msg0);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 1);
+			Msg3 = _mm_sha1msg1_epu32(Msg3, Msg0);
+			Msg2 = _mm_xor_si128(Msg2, Msg0);
+
+			// Rounds 36 to 39
+			E1 = _mm_sha1nexte_epu32(E1, Msg1);
+			E0 = ABCD;
+			Msg2 = _mm_sha1msg2_epu32(Msg2, Msg1);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 1);
+			Msg0 = _mm_sha1msg1_epu32(Msg0, Msg1);
+			Msg3 = _mm_xor_si128(Msg3, Msg1);
+
+			// Rounds 40 to 43
+			E0 = _mm_sha1nexte_epu32(E0, Msg2);
+			E1 = ABCD;
+			Msg3 = _mm_sha1msg2_epu32(Msg3, Msg2);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+			Msg1 = _mm_sha1msg1_epu32(Msg1, Msg2);
+			Msg0 = _mm_xor_si128(Msg0, Msg2);
+
+			// Rounds 44 to 47
+			E1 = _mm_sha1nexte_epu32(E1, Msg3);
+			E0 = ABCD;
+			Msg0 = _mm_sha1msg2_epu32(Msg0, Msg3);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+			Msg2 = _mm_sha1msg1_epu32(Msg2, Msg3);
+			Msg1 = _mm_xor_si128(Msg1, Msg3);
+
+			// Rounds 48 to 51
+			E0 = _mm_sha1nexte_epu32(E0, Msg0);
+			E1 = ABCD;
+			Msg1 = _mm_sha1msg2_epu32(Msg1, Msg0);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+			Msg3 = _mm_sha1msg1_epu32(Msg3, Msg0);
+			Msg2 = _mm_xor_si128(Msg2, Msg0);
+
+			// Rounds 52 to 55
+			E1 = _mm_sha1nexte_epu32(E1, Msg1);
+			E0 = ABCD;
+			Msg2 = _mm_sha1msg2_epu32(Msg2, Msg1);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 2);
+			Msg0 = _mm_sha1msg1_epu32(Msg0, Msg1);
+			Msg3 = _mm_xor_si128(Msg3, Msg1);
+
+			// Rounds 56 to 59
+			E0 = _mm_sha1nexte_epu32(E0, Msg2);
+			E1 = ABCD;
+			Msg3 = _mm_sha1msg2_epu32(Msg3, Msg2);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 2);
+			Msg1 = _mm_sha1msg1_epu32(Msg1, Msg2);
+			Msg0 = _mm_xor_si128(Msg0, Msg2);
+
+			// Rounds 60 to 63
+			E1 = _mm_sha1nexte_epu32(E1, Msg3);
+			E0 = ABCD;
+			Msg0 = _mm_sha1msg2_epu32(Msg0, Msg3);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+			Msg2 = _mm_sha1msg1_epu32(Msg2, Msg3);
+			Msg1 = _mm_xor_si128(Msg1, Msg3);
+
+			// Rounds 64 to 67
+			E0 = _mm_sha1nexte_epu32(E0, Msg0);
+			E1 = ABCD;
+			Msg1 = _mm_sha1msg2_epu32(Msg1, Msg0);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+			Msg3 = _mm_sha1msg1_epu32(Msg3, Msg0);
+			Msg2 = _mm_xor_si128(Msg2, Msg0);
+
+			// Rounds 68 to 71
+			E1 = _mm_sha1nexte_epu32(E1, Msg1);
+			E0 = ABCD;
+			Msg2 = _mm_sha1msg2_epu32(Msg2, Msg1);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+			Msg3 = _mm_xor_si128(Msg3, Msg1);
+
+			// Rounds 72 to 75
+			E0 = _mm_sha1nexte_epu32(E0, Msg2);
+			E1 = ABCD;
+			Msg3 = _mm_sha1msg2_epu32(Msg3, Msg2);
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 3);
+
+			// Rounds 76 to 79
+			E1 = _mm_sha1nexte_epu32(E1, Msg3);
+			E0 = ABCD;
+			ABCD = _mm_sha1rnds4_epu32(ABCD, E1, 3);
+			E0 = _mm_sha1nexte_epu32(E0, E0Save);
+			ABCD = _mm_add_epi32(ABCD, ABCDSave);
+
+			Data += 64;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(H), _mm_shuffle_epi32(ABCD, 0x1b));
+		H[4] = static_cast<UInt32>(_mm_extract_epi32(E0, 3));
+	}
+#endif // MXFLIB_X86_SIMD
+}
+
+
+//! Set up an encryption wrapper, with no key or Initialization Vector
+AESEncrypt::AESEncrypt()
+{
+	KeySet = false;
+	IVSet = false;
+	memset(Chain, 0, sizeof(Chain));
+
+	Kernel = AESEncryptCBC;
+
+#ifdef MXFLIB_X86_SIMD
+	if(CPUSupports(CPU_AESNI | CPU_SSE2)) Kernel = AESEncryptCBC_AESNI;
+#endif // MXFLIB_X86_SIMD
+}
+
+
+//! Set an encryption key
+/*! \return True if key is accepted (only 16-byte keys are accepted)
+ */
+bool AESEncrypt::SetKey(size_t KeySize, const UInt8 *Key)
+{
+	if(KeySize != 16)
+	{
+		error("AS-DCP encryption requires a 16 byte key, but a %d byte key was given\n", static_cast<int>(KeySize));
+		return false;
+	}
+
+	UInt32 W[44];
+	ExpandKey(Key, W);
+	StoreKey(W, RoundKeys);
+
+	KeySet = true;
+	return true;
+}
+
+
+//! Set an encryption Initialization Vector
+/*! \return False if Initialization Vector is rejected
+ */
+bool AESEncrypt::SetIV(size_t IVSize, const UInt8 *IV, bool Force /*=false*/)
+{
+	if(IVSize != 16) return false;
+
+	// Once chaining has started only a forced vector replaces the chained value
+	if(Force || !IVSet)
+	{
+		memcpy(Chain, IV, 16);
+		IVSet = true;
+	}
+
+	return true;
+}
+
+
+//! Get the Initialization Vector that will be used for the next encryption
+DataChunkPtr AESEncrypt::GetIV(void)
+{
+	return new DataChunk(16, Chain);
+}
+
+
+//! Check that we are ready to encrypt Size bytes, reporting any problem
+bool AESEncrypt::Validate(size_t Size, bool NeedIV /*=true*/)
+{
+	if(!KeySet)
+	{
+		error("Attempted to encrypt with no key set\n");
+		return false;
+	}
+
+	if(NeedIV && !IVSet)
+	{
+		error("Attempted to encrypt with no Initialization Vector set\n");
+		return false;
+	}
+
+	if(Size % 16)
+	{
+		error("AES-CBC can only encrypt multiples of 16 bytes, but %s bytes were given\n", Int64toString(Size).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+//! Encrypt data bytes in place
+/*! \return true if the encryption is successful
+ */
+bool AESEncrypt::EncryptInPlace(size_t Size, UInt8 *Data)
+{
+	if(!Validate(Size)) return false;
+
+	Kernel(RoundKeys, Chain, Data, Data, Size / 16);
+
+	return true;
+}
+
+
+//! Encrypt one section of data in place, starting from the given Initialization Vector
+/*! \return true if the encryption is successful
+ */
+bool AESEncrypt::EncryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data)
+{
+	if(!Validate(Size, false)) return false;
+
+	// Chain from a local copy so that the held vector is untouched and other threads may encrypt at the same time
+	UInt8 SectionChain[16];
+	memcpy(SectionChain, SectionIV, 16);
+
+	Kernel(RoundKeys, SectionChain, Data, Data, Size / 16);
+
+	return true;
+}
+
+
+//! Encrypt data and return in a new buffer
+/*! \return NULL pointer if the encryption is unsuccessful
+ */
+DataChunkPtr AESEncrypt::Encrypt(size_t Size, const UInt8 *Data)
+{
+	if(!Validate(Size)) return NULL;
+
+	DataChunkPtr Ret = new DataChunk(Size);
+	Kernel(RoundKeys, Chain, Data, Ret->Data, Size / 16);
+
+	return Ret;
+}
+
+
+//! Set up a decryption wrapper, with no key or Initialization Vector
+AESDecrypt::AESDecrypt()
+{
+	KeySet = false;
+	IVSet = false;
+	memset(Chain, 0, sizeof(Chain));
+
+	Kernel = AESDecryptCBC;
+
+#ifdef MXFLIB_X86_SIMD
+	if(CPUSupports(CPU_AESNI | CPU_SSE2)) Kernel = AESDecryptCBC_AESNI;
+#endif // MXFLIB_X86_SIMD
+}
+
+
+//! Set a decryption key
+/*! \return True if key is accepted (only 16-byte keys are accepted)
+ */
+bool AESDecrypt::SetKey(size_t KeySize, const UInt8 *Key)
+{
+	if(KeySize != 16)
+	{
+		error("AS-DCP decryption requires a 16 byte key, but a %d byte key was given\n", static_cast<int>(KeySize));
+		return false;
+	}
+
+	UInt32 W[44];
+	ExpandKey(Key, W);
+
+	// Build the schedule for the equivalent inverse cypher: reverse the round order
+	// and apply InvMixColumns to all but the first and last round keys
+	const AESTables &T = GetAESTables();
+	UInt32 InvW[44];
+	int Round;
+	for(Round = 0; Round <= 10; Round++)
+	{
+		int i;
+		for(i = 0; i < 4; i++)
+		{
+			UInt32 Word = W[(10 - Round) * 4 + i];
+			InvW[Round * 4 + i] = ((Round == 0) || (Round == 10)) ? Word : InvMixColumn(T, Word);
+		}
+	}
+
+	StoreKey(InvW, RoundKeys);
+
+	KeySet = true;
+	return true;
+}
+
+
+//! Set a decryption Initialization Vector
+/*! \return False if Initialization Vector is rejected
+ */
+bool AESDecrypt::SetIV(size_t IVSize, const UInt8 *IV, bool Force /*=false*/)
+{
+	if(IVSize != 16) return false;
+
+	// Once chaining has started only a forced vector replaces the chained value
+	if(Force || !IVSet)
+	{
+		memcpy(Chain, IV, 16);
+		IVSet = true;
+	}
+
+	return true;
+}
+
+
+//! Get the Initialization Vector that will be used for the next decryption
+DataChunkPtr AESDecrypt::GetIV(void)
+{
+	return new DataChunk(16, Chain);
+}
+
+
+//! Check that we are ready to decrypt Size bytes, reporting any problem
+bool AESDecrypt::Validate(size_t Size)
+{
+	if(!KeySet)
+	{
+		error("Attempted to decrypt with no key set\n");
+		return false;
+	}
+
+	if(!IVSet)
+	{
+		error("Attempted to decrypt with no Initialization Vector set\n");
+		return false;
+	}
+
+	if(Size % 16)
+	{
+		error("AES-CBC can only decrypt multiples of 16 bytes, but %s bytes were given\n", Int64toString(Size).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+//! Decrypt data bytes in place
+/*! \return true if the decryption <i>appears to be</i> successful
+ */
+bool AESDecrypt::DecryptInPlace(size_t Size, UInt8 *Data)
+{
+	if(!Validate(Size)) return false;
+
+	Kernel(RoundKeys, Chain, Data, Data, Size / 16);
+
+	return true;
+}
+
+
+//! Decrypt one section of a chunk in place, given the Initialization Vector for that section
+/*! \return true if the decryption <i>appears to be</i> successful
+ */
+bool AESDecrypt::DecryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data)
+{
+	if(!Validate(Size)) return false;
+
+	// Chain from a local copy so that sections may be decrypted at the same time on different threads
+	UInt8 SectionChain[16];
+	memcpy(SectionChain, SectionIV, 16);
+
+	Kernel(RoundKeys, SectionChain, Data, Data, Size / 16);
+
+	return true;
+}
+
+
+//! Decrypt data and return in a new buffer
+/*! \return NULL pointer if the decryption is unsuccessful
+ */
+DataChunkPtr AESDecrypt::Decrypt(size_t Size, const UInt8 *Data)
+{
+	if(!Validate(Size)) return NULL;
+
+	DataChunkPtr Ret = new DataChunk(Size);
+	Kernel(RoundKeys, Chain, Data, Ret->Data, Size / 16);
+
+	return Ret;
+}
+
+
+//! Initialize this hash, with an empty key until SetKey() is called
+HashHMACSHA1::HashHMACSHA1()
+{
+	Kernel = SelectKernel();
+
+	SetKey(0, NULL);
+}
+
+
+//! Select the SHA-1 kernel for this processor
+SHA1Kernel HashHMACSHA1::SelectKernel(void)
+{
+#ifdef MXFLIB_X86_SIMD
+	if(CPUSupports(CPU_SHA | CPU_SSSE3 | CPU_SSE41)) return SHA1Blocks_SHA;
+#endif // MXFLIB_X86_SIMD
+
+	return SHA1Blocks;
+}
+
+
+//! Set State to the initial SHA-1 state
+void HashHMACSHA1::Reset(SHA1State &State)
+{
+	State.H[0] = 0x67452301;
+	State.H[1] = 0xefcdab89;
+	State.H[2] = 0x98badcfe;
+	State.H[3] = 0x10325476;
+	State.H[4] = 0xc3d2e1f0;
+	State.Length = 0;
+}
+
+
+//! Add bytes to a SHA-1 calculation
+void HashHMACSHA1::Update(SHA1Kernel Kernel, SHA1State &State, size_t Size, const UInt8 *Data)
+{
+	size_t Used = static_cast<size_t>(State.Length % 64);
+	State.Length += Size;
+
+	// Complete any partial block first
+	if(Used)
+	{
+		size_t Count = 64 - Used;
+		if(Count > Size) Count = Size;
+
+		memcpy(&State.Buffer[Used], Data, Count);
+		Data += Count;
+		Size -= Count;
+
+		if((Used + Count) < 64) return;
+
+		Kernel(State.H, State.Buffer, 1);
+	}
+
+	// Hash whole blocks straight from the caller's buffer
+	size_t Blocks = Size / 64;
+	if(Blocks)
+	{
+		Kernel(State.H, Data, Blocks);
+		Data += Blocks * 64;
+		Size -= Blocks * 64;
+	}
+
+	if(Size) memcpy(State.Buffer, Data, Size);
+}
+
+
+//! Complete a SHA-1 calculation, writing the 20-byte result to Digest (the state is left undefined)
+void HashHMACSHA1::Finish(SHA1Kernel Kernel, SHA1State &State, UInt8 *Digest)
+{
+	UInt64 BitLength = State.Length * 8;
+
+	// Pad with a single 1 bit then zeros up to 8 bytes short of a block boundary
+	UInt8 Padding[72];
+	memset(Padding, 0, sizeof(Padding));
+	Padding[0] = 0x80;
+
+	size_t Used = static_cast<size_t>(State.Length % 64);
+	size_t PadSize = (Used < 56) ? (56 - Used) : (120 - Used);
+
+	PutU64(BitLength, &Padding[PadSize]);
+	Update(Kernel, State, PadSize + 8, Padding);
+
+	int i;
+	for(i = 0; i < 5; i++) PutU32(State.H[i], &Digest[i * 4]);
+}
+
+
+//! Set the HMAC key
+/*! \return True if key is accepted (any key length is accepted)
+ */
+bool HashHMACSHA1::SetKey(size_t Size, const UInt8 *Key)
+{
+	UInt8 Block[64];
+	memset(Block, 0, sizeof(Block));
+
+	// Keys longer than a block are replaced by their hash
+	if(Size > 64)
+	{
+		SHA1State KeyHash;
+		Reset(KeyHash);
+		Update(Kernel, KeyHash, Size, Key);
+		Finish(Kernel, KeyHash, Block);
+	}
+	else if(Size)
+	{
+		memcpy(Block, Key, Size);
+	}
+
+	UInt8 Pad[64];
+	int i;
+
+	for(i = 0; i < 64; i++) Pad[i] = Block[i] ^ 0x36;
+	Reset(KeyedInner);
+	Update(Kernel, KeyedInner, 64, Pad);
+
+	for(i = 0; i < 64; i++) Pad[i] = Block[i] ^ 0x5c;
+	Reset(KeyedOuter);
+	Update(Kernel, KeyedOuter, 64, Pad);
+
+	Inner = KeyedInner;
+
+	return true;
+}
+
+
+//! Add the given data to the current hash being calculated
+void HashHMACSHA1::HashData(size_t Size, const UInt8 *Data)
+{
+	Update(Kernel, Inner, Size, Data);
+}
+
+
+//! Get the finished hash value
+DataChunkPtr HashHMACSHA1::GetHash(void)
+{
+	UInt8 InnerDigest[20];
+	Finish(Kernel, Inner, InnerDigest);
+
+	SHA1State Outer = KeyedOuter;
+	Update(Kernel, Outer, 20, InnerDigest);
+
+	DataChunkPtr Ret = new DataChunk(20);
+	Finish(Kernel, Outer, Ret->Data);
+
+	// Ready to start the next hash with the same key
+	Inner = KeyedInner;
+
+	return Ret;
+}
+
+
+//! Make a new hasher with the same key, ready to start a new hash
+HashPtr HashHMACSHA1::MakeNew(void)
+{
+	HashHMACSHA1 *Ret = new HashHMACSHA1;
+
+	// Copying the keyed states is the same as setting the key again
+	Ret->KeyedInner = KeyedInner;
+	Ret->KeyedOuter = KeyedOuter;
+	Ret->Inner = KeyedInner;
+
+	return Ret;
+}
+
+
+//! Calculate the plain SHA-1 digest of a buffer
+/*! \param Digest Buffer to receive the 20-byte result
+ */
+void HashHMACSHA1::SHA1(size_t Size, const UInt8 *Data, UInt8 *Digest)
+{
+	SHA1Kernel Kernel = SelectKernel();
+
+	SHA1State State;
+	Reset(State);
+	Update(Kernel, State, Size, Data);
+	Finish(Kernel, State, Digest);
+}
+
+
+namespace
+{
+	//! Convert a string of hex digits to bytes
+	/*! \return The number of bytes written to Dest */
+	size_t HexToBytes(const char *Hex, UInt8 *Dest)
+	{
+		size_t Ret = 0;
+		while(Hex[0] && Hex[1])
+		{
+			unsigned int Value;
+			sscanf(Hex, "%2x", &Value);
+			Dest[Ret++] = static_cast<UInt8>(Value);
+			Hex += 2;
+		}
+
+		return Ret;
+	}
+
+	//! Check a result against its expected value, reporting any mismatch
+	bool CheckResult(const char *Test, const UInt8 *Result, size_t Size, const char *ExpectedHex)
+	{
+		UInt8 Expected[64];
+		size_t ExpectedSize = HexToBytes(ExpectedHex, Expected);
+
+		if((Size == ExpectedSize) && (memcmp(Result, Expected, Size) == 0)) return true;
+
+		error("Crypto self-test \"%s\" failed\n", Test);
+		return false;
+	}
+
+	//! SP 800-38A F.2.1 CBC-AES128 key
+	const char CBCKey[] = "2b7e151628aed2a6abf7158809cf4f3c";
+
+	//! SP 800-38A F.2.1 CBC-AES128 Initialization Vector
+	const char CBCIV[] = "000102030405060708090a0b0c0d0e0f";
+
+	//! SP 800-38A F.2.1 CBC-AES128 plaintext
+	const char CBCPlaintext[] = "6bc1bee22e409f96e93d7e117393172a" "ae2d8a571e03ac9c9eb76fac45af8e51"
+								"30c81c46a35ce411e5fbc1191a0a52ef" "f69f2445df4f9b17ad2b417be66c3710";
+
+	//! SP 800-38A F.2.1 CBC-AES128 cyphertext
+	const char CBCCyphertext[] = "7649abac8119b246cee98e9b12e9197d" "5086cb9b507219ee95db113a917678b2"
+								 "73bed6b8e3c1743b7116e69e22229516" "3ff1caa1681fac09120eca307586e1a7";
+
+	//! One RFC 2202 HMAC-SHA1 test case
+	struct HMACTestCase
+	{
+		const char *Name;					//!< Name used when reporting a failure
+		UInt8 KeyByte;						//!< Value of every key byte, or 0 to use KeyText
+		size_t KeySize;						//!< Number of key bytes when KeyByte is used
+		const char *KeyText;				//!< Key as text, when KeyByte is 0
+		const char *Data;					//!< Data to hash
+		const char *Digest;					//!< Expected result, as hex
+	};
+
+	//! RFC 2202 test cases 1, 2, 6 and 7 - between them these cover short, text and longer-than-block keys, and more than one block of data
+	const HMACTestCase HMACTests[] =
+	{
+		{ "HMAC-SHA1 case 1", 0x0b, 20, NULL, "Hi There", "b617318655057264e28bc0b6fb378c8ef146be00" },
+		{ "HMAC-SHA1 case 2", 0, 0, "Jefe", "what do ya want for nothing?", "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79" },
+		{ "HMAC-SHA1 case 6", 0xaa, 80, NULL, "Test Using Larger Than Block-Size Key - Hash Key First", "aa4ae5e15272d00e95705637ce8a3b55ed402112" },
+		{ "HMAC-SHA1 case 7", 0xaa, 80, NULL, "Test Using Larger Than Block-Size Key and Larger Than One Block-Size Data", "e8e99d0f45237d786d6bbaa7965c7808bbff1a91" },
+	};
+}
+
+
+//! Run known-answer tests on the AES-128-CBC and HMAC-SHA1 kernels selected for this processor
+/*! Uses the SP 800-38A CBC-AES128 vectors, FIPS 180 SHA-1 vectors and RFC 2202 HMAC-SHA1 test cases.
+ *  Use SetCPUFeatureMask() before calling to test the portable kernels.
+ *  \return true if all tests pass, otherwise each failure is reported with error()
+ */
+bool mxflib::ASDCPCryptoSelfTest(void)
+{
+	bool Ret = true;
+
+	UInt8 Key[16];
+	UInt8 IV[16];
+	UInt8 Plaintext[64];
+	UInt8 Cyphertext[64];
+	HexToBytes(CBCKey, Key);
+	HexToBytes(CBCIV, IV);
+	HexToBytes(CBCPlaintext, Plaintext);
+	HexToBytes(CBCCyphertext, Cyphertext);
+
+	/* AES-128-CBC, in one call and chained across calls */
+
+	UInt8 Buffer[64];
+
+	AESEncrypt Enc;
+	Enc.SetKey(16, Key);
+	Enc.SetIV(16, IV);
+	memcpy(Buffer, Plaintext, 64);
+	if(!Enc.EncryptInPlace(64, Buffer)) Ret = false;
+	if(!CheckResult("AES-128-CBC encrypt", Buffer, 64, CBCCyphertext)) Ret = false;
+
+	Enc.SetIV(16, IV, true);
+	memcpy(Buffer, Plaintext, 64);
+	if(!Enc.EncryptInPlace(16, Buffer) || !Enc.EncryptInPlace(48, &Buffer[16])) Ret = false;
+	if(!CheckResult("AES-128-CBC chained encrypt", Buffer, 64, CBCCyphertext)) Ret = false;
+
+	// The last cyphertext block is the Initialization Vector for a following section
+	memcpy(Buffer, &Plaintext[32], 32);
+	if(!Enc.EncryptSectionInPlace(&Cyphertext[16], 32, Buffer)) Ret = false;
+	if(!CheckResult("AES-128-CBC section encrypt", Buffer, 32, &CBCCyphertext[64])) Ret = false;
+
+	AESDecrypt Dec;
+	Dec.SetKey(16, Key);
+	Dec.SetIV(16, IV);
+	memcpy(Buffer, Cyphertext, 64);
+	if(!Dec.DecryptInPlace(64, Buffer)) Ret = false;
+	if(!CheckResult("AES-128-CBC decrypt", Buffer, 64, CBCPlaintext)) Ret = false;
+
+	Dec.SetIV(16, IV, true);
+	memcpy(Buffer, Cyphertext, 64);
+	if(!Dec.DecryptInPlace(48, Buffer) || !Dec.DecryptInPlace(16, &Buffer[48])) Ret = false;
+	if(!CheckResult("AES-128-CBC chained decrypt", Buffer, 64, CBCPlaintext)) Ret = false;
+
+	memcpy(Buffer, &Cyphertext[16], 48);
+	if(!Dec.DecryptSectionInPlace(Cyphertext, 48, Buffer)) Ret = false;
+	if(!CheckResult("AES-128-CBC section decrypt", Buffer, 48, &CBCPlaintext[32])) Ret = false;
+
+	/* SHA-1 */
+
+	UInt8 Digest[20];
+	const char *SHAShort = "abc";
+	HashHMACSHA1::SHA1(strlen(SHAShort), reinterpret_cast<const UInt8*>(SHAShort), Digest);
+	if(!CheckResult("SHA-1 one block", Digest, 20, "a9993e364706816aba3e25717850c26c9cd0d89d")) Ret = false;
+
+	const char *SHALong = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	HashHMACSHA1::SHA1(strlen(SHALong), reinterpret_cast<const UInt8*>(SHALong), Digest);
+	if(!CheckResult("SHA-1 two blocks", Digest, 20, "84983e441c3bd26ebaae4aa1f95129e5e54670f1")) Ret = false;
+
+	/* HMAC-SHA1, hashing each message in two parts and then again with the same hasher to check it restarts */
+
+	size_t i;
+	for(i = 0; i < sizeof(HMACTests) / sizeof(HMACTests[0]); i++)
+	{
+		const HMACTestCase &Test = HMACTests[i];
+
+		UInt8 HMACKey[80];
+		size_t KeySize = Test.KeySize;
+		if(Test.KeyByte) memset(HMACKey, Test.KeyByte, KeySize);
+		else
+		{
+			KeySize = strlen(Test.KeyText);
+			memcpy(HMACKey, Test.KeyText, KeySize);
+		}
+
+		HashHMACSHA1 Hasher;
+		Hasher.SetKey(KeySize, HMACKey);
+
+		const UInt8 *Data = reinterpret_cast<const UInt8*>(Test.Data);
+		size_t DataSize = strlen(Test.Data);
+
+		int Pass;
+		for(Pass = 0; Pass < 2; Pass++)
+		{
+			Hasher.HashData(5, Data);
+			Hasher.HashData(DataSize - 5, &Data[5]);
+
+			DataChunkPtr Hash = Hasher.GetHash();
+			if(!CheckResult(Test.Name, Hash->Data, Hash->Size, Test.Digest)) Ret = false;
+		}
+	}
+
+	return Ret;
+}
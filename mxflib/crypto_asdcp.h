@@ -0,0 +1,246 @@
+/*! \file	crypto_asdcp.h
+ *	\brief	Definition of the built-in AS-DCP encryption, decryption and hashing wrappers
+ *
+ *			AS-DCP encrypted essence uses AES-128 in cypher block chaining mode
+ *			for the encrypted value and HMAC-SHA1 for the Message Integrity Code.
+ *			These classes supply both so that applications do not need to link
+ *			their own crypto library simply to read or write AS-DCP files.
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#ifndef MXFLIB__CRYPTO_ASDCP_H
+#define MXFLIB__CRYPTO_ASDCP_H
+
+
+namespace mxflib
+{
+	//! Kernel to run AES-128-CBC over a number of whole 16-byte blocks
+	/*! \param RoundKeys The 11 expanded round keys for the direction being processed
+	 *  \param Chain The current chaining value, updated to the value for the next block on exit
+	 *  \note Source and Dest may be the same buffer, but must not otherwise overlap
+	 */
+	typedef void (*AESCBCKernel)(const UInt8 *RoundKeys, UInt8 *Chain, const UInt8 *Source, UInt8 *Dest, size_t Blocks);
+
+
+	//! AES-128-CBC encryption wrapper for AS-DCP
+	/*! Uses AES-NI where the processor supports it, otherwise a portable table-driven implementation.
+	 *  Only whole 16-byte blocks are encrypted - KLVEObject adds the AS-DCP padding before encrypting.
+	 */
+	class AESEncrypt : public Encrypt_Base
+	{
+	protected:
+		UInt8 RoundKeys[176];				//!< Expanded key schedule
+		UInt8 Chain[16];					//!< The chaining value for the next block (the IV that will be used)
+		bool KeySet;						//!< True once a valid key has been set
+		bool IVSet;							//!< True once an Initialization Vector has been set
+		AESCBCKernel Kernel;				//!< The kernel selected for this processor
+
+	public:
+		AESEncrypt();
+
+		//! Set an encryption key
+		/*! \return True if key is accepted (only 16-byte keys are accepted)
+		 */
+		virtual bool SetKey(size_t KeySize, const UInt8 *Key);
+
+		//! Set an encryption Initialization Vector
+		/*! \return False if Initialization Vector is rejected
+		 *  \note As this is a cypher block chaining scheme the vector is only changed if Force is true
+		 *        or no vector has been set yet - otherwise the chained value continues to be used
+		 */
+		virtual bool SetIV(size_t IVSize, const UInt8 *IV, bool Force = false);
+
+		//! Get the Initialization Vector that will be used for the next encryption
+		virtual DataChunkPtr GetIV(void);
+
+		//! Can this encryption system safely encrypt in place?
+		/*! AES-CBC can always encrypt whole blocks in place, so this is true for any multiple of 16 bytes
+		 */
+		virtual bool CanEncryptInPlace(size_t BlockSize = 0) { return (BlockSize % 16) == 0; }
+
+		//! Encrypt data bytes in place
+		/*! \return true if the encryption is successful
+		 */
+		virtual bool EncryptInPlace(size_t Size, UInt8 *Data);
+
+		//! Can this encryption system encrypt independent chunks at the same time?
+		/*! Always true for AES-CBC
+		 */
+		virtual bool CanEncryptSections(void) { return true; }
+
+		//! Encrypt one section of data in place, starting from the given Initialization Vector
+		/*! \return true if the encryption is successful
+		 */
+		virtual bool EncryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data);
+
+		//! Encrypt data and return in a new buffer
+		/*! \return NULL pointer if the encryption is unsuccessful
+		 */
+		virtual DataChunkPtr Encrypt(size_t Size, const UInt8 *Data);
+
+	protected:
+		//! Check that we are ready to encrypt Size bytes, reporting any problem
+		/*! \param NeedIV False if the caller supplies its own vector, so none need have been set
+		 */
+		bool Validate(size_t Size, bool NeedIV = true);
+	};
+
+
+	//! AES-128-CBC decryption wrapper for AS-DCP
+	/*! Uses AES-NI where the processor supports it, otherwise a portable table-driven implementation.
+	 *  Decryption is always possible in place, which allows KLVEObject to decrypt its read buffer without a copy.
+	 *  \note Any AS-DCP padding is returned as part of the final block and is removed by KLVEObject
+	 */
+	class AESDecrypt : public Decrypt_Base
+	{
+	protected:
+		UInt8 RoundKeys[176];				//!< Expanded key schedule for the equivalent inverse cypher
+		UInt8 Chain[16];					//!< The chaining value for the next block (the IV that will be used)
+		bool KeySet;						//!< True once a valid key has been set
+		bool IVSet;							//!< True once an Initialization Vector has been set
+		AESCBCKernel Kernel;				//!< The kernel selected for this processor
+
+	public:
+		AESDecrypt();
+
+		//! Set a decryption key
+		/*! \return True if key is accepted (only 16-byte keys are accepted)
+		 */
+		virtual bool SetKey(size_t KeySize, const UInt8 *Key);
+
+		//! Set a decryption Initialization Vector
+		/*! \return False if Initialization Vector is rejected
+		 *  \note As this is a cypher block chaining scheme the vector is only changed if Force is true
+		 *        or no vector has been set yet - otherwise the chained value continues to be used
+		 */
+		virtual bool SetIV(size_t IVSize, const UInt8 *IV, bool Force = false);
+
+		//! Get the Initialization Vector that will be used for the next decryption
+		virtual DataChunkPtr GetIV(void);
+
+		//! Can this decryption system safely decrypt in place?
+		/*! AES-CBC can always decrypt whole blocks in place, so this is true for any multiple of 16 bytes
+		 */
+		virtual bool CanDecryptInPlace(size_t BlockSize = 0) { return (BlockSize % 16) == 0; }
+
+		//! Decrypt data bytes in place
+		/*! \return true if the decryption <i>appears to be</i> successful
+		 */
+		virtual bool DecryptInPlace(size_t Size, UInt8 *Data);
+
+		//! Can this decryption system decrypt separate sections of a chunk independently?
+		/*! Always true for AES-CBC
+		 */
+		virtual bool CanDecryptSections(void) { return true; }
+
+		//! Decrypt one section of a chunk in place, given the Initialization Vector for that section
+		/*! \return true if the decryption <i>appears to be</i> successful
+		 */
+		virtual bool DecryptSectionInPlace(const UInt8 *SectionIV, size_t Size, UInt8 *Data);
+
+		//! Decrypt data and return in a new buffer
+		/*! \return NULL pointer if the decryption is unsuccessful
+		 */
+		virtual DataChunkPtr Decrypt(size_t Size, const UInt8 *Data);
+
+	protected:
+		//! Check that we are ready to decrypt Size bytes, reporting any problem
+		bool Validate(size_t Size);
+	};
+
+
+	//! Kernel to add a number of whole 64-byte blocks to a SHA-1 hash
+	typedef void (*SHA1Kernel)(UInt32 *H, const UInt8 *Data, size_t Blocks);
+
+
+	//! HMAC-SHA1 hashing wrapper, used to calculate the AS-DCP Message Integrity Code
+	/*! Uses the SHA extensions where the processor supports them, otherwise a portable implementation.
+	 *  \note The key must be the MIC key, not the cypher key - deriving one from the other is a matter for the application
+	 *  \note Once GetHash() has been called the hasher is reset, ready to hash the next KLVEObject with the same key
+	 */
+	class HashHMACSHA1 : public Hash_Base
+	{
+	protected:
+		//! The state of a SHA-1 calculation
+		struct SHA1State
+		{
+			UInt32 H[5];					//!< Intermediate hash value
+			UInt64 Length;					//!< Total number of bytes hashed so far
+			UInt8 Buffer[64];				//!< Bytes awaiting a complete block (Length % 64 of them are valid)
+		};
+
+		SHA1State KeyedInner;				//!< Inner state after hashing the padded key, used to restart the hash
+		SHA1State KeyedOuter;				//!< Outer state after hashing the padded key, used to finish the hash
+		SHA1State Inner;					//!< Inner hash currently being calculated
+		SHA1Kernel Kernel;					//!< The kernel selected for this processor
+
+	public:
+		//! Initialize this hash, with an empty key until SetKey() is called
+		HashHMACSHA1();
+
+		//! Set the HMAC key
+		/*! \return True if key is accepted (any key length is accepted)
+		 *  \note Any hash currently being calculated is discarded
+		 */
+		virtual bool SetKey(size_t Size, const UInt8 *Key);
+
+		//! Add the given data to the current hash being calculated
+		virtual void HashData(size_t Size, const UInt8 *Data);
+
+		//! Get the finished hash value
+		virtual DataChunkPtr GetHash(void);
+
+		//! Make a new hasher with the same key, ready to start a new hash
+		virtual HashPtr MakeNew(void);
+
+		//! Calculate the plain SHA-1 digest of a buffer
+		/*! \param Digest Buffer to receive the 20-byte result
+		 */
+		static void SHA1(size_t Size, const UInt8 *Data, UInt8 *Digest);
+
+	protected:
+		//! Add bytes to a SHA-1 calculation
+		static void Update(SHA1Kernel Kernel, SHA1State &State, size_t Size, const UInt8 *Data);
+
+		//! Complete a SHA-1 calculation, writing the 20-byte result to Digest (the state is left undefined)
+		static void Finish(SHA1Kernel Kernel, SHA1State &State, UInt8 *Digest);
+
+		//! Set State to the initial SHA-1 state
+		static void Reset(SHA1State &State);
+
+		//! Select the SHA-1 kernel for this processor
+		static SHA1Kernel SelectKernel(void);
+	};
+
+
+	//! Run known-answer tests on the AES-128-CBC and HMAC-SHA1 kernels selected for this processor
+	/*! Uses the SP 800-38A CBC-AES128 vectors, FIPS 180 SHA-1 vectors and RFC 2202 HMAC-SHA1 test cases.
+	 *  Use SetCPUFeatureMask() before calling to test the portable kernels.
+	 *  \return true if all tests pass, otherwise each failure is reported with error()
+	 */
+	bool ASDCPCryptoSelfTest(void);
+}
+
+#endif // MXFLIB__CRYPTO_ASDCP_H
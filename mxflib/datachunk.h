@@ -38,6 +38,9 @@ namespace mxflib
 
 	//! A list of smart pointers to DataChunk objects
 	typedef std::list<DataChunkPtr> DataChunkList;
+
+	//! A vector of smart pointers to DataChunk objects
+	typedef std::vector<DataChunkPtr> DataChunkVector;
 }
 
 
@@ -200,6 +203,28 @@ namespace mxflib
 		 */
 		bool TakeBuffer(DataChunkPtr &OldOwner, bool MakeEmpty = false);
 	};
+
+
+	//! A DataChunk that references part of the buffer of another DataChunk, without copying it
+	/*! The owning DataChunk is kept alive for as long as the view exists, so a large buffer can be sliced into many views
+	 *  that may outlive the code that read it.
+	 *  \note Changes to the data of the view are changes to the data of the owner. If the view is resized to be larger than
+	 *		  the referenced part it will switch to its own buffer (as for any DataChunk using SetBuffer())
+	 */
+	class DataChunkView : public DataChunk
+	{
+	protected:
+		DataChunkPtr Owner;						//!< The DataChunk owning the buffer that we reference
+
+	public:
+		//! Construct a view of Size bytes of the buffer of Owner, starting at byte Offset
+		DataChunkView(const DataChunkPtr &Owner, size_t Offset, size_t Size) : Owner(Owner)
+		{
+			mxflib_assert((Offset + Size) <= Owner->Size);
+
+			SetBuffer(&Owner->Data[Offset], Size);
+		}
+	};
 }
 
 #endif // MXFLIB__DATACHUNK_H
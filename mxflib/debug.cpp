@@ -0,0 +1,319 @@
+/*! \file	debug.cpp
+ *	\brief	Message levels and message sinks
+ *
+ *			The debug(), warning() and error() functions themselves are
+ *			an application issue, but the levels and sinks they use live here
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "mxflib.h"
+
+#include <stdio.h>
+
+#ifdef MXFLIB_THREADS
+#include <atomic>
+#include <IlmThread.h>
+#include <IlmThreadSemaphore.h>
+#endif // MXFLIB_THREADS
+
+using namespace mxflib;
+
+
+namespace mxflib
+{
+	//! The most detailed level of message currently output - by default everything is output
+	MessageLevel MessageThreshold = MessageLevelDebug;
+}
+
+
+namespace
+{
+	//! The current message sink, or NULL for the default output
+	MessageSink *CurrentSink = NULL;
+}
+
+
+//! Set the sink to receive all messages, or NULL to restore the default output
+void mxflib::SetMessageSink(MessageSink *Sink)
+{
+	CurrentSink = Sink;
+}
+
+
+//! Get the current message sink, or NULL if the default output is being used
+MessageSink *mxflib::GetMessageSink(void)
+{
+	return CurrentSink;
+}
+
+
+//! Format a message and pass it to the current message sink
+/*! \return false if there is no sink, in which case args has not been used and the caller should output the message
+ */
+bool mxflib::SinkMessage(MessageLevel Level, const char *Fmt, va_list args)
+{
+	MessageSink *Sink = CurrentSink;
+	if(!Sink) return false;
+
+	char Buffer[AsyncMessageSink::MaxMessageSize];
+	vsnprintf(Buffer, sizeof(Buffer), Fmt, args);
+
+	Sink->Message(Level, Buffer);
+
+	return true;
+}
+
+
+//! Get the prefix that the default output uses for a given message level, such as "mxflib Warning: "
+const char *mxflib::MessagePrefix(MessageLevel Level)
+{
+	switch(Level)
+	{
+	case MessageLevelError: return "MXFLIB ERROR: ";
+	case MessageLevelWarning: return "mxflib Warning: ";
+	case MessageLevelDebug: return "mxflib debug: ";
+	default: return "";
+	}
+}
+
+
+namespace
+{
+	//! Output a message in the default way
+	void DefaultOutput(MessageLevel Level, const char *Text)
+	{
+		fputs(MessagePrefix(Level), stdout);
+		fputs(Text, stdout);
+	}
+}
+
+
+#ifdef MXFLIB_THREADS
+namespace mxflib
+{
+	//! One message in the ring of an AsyncMessageSink
+	struct AsyncMessageSlot
+	{
+		std::atomic<size_t> Sequence;					//!< Equal to the ring position when free for writing, one more when holding a message
+		MessageLevel Level;								//!< The level of the message
+		char Text[AsyncMessageSink::MaxMessageSize];	//!< The message
+	};
+
+	//! Background thread that outputs messages from an AsyncMessageSink
+#if defined (ILMBASE_FORCE_CXX17) || defined (ILMBASE_FORCE_CXX20)
+	class AsyncMessageThread : public IlmThread::jthread
+#else
+	class AsyncMessageThread : public IlmThread::Thread
+#endif
+	{
+	protected:
+		AsyncMessageState *State;
+
+	public:
+		AsyncMessageThread(AsyncMessageState *State) : State(State) {}
+
+		virtual void run();
+	};
+
+	//! The ring buffer and background thread of an AsyncMessageSink
+	/*! The ring is a bounded multiple-producer, single-consumer queue. Each slot's sequence number says whether it is
+	 *  free for the producer claiming that ring position or full for the consumer, so no locks are needed.
+	 */
+	struct AsyncMessageState
+	{
+		MessageSink *Output;							//!< The sink to pass messages to, or NULL for the default output
+		AsyncMessageSlot *Ring;							//!< The slots
+		size_t Mask;									//!< Number of slots - 1
+		std::atomic<size_t> Head;						//!< The next ring position to be claimed by a producer
+		size_t Tail;									//!< The next ring position to be output - only used by the background thread
+		std::atomic<size_t> Dropped;					//!< Number of messages dropped because the ring was full
+		std::atomic<int> FlushRequests;					//!< Number of Flush() calls waiting for the ring to empty
+		std::atomic<bool> Stopping;						//!< Set to stop the background thread once the ring is empty
+		IlmThread::Semaphore Wake;						//!< Posted for each message and each request to flush or stop
+		IlmThread::Semaphore Flushed;					//!< Posted once for each flush request, when the ring has been emptied
+		AsyncMessageThread Thread;						//!< The background thread
+
+		AsyncMessageState(MessageSink *Output, size_t Slots) : Output(Output), Head(0), Tail(0), Dropped(0), FlushRequests(0), Stopping(false), Thread(this)
+		{
+			size_t Size = 1;
+			while(Size < Slots) Size <<= 1;
+
+			Ring = new AsyncMessageSlot[Size];
+			Mask = Size - 1;
+
+			for(size_t i = 0; i < Size; i++) Ring[i].Sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~AsyncMessageState() { delete[] Ring; }
+
+		//! Output every message currently in the ring
+		void Drain(void)
+		{
+			for(;;)
+			{
+				AsyncMessageSlot &Slot = Ring[Tail & Mask];
+				if(Slot.Sequence.load(std::memory_order_acquire) != Tail + 1) break;
+
+				if(Output) Output->Message(Slot.Level, Slot.Text);
+				else DefaultOutput(Slot.Level, Slot.Text);
+
+				// Free the slot for the producer that will next claim this part of the ring
+				Slot.Sequence.store(Tail + Mask + 1, std::memory_order_release);
+				Tail++;
+			}
+
+			if(!Output) fflush(stdout);
+		}
+	};
+}
+
+
+//! Output messages until the sink is destroyed
+void mxflib::AsyncMessageThread::run()
+{
+	for(;;)
+	{
+		State->Wake.wait();
+
+		// DRAGONS: Take the flush requests before draining, so everything queued before each request is included
+		int Requests = State->FlushRequests.exchange(0);
+
+		State->Drain();
+
+		// Release any threads waiting in Flush()
+		while(Requests--) State->Flushed.post();
+
+		if(State->Stopping.load())
+		{
+			// Catch anything queued while we were stopping
+			State->Drain();
+			return;
+		}
+	}
+}
+#else // MXFLIB_THREADS
+namespace mxflib
+{
+	//! Without threads an AsyncMessageSink passes messages straight on, so there is no state
+	struct AsyncMessageState
+	{
+	};
+}
+#endif // MXFLIB_THREADS
+
+
+//! Construct an asynchronous sink and start its background thread
+AsyncMessageSink::AsyncMessageSink(MessageSink *Output /*=NULL*/, size_t Slots /*=1024*/)
+	: Output(Output)
+{
+#ifdef MXFLIB_THREADS
+	State = new AsyncMessageState(Output, Slots ? Slots : 1);
+	State->Thread.start();
+#else // MXFLIB_THREADS
+	UNUSED_PARAMETER(Slots);
+	State = NULL;
+#endif // MXFLIB_THREADS
+}
+
+
+//! Output any queued messages and stop the background thread
+AsyncMessageSink::~AsyncMessageSink()
+{
+	// Don't leave a dangling pointer if we are still in use
+	if(CurrentSink == this) CurrentSink = NULL;
+
+#ifdef MXFLIB_THREADS
+	State->Stopping.store(true);
+	State->Wake.post();
+	State->Thread.join();
+
+	delete State;
+#endif // MXFLIB_THREADS
+}
+
+
+//! Queue a message
+void AsyncMessageSink::Message(MessageLevel Level, const char *Text)
+{
+#ifdef MXFLIB_THREADS
+	size_t Pos = State->Head.load(std::memory_order_relaxed);
+	AsyncMessageSlot *Slot;
+	for(;;)
+	{
+		Slot = &State->Ring[Pos & State->Mask];
+		size_t Sequence = Slot->Sequence.load(std::memory_order_acquire);
+
+		// This slot is free for our position - try and claim it
+		if(Sequence == Pos)
+		{
+			if(State->Head.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed)) break;
+		}
+		// This slot still holds the message from one lap of the ring ago - we are full
+		else if(Sequence < Pos)
+		{
+			State->Dropped++;
+			return;
+		}
+		// Another producer claimed this position first
+		else Pos = State->Head.load(std::memory_order_relaxed);
+	}
+
+	Slot->Level = Level;
+	strncpy(Slot->Text, Text, MaxMessageSize - 1);
+	Slot->Text[MaxMessageSize - 1] = '\0';
+
+	// Publish the message
+	Slot->Sequence.store(Pos + 1, std::memory_order_release);
+
+	State->Wake.post();
+#else // MXFLIB_THREADS
+	if(Output) Output->Message(Level, Text);
+	else DefaultOutput(Level, Text);
+#endif // MXFLIB_THREADS
+}
+
+
+//! Wait until all messages queued so far have been output
+void AsyncMessageSink::Flush(void)
+{
+#ifdef MXFLIB_THREADS
+	State->FlushRequests++;
+	State->Wake.post();
+	State->Flushed.wait();
+#else // MXFLIB_THREADS
+	if(!Output) fflush(stdout);
+#endif // MXFLIB_THREADS
+}
+
+
+//! Get the number of messages dropped because the ring was full
+size_t AsyncMessageSink::GetDroppedCount(void)
+{
+#ifdef MXFLIB_THREADS
+	return State->Dropped.load();
+#else // MXFLIB_THREADS
+	return 0;
+#endif // MXFLIB_THREADS
+}
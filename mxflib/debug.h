@@ -31,6 +31,9 @@
 #ifndef MXFLIB__DEBUG_H
 #define MXFLIB__DEBUG_H
 
+#include <stdarg.h>
+#include <stddef.h>
+
 // Define this value here, or on the compiler command line to enable debug() function
 #define MXFLIB_DEBUG
 
@@ -44,6 +47,133 @@ namespace mxflib
 
 	void warning(const char *Fmt, ...);						//!< Display a warning message
 	void error(const char *Fmt, ...);						//!< Display an error message
+
+
+	//! Levels of message, in increasing order of detail
+	enum MessageLevel
+	{
+		MessageLevelNone = 0,								//!< No messages are output
+		MessageLevelError,									//!< Only error() messages are output
+		MessageLevelWarning,								//!< error() and warning() messages are output
+		MessageLevelDebug									//!< All messages are output
+	};
+
+	//! The most detailed level of message currently output, use MessageEnabled() and SetMessageLevel() rather than accessing this directly
+	extern MessageLevel MessageThreshold;
+
+	//! Is a given level of message currently being output?
+	/*! This is cheap enough to test before building expensive message arguments, see mxflib_debug()
+	 */
+	inline bool MessageEnabled(MessageLevel Level) { return Level <= MessageThreshold; }
+
+	//! Set the most detailed level of message to output
+	inline void SetMessageLevel(MessageLevel Level) { MessageThreshold = Level; }
+
+	//! Get the most detailed level of message currently output
+	inline MessageLevel GetMessageLevel(void) { return MessageThreshold; }
+
+
+	//! Base class for message sinks, which receive each formatted message instead of it being printed
+	class MessageSink
+	{
+	public:
+		//! Virtual destructor to allow polymorphism
+		virtual ~MessageSink() {};
+
+		//! Handle a message
+		/*! \param Level The level of this message
+		 *  \param Text The formatted message, without any prefix such as "Warning:"
+		 *  \note This may be called from any thread
+		 */
+		virtual void Message(MessageLevel Level, const char *Text) = 0;
+	};
+
+	//! Set the sink to receive all messages, or NULL to restore the default output
+	/*! \note The sink is not owned by mxflib and must remain valid until it is replaced
+	 */
+	void SetMessageSink(MessageSink *Sink);
+
+	//! Get the current message sink, or NULL if the default output is being used
+	MessageSink *GetMessageSink(void);
+
+	//! Format a message and pass it to the current message sink
+	/*! This is for use by the implementations of debug(), warning() and error()
+	 *  \return false if there is no sink, in which case args has not been used and the caller should output the message
+	 */
+	bool SinkMessage(MessageLevel Level, const char *Fmt, va_list args);
+
+	//! Get the prefix that the default output uses for a given message level, such as "mxflib Warning: "
+	const char *MessagePrefix(MessageLevel Level);
+
+
+	// Forward declare the state of an asynchronous sink (only used in debug.cpp)
+	struct AsyncMessageState;
+
+	//! Message sink that queues messages for output by a background thread
+	/*! Messages are copied into a fixed size ring buffer without taking any locks, so threads producing messages
+	 *  never wait for terminal or file output. If the ring is full the message is dropped and counted rather than waiting.
+	 *  DRAGONS: Messages longer than MaxMessageSize are truncated
+	 *  \note Without MXFLIB_THREADS there is no background thread and messages are passed on as they arrive
+	 */
+	class AsyncMessageSink : public MessageSink
+	{
+	public:
+		//! The largest message held in the ring, including the terminating zero
+		enum { MaxMessageSize = 512 };
+
+	protected:
+		MessageSink *Output;								//!< The sink to pass messages to, or NULL to print them in the default way
+		AsyncMessageState *State;							//!< The ring buffer and background thread
+
+	private:
+		//! Prevent copy construction
+		AsyncMessageSink(AsyncMessageSink &);
+
+	public:
+		//! Construct an asynchronous sink and start its background thread
+		/*! \param Output The sink to pass messages to from the background thread, or NULL to print them in the default way
+		 *  \param Slots The number of messages the ring can hold, rounded up to a power of 2
+		 */
+		AsyncMessageSink(MessageSink *Output = NULL, size_t Slots = 1024);
+
+		//! Output any queued messages and stop the background thread
+		virtual ~AsyncMessageSink();
+
+		//! Queue a message
+		virtual void Message(MessageLevel Level, const char *Text);
+
+		//! Wait until all messages queued so far have been output
+		void Flush(void);
+
+		//! Get the number of messages dropped because the ring was full
+		size_t GetDroppedCount(void);
+	};
 }
 
+
+//! Output a debug message only if debug messages are enabled, without evaluating the arguments otherwise
+/*! Use this in place of debug() where building the arguments is not free, for example:
+ *  mxflib_debug("Reading set at 0x%s\n", Int64toHexString(GetLocation(), 8).c_str());
+ */
+#ifdef MXFLIB_DEBUG
+#define mxflib_debug(...) do { if(mxflib::MessageEnabled(mxflib::MessageLevelDebug)) mxflib::debug(__VA_ARGS__); } while(0)
+#else
+#define mxflib_debug(...) do { } while(0)
+#endif
+
+//! Output a warning message only if warning messages are enabled, without evaluating the arguments otherwise
+#define mxflib_warning(...) do { if(mxflib::MessageEnabled(mxflib::MessageLevelWarning)) mxflib::warning(__VA_ARGS__); } while(0)
+
+//! Record a trace span covering the rest of the enclosing scope
+/*! Spans are only compiled in if MXFLIB_TRACE is defined, and only recorded between IlmThread::startTrace() and IlmThread::stopTrace().
+ *  The recorded spans can be written with IlmThread::writeChromeTrace() and opened in Perfetto.
+ *  \note Name is not copied, so should be a string literal
+ */
+#ifdef MXFLIB_TRACE
+#include <IlmThreadTrace.h>
+#define MXFLIB_TRACE_SPAN(Name) IlmThread::TraceSpan ILMTHREAD_TRACE_CONCAT(MXFLibTraceSpan, __LINE__)(Name, "mxflib")
+#else
+#define MXFLIB_TRACE_SPAN(Name)
+#endif
+
 #endif // MXFLIB__DEBUG_H
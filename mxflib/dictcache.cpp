@@ -0,0 +1,789 @@
+/*! \file	dictcache.cpp
+ *	\brief	Compiled dictionary images, built from XML dictionaries and loaded without parsing
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "mxflib.h"
+
+#include <map>
+
+using namespace mxflib;
+
+
+/* Layout of a compiled dictionary image
+ *
+ * All values are big-endian.
+ *
+ * Header:
+ *   8 bytes	"mxflibCD"
+ *   UInt32		Layout version
+ *   UInt32		Size of the body
+ *   20 bytes	SHA-1 of the XML dictionary the image was built from
+ *   20 bytes	SHA-1 of the body
+ *
+ * Body:
+ *   UInt32		Size of the string table
+ *   ...		String table - NUL terminated strings, the empty string is at offset 0
+ *   UInt32		String offset of the application name
+ *   UInt32		String offset of the name of the default symbol space
+ *   UInt32		Number of sections
+ *   ...		Sections
+ *
+ * Each section is a list of types or classes, loaded in one call to LoadTypes() or LoadClasses():
+ *   UInt32		Kind - 1 for types, 2 for classes
+ *   UInt32		String offset of the name of the default symbol space for this section
+ *   UInt32		Number of top-level records
+ *   ...		Records, each followed by its children
+ *
+ * Type record (52 bytes):
+ *   UInt8		Class, Flags, ArrayClass, RefType + 1
+ *   Int32		Size
+ *   UInt32		Number of children
+ *   UInt32		String offsets of Type, Detail, Base, Value, RefTarget and SymSpace
+ *   16 bytes	UL
+ *
+ * Class record (80 bytes):
+ *   UInt8		Class, Usage, RefType + 1, Flags
+ *   UInt32		MinSize, MaxSize, LocalTag and number of children
+ *   UInt32		String offsets of Name, Detail, Base, Default, DValue, RefTarget and SymSpace
+ *   16 bytes	UL
+ *   16 bytes	Parent
+ */
+
+namespace
+{
+	//! Identifier at the start of each compiled dictionary
+	const UInt8 ImageMagic[8] = { 'm', 'x', 'f', 'l', 'i', 'b', 'C', 'D' };
+
+	//! Version of the layout - images with any other version are treated as stale
+	const UInt32 ImageVersion = 1;
+
+	//! Size of the image header
+	const size_t HeaderSize = 8 + 4 + 4 + 20 + 20;
+
+	//! Size of a type record, excluding its children
+	const size_t TypeRecordSize = 52;
+
+	//! Size of a class record, excluding its children
+	const size_t ClassRecordSize = 80;
+
+	//! Section kinds
+	const UInt32 SectionTypes = 1;
+	const UInt32 SectionClasses = 2;
+
+	/* Bit values for type record flags */
+	const UInt8 TypeImage_Endian = 0x01;
+	const UInt8 TypeImage_Baseline = 0x02;
+	const UInt8 TypeImage_HasUL = 0x04;
+
+	/* Bit values for class record flags */
+	const UInt8 ClassImage_Baseline = 0x01;
+	const UInt8 ClassImage_ExtendSubs = 0x02;
+	const UInt8 ClassImage_HasDefault = 0x04;
+	const UInt8 ClassImage_HasDValue = 0x08;
+	const UInt8 ClassImage_HasUL = 0x10;
+	const UInt8 ClassImage_HasParent = 0x20;
+
+	//! One list of types or classes, with the default symbol space used to load it
+	struct DictSection
+	{
+		UInt32 Kind;							//!< SectionTypes or SectionClasses
+		SymbolSpacePtr DefaultSymbolSpace;		//!< The default symbol space to pass to LoadTypes() or LoadClasses()
+		TypeRecordList Types;					//!< The types, if Kind == SectionTypes
+		ClassRecordList Classes;				//!< The classes, if Kind == SectionClasses
+	};
+
+	//! List of dictionary sections, in the order they are to be loaded
+	typedef std::list<DictSection> DictSectionList;
+
+
+	//! Read the whole of a file into a buffer
+	bool ReadWholeFile(const char *FileName, DataChunk &Buffer)
+	{
+		FileHandle File = FileOpenRead(FileName);
+		if(!FileValid(File)) return false;
+
+		bool Ret = false;
+
+		Int64 Size = FileSize(File);
+		if(Size >= 0)
+		{
+			Buffer.Resize(static_cast<size_t>(Size), false);
+			Ret = (Size == 0) || (FileRead(File, Buffer.Data, Buffer.Size) == Buffer.Size);
+		}
+
+		FileClose(File);
+
+		return Ret;
+	}
+
+
+	//! Calculate the SHA-1 of an XML dictionary
+	bool HashDictionary(const char *DictFile, UInt8 *Digest)
+	{
+		std::string XMLFilePath = LookupDictionaryPath(DictFile);
+
+		DataChunk Buffer;
+		if(XMLFilePath.empty() || !ReadWholeFile(XMLFilePath.c_str(), Buffer)) return false;
+
+		HashHMACSHA1::SHA1(Buffer.Size, Buffer.Data, Digest);
+
+		return true;
+	}
+
+
+	//! Get the name of a symbol space, or "" for none
+	std::string SymbolSpaceName(SymbolSpacePtr &Space)
+	{
+		return Space ? Space->Name() : std::string();
+	}
+
+
+	//! Add a section to a list if it is not empty
+	void AddSection(DictSectionList &Sections, TypeRecordList &Types, SymbolSpacePtr DefaultSymbolSpace)
+	{
+		if(Types.empty()) return;
+
+		Sections.push_back(DictSection());
+		Sections.back().Kind = SectionTypes;
+		Sections.back().DefaultSymbolSpace = DefaultSymbolSpace;
+		Sections.back().Types = Types;
+	}
+
+
+	//! Add a section to a list if it is not empty
+	void AddSection(DictSectionList &Sections, ClassRecordList &Classes, SymbolSpacePtr DefaultSymbolSpace)
+	{
+		if(Classes.empty()) return;
+
+		Sections.push_back(DictSection());
+		Sections.back().Kind = SectionClasses;
+		Sections.back().DefaultSymbolSpace = DefaultSymbolSpace;
+		Sections.back().Classes = Classes;
+	}
+
+
+	//! Parse an XML or RXI dictionary into the sections that LoadDictionary() would load
+	bool ParseDictionary(const char *DictFile, SymbolSpacePtr DefaultSymbolSpace, std::string Application, DictSectionList &Sections)
+	{
+		RXIDataPtr Dict = ParseRXIFile(DictFile, DefaultSymbolSpace, Application);
+		if(!Dict) return false;
+
+		if(Dict->LegacyFormat)
+		{
+			DictionaryPtr Legacy = ParseLegacyDictionary(DictFile, DefaultSymbolSpace);
+			if(!Legacy) return false;
+
+			// DRAGONS: LoadLegacyDictionary() loads its types with the library default symbol space
+			TypeRecordListList::iterator Types_it = Legacy->Types.begin();
+			while(Types_it != Legacy->Types.end())
+			{
+				AddSection(Sections, *Types_it, MXFLibSymbols);
+				Types_it++;
+			}
+
+			ClassRecordListList::iterator Classes_it = Legacy->Classes.begin();
+			while(Classes_it != Legacy->Classes.end())
+			{
+				AddSection(Sections, *Classes_it, DefaultSymbolSpace);
+				Classes_it++;
+			}
+
+			return true;
+		}
+
+		AddSection(Sections, Dict->TypesList, DefaultSymbolSpace);
+		AddSection(Sections, Dict->GroupList, DefaultSymbolSpace);
+		AddSection(Sections, Dict->ElementList, DefaultSymbolSpace);
+
+		return true;
+	}
+
+
+	//! Load parsed or compiled dictionary sections
+	/*! \return 0 if all OK
+	 *  \return -1 on error
+	 */
+	int LoadSections(DictSectionList &Sections, bool FastFail)
+	{
+		int Ret = 0;
+		bool ClassesLoaded = false;
+
+		DictSectionList::iterator it = Sections.begin();
+		while(it != Sections.end())
+		{
+			if((*it).Kind == SectionTypes)
+			{
+				if(LoadTypes((*it).Types, (*it).DefaultSymbolSpace) != 0) Ret = -1;
+			}
+			else
+			{
+				if(LoadClasses((*it).Classes, (*it).DefaultSymbolSpace) != 0) Ret = -1;
+				ClassesLoaded = true;
+			}
+
+			if(FastFail && (Ret != 0)) return Ret;
+
+			it++;
+		}
+
+		// If we loaded any classes, build a static primer (for use in index tables)
+		if(ClassesLoaded) MDOType::MakePrimer(true);
+
+		// Locate reference target types for any new types
+		MDOType::LocateRefTypes();
+
+		return Ret;
+	}
+
+
+	//! Builds the body of a compiled dictionary image
+	class ImageWriter
+	{
+	protected:
+		DataChunk Strings;							//!< The string table
+		size_t StringsAllocated;					//!< Allocated size of the string table buffer
+		std::map<std::string, UInt32> StringMap;	//!< Offset of each string already in the table
+		DataChunk Records;							//!< Everything following the string table
+		size_t RecordsAllocated;					//!< Allocated size of the records buffer
+
+	public:
+		ImageWriter() : StringsAllocated(0), RecordsAllocated(0)
+		{
+			// Offset zero is the empty string
+			Extend(Strings, StringsAllocated, 1)[0] = 0;
+			StringMap[""] = 0;
+		}
+
+		//! Add a string to the table, and get its offset
+		UInt32 AddString(const std::string &String)
+		{
+			std::map<std::string, UInt32>::iterator it = StringMap.find(String);
+			if(it != StringMap.end()) return (*it).second;
+
+			UInt32 Offset = static_cast<UInt32>(Strings.Size);
+			memcpy(Extend(Strings, StringsAllocated, String.size() + 1), String.c_str(), String.size() + 1);
+
+			StringMap[String] = Offset;
+
+			return Offset;
+		}
+
+		//! Add a number to the records
+		void AddU32(UInt32 Value)
+		{
+			PutU32(Value, Extend(Records, RecordsAllocated, 4));
+		}
+
+		//! Add a type record and all its children
+		void AddType(TypeRecordPtr &Type)
+		{
+			UInt32 Names[6];
+			Names[0] = AddString(Type->Type);
+			Names[1] = AddString(Type->Detail);
+			Names[2] = AddString(Type->Base);
+			Names[3] = AddString(Type->Value);
+			Names[4] = AddString(Type->RefTarget);
+			Names[5] = AddString(SymbolSpaceName(Type->SymSpace));
+
+			UInt8 *Record = Extend(Records, RecordsAllocated, TypeRecordSize);
+
+			UInt8 Flags = 0;
+			if(Type->Endian) Flags |= TypeImage_Endian;
+			if(Type->IsBaseline) Flags |= TypeImage_Baseline;
+			if(Type->UL) Flags |= TypeImage_HasUL;
+
+			Record[0] = static_cast<UInt8>(Type->Class);
+			Record[1] = Flags;
+			Record[2] = static_cast<UInt8>(Type->ArrayClass);
+			Record[3] = static_cast<UInt8>(Type->RefType + 1);
+			PutI32(Type->Size, &Record[4]);
+			PutU32(static_cast<UInt32>(Type->Children.size()), &Record[8]);
+
+			int i;
+			for(i = 0; i < 6; i++) PutU32(Names[i], &Record[12 + (i * 4)]);
+
+			if(Type->UL) memcpy(&Record[36], Type->UL->GetValue(), 16);
+			else memset(&Record[36], 0, 16);
+
+			TypeRecordList::iterator it = Type->Children.begin();
+			while(it != Type->Children.end())
+			{
+				AddType(*it);
+				it++;
+			}
+		}
+
+		//! Add a class record and all its children
+		void AddClass(ClassRecordPtr &Class)
+		{
+			UInt32 Names[7];
+			Names[0] = AddString(Class->Name);
+			Names[1] = AddString(Class->Detail);
+			Names[2] = AddString(Class->Base);
+			Names[3] = AddString(Class->Default);
+			Names[4] = AddString(Class->DValue);
+			Names[5] = AddString(Class->RefTarget);
+			Names[6] = AddString(SymbolSpaceName(Class->SymSpace));
+
+			UInt8 *Record = Extend(Records, RecordsAllocated, ClassRecordSize);
+
+			UInt8 Flags = 0;
+			if(Class->IsBaseline) Flags |= ClassImage_Baseline;
+			if(Class->ExtendSubs) Flags |= ClassImage_ExtendSubs;
+			if(Class->HasDefault) Flags |= ClassImage_HasDefault;
+			if(Class->HasDValue) Flags |= ClassImage_HasDValue;
+			if(Class->UL) Flags |= ClassImage_HasUL;
+			if(Class->Parent) Flags |= ClassImage_HasParent;
+
+			Record[0] = static_cast<UInt8>(Class->Class);
+			Record[1] = static_cast<UInt8>(Class->Usage);
+			Record[2] = static_cast<UInt8>(Class->RefType + 1);
+			Record[3] = Flags;
+			PutU32(Class->MinSize, &Record[4]);
+			PutU32(Class->MaxSize, &Record[8]);
+			PutU32(Class->LocalTag, &Record[12]);
+			PutU32(static_cast<UInt32>(Class->Children.size()), &Record[16]);
+
+			int i;
+			for(i = 0; i < 7; i++) PutU32(Names[i], &Record[20 + (i * 4)]);
+
+			if(Class->UL) memcpy(&Record[48], Class->UL->GetValue(), 16);
+			else memset(&Record[48], 0, 16);
+
+			if(Class->Parent) memcpy(&Record[64], Class->Parent->GetValue(), 16);
+			else memset(&Record[64], 0, 16);
+
+			ClassRecordList::iterator it = Class->Children.begin();
+			while(it != Class->Children.end())
+			{
+				AddClass(*it);
+				it++;
+			}
+		}
+
+		//! Build the complete image
+		void Build(DataChunk &Image, const UInt8 *SourceHash, const std::string &Application, SymbolSpacePtr DefaultSymbolSpace, DictSectionList &Sections)
+		{
+			UInt32 AppName = AddString(Application);
+			UInt32 SpaceName = AddString(SymbolSpaceName(DefaultSymbolSpace));
+
+			AddU32(AppName);
+			AddU32(SpaceName);
+			AddU32(static_cast<UInt32>(Sections.size()));
+
+			DictSectionList::iterator it = Sections.begin();
+			while(it != Sections.end())
+			{
+				AddU32((*it).Kind);
+				AddU32(AddString(SymbolSpaceName((*it).DefaultSymbolSpace)));
+
+				if((*it).Kind == SectionTypes)
+				{
+					AddU32(static_cast<UInt32>((*it).Types.size()));
+
+					TypeRecordList::iterator Type_it = (*it).Types.begin();
+					while(Type_it != (*it).Types.end())
+					{
+						AddType(*Type_it);
+						Type_it++;
+					}
+				}
+				else
+				{
+					AddU32(static_cast<UInt32>((*it).Classes.size()));
+
+					ClassRecordList::iterator Class_it = (*it).Classes.begin();
+					while(Class_it != (*it).Classes.end())
+					{
+						AddClass(*Class_it);
+						Class_it++;
+					}
+				}
+
+				it++;
+			}
+
+			size_t BodySize = 4 + Strings.Size + Records.Size;
+
+			Image.Resize(HeaderSize + BodySize, false);
+
+			UInt8 *Body = &Image.Data[HeaderSize];
+			PutU32(static_cast<UInt32>(Strings.Size), Body);
+			memcpy(&Body[4], Strings.Data, Strings.Size);
+			memcpy(&Body[4 + Strings.Size], Records.Data, Records.Size);
+
+			memcpy(Image.Data, ImageMagic, 8);
+			PutU32(ImageVersion, &Image.Data[8]);
+			PutU32(static_cast<UInt32>(BodySize), &Image.Data[12]);
+			memcpy(&Image.Data[16], SourceHash, 20);
+			HashHMACSHA1::SHA1(BodySize, Body, &Image.Data[36]);
+		}
+
+	protected:
+		//! Extend a buffer by a number of bytes, and get a pointer to the new bytes
+		/*! DRAGONS: DataChunk::Resize() allocates exactly, so we grow the buffer geometrically ourselves */
+		static UInt8 *Extend(DataChunk &Buffer, size_t &Allocated, size_t Bytes)
+		{
+			size_t Start = Buffer.Size;
+
+			if(Start + Bytes > Allocated)
+			{
+				Allocated = (Allocated * 2 > Start + Bytes) ? Allocated * 2 : Start + Bytes + 4096;
+				Buffer.ResizeBuffer(Allocated);
+			}
+
+			Buffer.Resize(Start + Bytes);
+
+			return &Buffer.Data[Start];
+		}
+	};
+
+
+	//! Write a compiled dictionary image for some parsed sections
+	bool WriteImage(const char *CompiledFile, const UInt8 *SourceHash, const std::string &Application, SymbolSpacePtr DefaultSymbolSpace, DictSectionList &Sections)
+	{
+		DataChunk Image;
+		ImageWriter Writer;
+		Writer.Build(Image, SourceHash, Application, DefaultSymbolSpace, Sections);
+
+		FileHandle File = FileOpenNew(CompiledFile);
+		if(!FileValid(File))
+		{
+			error("Unable to create compiled dictionary \"%s\"\n", CompiledFile);
+			return false;
+		}
+
+		bool Ret = (FileWrite(File, Image.Data, Image.Size) == Image.Size);
+		FileClose(File);
+
+		if(!Ret) error("Failed to write compiled dictionary \"%s\"\n", CompiledFile);
+
+		return Ret;
+	}
+
+
+	//! Rebuilds the records held in the body of a compiled dictionary image
+	/*! Any out-of-range count or string offset sets Failed, after which all reads return empty values */
+	class ImageReader
+	{
+	protected:
+		const UInt8 *Strings;						//!< The string table
+		UInt32 StringsSize;							//!< Size of the string table
+		const UInt8 *Ptr;							//!< The next byte to read
+		const UInt8 *End;							//!< The end of the body
+		std::map<UInt32, SymbolSpacePtr> Spaces;	//!< Symbol spaces already located, indexed by string offset
+
+	public:
+		bool Failed;								//!< Set if the body is not valid
+
+	public:
+		ImageReader(const UInt8 *Body, size_t BodySize) : Strings(NULL), StringsSize(0), Ptr(Body), End(Body + BodySize), Failed(false)
+		{
+			if(!Need(4)) return;
+			StringsSize = GetU32(Ptr);
+			Ptr += 4;
+
+			// The table must hold at least the empty string, and must end with a terminator
+			if((StringsSize == 0) || !Need(StringsSize) || (Ptr[StringsSize - 1] != 0))
+			{
+				Failed = true;
+				return;
+			}
+
+			Strings = Ptr;
+			Ptr += StringsSize;
+		}
+
+		//! Check that a number of bytes are available
+		bool Need(size_t Bytes)
+		{
+			if(static_cast<size_t>(End - Ptr) < Bytes) Failed = true;
+			return !Failed;
+		}
+
+		//! Check that the whole body has been read
+		bool AtEnd(void) { return Ptr == End; }
+
+		//! Read a number
+		UInt32 ReadU32(void)
+		{
+			if(!Need(4)) return 0;
+			UInt32 Ret = GetU32(Ptr);
+			Ptr += 4;
+			return Ret;
+		}
+
+		//! Get a string from the table
+		const char *String(UInt32 Offset)
+		{
+			if(Offset >= StringsSize)
+			{
+				Failed = true;
+				return "";
+			}
+
+			return reinterpret_cast<const char *>(&Strings[Offset]);
+		}
+
+		//! Get a symbol space by the string offset of its name, creating it if required
+		SymbolSpacePtr Space(UInt32 Offset)
+		{
+			if(Offset == 0) return NULL;
+
+			std::map<UInt32, SymbolSpacePtr>::iterator it = Spaces.find(Offset);
+			if(it != Spaces.end()) return (*it).second;
+
+			std::string Name = String(Offset);
+
+			SymbolSpacePtr Ret = SymbolSpace::FindSymbolSpace(Name);
+			if(!Ret) Ret = new SymbolSpace(Name);
+
+			Spaces[Offset] = Ret;
+
+			return Ret;
+		}
+
+		//! Read a type record and all its children
+		TypeRecordPtr ReadType(void)
+		{
+			if(!Need(TypeRecordSize)) return NULL;
+
+			const UInt8 *Record = Ptr;
+			Ptr += TypeRecordSize;
+
+			TypeRecordPtr Ret = new TypeRecord;
+
+			Ret->Class = static_cast<TypeClass>(Record[0]);
+			Ret->Endian = (Record[1] & TypeImage_Endian) ? true : false;
+			Ret->IsBaseline = (Record[1] & TypeImage_Baseline) ? true : false;
+			Ret->ArrayClass = static_cast<MDArrayClass>(Record[2]);
+			Ret->RefType = static_cast<TypeRef>(static_cast<int>(Record[3]) - 1);
+			Ret->Size = GetI32(&Record[4]);
+
+			Ret->Type = String(GetU32(&Record[12]));
+			Ret->Detail = String(GetU32(&Record[16]));
+			Ret->Base = String(GetU32(&Record[20]));
+			Ret->Value = String(GetU32(&Record[24]));
+			Ret->RefTarget = String(GetU32(&Record[28]));
+			Ret->SymSpace = Space(GetU32(&Record[32]));
+
+			if(Record[1] & TypeImage_HasUL) Ret->UL = new UL(&Record[36]);
+
+			UInt32 Children = GetU32(&Record[8]);
+			while(Children-- && !Failed) Ret->Children.push_back(ReadType());
+
+			return Ret;
+		}
+
+		//! Read a class record and all its children
+		ClassRecordPtr ReadClass(void)
+		{
+			if(!Need(ClassRecordSize)) return NULL;
+
+			const UInt8 *Record = Ptr;
+			Ptr += ClassRecordSize;
+
+			ClassRecordPtr Ret = new ClassRecord;
+
+			Ret->Class = static_cast<ClassType>(Record[0]);
+			Ret->Usage = static_cast<ClassUsage>(Record[1]);
+			Ret->RefType = static_cast<ClassRef>(static_cast<int>(Record[2]) - 1);
+			Ret->IsBaseline = (Record[3] & ClassImage_Baseline) ? true : false;
+			Ret->ExtendSubs = (Record[3] & ClassImage_ExtendSubs) ? true : false;
+			Ret->HasDefault = (Record[3] & ClassImage_HasDefault) ? true : false;
+			Ret->HasDValue = (Record[3] & ClassImage_HasDValue) ? true : false;
+			Ret->MinSize = GetU32(&Record[4]);
+			Ret->MaxSize = GetU32(&Record[8]);
+			Ret->LocalTag = GetU32(&Record[12]);
+
+			Ret->Name = String(GetU32(&Record[20]));
+			Ret->Detail = String(GetU32(&Record[24]));
+			Ret->Base = String(GetU32(&Record[28]));
+			Ret->Default = String(GetU32(&Record[32]));
+			Ret->DValue = String(GetU32(&Record[36]));
+			Ret->RefTarget = String(GetU32(&Record[40]));
+			Ret->SymSpace = Space(GetU32(&Record[44]));
+
+			if(Record[3] & ClassImage_HasUL) Ret->UL = new UL(&Record[48]);
+			if(Record[3] & ClassImage_HasParent) Ret->Parent = new UL(&Record[64]);
+
+			UInt32 Children = GetU32(&Record[16]);
+			while(Children-- && !Failed) Ret->Children.push_back(ReadClass());
+
+			return Ret;
+		}
+	};
+
+
+	//! Read a compiled dictionary image
+	/*! If SourceHash is not NULL the image is only accepted if it was built from a dictionary with that hash,
+	 *  for the same application and default symbol space.
+	 *  \return true if the image was read into Sections
+	 */
+	bool ReadImage(const char *CompiledFile, const UInt8 *SourceHash, SymbolSpacePtr DefaultSymbolSpace, const std::string &Application, DictSectionList &Sections)
+	{
+		DataChunk Image;
+		if(!ReadWholeFile(CompiledFile, Image))
+		{
+			debug("No compiled dictionary \"%s\"\n", CompiledFile);
+			return false;
+		}
+
+		if((Image.Size < HeaderSize) || (memcmp(Image.Data, ImageMagic, 8) != 0) || (GetU32(&Image.Data[12]) != Image.Size - HeaderSize))
+		{
+			warning("\"%s\" is not a valid compiled dictionary\n", CompiledFile);
+			return false;
+		}
+
+		if(GetU32(&Image.Data[8]) != ImageVersion)
+		{
+			debug("Compiled dictionary \"%s\" is layout version %u, not %u\n", CompiledFile, GetU32(&Image.Data[8]), ImageVersion);
+			return false;
+		}
+
+		if(SourceHash && (memcmp(&Image.Data[16], SourceHash, 20) != 0))
+		{
+			debug("Compiled dictionary \"%s\" is out of date\n", CompiledFile);
+			return false;
+		}
+
+		const UInt8 *Body = &Image.Data[HeaderSize];
+		size_t BodySize = Image.Size - HeaderSize;
+
+		UInt8 BodyHash[20];
+		HashHMACSHA1::SHA1(BodySize, Body, BodyHash);
+		if(memcmp(&Image.Data[36], BodyHash, 20) != 0)
+		{
+			warning("Compiled dictionary \"%s\" is damaged\n", CompiledFile);
+			return false;
+		}
+
+		ImageReader Reader(Body, BodySize);
+
+		std::string ImageApplication = Reader.String(Reader.ReadU32());
+		std::string ImageSpace = Reader.String(Reader.ReadU32());
+
+		if(SourceHash && !Reader.Failed)
+		{
+			if((ImageApplication != Application) || (ImageSpace != SymbolSpaceName(DefaultSymbolSpace)))
+			{
+				debug("Compiled dictionary \"%s\" was built for a different application or symbol space\n", CompiledFile);
+				return false;
+			}
+		}
+
+		UInt32 SectionCount = Reader.ReadU32();
+		while(SectionCount-- && !Reader.Failed)
+		{
+			Sections.push_back(DictSection());
+			DictSection &Section = Sections.back();
+
+			Section.Kind = Reader.ReadU32();
+			Section.DefaultSymbolSpace = Reader.Space(Reader.ReadU32());
+
+			UInt32 Count = Reader.ReadU32();
+			if(Section.Kind == SectionTypes)
+			{
+				while(Count-- && !Reader.Failed) Section.Types.push_back(Reader.ReadType());
+			}
+			else if(Section.Kind == SectionClasses)
+			{
+				while(Count-- && !Reader.Failed) Section.Classes.push_back(Reader.ReadClass());
+			}
+			else Reader.Failed = true;
+		}
+
+		if(Reader.Failed || !Reader.AtEnd())
+		{
+			warning("Compiled dictionary \"%s\" is damaged\n", CompiledFile);
+			Sections.clear();
+			return false;
+		}
+
+		return true;
+	}
+}
+
+
+//! Build a compiled dictionary image from an XML or RXI dictionary
+/*! \return true if the image was written
+ */
+bool mxflib::CompileDictionary(const char *DictFile, const char *CompiledFile, SymbolSpacePtr DefaultSymbolSpace /*=MXFLibSymbols*/, std::string Application /*=""*/)
+{
+	UInt8 SourceHash[20];
+	if(!HashDictionary(DictFile, SourceHash))
+	{
+		error("Failed to read dictionary \"%s\"\n", DictFile);
+		return false;
+	}
+
+	DictSectionList Sections;
+	if(!ParseDictionary(DictFile, DefaultSymbolSpace, Application, Sections)) return false;
+
+	return WriteImage(CompiledFile, SourceHash, Application, DefaultSymbolSpace, Sections);
+}
+
+
+//! Load dictionary from a compiled dictionary image
+/*! \return 0 if all OK
+ *  \return -1 on error
+ *  \return 1 if the image is missing, damaged or stale - in which case nothing has been loaded
+ */
+int mxflib::LoadCompiledDictionary(const char *CompiledFile, const char *DictFile /*=NULL*/, SymbolSpacePtr DefaultSymbolSpace /*=MXFLibSymbols*/, std::string Application /*=""*/, bool FastFail /*=false*/)
+{
+	UInt8 SourceHash[20];
+	if(DictFile && !HashDictionary(DictFile, SourceHash)) return 1;
+
+	DictSectionList Sections;
+	if(!ReadImage(CompiledFile, DictFile ? SourceHash : NULL, DefaultSymbolSpace, Application, Sections)) return 1;
+
+	return LoadSections(Sections, FastFail);
+}
+
+
+//! Load dictionary from an XML dictionary, using a compiled image of it as a cache
+/*! \return 0 if all OK
+ *  \return -1 on error
+ */
+int mxflib::LoadCachedDictionary(const char *DictFile, const char *CompiledFile, SymbolSpacePtr DefaultSymbolSpace /*=MXFLibSymbols*/, std::string Application /*=""*/, bool FastFail /*=false*/)
+{
+	UInt8 SourceHash[20];
+	if(!HashDictionary(DictFile, SourceHash))
+	{
+		error("Failed to read dictionary \"%s\"\n", DictFile);
+		return -1;
+	}
+
+	DictSectionList Sections;
+	if(ReadImage(CompiledFile, SourceHash, DefaultSymbolSpace, Application, Sections)) return LoadSections(Sections, FastFail);
+
+	// The image is no use, so parse the XML and make a new image before loading, as loading may modify the records
+	if(!ParseDictionary(DictFile, DefaultSymbolSpace, Application, Sections)) return -1;
+
+	WriteImage(CompiledFile, SourceHash, Application, DefaultSymbolSpace, Sections);
+
+	return LoadSections(Sections, FastFail);
+}
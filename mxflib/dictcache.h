@@ -0,0 +1,71 @@
+/*! \file	dictcache.h
+ *	\brief	Compiled dictionary images, built from XML dictionaries and loaded without parsing
+ *
+ *			A compiled dictionary holds the type and class records parsed from an
+ *			XML or RXI dictionary in a flat binary image, with binary ULs and a single
+ *			string table. Loading an image reads it in one pass and rebuilds the
+ *			records directly, so none of the XML parsing or string to UL conversion
+ *			is repeated. Each image records a SHA-1 of the dictionary it was built
+ *			from so that a stale image can be detected and the XML used instead.
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+#ifndef MXFLIB__DICTCACHE_H
+#define MXFLIB__DICTCACHE_H
+
+// STL Includes
+#include <string>
+
+
+namespace mxflib
+{
+	//! Build a compiled dictionary image from an XML or RXI dictionary
+	/*! The dictionary is parsed but not loaded.
+	 *  \param DictFile The XML dictionary, which is located with LookupDictionaryPath()
+	 *  \param CompiledFile The image file to write
+	 *  \param DefaultSymbolSpace The default symbol space, as would be given to LoadDictionary()
+	 *  \param Application The application name used to select RXI entries, as would be given to LoadDictionary()
+	 *  \return true if the image was written
+	 */
+	bool CompileDictionary(const char *DictFile, const char *CompiledFile, SymbolSpacePtr DefaultSymbolSpace = MXFLibSymbols, std::string Application = "");
+
+	//! Load dictionary from a compiled dictionary image
+	/*! If DictFile is given the image is only used if it was compiled from the current contents of that file
+	 *  with the same DefaultSymbolSpace and Application.
+	 *  \return 0 if all OK
+	 *  \return -1 on error
+	 *  \return 1 if the image is missing, damaged or stale - in which case nothing has been loaded
+	 */
+	int LoadCompiledDictionary(const char *CompiledFile, const char *DictFile = NULL, SymbolSpacePtr DefaultSymbolSpace = MXFLibSymbols, std::string Application = "", bool FastFail = false);
+
+	//! Load dictionary from an XML dictionary, using a compiled image of it as a cache
+	/*! If CompiledFile holds an up-to-date image of DictFile it is loaded, otherwise DictFile is
+	 *  parsed and loaded and a new image is written to CompiledFile for next time.
+	 *  \return 0 if all OK
+	 *  \return -1 on error
+	 */
+	int LoadCachedDictionary(const char *DictFile, const char *CompiledFile, SymbolSpacePtr DefaultSymbolSpace = MXFLibSymbols, std::string Application = "", bool FastFail = false);
+}
+
+#endif // MXFLIB__DICTCACHE_H
@@ -45,216 +45,793 @@ static XML_Type_t XMLType=XML_Type_MXFixer; // -xg
 static bool CollapseSingleSequence = false;	// -xc Collapse Sequence of single segment to a Segment
 static bool SkipStrongSingleton = false;	// -xs Skip showing the class of a singleton strong ref as a separate element as in RegXML
 
-// from mxfdump
-//! Flag for dumping object locations as well as object data
-static bool DumpLocation = false;
-
-//! Flag for following global references
-static bool FollowGlobals = true;
-
-//! Flag for noting if IsModified()
-static bool DumpModified = false;
-
-//! Flag for alpha sorted dump
-static bool SortedDump = false;
-
 #ifdef OPTION3ENABLED
 //! Flag for diplaying baseline UL of sets using the ObjectClass extension mechanism
 static bool ShowBaseline = false;
 #endif // OPTION3ENABLED
 
-// maximum value size to dump
-// above this, dump will just state size
-#define MAX_DUMPSIZE 128
-
 // merged from XMLMetaParser, mxfsplit, mxfdump
 
 //! Dump an MDObject and any physical or logical children
 void DumpObject( MDObjectPtr Object, std::string Prefix, bool bare /* = false */ )
 {
-	if(DumpLocation) printf("%s0x%s:\n", Prefix.c_str(), Int64toHexString(Object->GetLocation(),8).c_str());
+	// DRAGONS: Anything already printed to stdout is still in the stdio buffer, so the order of output is preserved
+	DumpFileOutput Out(stdout);
+	Out.SetPrefix(Prefix);
 
-	if(DumpModified && Object->IsModified()) printf("%s%s is *MODIFIED*\n", Prefix.c_str(), Object->FullName().c_str() );
+	DumpObject(Object, Out);
+}
 
-#ifdef OPTION3ENABLED
-	if(ShowBaseline)
+
+//! Write some text
+void DumpOutput::Write(const char *Text, size_t Size)
+{
+	while(Size)
+	{
+		if(Used == sizeof(Buffer)) Flush();
+
+		size_t Count = sizeof(Buffer) - Used;
+		if(Count > Size) Count = Size;
+
+		memcpy(&Buffer[Used], Text, Count);
+		Used += Count;
+		Text += Count;
+		Size -= Count;
+	}
+}
+
+
+//! Start a new line, writing the prefix and two spaces for each level of indentation
+void DumpOutput::StartLine(int Indent)
+{
+	static const char Spaces[] = "                                                                ";
+
+	Write(Prefix);
+
+	size_t Count = static_cast<size_t>(Indent) * 2;
+	while(Count)
+	{
+		size_t Chunk = Count < (sizeof(Spaces) - 1) ? Count : (sizeof(Spaces) - 1);
+		Write(Spaces, Chunk);
+		Count -= Chunk;
+	}
+}
+
+
+//! Write a string to a DumpOutput as a quoted JSON string, escaping as required
+void WriteJSONString(DumpOutput &Out, const std::string &Text)
+{
+	static const char Hex[] = "0123456789abcdef";
+
+	Out.Put('"');
+
+	const char *p = Text.data();
+	const char *End = p + Text.size();
+	const char *Run = p;
+	while(p != End)
+	{
+		unsigned char c = static_cast<unsigned char>(*p);
+		if((c >= 0x20) && (c != '"') && (c != '\\'))
+		{
+			p++;
+			continue;
+		}
+
+		// Write everything up to this character in one go
+		Out.Write(Run, p - Run);
+
+		Out.Put('\\');
+		if(c == '"') Out.Put('"');
+		else if(c == '\\') Out.Put('\\');
+		else if(c == '\n') Out.Put('n');
+		else if(c == '\r') Out.Put('r');
+		else if(c == '\t') Out.Put('t');
+		else
+		{
+			Out.Write("u00");
+			Out.Put(Hex[c >> 4]);
+			Out.Put(Hex[c & 0x0f]);
+		}
+
+		Run = ++p;
+	}
+	Out.Write(Run, p - Run);
+
+	Out.Put('"');
+}
+
+} // namespace mxflib
+
+
+namespace
+{
+	//! Walks an MDObject tree, writing it to a DumpOutput
+	class ObjectDumper
 	{
-		if(!Object->IsBaseline())
+	protected:
+		DumpOutput &Out;									//!< Where to write the dump
+		const DumpOptions &Options;							//!< How to write it
+		std::map<std::string, std::string> NameCache;		//!< Object names as they are written in JSON or XML, indexed by object name
+		std::vector<std::pair<MDObject *, std::string> > Path;	//!< Objects being dumped, with their full names - only used if Options.DumpModified
+
+	public:
+		ObjectDumper(DumpOutput &Out, const DumpOptions &Options) : Out(Out), Options(Options) {}
+
+		//! Dump an object in the selected format
+		void Dump(MDObjectPtr &Object, int Indent)
 		{
-			if(Object->GetBaselineUL())
+			if(Options.Format == DumpFormatJSON)
 			{
-				MDOTypePtr BaselineClass = MDOType::Find(Object->GetBaselineUL());
-				if(BaselineClass)
+				Out.StartLine(Indent);
+				JSON(Object, Indent);
+				Out.Put('\n');
+			}
+			else if(Options.Format == DumpFormatXML) XML(Object, Indent);
+			else Text(Object, Indent);
+		}
+
+	protected:
+		/* Helpers shared by all formats */
+
+		//! Get the full name of an object, using the names of the objects being dumped where possible
+		std::string FullName(MDObject *Object)
+		{
+			if((!Path.empty()) && (Object->GetParent().GetPtr() == Path.back().first)) return Path.back().second + "/" + Object->Name();
+			return Object->FullName();
+		}
+
+		//! Note that we are about to dump the children of an object
+		void EnterChildren(MDObject *Object)
+		{
+			if(Options.DumpModified) Path.push_back(std::make_pair(Object, FullName(Object)));
+		}
+
+		//! Note that we have dumped the children of an object
+		void LeaveChildren(void)
+		{
+			if(Options.DumpModified) Path.pop_back();
+		}
+
+		//! Get the children of an object in the order they are to be dumped
+		void GetChildren(MDObjectPtr &Object, MDObjectList &Children)
+		{
+			MDObjectULList::iterator it = Object->begin();
+
+			if(!Options.SortedDump)
+			{
+				/* Dump Objects in the order stored */
+				while(it != Object->end())
 				{
-					printf("%sBaseline: %s\n", Prefix.c_str(), BaselineClass->Name().c_str());
+					Children.push_back((*it).second);
+					it++;
 				}
-				else
+			}
+			else
+			{
+				/* Dump Objects in alphabetical order - to allow easier file comparisons */
+				std::multimap<std::string, MDObjectPtr> ChildMap;
+				while(it != Object->end())
 				{
-					printf("%sNote: Current dictionary does not contain a set with the baseline UL used to wrap this non-baseline class\n", Prefix.c_str());
-					printf("%sBaseline: %s\n", Prefix.c_str(), Object->GetBaselineUL()->GetString().c_str());
+					ChildMap.insert(std::multimap<std::string, MDObjectPtr>::value_type((*it).second->Name(), (*it).second));
+					it++;
+				}
+
+				std::multimap<std::string, MDObjectPtr>::iterator CM_Iter = ChildMap.begin();
+				while(CM_Iter != ChildMap.end())
+				{
+					Children.push_back((*CM_Iter).second);
+					CM_Iter++;
 				}
-				Prefix += "  ";
 			}
-			else
+		}
+
+		//! Write the first few bytes of a large value as hex, as groups of 4 bytes
+		/*! \return The number of bytes written */
+		size_t WriteHexStart(MDObjectPtr &Object, int Groups, const char *Separator)
+		{
+			const DataChunk &Data = Object->Value->GetData();
+			size_t Count = Groups * 4;
+			if(Count > Data.Size) Count = Data.Size;
+
+			static const char Hex[] = "0123456789abcdef";
+
+			size_t i;
+			for(i = 0; i < Count; i++)
 			{
-				printf("%sNote: Current dictionary flags this class as non-baseline, but it is not wrapped in a baseline class\n", Prefix.c_str());
+				if(i && ((i % 4) == 0)) Out.Write(Separator);
+				Out.Put(Hex[Data.Data[i] >> 4]);
+				Out.Put(Hex[Data.Data[i] & 0x0f]);
 			}
+
+			return Count;
 		}
-		else
+
+		//! Get the name of the kind of reference an object holds
+		static const char *RefName(MDObjectPtr &Object)
 		{
-			if(Object->GetBaselineUL())
+			switch(Object->GetRefType())
 			{
-				printf("%sNote: Current dictionary flags this class as baseline, but it is wrapped as a non-baseline class\n", Prefix.c_str());
+			case ClassRefStrong: return Object->EffectiveRefNested() ? "nested" : "strong";
+			case ClassRefGlobal: return "global";
+			case ClassRefMeta: return "meta";
+			case ClassRefDict: return "dict";
+			default: return "weak";
+			}
+		}
+
+		//! Get the name of the target of a reference, as shown in the dump
+		static std::string TargetName(MDObjectPtr &Object)
+		{
+			MDObjectPtr Link = Object->GetLink();
+
+			if(Object->GetRefType() == ClassRefMeta) return Link->GetString(MetaDefinitionName_UL, Link->Name());
+			if(Object->GetRefType() == ClassRefDict) return Link->GetString(DefinitionObjectName_UL, Link->Name());
+			return Link->Name();
+		}
 
-				MDOTypePtr BaselineClass = MDOType::Find(Object->GetBaselineUL());
-				if(BaselineClass)
+		//! Should the target of a reference held by this object be dumped?
+		bool FollowLink(MDObjectPtr &Object)
+		{
+			if(Object->GetRefType() == ClassRefStrong) return true;
+			if(Object->GetRefType() == ClassRefGlobal) return Options.FollowGlobals;
+			return false;
+		}
+
+
+		/* Text */
+
+		//! Dump an object as indented text
+		void Text(MDObjectPtr &Object, int Indent)
+		{
+			const std::string &Name = Object->Name();
+
+			if(Options.DumpLocation)
+			{
+				Out.StartLine(Indent);
+				Out.Write("0x");
+				Out.Write(Int64toHexString(Object->GetLocation(), 8));
+				Out.Write(":\n");
+			}
+
+			if(Options.DumpModified && Object->IsModified())
+			{
+				Out.StartLine(Indent);
+				Out.Write(FullName(Object));
+				Out.Write(" is *MODIFIED*\n");
+			}
+
+#ifdef OPTION3ENABLED
+			if(ShowBaseline)
+			{
+				if(!Object->IsBaseline())
 				{
-					printf("%sBaseline: %s\n", Prefix.c_str(), BaselineClass->Name().c_str());
+					if(Object->GetBaselineUL())
+					{
+						WriteBaseline(Object, Indent);
+						Indent++;
+					}
+					else
+					{
+						Out.StartLine(Indent);
+						Out.Write("Note: Current dictionary flags this class as non-baseline, but it is not wrapped in a baseline class\n");
+					}
 				}
 				else
 				{
-					printf("%sNote: Current dictionary does not contain a set with the baseline UL used to wrap this non-baseline class\n", Prefix.c_str());
-					printf("%sBaseline: %s\n", Prefix.c_str(), Object->GetBaselineUL()->GetString().c_str());
+					if(Object->GetBaselineUL())
+					{
+						Out.StartLine(Indent);
+						Out.Write("Note: Current dictionary flags this class as baseline, but it is wrapped as a non-baseline class\n");
+
+						WriteBaseline(Object, Indent);
+						Indent++;
+					}
 				}
-				Prefix += "  ";
 			}
-		}
-	}
 #endif // OPTION3ENABLED
 
-	if(Object->GetLink())
-	{
-		if(Object->GetRefType() == ClassRefStrong)
-		{
-			if(Object->EffectiveRefNested())
+			if(Object->GetLink())
 			{
-				printf("%s%s -> Nested Item\n", Prefix.c_str(), Object->Name().c_str(), Object->GetLink()->Name().c_str());
+				MDObjectPtr Link = Object->GetLink();
+
+				if(Object->GetRefType() == ClassRefStrong)
+				{
+					if(Object->EffectiveRefNested())
+					{
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" -> Nested Item\n");
+					}
+					else
+					{
+						WriteTextValue(Name, Object, Indent);
+
+						if(Options.DumpLocation)
+						{
+							Out.StartLine(Indent);
+							Out.Write("0x");
+							Out.Write(Int64toHexString(Object->GetLocation(), 8));
+							Out.Write(":\n");
+						}
+
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" -> Strong Reference to ");
+						Out.Write(Link->Name());
+						Out.Put('\n');
+					}
+
+					Text(Link, Indent + 1);
+				}
+				else if(Object->GetRefType() == ClassRefGlobal)
+				{
+					if(Options.FollowGlobals)
+					{
+						WriteTextValue(Name, Object, Indent);
+
+						if(Options.DumpLocation)
+						{
+							Out.Write("0x");
+							Out.Write(Int64toHexString(Object->GetLocation(), 8));
+							Out.Write(" : ");
+						}
+
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" -> Global Reference to ");
+						Out.Write(Link->Name());
+						Out.Put('\n');
+
+						Text(Link, Indent + 1);
+					}
+					else
+					{
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" -> Global Reference to ");
+						Out.Write(Link->Name());
+						Out.Write(", ");
+						Out.Write(Object->GetString());
+						Out.Put('\n');
+					}
+				}
+				else
+				{
+					Out.StartLine(Indent);
+					Out.Write(Name);
+					if(Object->GetRefType() == ClassRefMeta) Out.Write(" -> MetaDictionary Reference to ");
+					else if(Object->GetRefType() == ClassRefDict) Out.Write(" -> Dictionary Reference to ");
+					else Out.Write(" -> Weak Reference to ");
+					Out.Write(TargetName(Object));
+					Out.Put(' ');
+					Out.Write(Object->GetString());
+					Out.Put('\n');
+				}
+			}
+			else if(Object->IsDValue())
+			{
+				Out.StartLine(Indent);
+				Out.Write(Name);
+				Out.Write(" = <Unknown>\n");
+			}
+			// Check first for values that are not reference batches
+			else if(Object->IsAValue())
+			{
+				if(Object->Value->GetData().Size > Options.MaxValueSize)
+				{
+					Out.StartLine(Indent);
+					Out.Write(Name);
+					Out.Write(" = RAW[0x");
+					Out.Write(Int64toHexString(Object->Value->GetData().Size, 8));
+					Out.Write("]");
+
+					int i;
+					for(i = 0; i < 3; i++)
+					{
+						Out.Put('\n');
+						Out.StartLine(Indent);
+
+						// Line up under the value
+						size_t Pad = Name.size() ? Name.size() : 1;
+						while(Pad--) Out.Put(' ');
+						Out.Write("      ");
 
-				DumpObject(Object->GetLink(), Prefix + "  ");
+						const DataChunk &Data = Object->Value->GetData();
+						size_t j;
+						for(j = 0; j < 16; j++)
+						{
+							size_t Pos = (i * 16) + j;
+							if(Pos < Data.Size) Out.Write(Int64toHexString(Data.Data[Pos], 2));
+							if((j % 4) == 3) Out.Put(' ');
+						}
+
+						if(i == 2) Out.Write("...\n");
+					}
+				}
+				else
+				{
+					if(Name.find("Unknown") == std::string::npos) WriteTextValue(Name, Object, Indent);
+					else
+					{
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Put('\n');
+					}
+
+					if(Object->GetRefType() == ClassRefMeta)
+					{
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" is an unsatisfied MetaRef\n");
+					}
+					else if(Object->GetRefType() == ClassRefDict)
+					{
+						Out.StartLine(Indent);
+						Out.Write(Name);
+						Out.Write(" is an unsatisfied DictRef\n");
+					}
+				}
 			}
 			else
 			{
-				printf("%s%s = %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetString().c_str());
+				Out.StartLine(Indent);
+				Out.Write(Name);
+				Out.Put('\n');
+
+				MDObjectList Children;
+				GetChildren(Object, Children);
 
-				if(DumpLocation) printf("%s0x%s:\n", Prefix.c_str(), Int64toHexString(Object->GetLocation(),8).c_str());
-				printf("%s%s -> Strong Reference to %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetLink()->Name().c_str());
+				EnterChildren(Object);
 
-				DumpObject(Object->GetLink(), Prefix + "  ");
+				MDObjectList::iterator it = Children.begin();
+				while(it != Children.end())
+				{
+					Text(*it, Indent + 1);
+					it++;
+				}
+
+				LeaveChildren();
 			}
 		}
-		else if(Object->GetRefType() == ClassRefGlobal)
+
+		//! Write a "Name = Value" line
+		void WriteTextValue(const std::string &Name, MDObjectPtr &Object, int Indent)
 		{
-			if(FollowGlobals)
+			Out.StartLine(Indent);
+			Out.Write(Name);
+			Out.Write(" = ");
+			Out.Write(Object->GetString());
+			Out.Put('\n');
+		}
+
+#ifdef OPTION3ENABLED
+		//! Write the baseline class of an object that uses the ObjectClass extension mechanism
+		void WriteBaseline(MDObjectPtr &Object, int Indent)
+		{
+			MDOTypePtr BaselineClass = MDOType::Find(Object->GetBaselineUL());
+			if(!BaselineClass)
 			{
-				printf("%s%s = %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetString().c_str());
+				Out.StartLine(Indent);
+				Out.Write("Note: Current dictionary does not contain a set with the baseline UL used to wrap this non-baseline class\n");
+			}
+
+			Out.StartLine(Indent);
+			Out.Write("Baseline: ");
+			Out.Write(BaselineClass ? BaselineClass->Name() : Object->GetBaselineUL()->GetString());
+			Out.Put('\n');
+		}
+#endif // OPTION3ENABLED
 
-				if(DumpLocation) printf("0x%s : ", Int64toHexString(Object->GetLocation(),8).c_str());
-				printf("%s%s -> Global Reference to %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetLink()->Name().c_str());
 
-				DumpObject(Object->GetLink(), Prefix + "  ");
-			}
-			else
+		/* JSON */
+
+		//! Write a string as a quoted JSON string
+		void JSONString(const std::string &Text) { WriteJSONString(Out, Text); }
+
+		//! Write the name of an object as a quoted JSON string
+		void JSONName(const std::string &Name)
+		{
+			std::map<std::string, std::string>::iterator it = NameCache.find(Name);
+			if(it == NameCache.end())
 			{
-				printf("%s%s -> Global Reference to %s, %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetLink()->Name().c_str(), Object->GetString().c_str());
+				std::string Quoted;
+				DumpStringOutput QuotedOut(Quoted);
+				ObjectDumper Quoter(QuotedOut, Options);
+				Quoter.JSONString(Name);
+				QuotedOut.Flush();
+
+				it = NameCache.insert(std::map<std::string, std::string>::value_type(Name, Quoted)).first;
 			}
+
+			Out.Write((*it).second);
 		}
-		else if(Object->GetRefType() == ClassRefMeta)
+
+		//! Dump an object as a JSON object, starting at the current position and leaving the output at the closing brace
+		void JSON(MDObjectPtr &Object, int Indent)
 		{
-			std::string TargetName = Object->GetLink()->GetString(MetaDefinitionName_UL, Object->GetLink()->Name());
-			printf("%s%s -> MetaDictionary Reference to %s %s\n", Prefix.c_str(), Object->Name().c_str(), TargetName.c_str(), Object->GetString().c_str());
+			Out.Write("{\"name\": ");
+			JSONName(Object->Name());
+
+			if(Options.DumpLocation)
+			{
+				Out.Write(", \"location\": \"0x");
+				Out.Write(Int64toHexString(Object->GetLocation(), 8));
+				Out.Put('"');
+			}
+
+			if(Options.DumpModified && Object->IsModified()) Out.Write(", \"modified\": true");
+
+			if(Object->GetLink())
+			{
+				Out.Write(", \"ref\": \"");
+				Out.Write(RefName(Object));
+				Out.Put('"');
+
+				if(!Object->EffectiveRefNested() || (Object->GetRefType() != ClassRefStrong))
+				{
+					Out.Write(", \"value\": ");
+					JSONString(Object->GetString());
+				}
+
+				if(FollowLink(Object))
+				{
+					Out.Write(",\n");
+					Out.StartLine(Indent + 1);
+					Out.Write("\"target\": ");
+
+					MDObjectPtr Link = Object->GetLink();
+					JSON(Link, Indent + 1);
+
+					Out.Put('\n');
+					Out.StartLine(Indent);
+					Out.Put('}');
+					return;
+				}
+
+				Out.Write(", \"targetName\": ");
+				JSONString(TargetName(Object));
+			}
+			else if(Object->IsDValue())
+			{
+				Out.Write(", \"unknown\": true");
+			}
+			else if(Object->IsAValue())
+			{
+				if(Object->Value->GetData().Size > Options.MaxValueSize)
+				{
+					Out.Write(", \"size\": ");
+					Out.Write(Int64toString(Object->Value->GetData().Size));
+					Out.Write(", \"data\": \"");
+					WriteHexStart(Object, 12, " ");
+					Out.Write(" ...\"");
+				}
+				else
+				{
+					Out.Write(", \"value\": ");
+					JSONString(Object->GetString());
+
+					if((Object->GetRefType() == ClassRefMeta) || (Object->GetRefType() == ClassRefDict))
+					{
+						Out.Write(", \"ref\": \"");
+						Out.Write(RefName(Object));
+						Out.Write("\", \"unsatisfied\": true");
+					}
+				}
+			}
+			else
+			{
+				MDObjectList Children;
+				GetChildren(Object, Children);
+
+				if(Children.empty())
+				{
+					Out.Write(", \"children\": []}");
+					return;
+				}
+
+				Out.Write(",\n");
+				Out.StartLine(Indent + 1);
+				Out.Write("\"children\": [\n");
+
+				EnterChildren(Object);
+
+				MDObjectList::iterator it = Children.begin();
+				while(it != Children.end())
+				{
+					Out.StartLine(Indent + 2);
+					JSON(*it, Indent + 2);
+
+					it++;
+					if(it != Children.end()) Out.Put(',');
+					Out.Put('\n');
+				}
+
+				LeaveChildren();
+
+				Out.StartLine(Indent + 1);
+				Out.Write("]\n");
+				Out.StartLine(Indent);
+				Out.Put('}');
+				return;
+			}
+
+			Out.Put('}');
 		}
-		else if(Object->GetRefType() == ClassRefDict)
+
+
+		/* XML */
+
+		//! Write text with XML special characters escaped
+		void XMLText(const std::string &Text)
 		{
-			std::string TargetName = Object->GetLink()->GetString(DefinitionObjectName_UL, Object->GetLink()->Name());
-			printf("%s%s -> Dictionary Reference to %s %s\n", Prefix.c_str(), Object->Name().c_str(), TargetName.c_str(), Object->GetString().c_str());
+			const char *p = Text.data();
+			const char *End = p + Text.size();
+			const char *Run = p;
+			while(p != End)
+			{
+				unsigned char c = static_cast<unsigned char>(*p);
+				if(((c >= 0x20) || (c == '\t') || (c == '\n') || (c == '\r')) && (c != '&') && (c != '<') && (c != '>') && (c != '"'))
+				{
+					p++;
+					continue;
+				}
+
+				// Write everything up to this character in one go
+				Out.Write(Run, p - Run);
+
+				if(c == '&') Out.Write("&amp;");
+				else if(c == '<') Out.Write("&lt;");
+				else if(c == '>') Out.Write("&gt;");
+				else if(c == '"') Out.Write("&quot;");
+				// DRAGONS: Other control characters are not permitted in XML 1.0, even as character references
+				else Out.Put('?');
+
+				Run = ++p;
+			}
+			Out.Write(Run, p - Run);
 		}
-		else
+
+		//! Get the name of an object as a valid XML element name
+		const std::string &XMLName(const std::string &Name)
 		{
-			printf("%s%s -> Weak Reference to %s %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetLink()->Name().c_str(), Object->GetString().c_str());
+			std::map<std::string, std::string>::iterator it = NameCache.find(Name);
+			if(it != NameCache.end()) return (*it).second;
+
+			std::string Element = Name;
+
+			std::string::iterator c = Element.begin();
+			while(c != Element.end())
+			{
+				if(!(isalnum(static_cast<unsigned char>(*c)) || (*c == '_') || (*c == '-') || (*c == '.'))) *c = '_';
+				c++;
+			}
+
+			if(Element.empty() || !(isalpha(static_cast<unsigned char>(Element[0])) || (Element[0] == '_'))) Element = "_" + Element;
+
+			return NameCache.insert(std::map<std::string, std::string>::value_type(Name, Element)).first->second;
 		}
-	}
-	else
-	{
-		if(Object->IsDValue())
+
+		//! Write an attribute
+		void XMLAttribute(const char *Name, const std::string &Value)
 		{
-			printf("%s%s = <Unknown>\n", Prefix.c_str(), Object->Name().c_str());
+			Out.Put(' ');
+			Out.Write(Name);
+			Out.Write("=\"");
+			XMLText(Value);
+			Out.Put('"');
 		}
-		else
+
+		//! Dump an object as an XML element on its own line(s)
+		void XML(MDObjectPtr &Object, int Indent)
 		{
-			// Check first for values that are not reference batches
-			if(Object->IsAValue())
+			const std::string &Element = XMLName(Object->Name());
+
+			Out.StartLine(Indent);
+			Out.Put('<');
+			Out.Write(Element);
+
+			if(Options.DumpLocation) XMLAttribute("location", "0x" + Int64toHexString(Object->GetLocation(), 8));
+			if(Options.DumpModified && Object->IsModified()) Out.Write(" modified=\"true\"");
+
+			if(Object->GetLink())
 			{
-				if( Object->Value->GetData().Size > MAX_DUMPSIZE )
+				Out.Write(" ref=\"");
+				Out.Write(RefName(Object));
+				Out.Put('"');
+
+				if(!Object->EffectiveRefNested() || (Object->GetRefType() != ClassRefStrong)) XMLAttribute("value", Object->GetString());
+
+				if(FollowLink(Object))
 				{
-					if(sizeof(size_t) == 4)
-                        printf("%s%s = RAW[0x%08x]", Prefix.c_str(), Object->Name().c_str(), (int)Object->Value->GetData().Size );
-					else
-						printf("%s%s = RAW[0x%s]", Prefix.c_str(), Object->Name().c_str(), Int64toHexString(Object->Value->GetData().Size, 8).c_str() );
+					Out.Write(">\n");
 
-					const unsigned char* p = Object->Value->GetData().Data;
-					int i; for(i=0;i<3;i++)
-					{
-						printf("\n%s%*c      ", Prefix.c_str(), (int)strlen(Object->Name().c_str()), ' ');
-						int j; for(j=0;j<4;j++)
-						{
-							int k; for(k=0;k<4;k++) printf("%02x", *p++);
-							printf(" ");
-						}
-						if(i==2) printf( "...\n" );
-					}
+					MDObjectPtr Link = Object->GetLink();
+					XML(Link, Indent + 1);
+
+					XMLClose(Element, Indent);
+					return;
+				}
+
+				XMLAttribute("target", TargetName(Object));
+				Out.Write("/>\n");
+			}
+			else if(Object->IsDValue())
+			{
+				Out.Write(" unknown=\"true\"/>\n");
+			}
+			else if(Object->IsAValue())
+			{
+				if(Object->Value->GetData().Size > Options.MaxValueSize)
+				{
+					XMLAttribute("size", Int64toString(Object->Value->GetData().Size));
+					Out.Put('>');
+					WriteHexStart(Object, 12, " ");
+					Out.Write(" ...");
 				}
 				else
 				{
-					if( Object->Name().find("Unknown") == std::string::npos )
-						printf("%s%s = %s\n", Prefix.c_str(), Object->Name().c_str(), Object->GetString().c_str());
-					else
-						printf("%s%s\n", Prefix.c_str(), Object->Name().c_str());
+					if((Object->GetRefType() == ClassRefMeta) || (Object->GetRefType() == ClassRefDict))
+					{
+						Out.Write(" ref=\"");
+						Out.Write(RefName(Object));
+						Out.Write("\" unsatisfied=\"true\"");
+					}
 
-					if( Object->GetRefType() == ClassRefMeta )
-						printf("%s%s is an unsatisfied MetaRef\n", Prefix.c_str(), Object->Name().c_str());
-					else if( Object->GetRefType() == ClassRefDict )
-						printf("%s%s is an unsatisfied DictRef\n", Prefix.c_str(), Object->Name().c_str());
+					Out.Put('>');
+					XMLText(Object->GetString());
 				}
+
+				Out.Write("</");
+				Out.Write(Element);
+				Out.Write(">\n");
 			}
 			else
 			{
-				printf("%s%s\n", Prefix.c_str(), Object->Name().c_str());
+				MDObjectList Children;
+				GetChildren(Object, Children);
 
-				MDObjectULList::iterator it = Object->begin();
-
-				if(!SortedDump)
+				if(Children.empty())
 				{
-					/* Dump Objects in the order stored */
-					while(it != Object->end())
-					{
-						DumpObject((*it).second, Prefix + "  ");
-						it++;
-					}
+					Out.Write("/>\n");
+					return;
 				}
-				else
-				{
-					/* Dump Objects in alphabetical order - to allow easier file comparisons */
-					std::multimap<std::string, MDObjectPtr> ChildMap;
-					std::multimap<std::string, MDObjectPtr>::iterator CM_Iter;
 
-					while(it != Object->end())
-					{
-						ChildMap.insert(std::multimap<std::string, MDObjectPtr>::value_type((*it).second->Name(), (*it).second));
-						it++;
-					}
+				Out.Write(">\n");
 
-					CM_Iter = ChildMap.begin();
-					while(CM_Iter != ChildMap.end())
-					{
-						DumpObject((*CM_Iter).second, Prefix + "  ");
-						CM_Iter++;
-					}
+				EnterChildren(Object);
+
+				MDObjectList::iterator it = Children.begin();
+				while(it != Children.end())
+				{
+					XML(*it, Indent + 1);
+					it++;
 				}
+
+				LeaveChildren();
+
+				XMLClose(Element, Indent);
 			}
 		}
-	}
 
-	return;
+		//! Write a closing tag on its own line
+		void XMLClose(const std::string &Element, int Indent)
+		{
+			Out.StartLine(Indent);
+			Out.Write("</");
+			Out.Write(Element);
+			Out.Write(">\n");
+		}
+	};
+}
+
+
+namespace mxflib {
+
+//! Dump an MDObject, and any physical or logical children, to a DumpOutput
+void DumpObject( MDObjectPtr Object, DumpOutput &Out, const DumpOptions &Options /*=DumpOptions()*/, int Indent /*=0*/ )
+{
+	ObjectDumper Dumper(Out, Options);
+	Dumper.Dump(Object, Indent);
 }
 
 } // namespace mxflib
@@ -57,6 +57,118 @@ namespace mxflib {
 	//! Dump an MDObject
 	void DumpObject( MDObjectPtr Object, std::string PrefixString, bool bare = false );
 
+
+	//! Output formats for dumping objects to a DumpOutput
+	enum DumpFormat
+	{
+		DumpFormatText,			//!< Indented text, as written by DumpObject( MDObjectPtr, std::string, bool )
+		DumpFormatJSON,			//!< A JSON object per MDObject, with children in a "children" array
+		DumpFormatXML			//!< An XML element per MDObject, named after the object
+	};
+
+	//! Options for dumping objects to a DumpOutput
+	struct DumpOptions
+	{
+		DumpFormat Format;		//!< The output format
+		bool DumpLocation;		//!< Include the location of each object
+		bool FollowGlobals;		//!< Dump the targets of global references
+		bool DumpModified;		//!< Note objects that have been modified
+		bool SortedDump;		//!< Dump children in alphabetical order, to allow easier file comparisons
+		size_t MaxValueSize;	//!< Values larger than this are shown by their size and first few bytes
+
+		DumpOptions(DumpFormat Format = DumpFormatText)
+			: Format(Format), DumpLocation(false), FollowGlobals(true), DumpModified(false), SortedDump(false), MaxValueSize(128) {}
+	};
+
+	//! Buffered destination for dumped objects
+	/*! Output is collected in a fixed buffer and passed to Output() in large blocks.
+	 *  Derived classes must call Flush() in their destructors.
+	 */
+	class DumpOutput
+	{
+	protected:
+		std::string Prefix;				//!< Text written at the start of each line, before any indentation
+		char Buffer[16384];				//!< Output not yet passed to Output()
+		size_t Used;					//!< Number of bytes in Buffer
+
+	public:
+		DumpOutput() : Used(0) {}
+
+		virtual ~DumpOutput() {}
+
+		//! Set text to be written at the start of each line
+		void SetPrefix(const std::string &Text) { Prefix = Text; }
+
+		//! Write some text
+		void Write(const char *Text, size_t Size);
+
+		//! Write some text
+		void Write(const char *Text) { Write(Text, strlen(Text)); }
+
+		//! Write some text
+		void Write(const std::string &Text) { Write(Text.data(), Text.size()); }
+
+		//! Write a single character
+		void Put(char c)
+		{
+			if(Used == sizeof(Buffer)) Flush();
+			Buffer[Used++] = c;
+		}
+
+		//! Start a new line, writing the prefix and two spaces for each level of indentation
+		void StartLine(int Indent);
+
+		//! Pass all buffered output on
+		void Flush(void)
+		{
+			if(Used) Output(Buffer, Used);
+			Used = 0;
+		}
+
+	protected:
+		//! Send a block of output to its destination
+		virtual void Output(const char *Data, size_t Size) = 0;
+	};
+
+	//! DumpOutput that writes to a stdio file
+	class DumpFileOutput : public DumpOutput
+	{
+	protected:
+		FILE *File;						//!< The file to write to
+
+	public:
+		DumpFileOutput(FILE *File) : File(File) {}
+
+		~DumpFileOutput() { Flush(); }
+
+	protected:
+		virtual void Output(const char *Data, size_t Size) { fwrite(Data, 1, Size, File); }
+	};
+
+	//! DumpOutput that appends to a string
+	class DumpStringOutput : public DumpOutput
+	{
+	protected:
+		std::string &Dest;				//!< The string to append to
+
+	public:
+		DumpStringOutput(std::string &Dest) : Dest(Dest) {}
+
+		~DumpStringOutput() { Flush(); }
+
+	protected:
+		virtual void Output(const char *Data, size_t Size) { Dest.append(Data, Size); }
+	};
+
+	//! Write a string to a DumpOutput as a quoted JSON string, escaping as required
+	void WriteJSONString(DumpOutput &Out, const std::string &Text);
+
+	//! Dump an MDObject, and any physical or logical children, to a DumpOutput
+	/*! \param Indent The level of indentation for the object, as used by DumpOutput::StartLine()
+	 *  \note Output is left in the DumpOutput's buffer until it is flushed or destroyed
+	 */
+	void DumpObject( MDObjectPtr Object, DumpOutput &Out, const DumpOptions &Options = DumpOptions(), int Indent = 0 );
+
 } // namespace mxflib
 
 #endif // _dumpobject_h_
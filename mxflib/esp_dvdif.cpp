@@ -688,6 +688,9 @@ DataChunkPtr DV_DIF_EssenceSubParser::Read(FileHandle InFile, UInt32 Stream, UIn
 	// If this is not an AVI file read the data and return
 	if(DIFEnd != -1)
 	{
+		// Take the data from the read-ahead buffer if streaming
+		if(UseStreaming()) return StreamRead(InFile, Bytes);
+
 		// Read the data
 		return FileReadChunk(InFile, Bytes);
 	}
@@ -795,13 +798,32 @@ DataChunkPtr DV_DIF_EssenceSubParser::AVIRead(FileHandle InFile, size_t Bytes)
  */
 Length DV_DIF_EssenceSubParser::Write(FileHandle InFile, UInt32 Stream, MXFFilePtr OutFile, UInt64 Count /*=1*/)
 {
-	const unsigned int BUFFERSIZE = 32768;
-	UInt8 *Buffer = new UInt8[BUFFERSIZE];
-
 	// Scan the stream and find out how many bytes to transfer
 	size_t Bytes = ReadInternal(InFile, Stream, Count);
 	Length Ret = static_cast<Length>(Bytes);
 
+	// Clear the data size so that the next read scans again
+	CachedDataSize = static_cast<size_t>(-1);
+
+	// Transfer via the read-ahead buffer if streaming, so that it stays in step with the file
+	if(UseStreaming())
+	{
+		while(Bytes)
+		{
+			DataChunkPtr Data = StreamRead(InFile, (Bytes < StreamBufferSize) ? Bytes : StreamBufferSize);
+			if((!Data) || (Data->Size == 0)) break;
+
+			OutFile->Write(Data->Data, Data->Size);
+
+			Bytes -= Data->Size;
+		}
+
+		return Ret;
+	}
+
+	const unsigned int BUFFERSIZE = 32768;
+	UInt8 *Buffer = new UInt8[BUFFERSIZE];
+
 	while(Bytes)
 	{
 		size_t ChunkSize;
@@ -1325,7 +1347,15 @@ size_t DV_DIF_EssenceSubParser::ReadInternal(FileHandle InFile, UInt32 Stream, U
 	if((CachedDataSize != static_cast<size_t>(-1)) && CachedCount == Count) return CachedDataSize;
 
 	// Seek to the start of the essence on the first read
-	if(PictureNumber == 0) FileSeek(InFile, DIFStart);
+	if(PictureNumber == 0)
+	{
+		FileSeek(InFile, DIFStart);
+
+		// Discard anything read-ahead from a previous pass
+		StreamData = NULL;
+		StreamOffset = 0;
+		StreamPos = DIFStart;
+	}
 
 	// Return anything remaining if clip wrapping
 	if((Count == 0) && (SelectedWrapping->ThisWrapType == WrappingOption::Clip))
@@ -1350,11 +1380,15 @@ size_t DV_DIF_EssenceSubParser::ReadInternal(FileHandle InFile, UInt32 Stream, U
 		PictureNumber += Count;
 
 		// If this would read beyond the end of the file stop at the end (don't test on AVI files)
-		if((DIFEnd != -1) && ((Ret + static_cast<Position>(FileTell(InFile))) > DIFEnd))
+		// DRAGONS: When streaming the file pointer is beyond the data read-ahead, so use our own record of the position
+		Position Here = 0;
+		if(DIFEnd != -1) Here = UseStreaming() ? StreamPos : static_cast<Position>(FileTell(InFile));
+
+		if((DIFEnd != -1) && ((Ret + Here) > DIFEnd))
 		{
 			Position SeqSize = (150 * 80 * SeqCount);
 
-			Ret = DIFEnd - static_cast<Position>(FileTell(InFile));
+			Ret = DIFEnd - Here;
 
 			// Fix for an incomplete frame at the end of the previous read
 			if(Ret < 0) Ret = 0;
@@ -1389,6 +1423,17 @@ size_t DV_DIF_EssenceSubParser::ReadInternal(FileHandle InFile, UInt32 Stream, U
 /*! \return true if the option was successfully set */
 bool DV_DIF_EssenceSubParser::SetOption(std::string Option, Int64 Param /*=0*/ )
 {
+	if(Option == "StreamBuffer")
+	{
+		// {StreamBuffer=0} reads each edit unit directly from the file (but we can't change mode part way through)
+		if(PictureNumber != 0) return false;
+
+		if(Param < 0) return false;
+		StreamBufferSize = static_cast<size_t>(Param);
+
+		return true;
+	}
+
 		warning("DV_DIF_EssenceSubParser::SetOption(\"%s\", Param) not a known option\n", Option.c_str());
 
 	return false;
@@ -1396,6 +1441,91 @@ bool DV_DIF_EssenceSubParser::SetOption(std::string Option, Int64 Param /*=0*/ )
 
 
 
+//! Get the next bytes of the essence stream from the read-ahead buffer, refilling it as required
+/*! Edit units are normally returned as views of the buffer, so a whole buffer of edit units costs a single file read.
+ *  \return The data read, which will be shorter than Bytes if the end of the file is reached
+ */
+DataChunkPtr DV_DIF_EssenceSubParser::StreamRead(FileHandle InFile, size_t Bytes)
+{
+	if(Bytes == 0) return new DataChunk;
+
+	size_t Buffered = StreamData ? (StreamData->Size - StreamOffset) : 0;
+
+	if(Bytes > Buffered)
+	{
+		// Read a whole number of edit units at a time so that edit units don't normally span buffers
+		size_t EditUnitSize = 150 * 80 * SeqCount;
+		size_t FillSize = (StreamBufferSize / EditUnitSize) * EditUnitSize;
+		if(FillSize < EditUnitSize) FillSize = EditUnitSize;
+
+		// Reading lots of edit units in one go may need a larger buffer than normal
+		if(FillSize < Bytes) FillSize = Bytes;
+
+		// Don't read beyond the end of the essence
+		Position FilePos = StreamPos + Buffered;
+		if((FilePos + static_cast<Position>(FillSize - Buffered)) > DIFEnd)
+		{
+			if(FilePos >= DIFEnd) FillSize = Buffered;
+			else FillSize = Buffered + static_cast<size_t>(DIFEnd - FilePos);
+		}
+
+		DataChunkPtr NewData = new DataChunk(FillSize);
+
+		// Carry over any part edit unit from the old buffer
+		// DRAGONS: The old buffer will stay allocated until all views of it have been released
+		if(Buffered) memcpy(NewData->Data, &StreamData->Data[StreamOffset], Buffered);
+
+		size_t Got = 0;
+		if(FillSize > Buffered)
+		{
+			Got = FileRead(InFile, &NewData->Data[Buffered], FillSize - Buffered);
+			if(Got == static_cast<size_t>(-1)) Got = 0;
+		}
+		NewData->Resize(Buffered + Got);
+
+		StreamData = NewData;
+		StreamOffset = 0;
+		Buffered = StreamData->Size;
+
+		// Return what we can if the file ends early
+		if(Bytes > Buffered) Bytes = Buffered;
+	}
+
+	DataChunkPtr Ret;
+
+	// If all the buffer is being returned hand it over, otherwise return a view of the required part
+	if((StreamOffset == 0) && (Bytes == StreamData->Size))
+	{
+		Ret = StreamData;
+		StreamData = NULL;
+	}
+	else
+	{
+		Ret = new DataChunkView(StreamData, StreamOffset, Bytes);
+		StreamOffset += Bytes;
+	}
+
+	StreamPos += Bytes;
+
+	return Ret;
+}
+
+
+//! Get the number of edit units to read per call when clip wrapping, limited to fit in MaxSize (if MaxSize > 0)
+/*! \return 1 unless clip wrapping a stream through the read-ahead buffer */
+UInt64 DV_DIF_EssenceSubParser::GetClipReadCount(size_t MaxSize)
+{
+	if((SelectedWrapping->ThisWrapType != WrappingOption::Clip) || !UseStreaming()) return 1;
+
+	size_t EditUnitSize = 150 * 80 * SeqCount;
+
+	size_t Ret = StreamBufferSize / EditUnitSize;
+	if(MaxSize && (Ret > (MaxSize / EditUnitSize))) Ret = MaxSize / EditUnitSize;
+
+	return Ret ? Ret : 1;
+}
+
+
 //! Build a new parser of this type and return a pointer to it
 EssenceSubParserPtr DV_DIF_EssenceSubParser::NewParser(void) const
 {
@@ -33,6 +33,9 @@
 
 #define DV_DIF_BUFFERSIZE  (256 * 1024)
 
+// Default size of the read-ahead buffer used when streaming raw DIF files, rounded down to a whole number of edit units when used
+#define DV_DIF_STREAMBUFFERSIZE  (4 * 1024 * 1024)
+
 namespace mxflib
 {
 	//! Class that handles parsing of DV-DIf streams
@@ -73,6 +76,12 @@ namespace mxflib
 		int BuffCount;										//!< Count of bytes still unread in Buffer
 		UInt8 *BuffPtr;										//!< Pointer to next byte to read from Buffer
 
+		// Streaming
+		size_t StreamBufferSize;							//!< Size of the read-ahead buffer for streaming raw DIF files, or zero to read each edit unit directly
+		DataChunkPtr StreamData;							//!< Read-ahead buffer holding the next essence data, edit units are returned as views of this buffer
+		size_t StreamOffset;								//!< Offset in StreamData of the next byte to return
+		Position StreamPos;									//!< File position of the next byte to return (the file pointer is at the end of StreamData)
+
 		MDObjectParent CurrentDescriptor;					//!< Pointer to the last essence descriptor we built
 															/*!< This is used as a quick-and-dirty check that we know how to process this source */
 
@@ -119,7 +128,41 @@ namespace mxflib
 				}
 			 */
 
-				return BaseGetEssenceData(Size, MaxSize);
+				// When clip wrapping a buffered stream, return as many whole edit units as we can in one go
+				DV_DIF_EssenceSubParser *pCaller = SmartPtr_Cast(Caller, DV_DIF_EssenceSubParser);
+				UInt64 Count = pCaller->GetClipReadCount(MaxSize);
+				if(RemainingData || (Count <= 1)) return BaseGetEssenceData(Size, MaxSize);
+
+				Started = true;
+
+				DataChunkPtr Data = Caller->Read(File, Stream, Count);
+				if(Data && (Data->Size == 0)) Data = NULL;
+
+				// Record when we hit the end of all data
+				if(!Data) AtEndOfData = true;
+
+				return Data;
+			}
+
+			//! Get the next Count wrapping units of essence data, read from the file in a single operation
+			virtual DataChunkVector GetEssenceDataBatch(size_t Count)
+			{
+				DV_DIF_EssenceSubParser *pCaller = SmartPtr_Cast(Caller, DV_DIF_EssenceSubParser);
+
+				// Only whole edit units from raw DIF files are batched, finish any part-read item and leave clip-wrapping and AVI files to the normal route
+				if(RemainingData || (RequestedCount == 0) || (pCaller->DIFEnd == -1)) return EssenceSource::GetEssenceDataBatch(Count);
+
+				Started = true;
+
+				// Every edit unit is the same size, so we can read them all as one larger item
+				DataChunkPtr Buffer = Caller->Read(File, Stream, Count * RequestedCount);
+				if(Buffer && (Buffer->Size == 0)) Buffer = NULL;
+
+				// Record when we hit the end of all data
+				if(!Buffer) AtEndOfData = true;
+
+				std::vector<size_t> Sizes(Count, static_cast<size_t>(RequestedCount * 150 * 80 * pCaller->SeqCount));
+				return SplitBatch(Buffer, Sizes);
 			}
 
 			//! Get the preferred BER length size for essence KLVs written from this source, 0 for auto
@@ -145,6 +188,10 @@ namespace mxflib
 			StreamNumber = 0;
 			Buffer = NULL;
 
+			StreamBufferSize = DV_DIF_STREAMBUFFERSIZE;
+			StreamOffset = 0;
+			StreamPos = 0;
+
 			CachedDataSize = static_cast<size_t>(-1);
 			CachedCount = 0;
 
@@ -259,6 +306,17 @@ namespace mxflib
 		//! Read data from AVI wrapped essence
 		/*! Parses the list and chunk structure - can recurse */
 		DataChunkPtr AVIRead(FileHandle InFile, size_t Bytes);
+
+		//! Are we streaming the essence through the read-ahead buffer?
+		/*! Only raw DIF files are streamed, AVI files are read chunk by chunk */
+		bool UseStreaming(void) const { return (StreamBufferSize > 0) && (DIFEnd != -1); }
+
+		//! Get the next bytes of the essence stream from the read-ahead buffer, refilling it as required
+		DataChunkPtr StreamRead(FileHandle InFile, size_t Bytes);
+
+		//! Get the number of edit units to read per call when clip wrapping, limited to fit in MaxSize (if MaxSize > 0)
+		/*! \return 1 unless clip wrapping a stream through the read-ahead buffer */
+		UInt64 GetClipReadCount(size_t MaxSize);
 	};
 
 
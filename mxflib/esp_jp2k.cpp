@@ -332,6 +332,60 @@ DataChunkPtr mxflib::JP2K_EssenceSubParser::Read(FileHandle InFile, UInt32 Strea
 }
 
 
+//! Read a batch of wrapping items from the specified stream into a single buffer
+/*! Each item is Count edit units, as for Read(). The codestreams are scanned first to find the size of
+ *  each item, then all items are read with a single file read.
+ *	\param Sizes Receives the size of each item held in the returned buffer
+ *	\return Buffer holding the items, or NULL if there is no data left
+ */
+DataChunkPtr mxflib::JP2K_EssenceSubParser::ReadBatch(FileHandle InFile, UInt32 Stream, UInt64 Count, size_t Items, std::vector<size_t> &Sizes)
+{
+	// Return value
+	DataChunkPtr Ret;
+
+	// Move to the current position
+	if(CurrentPos == 0) CurrentPos = DataStart;
+
+	Position Start = CurrentPos;
+	size_t Total = 0;
+
+	// Scan for the size of each item in turn
+	while(Sizes.size() < Items)
+	{
+		size_t Bytes = ReadInternal(InFile, Stream, (Length)Count);
+
+		// Clear the cached size so the next scan starts afresh
+		CachedDataSize = static_cast<size_t>(-1);
+
+		if(!Bytes) break;
+
+		Sizes.push_back(Bytes);
+		Total += Bytes;
+
+		// Move on so that the next scan starts at the following item
+		CurrentPos += Bytes;
+	}
+
+	// If there is no data left return a NULL pointer as a signal
+	if(!Total) return Ret;
+
+	// Read all the data in one go
+	Ret = new DataChunk(Total);
+
+	FileSeek(InFile, Start);
+	size_t BytesRead = (size_t)FileRead(InFile, Ret->Data, Total);
+	if(BytesRead < Total) Ret->Resize(BytesRead);
+
+	// Update the file pointer
+	CurrentPos = Start + BytesRead;
+
+	// Update the picture number
+	PictureNumber += Sizes.size();
+
+	return Ret;
+}
+
+
 //! Write a number of wrapping items from the specified stream to an MXF file
 /*! If frame or line mapping is used the parameter Count is used to
  *	determine how many items are read. In frame wrapping it is in
@@ -90,6 +90,25 @@ namespace mxflib
 				return BaseGetEssenceData(Size, MaxSize);
 			}
 
+			//! Get the next Count wrapping units of essence data, read from the file in a single operation
+			virtual DataChunkVector GetEssenceDataBatch(size_t Count)
+			{
+				JP2K_EssenceSubParser *pCaller = SmartPtr_Cast(Caller, JP2K_EssenceSubParser);
+
+				// Only whole edit units are batched, so finish any part-read item and leave clip-wrapping to the normal route
+				if(RemainingData || (pCaller->SelectedWrapping->ThisWrapType == WrappingOption::Clip)) return EssenceSource::GetEssenceDataBatch(Count);
+
+				Started = true;
+
+				std::vector<size_t> Sizes;
+				DataChunkPtr Buffer = pCaller->ReadBatch(File, Stream, RequestedCount, Count, Sizes);
+
+				// Record when we hit the end of all data
+				if(!Buffer) AtEndOfData = true;
+
+				return SplitBatch(Buffer, Sizes);
+			}
+
 			//! Get the preferred BER length size for essence KLVs written from this source, 0 for auto
 			virtual int GetBERSize(void) 
 			{ 
@@ -237,6 +256,9 @@ namespace mxflib
 		//! Scan the essence to calculate how many bytes to transfer for the given edit unit count
 		size_t ReadInternal(FileHandle InFile, UInt32 Stream, Length Count);
 
+		//! Read a batch of wrapping items from the specified stream into a single buffer
+		DataChunkPtr ReadBatch(FileHandle InFile, UInt32 Stream, UInt64 Count, size_t Items, std::vector<size_t> &Sizes);
+
 		//! Parse a JP2 header at the start of the specified file into items in the Header multimap
 		bool ParseJP2Header(FileHandle InFile);
 
@@ -39,6 +39,67 @@ namespace
 {
 	//! Modified UUID for MPEG2-VES
 	const UInt8 MPEG2_VES_Format[] = { 0x45, 0x54, 0x57, 0x62,  0xd6, 0xb4, 0x2e, 0x4e,  0xf3, 0xd2, 'M', 'P',  'E', 'G', '2', 'V' };
+
+	//! Accumulator for the GOP structure statistics gathered by MPEG2_VES_EssenceSubParser::PreScan()
+	class GOPStats
+	{
+	public:
+		std::string FirstGOP;					//!< Picture types of the first GOP, one character per picture
+		std::string ThisGOP;					//!< Picture types of the current GOP so far
+		bool Identical;							//!< True while all GOPs have matched the first
+		bool ShortGOP;							//!< True if a GOP has been shorter than the first (only allowed for the last GOP)
+		int Largest;							//!< Picture count of the largest GOP so far
+		int BRun;								//!< Number of B pictures since the last anchor picture
+		int MaxB;								//!< Largest number of consecutive B pictures so far
+		int BCount;								//!< Number of B pictures between the first two anchor pictures, or -1 if not yet known
+		bool ConstantB;							//!< True while the number of B pictures between anchor pictures has been constant
+		bool SeenAnchor;						//!< True once an anchor picture has been found
+
+		GOPStats() : Identical(true), ShortGOP(false), Largest(0), BRun(0), MaxB(0), BCount(-1), ConstantB(true), SeenAnchor(false) {}
+
+		//! Add a picture of the given picture_coding_type to the current GOP
+		void AddPicture(int PictureType)
+		{
+			if(PictureType == 3)
+			{
+				ThisGOP += 'B';
+				if(++BRun > MaxB) MaxB = BRun;
+				return;
+			}
+
+			ThisGOP += (PictureType == 2) ? 'P' : 'I';
+
+			// Check the run of B pictures since the last anchor picture
+			if(SeenAnchor)
+			{
+				if(BCount == -1) BCount = BRun;
+				else if(BRun != BCount) ConstantB = false;
+			}
+
+			SeenAnchor = true;
+			BRun = 0;
+		}
+
+		//! End the current GOP
+		void EndGOP(void)
+		{
+			if(ThisGOP.empty()) return;
+
+			// Only the last GOP may be short
+			if(ShortGOP) Identical = false;
+
+			if(static_cast<int>(ThisGOP.size()) > Largest) Largest = static_cast<int>(ThisGOP.size());
+
+			if(FirstGOP.empty()) FirstGOP = ThisGOP;
+			else if(ThisGOP != FirstGOP)
+			{
+				if((ThisGOP.size() < FirstGOP.size()) && (FirstGOP.compare(0, ThisGOP.size(), ThisGOP) == 0)) ShortGOP = true;
+				else Identical = false;
+			}
+
+			ThisGOP.clear();
+		}
+	};
 }
 
 
@@ -111,6 +172,10 @@ EssenceStreamDescriptorList MPEG2_VES_EssenceSubParser::IdentifyEssence(FileHand
 		}
 	}
 
+	// Scan the whole stream first if requested, so that the descriptor and index tables hold the real GOP structure
+	PictureTable.clear();
+	if(Feature(FeatureMPEGPreScan)) PreScan(InFile);
+
 	MDObjectPtr DescObj = BuildMPEG2VideoDescriptor(InFile, StartPos);
 
 	// Quit here if we couldn't build an essence descriptor
@@ -325,6 +390,24 @@ DataChunkPtr MPEG2_VES_EssenceSubParser::ESP_EssenceSource::GetEssenceData(size_
 }
 
 
+//! Get the next Count wrapping units of essence data, read from the file in a single operation
+DataChunkVector MPEG2_VES_EssenceSubParser::ESP_EssenceSource::GetEssenceDataBatch(size_t Count)
+{
+	MPEG2_VES_EssenceSubParser *pCaller = SmartPtr_Cast(Caller, MPEG2_VES_EssenceSubParser);
+
+	// Only whole edit units are batched, so finish any part-read item and leave clip-wrapping to the normal route
+	if(BytesRemaining || (pCaller->SelectedWrapping->ThisWrapType == WrappingOption::Clip)) return EssenceSource::GetEssenceDataBatch(Count);
+
+	std::vector<size_t> Sizes;
+	DataChunkPtr Buffer = pCaller->ReadBatch(File, Stream, RequestedCount, Count, Sizes);
+
+	// Flag all done when no more to read
+	if(!Buffer) AtEndOfData = true;
+
+	return SplitBatch(Buffer, Sizes);
+}
+
+
 //! Read a number of wrapping items from the specified stream and return them in a data chunk
 /*! If frame or line mapping is used the parameter Count is used to
  *	determine how many items are read. In frame wrapping it is in
@@ -347,6 +430,53 @@ DataChunkPtr MPEG2_VES_EssenceSubParser::Read(FileHandle InFile, UInt32 Stream,
 };
 
 
+//! Read a batch of wrapping items from the specified stream into a single buffer
+/*! Each item is Count edit units, as for Read(). The stream is scanned first to find the size of
+ *  each item, then all items are read with a single file read.
+ *	\param Sizes Receives the size of each item held in the returned buffer
+ *	\return Buffer holding the items, or NULL if there is no data left
+ *	\note As the whole batch is scanned before any data is returned, index table entries are offered
+ *		  and IsEditPoint() is updated for the last item in the batch rather than the first
+ */
+DataChunkPtr MPEG2_VES_EssenceSubParser::ReadBatch(FileHandle InFile, UInt32 Stream, UInt64 Count, size_t Items, std::vector<size_t> &Sizes)
+{
+	// Return value
+	DataChunkPtr Ret;
+
+	Position Start = 0;
+	size_t Total = 0;
+
+	// Scan for the size of each item in turn
+	while(Sizes.size() < Items)
+	{
+		// Either use the cached value, or scan the stream and find out how many bytes to read
+		if((CachedDataSize == static_cast<size_t>(-1)) || (CachedCount != Count)) ReadInternal(InFile, Stream, Count);
+
+		size_t Bytes = CachedDataSize;
+
+		// Clear the cached size so the next scan starts afresh
+		CachedDataSize = static_cast<size_t>(-1);
+
+		if(!Bytes) break;
+
+		// DRAGONS: CurrentPos has already moved on to the start of the next item
+		if(Sizes.empty()) Start = CurrentPos - Bytes;
+
+		Sizes.push_back(Bytes);
+		Total += Bytes;
+	}
+
+	// If there is no data left return a NULL pointer as a signal
+	if(!Total) return Ret;
+
+	// Read all the data in one go
+	FileSeek(InFile, Start);
+	Ret = FileReadChunk(InFile, Total);
+
+	return Ret;
+}
+
+
 //! Write a number of wrapping items from the specified stream to an MXF file
 /*! If frame or line mapping is used the parameter Count is used to
  *	determine how many items are read. In frame wrapping it is in
@@ -661,8 +791,19 @@ printf("Chroma vertical sub-sampling = %d\n", VChromaSub);
 
 	Ret->SetUInt(ProfileAndLevel_UL, PandL);
 
+	// Use the real GOP structure if the stream has been pre-scanned
+	if(!PictureTable.empty())
+	{
+		Ret->SetUInt(ClosedGOP_UL, AllGOPsClosed ? 1 : 0);
+		Ret->SetUInt(IdenticalGOP_UL, AllGOPsIdentical ? 1 : 0);
+		Ret->SetUInt(MaxGOP_UL, LargestGOP);
+
+		Ret->SetUInt(BPictureCount_UL, MaxConsecutiveB);
+		Ret->SetUInt(ConstantBFrames_UL, ConstantB ? 1 : 0);
+		Ret->SetUInt(SingleSequence_UL, OneSequence ? 1 : 0);
+	}
 	// AS-10
-	if( Feature(FeatureFullDescriptors) )
+	else if( Feature(FeatureFullDescriptors) )
 	{
 		Ret->SetUInt(ClosedGOP_UL, 0);			// TODO from IBP Descriptor, check while parsing
 		Ret->SetUInt(IdenticalGOP_UL, 1);		// TODO from IBP Descriptor, check while parsing
@@ -676,11 +817,14 @@ printf("Chroma vertical sub-sampling = %d\n", VChromaSub);
 #if defined(AS_CNN)
 	// AS-CNN only - default values
 	//! DRAGONS: should be evaluated while wrapping and set when rewriting Header
-	Ret->SetUInt(ClosedGOP_UL, 1);				// from IBP Descriptor, check while parsing
-	Ret->SetUInt(IdenticalGOP_UL, 1);			// from IBP Descriptor, check while parsing
-	Ret->SetUInt(MaxGOP_UL,	15);				// from IBP Descriptor, check while parsing
+	if(PictureTable.empty())
+	{
+		Ret->SetUInt(ClosedGOP_UL, 1);				// from IBP Descriptor, check while parsing
+		Ret->SetUInt(IdenticalGOP_UL, 1);			// from IBP Descriptor, check while parsing
+		Ret->SetUInt(MaxGOP_UL,	15);				// from IBP Descriptor, check while parsing
 
-	Ret->SetUInt(BPictureCount_UL, 2);			// evaluate while parsing
+		Ret->SetUInt(BPictureCount_UL, 2);			// evaluate while parsing
+	}
 #endif
 
 	const UInt8 PandL_MP_ML		= 0x48;
@@ -767,6 +911,207 @@ printf("Chroma vertical sub-sampling = %d\n", VChromaSub);
 }
 
 
+//! Scan the whole stream to find the GOP structure and the size and index details of every picture
+/*! The same rules as ReadInternal() are used to decide where each picture starts, but the file is read in large
+ *  blocks which are searched for start codes rather than being stepped through a byte at a time. Once the table
+ *  is built ReadInternal() takes the picture sizes and index details from it rather than parsing while wrapping.
+ *	\return false if no pictures were found
+ */
+bool MPEG2_VES_EssenceSubParser::PreScan(FileHandle InFile)
+{
+	// Size of each block read from the file
+	const size_t ScanBlockSize = 1024 * 1024;
+
+	// Number of bytes from the start of a start code that we may need to examine
+	const size_t Lookahead = 8;
+
+	PictureTable.clear();
+
+	DataChunk Block(ScanBlockSize);
+	Position BlockStart = 0;				//!< File position of the start of Block
+	size_t Bytes = 0;						//!< Number of valid bytes in Block
+	bool AtEOF = false;						//!< True once Block holds the end of the file
+
+	// Parsing state, following ReadInternal()
+	Position UnitStart = 0;
+	bool FoundStart = false;
+	bool SeqHead = false;
+	bool Closed = false;
+	int GOPPos = 0;
+	Position Anchor = 0;
+	int Place = GOP_unknown;
+
+	// GOP structure
+	GOPStats Stats;
+	bool SeenGOPHeader = false;
+	bool AllClosed = true;
+	bool SequenceEnded = false;
+	bool Single = true;
+
+	// File position at which to continue searching for a start code
+	Position Next = 0;
+
+	for(;;)
+	{
+		// Read a new block if we are too close to the end of this one to see a whole start code and the bytes following it
+		if((!AtEOF) && ((Next + static_cast<Position>(Lookahead)) > (BlockStart + static_cast<Position>(Bytes))))
+		{
+			BlockStart = Next;
+			FileSeek(InFile, BlockStart);
+			Bytes = static_cast<size_t>(FileRead(InFile, Block.Data, ScanBlockSize));
+			AtEOF = (Bytes < ScanBlockSize);
+		}
+
+		size_t Offset = static_cast<size_t>(Next - BlockStart);
+		if((Offset + 3) > Bytes) break;
+
+		// Search for the 0x01 of the next 0x000001 start code prefix
+		size_t SearchEnd = AtEOF ? Bytes : (Bytes - Lookahead + 3);
+		UInt8 *p = &Block.Data[Offset + 2];
+		UInt8 *End = &Block.Data[SearchEnd];
+		UInt8 *Found = NULL;
+		while(p < End)
+		{
+			p = static_cast<UInt8*>(memchr(p, 0x01, End - p));
+			if(!p) break;
+
+			if((p[-1] == 0) && (p[-2] == 0))
+			{
+				Found = p;
+				break;
+			}
+			p++;
+		}
+
+		if(!Found)
+		{
+			if(AtEOF) break;
+
+			// Continue from the last two bytes searched, as they may be the start of a prefix
+			Next = BlockStart + static_cast<Position>(SearchEnd - 2);
+			continue;
+		}
+
+		// Number of bytes available from the start code value onwards
+		size_t Avail = Bytes - static_cast<size_t>(&Found[1] - Block.Data);
+		if(Avail == 0) break;
+
+		Position CodePos = BlockStart + static_cast<Position>(&Found[-2] - Block.Data);
+		UInt8 Code = Found[1];
+
+		Next = CodePos + 4;
+
+		if(FoundStart)
+		{
+			// Note a sequence end code - it is only valid as the last item in the stream
+			if(Code == 0xb7) SequenceEnded = true;
+
+			// All signs of the start of the next picture
+			if((Code != 0xb3) && (Code != 0xb8) && (Code != 0x00)) continue;
+
+			// This start code begins the next picture
+			UnitStart = CodePos;
+			FoundStart = false;
+			SeqHead = false;
+		}
+
+		// Picture start code
+		if(Code == 0x00)
+		{
+			FoundStart = true;
+
+			if(SequenceEnded) Single = false;
+
+			int PictureData = (Avail >= 3) ? ((Found[2] << 8) | Found[3]) : 0;
+			Next += 2;
+
+			int TemporalReference = PictureData >> 6;
+			int PictureType = (PictureData >> 3) & 0x07;
+
+			// With no GOP headers we treat each I picture as the start of a GOP
+			if((!SeenGOPHeader) && (PictureType == 1)) Stats.EndGOP();
+			Stats.AddPicture(PictureType);
+
+			if( Place==GOP_start && PictureType==1 )		 Place = GOP_first_I;
+			else if( Place==GOP_first_I && PictureType==3 )  Place = GOP_consec_B;
+			else if( Place==GOP_first_I && PictureType==1 )  Place = GOP_second_I;
+			else if( Place==GOP_consec_B && PictureType!=3 ) Place = GOP_post_B;
+
+			Position ThisPicture = static_cast<Position>(PictureTable.size());
+
+			int Flags;
+			switch(PictureType)
+			{
+			case 1: default:
+				Anchor = ThisPicture;
+				Flags = 0x00;
+				break;
+			case 2:
+				Flags = 0x22;
+				break;
+			case 3: Flags = (Closed && Place==GOP_consec_B) ? 0x13 : 0x33; break;
+			}
+
+			if(SeqHead)
+			{
+				Flags |= 0x40;
+				if(Closed) Flags |= 0x80;
+			}
+
+			// DRAGONS: In MPEG all offsets are -ve, and are fixed at 127 with bit 3 of the flags set if out of range (as ReadInternal)
+			int AnchorOffset = (int)(Anchor - ThisPicture);
+			if(AnchorOffset < -128)
+			{
+				AnchorOffset = 127;
+				Flags |= 4;
+			}
+
+			PictureInfo Info;
+			Info.Offset = UnitStart;
+			Info.Flags = Flags;
+			Info.KeyOffset = AnchorOffset;
+			Info.TemporalDelta = GOPPos - TemporalReference;
+			PictureTable.push_back(Info);
+
+			GOPPos++;
+		}
+		// GOP start code
+		else if(Code == 0xb8)
+		{
+			SeenGOPHeader = true;
+			Stats.EndGOP();
+
+			GOPPos = 0;
+			Place = GOP_start;
+
+			Closed = (Avail >= 5) && (Found[5] & 0x40);
+			if(!Closed) AllClosed = false;
+
+			Next += 4;
+		}
+		// Sequence header start code
+		else if(Code == 0xb3)
+		{
+			SeqHead = true;
+		}
+	}
+
+	// End of the last picture is the end of the file
+	PictureTableEnd = BlockStart + static_cast<Position>(Bytes);
+
+	Stats.EndGOP();
+
+	AllGOPsClosed = AllClosed;
+	AllGOPsIdentical = Stats.Identical;
+	LargestGOP = Stats.Largest;
+	MaxConsecutiveB = Stats.MaxB;
+	ConstantB = Stats.ConstantB;
+	OneSequence = Single;
+
+	return !PictureTable.empty();
+}
+
+
 //! Scan the essence to calculate how many bytes to transfer for the given edit unit count
 /*! \note The file position pointer is moved to the start of the chunk at the end of
  *		  this function, but CurrentPos points to the start of the next edit unit
@@ -796,6 +1141,45 @@ size_t MPEG2_VES_EssenceSubParser::ReadInternal(FileHandle InFile, UInt32 Stream
 	// Apply any edit rate factor for integer multiples of native edit rate
 	Count *= EditRatio;
 
+	// If the stream has been pre-scanned we can take everything from the picture table
+	if(Count && !PictureTable.empty())
+	{
+		while(Count && (PictureNumber < static_cast<Position>(PictureTable.size())))
+		{
+			const PictureInfo &Info = PictureTable[static_cast<size_t>(PictureNumber)];
+
+			// Edit points are flagged in the index flags as the sequence header of a closed GOP
+			EditPoint = (Info.Flags & 0x80) ? true : false;
+
+			if(Manager)
+			{
+				// Offer this index table data to the index manager
+				Manager->OfferEditUnit(ManagedStreamID, PictureNumber, Info.KeyOffset, Info.Flags);
+				Manager->OfferTemporalOffset(PictureNumber - Info.TemporalDelta, Info.TemporalDelta);
+			}
+
+			Count--;
+			PictureNumber++;
+		}
+
+		if(PictureNumber < static_cast<Position>(PictureTable.size()))
+		{
+			CurrentPos = PictureTable[static_cast<size_t>(PictureNumber)].Offset;
+		}
+		else
+		{
+			CurrentPos = PictureTableEnd;
+			EndOfStream = true;
+		}
+
+		// Move to the start of the data
+		FileSeek(InFile, CurrentStart);
+
+		CachedDataSize = static_cast<size_t>(CurrentPos - CurrentStart);
+
+		return CachedDataSize;
+	}
+
 	// Return anything we can find if clip wrapping
 	//if(SelectedWrapping->ThisWrapType == WrappingOption::Clip) Count = UINT64_C(0xffffffffffffffff);
 
@@ -85,6 +85,26 @@ namespace mxflib
 
 		Position GOPStartTimecode;							//!< The most recently extracted GOP start timecode
 
+		//! Details of a single picture, as found by PreScan()
+		struct PictureInfo
+		{
+			Position Offset;								//!< Offset in the file of the start of this picture, including any preceding sequence or GOP headers
+			int Flags;										//!< Index table flags for this picture
+			int KeyOffset;									//!< Offset to the anchor frame for this picture (always <= 0)
+			int TemporalDelta;								//!< Stream position of this picture in the GOP less its temporal reference
+		};
+
+		std::vector<PictureInfo> PictureTable;				//!< Details of each picture in the stream, if it has been pre-scanned, else empty
+		Position PictureTableEnd;							//!< The offset of the end of the last picture in PictureTable
+
+		/* GOP structure found by PreScan() - only valid if PictureTable is not empty */
+		bool AllGOPsClosed;									//!< True if every GOP is flagged as closed
+		bool AllGOPsIdentical;								//!< True if every GOP has the same picture types in the same order (the last may be shorter)
+		int LargestGOP;										//!< The number of pictures in the largest GOP
+		int MaxConsecutiveB;								//!< The largest number of consecutive B pictures
+		bool ConstantB;										//!< True if the number of B pictures between anchor pictures is always the same
+		bool OneSequence;									//!< True if there is no sequence end code before the end of the stream
+
 	public:
 		//! Class for EssenceSource objects for parsing/sourcing MPEG-VES essence
 		class ESP_EssenceSource : public EssenceSubParserBase::ESP_EssenceSource
@@ -120,6 +140,9 @@ namespace mxflib
 			 */
 			virtual DataChunkPtr GetEssenceData(size_t Size = 0, size_t MaxSize = 0);
 
+			//! Get the next Count wrapping units of essence data, read from the file in a single operation
+			virtual DataChunkVector GetEssenceDataBatch(size_t Count);
+
 			//! Did the last call to GetEssenceData() return the end of a wrapping item
 			/*! \return true if the last call to GetEssenceData() returned an entire wrapping unit.
 			 *  \return true if the last call to GetEssenceData() returned the last chunk of a wrapping unit.
@@ -189,6 +212,8 @@ namespace mxflib
 			EndOfStream = false;
 
 			GOPStartTimecode = 0;
+
+			PictureTableEnd = 0;
 		}
 
 		//! Build a new parser of this type and return a pointer to it
@@ -253,9 +278,15 @@ namespace mxflib
 		//! Read the sequence header at the specified position in an MPEG2 file to build an essence descriptor
 		MDObjectPtr BuildMPEG2VideoDescriptor(FileHandle InFile, UInt64 Start = 0);
 
+		//! Scan the whole stream to find the GOP structure and the size and index details of every picture
+		bool PreScan(FileHandle InFile);
+
 		//! Scan the essence to calculate how many bytes to transfer for the given edit unit count
 		size_t ReadInternal(FileHandle InFile, UInt32 Stream, UInt64 Count);
 
+		//! Read a batch of wrapping items from the specified stream into a single buffer
+		DataChunkPtr ReadBatch(FileHandle InFile, UInt32 Stream, UInt64 Count, size_t Items, std::vector<size_t> &Sizes);
+
 		//! Get a byte from the current stream
 		int BuffGetU8(FileHandle InFile);
 
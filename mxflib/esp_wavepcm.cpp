@@ -281,6 +281,103 @@ DataChunkPtr WAVE_PCM_EssenceSubParser::ESP_EssenceSource::GetEssenceData(size_t
 }
 
 
+//! Get the next Count wrapping units of essence data, read from the file in a single operation
+/*! \note Index table entries are offered for all edit units in the batch as it is read
+ */
+DataChunkVector WAVE_PCM_EssenceSubParser::ESP_EssenceSource::GetEssenceDataBatch(size_t Count)
+{
+	WAVE_PCM_EssenceSubParser *pCaller = SmartPtr_Cast(Caller, WAVE_PCM_EssenceSubParser);
+
+	// Only whole edit units are batched, so finish any part-read item and leave clip-wrapping to the normal route
+	if(BytesRemaining || (pCaller->SelectedWrapping->ThisWrapType != WrappingOption::Frame)) return EssenceSource::GetEssenceDataBatch(Count);
+
+	// Allow us to differentiate the first call
+	if(!Started)
+	{
+		Started = true;
+
+		// Move to the selected position
+		if(pCaller->BytePosition == 0) pCaller->BytePosition = pCaller->DataStart;
+	}
+
+	Position Start = pCaller->BytePosition;
+	size_t Total = 0;
+
+	// Work out the size of each edit unit in turn, following the wrapping sequence
+	std::vector<size_t> Sizes;
+	while(Sizes.size() < Count)
+	{
+		// Either use the cached value, or scan the stream and find out how many bytes to read
+		if((pCaller->CachedDataSize == static_cast<size_t>(-1)) || (pCaller->CachedCount != RequestedCount)) pCaller->ReadInternal(File, Stream, RequestedCount);
+
+		// Record, then clear, the data size
+		size_t Bytes = pCaller->CachedDataSize;
+		pCaller->CachedDataSize = static_cast<size_t>(-1);
+
+		if(Bytes == 0)
+		{
+			// Undo removing the size by calling SamplesThisEditUnit so that the padding sequence stays corrent
+			if(PaddingEnabled) pCaller->PushBackSize();
+
+			break;
+		}
+
+		Sizes.push_back(Bytes);
+		Total += Bytes;
+
+		// DRAGONS: ReadInternal() works from BytePosition, so move it on to the next edit unit
+		pCaller->BytePosition += Bytes;
+	}
+
+	// Flag all done when no more to read
+	if(Total == 0)
+	{
+		AtEndOfData = true;
+		return DataChunkVector();
+	}
+
+	// Read all the data in one go
+	DataChunkPtr Buffer = new DataChunk(Total);
+
+	FileSeek(File, Start);
+	size_t BytesRead = static_cast<size_t>(FileRead(File, Buffer->Data, Total));
+
+	// Update the file pointer
+	pCaller->BytePosition = Start + BytesRead;
+
+	// The first edit unit to add to the index table
+	Position IndexedEditUnit = pCaller->CurrentPosition;
+
+	if(BytesRead == Total)
+	{
+		pCaller->CurrentPosition += Sizes.size() * RequestedCount;
+	}
+	else
+	{
+		// If we get too few bytes - and padding has been selected, pad the last wrapping unit, otherwise drop the missing data
+		if(PaddingEnabled) memset(&Buffer->Data[BytesRead], 0, Total - BytesRead);
+		else Buffer->Resize(BytesRead);
+
+		pCaller->CurrentPosition = pCaller->CalcCurrentPosition();
+	}
+
+	DataChunkVector Ret = SplitBatch(Buffer, Sizes);
+
+	if(Ret.empty()) AtEndOfData = true;
+	else if(pCaller->Manager)
+	{
+		// Offer this index table data to the index manager
+		size_t i;
+		for(i = 0; i < Ret.size(); i++)
+		{
+			pCaller->Manager->OfferEditUnit(pCaller->ManagedStreamID, IndexedEditUnit + i * RequestedCount, 0, 0x80);
+		}
+	}
+
+	return Ret;
+}
+
+
 //! Get data to write as padding after all real essence data has been processed
 /*! If more than one stream is being wrapped, they may not all end at the same wrapping-unit.
  *	When this happens each source that has ended will produce NULL is response to GetEssenceData().
@@ -101,6 +101,9 @@ namespace mxflib
 			 */
 			virtual DataChunkPtr GetEssenceData(size_t Size = 0, size_t MaxSize = 0);
 
+			//! Get the next Count wrapping units of essence data, read from the file in a single operation
+			virtual DataChunkVector GetEssenceDataBatch(size_t Count);
+
 			//! Did the last call to GetEssenceData() return the end of a wrapping item
 			/*! \return true if the last call to GetEssenceData() returned an entire wrapping unit.
 			 *  \return true if the last call to GetEssenceData() returned the last chunk of a wrapping unit.
@@ -30,6 +30,11 @@
 
 #include <cstddef>
 
+#ifdef MXFLIB_THREADS
+#include <IlmThread.h>
+#include <IlmThreadPool.h>
+#endif // MXFLIB_THREADS
+
 
 using namespace mxflib;
 
@@ -72,6 +77,49 @@ namespace
 	/*! This allows private or experimental system item keys to be treated as standard GC keys when reading
 	 */
 	DataChunkList GCSystemKeyAlternatives;
+
+
+	//! Bytes of a GC essence key that identify it as such - all but the version number, byte 12 and the track number
+	const UInt8 GCEssenceKeyMask[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+	//! The KLV fill key
+	const UInt8 FillerKey[16] = { 0x06, 0x0E, 0x2B, 0x34, 0x01, 0x01, 0x01, 0x01, 0x03, 0x01, 0x02, 0x10, 0x01, 0x00, 0x00, 0x00 };
+
+	//! Bytes of a KLV fill key that identify it as such - all but the version number
+	const UInt8 FillerKeyMask[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+	//! The encrypted triplet key
+	const UInt8 EncryptedKey[16] = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x04, 0x01, 0x07, 0x0d, 0x01, 0x03, 0x01, 0x02, 0x7e, 0x01, 0x00 };
+
+	//! Mask to compare every byte of a key
+	const UInt8 FullKeyMask[16] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+
+	//! A key and mask, matched as native-endian 64-bit words so a key can be checked with a few loads and compares
+	/*! DRAGONS: This is an aggregate of pointers to constant arrays so that the patterns below are constant-initialized,
+	 *           and are safe to use from the static initializers of other translation units
+	 */
+	struct KeyPattern
+	{
+		const UInt8 *Key;			//!< The key to match
+		const UInt8 *Mask;			//!< Bits of the key that must match
+
+		//! Does a 16-byte key match this pattern?
+		bool Matches(const UInt8 *Test) const
+		{
+			UInt64 Words[2];
+			UInt64 KeyWords[2];
+			UInt64 MaskWords[2];
+			memcpy(Words, Test, 16);
+			memcpy(KeyWords, Key, 16);
+			memcpy(MaskWords, Mask, 16);
+
+			return (((Words[0] ^ KeyWords[0]) & MaskWords[0]) | ((Words[1] ^ KeyWords[1]) & MaskWords[1])) == 0;
+		}
+	};
+
+	const KeyPattern GCEssencePattern = { GCEssenceKey, GCEssenceKeyMask };
+	const KeyPattern FillerPattern = { FillerKey, FillerKeyMask };
+	const KeyPattern EncryptedPattern = { EncryptedKey, FullKeyMask };
 }
 
 
@@ -83,9 +131,136 @@ namespace
 {
 	//! Max nmumber of bytes that we will try and wrap in one go (stops clip-wrapping bursting our memory)
 	const size_t MaxWrapChunkSize = 1024 * 1024 * 32;
+
+	//! Size of the AS-DCP cypher blocks
+	const size_t EncryptionGranularity = 16;
+
+	//! Space reserved before the Initialization Vector of an encrypted item for the key, length and AS-DCP header
+	/*! Key (16), outer BER length (up to 9), ContextID, PlaintextOffset, SourceKey and SourceLength (64) and the encrypted length (9)
+	 */
+	const size_t EncryptedHeaderSpace = 16 + 9 + 64 + 9;
+
+	//! Largest AS-DCP footer: TrackFileID (20), SequenceNumber (12) and MIC (24)
+	const size_t EncryptedFooterSpace = 20 + 12 + 24;
+
+	//! The plaintext of the AS-DCP check value
+	const UInt8 PlainCheck[16] = { 0x43, 0x48, 0x55, 0x4B, 0x43, 0x48, 0x55, 0x4B, 0x43, 0x48, 0x55, 0x4B, 0x43, 0x48, 0x55, 0x4B };
+
+	//! Encrypt whole blocks in place, chaining from the wrapper's current Initialization Vector, even if the wrapper cannot work in place
+	bool EncryptBlocks(Encrypt_Base *Encrypt, size_t Size, UInt8 *Data)
+	{
+		if(Encrypt->CanEncryptInPlace(Size)) return Encrypt->EncryptInPlace(Size, Data);
+
+		DataChunkPtr NewData = Encrypt->Encrypt(Size, Data);
+		if((!NewData) || (NewData->Size != Size)) return false;
+
+		memcpy(Data, NewData->Data, Size);
+		return true;
+	}
 }
 
 
+//! An item of encrypted essence being built, possibly on another thread
+/*! The whole encrypted KLV is built in Buffer. The value, from the Initialization Vector onwards, is built by Execute()
+ *  which may run on the thread pool. The key, length and header are built backwards from IVStart, and the footer after
+ *  the value, by the thread that adds the item to a content package - these bytes are not touched by Execute().
+ */
+struct GCWriter::EncryptJob
+{
+	GCStreamID ID;						//!< The stream this item belongs to
+	DataChunkPtr Chunk;					//!< The plaintext if it has not yet been copied into Buffer, else NULL
+	UInt64 ValueLength;					//!< Size of the plaintext value
+	size_t PlaintextOffset;				//!< Number of bytes at the start of the value that are not encrypted
+	UInt8 *Buffer;						//!< Buffer holding the whole encrypted KLV
+	size_t IVStart;						//!< Offset of the Initialization Vector within Buffer
+	size_t ValueSize;					//!< Size of the encrypted value, from the Initialization Vector to the end of the padding
+	size_t Start;						//!< Offset of the first byte of the key within Buffer, once the header has been built
+	size_t MICStart;					//!< Offset of the Message Integrity Code within Buffer, or 0 if there is no MIC
+	EncryptPtr Encrypt;					//!< The encryption wrapper
+	HashPtr Hasher;						//!< The hasher for the MIC, or NULL
+	bool HashInTask;					//!< True if Hasher is our own and the value is hashed by Execute(), false if it is hashed by FinishEncryption()
+	bool Result;						//!< True once the value has been successfully encrypted
+#ifdef MXFLIB_THREADS
+	IlmThread::TaskGroup *Group;		//!< Group holding the task running Execute(), or NULL if not queued
+#endif // MXFLIB_THREADS
+
+	EncryptJob() : Buffer(NULL), MICStart(0), HashInTask(false), Result(false)
+	{
+#ifdef MXFLIB_THREADS
+		Group = NULL;
+#endif // MXFLIB_THREADS
+	}
+
+	~EncryptJob()
+	{
+		Wait();
+		delete[] Buffer;
+	}
+
+	//! Build the encrypted value
+	void Execute(void)
+	{
+		UInt8 *Value = &Buffer[IVStart];
+
+		// The Initialization Vector is already in place, follow it with the check value, the plaintext and the padding
+		memcpy(&Value[EncryptionGranularity], PlainCheck, EncryptionGranularity);
+		if(Chunk) memcpy(&Value[2 * EncryptionGranularity], Chunk->Data, static_cast<size_t>(ValueLength));
+
+		// Pad in a 16-byte version of the scheme defined in RFC 2898
+		size_t PadStart = 2 * EncryptionGranularity + static_cast<size_t>(ValueLength);
+		UInt8 Pad = static_cast<UInt8>(ValueSize - PadStart);
+		memset(&Value[PadStart], Pad, Pad);
+
+		// The check value and the encrypted part of the value form a single chain, with the plaintext between them
+		size_t EncStart = 2 * EncryptionGranularity + PlaintextOffset;
+		size_t EncSize = ValueSize - EncStart;
+
+		if(Encrypt->CanEncryptSections())
+		{
+			Result = Encrypt->EncryptSectionInPlace(Value, EncryptionGranularity, &Value[EncryptionGranularity])
+				  && Encrypt->EncryptSectionInPlace(&Value[EncryptionGranularity], EncSize, &Value[EncStart]);
+		}
+		else
+		{
+			Result = Encrypt->SetIV(EncryptionGranularity, Value, true)
+				  && EncryptBlocks(Encrypt.GetPtr(), EncryptionGranularity, &Value[EncryptionGranularity])
+				  && EncryptBlocks(Encrypt.GetPtr(), EncSize, &Value[EncStart]);
+		}
+
+		// The MIC covers the whole value from the Initialization Vector onwards
+		if(HashInTask) Hasher->HashData(ValueSize, Value);
+	}
+
+	//! Wait for Execute() to complete if it has been queued on the thread pool
+	void Wait(void)
+	{
+#ifdef MXFLIB_THREADS
+		// DRAGONS: The TaskGroup destructor waits for all its tasks to complete
+		delete Group;
+		Group = NULL;
+#endif // MXFLIB_THREADS
+	}
+};
+
+
+#ifdef MXFLIB_THREADS
+namespace
+{
+	//! Task to build the encrypted value of one item of essence
+	class EncryptTask : public IlmThread::Task
+	{
+	public:
+		EncryptTask(IlmThread::TaskGroup *Group, GCWriter::EncryptJob *Job) : Task(Group), Job(Job) {}
+
+		virtual void execute() { Job->Execute(); }
+
+	private:
+		GCWriter::EncryptJob *Job;		//!< The item to encrypt
+	};
+}
+#endif // MXFLIB_THREADS
+
+
 
 //! Set the containing BodyStream
 void EssenceSource::SetBodyStream(BodyStream *pBodyStream)
@@ -455,6 +630,7 @@ void GCWriter::AddSystemData(GCStreamID ID, UInt64 Size, const UInt8 *Data)
 	WB.KLVSource = nullptr;
 	WB.FastClipWrap = false;
 	WB.LenSize = Stream->LenSize;
+	WB.Encrypted = NULL;
 
 	// Add the index data
 	WB.IndexMan = Stream->IndexMan;
@@ -471,28 +647,21 @@ void GCWriter::AddSystemData(GCStreamID ID, UInt64 Size, const UInt8 *Data)
 }
 
 
-//! Add essence item data to the current CP
-void GCWriter::AddEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, BodyStreamPtr BStream /*=nullptr*/)
+//! Build the essence key for the specified stream
+/*! The essence element count is fixed the first time this is called for a GC stream
+ */
+void GCWriter::MakeEssenceKey(GCStreamID ID, UInt8 *Key)
 {
-	// Index the data block for this stream
-	if((ID < 0) || (ID >= StreamCount))
-	{
-		error("Unknown stream ID in GCWriter::AddEssenceData()\n");
-		return;
-	}
 	GCStreamData *Stream = &StreamTable[ID];
 
-	// Set up a new buffer big enough for the key, a huge BER length and the data
-	UInt8 *Buffer = new UInt8[(size_t)(16 + 9 + Size)];
-
 	if(Stream->SpecifiedKey)
 	{
-		memcpy(Buffer, Stream->SpecifiedKey->Data, 16);
+		memcpy(Key, Stream->SpecifiedKey->Data, 16);
 	}
 	else
 	{
 		// Copy in the key template
-			memcpy(Buffer, GetGCEssenceKey(), 12);
+			memcpy(Key, GetGCEssenceKey(), 12);
 	}
 
 	// Update the last three GC track number bytes unless it's not a GC KLV
@@ -518,12 +687,38 @@ void GCWriter::AddEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, Bod
 		}
 
 		// Set up the rest of the key
-		Buffer[7] = Stream->RegVer;
-		Buffer[12] = Stream->Type;
-		Buffer[13] = Stream->SchemeOrCount;
-		Buffer[14] = Stream->Element;
-		Buffer[15] = Stream->SubOrNumber;
+		Key[7] = Stream->RegVer;
+		Key[12] = Stream->Type;
+		Key[13] = Stream->SchemeOrCount;
+		Key[14] = Stream->Element;
+		Key[15] = Stream->SubOrNumber;
 	}
+}
+
+
+//! Add essence item data to the current CP
+void GCWriter::AddEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, BodyStreamPtr BStream /*=nullptr*/)
+{
+	// Index the data block for this stream
+	if((ID < 0) || (ID >= StreamCount))
+	{
+		error("Unknown stream ID in GCWriter::AddEssenceData()\n");
+		return;
+	}
+	GCStreamData *Stream = &StreamTable[ID];
+
+	// Encrypted streams are built as AS-DCP encrypted KLVs
+	if(Stream->Encrypt)
+	{
+		AddEncryptedEssenceData(ID, Size, Data, BStream);
+		return;
+	}
+
+	// Set up a new buffer big enough for the key, a huge BER length and the data
+	UInt8 *Buffer = new UInt8[(size_t)(16 + 9 + Size)];
+
+	// Set the key
+	MakeEssenceKey(ID, Buffer);
 
 	// Add the length and work out the start of the data field
 	DataChunkPtr BER = MakeBER(Size);
@@ -541,6 +736,7 @@ void GCWriter::AddEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, Bod
 	WB.Stream = BStream;
 	WB.FastClipWrap = false;
 	WB.LenSize = Stream->LenSize;
+	WB.Encrypted = NULL;
 
 	// Add the index data
 	WB.IndexMan = Stream->IndexMan;
@@ -557,6 +753,253 @@ void GCWriter::AddEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, Bod
 }
 
 
+//! Write all items of the specified stream as AS-DCP encrypted KLVs
+void GCWriter::SetEncryption(GCStreamID ID, EncryptPtr Encrypt, UUIDPtr ContextID, HashPtr Hasher /*=NULL*/, UUIDPtr TrackFileID /*=NULL*/, Length PlaintextOffset /*=0*/)
+{
+	// Index the data block for this stream
+	if((ID < 0) || (ID >= StreamCount))
+	{
+		error("Unknown stream ID in GCWriter::SetEncryption()\n");
+		return;
+	}
+	GCStreamData *Stream = &StreamTable[ID];
+
+	Stream->Encrypt = Encrypt;
+	Stream->Hasher = Hasher;
+	Stream->ContextID = ContextID;
+	Stream->TrackFileID = TrackFileID;
+	Stream->PlaintextOffset = PlaintextOffset;
+	Stream->SequenceNumber = 0;
+}
+
+
+//! Start encrypting an item of essence for an encrypted stream before it is added to a content package
+void GCWriter::PreEncrypt(GCStreamID ID, DataChunkPtr &Chunk)
+{
+#ifdef MXFLIB_THREADS
+	if((ID < 0) || (ID >= StreamCount) || (!Chunk)) return;
+
+	GCStreamData *Stream = &StreamTable[ID];
+	if((!Stream->Encrypt) || (!Stream->Encrypt->CanEncryptSections())) return;
+
+	PendingEncryption.push_back(StartEncryption(ID, Chunk->Size, NULL, Chunk));
+#else // MXFLIB_THREADS
+	// Without the thread pool each item is encrypted when it is added
+	UNUSED_PARAMETER(ID);
+	UNUSED_PARAMETER(Chunk);
+#endif // MXFLIB_THREADS
+}
+
+
+//! Start encrypting an item for the specified stream, taking a copy of Data or a reference to Chunk
+/*! If Data is NULL the plaintext is copied from Chunk by the encryption task, otherwise it is copied before returning.
+ *  The Initialization Vector is chosen here, so each item has its own.
+ */
+GCWriter::EncryptJob *GCWriter::StartEncryption(GCStreamID ID, UInt64 Size, const UInt8 *Data, DataChunkPtr Chunk)
+{
+	GCStreamData *Stream = &StreamTable[ID];
+
+	EncryptJob *Job = new EncryptJob;
+	Job->ID = ID;
+	Job->ValueLength = Size;
+
+	Job->PlaintextOffset = static_cast<size_t>(Stream->PlaintextOffset);
+	if(static_cast<UInt64>(Stream->PlaintextOffset) > Size) Job->PlaintextOffset = static_cast<size_t>(Size);
+
+	// There is padding from 1 to 16 bytes at the end of the encrypted data
+	size_t EncryptedLength = static_cast<size_t>(((Size - Job->PlaintextOffset) + EncryptionGranularity) / EncryptionGranularity);
+	EncryptedLength = EncryptedLength * EncryptionGranularity + Job->PlaintextOffset;
+
+	Job->IVStart = EncryptedHeaderSpace;
+	Job->ValueSize = 2 * EncryptionGranularity + EncryptedLength;
+	Job->Buffer = new UInt8[EncryptedHeaderSpace + Job->ValueSize + EncryptedFooterSpace];
+
+	// DRAGONS: A random UUID has a few fixed bits, but is otherwise as good an Initialization Vector as any other random number
+	MakeUUID(&Job->Buffer[Job->IVStart]);
+
+	if(Data) memcpy(&Job->Buffer[Job->IVStart + 2 * EncryptionGranularity], Data, static_cast<size_t>(Size));
+	else Job->Chunk = Chunk;
+
+	Job->Encrypt = Stream->Encrypt;
+
+	// Use our own hasher if possible so that the value may be hashed as soon as it is encrypted
+	if(Stream->Hasher)
+	{
+		Job->Hasher = Stream->Hasher->MakeNew();
+		if(Job->Hasher) Job->HashInTask = true;
+		else Job->Hasher = Stream->Hasher;
+	}
+
+#ifdef MXFLIB_THREADS
+	if(Job->Encrypt->CanEncryptSections())
+	{
+		Job->Group = new IlmThread::TaskGroup;
+		IlmThread::ThreadPool::addGlobalTask(new EncryptTask(Job->Group, Job));
+
+		return Job;
+	}
+#endif // MXFLIB_THREADS
+
+	Job->Execute();
+
+	return Job;
+}
+
+
+//! Add encrypted essence data to the current CP
+/*! The essence is written as an AS-DCP encrypted KLV, matching the layout written by KLVEObject.
+ *  If the item was started by PreEncrypt() that item is used, otherwise it is started here.
+ */
+void GCWriter::AddEncryptedEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, BodyStreamPtr &BStream)
+{
+	GCStreamData *Stream = &StreamTable[ID];
+
+	// Pick up this item if it has already been started
+	EncryptJob *Job = NULL;
+	std::list<EncryptJob *>::iterator it = PendingEncryption.begin();
+	while(it != PendingEncryption.end())
+	{
+		if(((*it)->ID == ID) && ((*it)->Chunk) && ((*it)->Chunk->Data == Data) && ((*it)->ValueLength == Size))
+		{
+			Job = *it;
+			PendingEncryption.erase(it);
+			break;
+		}
+		it++;
+	}
+
+	if(!Job) Job = StartEncryption(ID, Size, Data, NULL);
+
+	// ** Build the header backwards from the Initialization Vector **
+
+	UInt8 Header[EncryptedHeaderSpace];
+	UInt8 *p = Header;
+
+	// ContextID
+	p += MakeBER(p, 4, 16, 4);
+	if(Stream->ContextID) memcpy(p, Stream->ContextID->GetValue(), 16);
+	else
+	{
+		error("GCWriter::SetEncryption() called without a valid ContextID\n");
+		memset(p, 0, 16);
+	}
+	p += 16;
+
+	// PlaintextOffset
+	p += MakeBER(p, 4, 8, 4);
+	PutU64(static_cast<UInt64>(Job->PlaintextOffset), p);
+	p += 8;
+
+	// SourceKey
+	p += MakeBER(p, 4, 16, 4);
+	MakeEssenceKey(ID, p);
+	p += 16;
+
+	// SourceLength
+	p += MakeBER(p, 4, 8, 4);
+	PutU64(Size, p);
+	p += 8;
+
+	// Length of the encrypted source value, including the Initialization Vector and check value
+	p += MakeBER(p, 9, Job->ValueSize, 0);
+
+	size_t HeaderSize = p - Header;
+
+	// ** Build the footer after the value **
+
+	UInt8 *Footer = &Job->Buffer[Job->IVStart + Job->ValueSize];
+	p = Footer;
+
+	if(!Stream->TrackFileID) p += MakeBER(p, 4, 0, 4);
+	else
+	{
+		p += MakeBER(p, 4, 16, 4);
+		memcpy(p, Stream->TrackFileID->GetValue(), 16);
+		p += 16;
+	}
+
+	p += MakeBER(p, 4, 8, 4);
+	PutU64(++Stream->SequenceNumber, p);
+	p += 8;
+
+	// The MIC is filled in once the value has been hashed
+	if(Job->Hasher)
+	{
+		p += MakeBER(p, 4, 20, 4);
+		Job->MICStart = p - Job->Buffer;
+		p += 20;
+	}
+
+	size_t FooterSize = p - Footer;
+
+	// ** Add the key and length in front of the header **
+
+	UInt64 OuterLength = HeaderSize + Job->ValueSize + FooterSize;
+
+	UInt8 KL[16 + 9];
+	memcpy(KL, EncryptedTriplet_UL.GetValue(), 16);
+	size_t KLSize = 16 + MakeBER(&KL[16], 9, OuterLength, Stream->LenSize);
+
+	Job->Start = Job->IVStart - (HeaderSize + KLSize);
+	memcpy(&Job->Buffer[Job->Start], KL, KLSize);
+	memcpy(&Job->Buffer[Job->Start + KLSize], Header, HeaderSize);
+
+	// Add this item to the write queue (the writer will free the memory)
+	WriteBlock WB;
+	WB.Size = KLSize + OuterLength;
+	WB.Buffer = NULL;
+	WB.KLVSource = nullptr;
+	WB.Stream = BStream;
+	WB.FastClipWrap = false;
+	WB.LenSize = Stream->LenSize;
+	WB.WriteEncrypted = true;
+	WB.Encrypted = Job;
+
+	// Add the index data
+	WB.IndexMan = Stream->IndexMan;
+	if(WB.IndexMan)
+	{
+		WB.IndexSubStream = Stream->IndexSubStream;
+		WB.IndexFiller = Stream->IndexFiller;
+		WB.IndexClip = Stream->IndexClip;
+	}
+	else
+		WB.IndexFiller = false;
+
+	WriteQueue.insert(WriteQueueMap::value_type(Stream->WriteOrder, WB));
+}
+
+
+//! Wait for an encrypted item to be complete and finish its Message Integrity Code
+void GCWriter::FinishEncryption(EncryptJob *Job)
+{
+	Job->Wait();
+
+	// Release the plaintext now that we are back on the writing thread
+	Job->Chunk = NULL;
+
+	if(!Job->Result) error("Failed to encrypt item for stream %d in GCWriter\n", Job->ID);
+
+	if(Job->Hasher)
+	{
+		// Hash the value here if the hasher is shared by all items of the stream
+		if(!Job->HashInTask) Job->Hasher->HashData(Job->ValueSize, &Job->Buffer[Job->IVStart]);
+
+		// The footer is hashed up to and including the BER length of the MIC
+		size_t FooterStart = Job->IVStart + Job->ValueSize;
+		Job->Hasher->HashData(Job->MICStart - FooterStart, &Job->Buffer[FooterStart]);
+
+		DataChunkPtr Hash = Job->Hasher->GetHash();
+		if(Hash && (Hash->Size == 20)) memcpy(&Job->Buffer[Job->MICStart], Hash->Data, 20);
+		else
+		{
+			error("Hash for encrypted item is not 20 bytes\n");
+			memset(&Job->Buffer[Job->MICStart], 0, 20);
+		}
+	}
+}
+
+
 //! Add an essence item to the current CP with the essence to be read from an EssenceSource object
 void GCWriter::AddEssenceData(GCStreamID ID, EssenceSourcePtr Source, bool FastClipWrap /*=false*/, BodyStreamPtr BStream /*=nullptr*/)
 {
@@ -568,6 +1011,13 @@ void GCWriter::AddEssenceData(GCStreamID ID, EssenceSourcePtr Source, bool FastC
 	}
 	GCStreamData *Stream = &StreamTable[ID];
 
+	// DRAGONS: Rather than write the essence unencrypted we refuse to write it at all
+	if(Stream->Encrypt)
+	{
+		error("Only buffered essence data may be written to an encrypted stream by GCWriter\n");
+		return;
+	}
+
 	// Set up a new buffer big enough for the key alone - the BER length and data will be added later
 	UInt8 *Buffer = new UInt8[16];
 
@@ -620,6 +1070,7 @@ void GCWriter::AddEssenceData(GCStreamID ID, EssenceSourcePtr Source, bool FastC
 	WB.Stream = BStream;
 	WB.FastClipWrap = FastClipWrap;
 	WB.LenSize = Stream->LenSize;
+	WB.Encrypted = NULL;
 
 	// Add the index data
 	WB.IndexMan = Stream->IndexMan;
@@ -648,6 +1099,13 @@ void GCWriter::AddEssenceData(GCStreamID ID, KLVObjectPtr Source, bool FastClipW
 	}
 	GCStreamData *Stream = &StreamTable[ID];
 
+	// DRAGONS: Rather than write the essence unencrypted we refuse to write it at all
+	if(Stream->Encrypt)
+	{
+		error("Only buffered essence data may be written to an encrypted stream by GCWriter\n");
+		return;
+	}
+
 	// Set up a new buffer big enough for the key alone - the BER length and data will be added later
 	UInt8 *Buffer = new UInt8[16];
 
@@ -699,6 +1157,7 @@ void GCWriter::AddEssenceData(GCStreamID ID, KLVObjectPtr Source, bool FastClipW
 	WB.Stream = BStream;
 	WB.FastClipWrap = FastClipWrap;
 	WB.LenSize = Stream->LenSize;
+	WB.Encrypted = NULL;
 
 	// Add the index data
 	WB.IndexMan = Stream->IndexMan;
@@ -852,9 +1311,18 @@ GCWriter::~GCWriter()
 	while(it != WriteQueue.end())
 	{
 		delete[] (*it).second.Buffer;
+		delete (*it).second.Encrypted;
 		it++;
 	}
 
+	// Clear any encrypted items that were never used
+	std::list<EncryptJob *>::iterator Job_it = PendingEncryption.begin();
+	while(Job_it != PendingEncryption.end())
+	{
+		delete *Job_it;
+		Job_it++;
+	}
+
 	// Clear the stream table
 	delete[] StreamTable;
 }
@@ -863,6 +1331,8 @@ GCWriter::~GCWriter()
 /*! \note It is important that any changes to this function are propogated to CalcWriteSize() */
 void GCWriter::Flush(void)
 {
+	MXFLIB_TRACE_SPAN("GCWriter::Flush");
+
 	//! Stream offset of the first byte of the key for this KLV - this will later be turned into the size of the (Key+Length) once they are written
 	Position KLSize = StreamOffset;
 
@@ -907,8 +1377,19 @@ void GCWriter::Flush(void)
 		}
 
 		// Write the pre-formatted data and free its buffer
-		StreamOffset += LinkedFile->Write((*it).second.Buffer, (UInt32)((*it).second.Size));
-		delete[] (*it).second.Buffer;
+		if((*it).second.Encrypted)
+		{
+			EncryptJob *Job = (*it).second.Encrypted;
+			FinishEncryption(Job);
+
+			StreamOffset += LinkedFile->Write(&Job->Buffer[Job->Start], (UInt32)((*it).second.Size));
+			delete Job;
+		}
+		else
+		{
+			StreamOffset += LinkedFile->Write((*it).second.Buffer, (UInt32)((*it).second.Size));
+			delete[] (*it).second.Buffer;
+		}
 
 		// Handle any KLVObject-buffered essence data
 		if((*it).second.KLVSource)
@@ -1418,6 +1899,56 @@ GCReader::GCReader( MXFFilePtr File, GCReadHandlerPtr DefaultHandler /*=nullptr*
 	PushBackRequested = false;
 
 	StreamOffset = 0;
+
+	BuildHandlerTable();
+}
+
+
+//! Rebuild HandlerTable after Handlers has changed
+/*! The table is sized to the smallest power of two that gives no collisions between the registered track numbers,
+ *  so a lookup is one multiply, one shift and one compare
+ */
+void GCReader::BuildHandlerTable(void)
+{
+	// Start with at least twice as many slots as handlers
+	int Bits = 1;
+	while((static_cast<size_t>(1) << Bits) < Handlers.size() * 2) Bits++;
+
+	// DRAGONS: We give up at 64k slots, which would need a very unlucky set of track numbers, and search Handlers instead
+	for(; Bits <= 16; Bits++)
+	{
+		size_t Size = static_cast<size_t>(1) << Bits;
+
+		HandlerKeys.assign(Size, 0);
+		HandlerTable.assign(Size, NULL);
+		HandlerShift = 32 - Bits;
+
+		bool Collision = false;
+		std::map<UInt32, GCReadHandlerPtr>::iterator it = Handlers.begin();
+		while(it != Handlers.end())
+		{
+			// Track number zero is never dispatched, so doesn't need a slot
+			if((*it).first != 0)
+			{
+				size_t Slot = static_cast<UInt32>((*it).first * 0x9e3779b1) >> HandlerShift;
+				if(HandlerTable[Slot])
+				{
+					Collision = true;
+					break;
+				}
+
+				HandlerKeys[Slot] = (*it).first;
+				HandlerTable[Slot] = (*it).second.GetPtr();
+			}
+			it++;
+		}
+
+		if(!Collision) return;
+	}
+
+	HandlerKeys.clear();
+	HandlerTable.clear();
+	HandlerShift = -1;
 }
 
 
@@ -1430,6 +1961,8 @@ bool GCReader::ReadFromFile(bool Focus /* = false */, ReaderUnit Unit /* = Unit_
 {
 	// Seek to the offset of the "next" KLV
 	mxflib_assert(File);
+	MXFLIB_TRACE_SPAN("GCReader::ReadFromFile");
+	StatisticsTimer Timer(File->Statistics(), &MXFFileStatistics::EssenceTime);
 	File->Seek(FileOffset);
 
 	// Force us to stop as soon as we have satisfied Focus,Unit,Count if requested
@@ -1489,47 +2022,49 @@ bool GCReader::ReadFromFile(bool Focus /* = false */, ReaderUnit Unit /* = Unit_
  */
 bool GCReader::HandleData(KLVObjectPtr Object)
 {
-	// First check is this KLV is a filler
-	// We first check if byte 9 == 3 which is true for filler keys, but is
-	// false for all GC sets and packs. Once this matches we can do a full memcmp.
-	if(Object->GetUL()->GetValue()[8] == 3)
+	ULPtr Key = Object->GetUL();
+
+	GCReadHandler_Base *Handler;
+	switch(ClassifyGCKey(Key->GetValue()))
 	{
-		const UInt8 FillerKey[16] = { 0x06, 0x0E, 0x2B, 0x34, 0x01, 0x01, 0x01, 0x01, 0x03, 0x01, 0x02, 0x10, 0x01, 0x00, 0x00, 0x00 };
-		if( memcmp(Object->GetUL()->GetValue(), FillerKey, 16) == 0 )
+		case GCKeyEssence:
+		{
+			// The common case - standard GC essence, so the track number is the end of the key
+			Handler = FindHandler(GetU32(&Key->GetValue()[12]));
+			if(Handler) return Handler->HandleData(this, Object);
+
+			// By this point we only have the default handler left
+			if(DefaultHandler) return DefaultHandler->HandleData(this, Object);
+			return true;
+		}
+
+		case GCKeyFiller:
 		{
 			if(FillerHandler) return FillerHandler->HandleData(this, Object);
-			else return true;
+			return true;
 		}
-	}
 
-	// Next check if this KLV is encrypted essence data - but only if we have an encryption handler
-	if(EncryptionHandler)
-	{
-		// We first check if byte 6 == 4 (variable pack) which is true for encrypted data keys,
-		// but is false for standard GC sets and packs. Once this matches we can do a full memcmp.
-		if(Object->GetUL()->GetValue()[5] == 4)
+		case GCKeyEncrypted:
 		{
-			const UInt8 EncryptedKey[16] = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x04, 0x01, 0x07, 0x0d, 0x01, 0x03, 0x01, 0x02, 0x7e, 0x01, 0x00 };
-			if( memcmp(Object->GetUL()->GetValue(), EncryptedKey, 16) == 0 )
-			{
-				return EncryptionHandler->HandleData(this, Object);
-			}
+			if(EncryptionHandler) return EncryptionHandler->HandleData(this, Object);
+			break;
 		}
+
+		default:
+			break;
 	}
 
-	// Get the track-number of this GC item (or zero if not GC)
+	// Get the track-number of this GC item (or zero if not GC) - this may be an alternative GC key or encrypted essence
 	// Note that we don't bother if no handlers have been registered
 	// because we will have to use the defualt handler whatever!
 	UInt32 TrackNumber;
-	if(!Handlers.size()) TrackNumber = 0; else TrackNumber = Object->GetGCTrackNumber();
+	if(Handlers.empty()) TrackNumber = 0; else TrackNumber = Object->GetGCTrackNumber();
 
 	if( TrackNumber != 0 )
 	{
-		// See if we have a handler registered for this track
-		std::map<UInt32, GCReadHandlerPtr>::iterator it = Handlers.find(TrackNumber);
-
-		// If so use that handler
-		if(it != Handlers.end()) return (*it).second->HandleData(this, Object);
+		// See if we have a handler registered for this track, and if so use that handler
+		Handler = FindHandler(TrackNumber);
+		if(Handler) return Handler->HandleData(this, Object);
 	}
 
 	// By this point we only have the default handler left
@@ -1566,6 +2101,8 @@ BodyReader::BodyReader(MXFFilePtr File)
 	AtEOF = false;					// We don't know if we are at the end of the file
 
 	CurrentBodySID = 0;				// We don't know what BodySID we are now in
+
+	SeekInited = false;				// The seek table is built by the first per SID seek
 };
 
 
@@ -1593,101 +2130,109 @@ Position BodyReader::Seek(Position Pos /*=0*/)
  */
 Position BodyReader::Seek(UInt32 BodySID, Position Pos)
 {
-	// We <b>need</b> a RIP for this to work
-	if(File->FileRIP.empty()) File->GetRIP();
-
-	PartitionInfoPtr PartInfo = File->FileRIP.FindPartition(BodySID, Pos);
-
-	if(!PartInfo)
-	{
-		error("BodyReader::Seek(%d, 0x%s) failed to locate the correct partition\n", BodySID, Int64toHexString(Pos).c_str());
-		return -1;
-	}
+	// Build the seek table the first time we are asked to seek within a stream
+	if(!SeekInited) InitSeek();
 
 	// This will hold the position requested once determined
-	Position PredictedPos = 0;
-	Position LastPredictedPos = -1;
+	Position PredictedPos = LookupSeekTable(BodySID, Pos);
 
-	// We now need to check this partition - and possibly scan forwards one or two partitions (depending on how accurate the FindPartition() call was)
-	for(;;)
+	// If the seek table does not cover this position (perhaps the file has grown since it was built) we locate the partition the slow way
+	if(PredictedPos == -1)
 	{
-		// Get the stream offset of the start of this partition
-		Position StreamOffset = PartInfo->GetStreamOffset();
+		// We <b>need</b> a RIP for this to work
+		if(File->FileRIP.empty()) File->GetRIP();
 
-		// If that was unknown we need to read the partition pack
-		if(StreamOffset == -1)
-		{
-			File->Seek(PartInfo->GetByteOffset());
-			PartInfo->ThePartition = File->ReadPartition();
+		PartitionInfoPtr PartInfo = File->FileRIP.FindPartition(BodySID, Pos);
 
-			if(PartInfo->ThePartition)
-			{
-				StreamOffset = PartInfo->ThePartition->GetInt64("BodyOffset");
-			}
+		if(!PartInfo)
+		{
+			error("BodyReader::Seek(%d, 0x%s) failed to locate the correct partition\n", BodySID, Int64toHexString(Pos).c_str());
+			return -1;
 		}
 
-		Position EssenceStart = PartInfo->GetEssenceStart();
-		if(EssenceStart == -1)
+		Position LastPredictedPos = -1;
+
+		// We now need to check this partition - and possibly scan forwards one or two partitions (depending on how accurate the FindPartition() call was)
+		for(;;)
 		{
-			if(!PartInfo->ThePartition)
+			// Get the stream offset of the start of this partition
+			Position StreamOffset = PartInfo->GetStreamOffset();
+
+			// If that was unknown we need to read the partition pack
+			if(StreamOffset == -1)
 			{
 				File->Seek(PartInfo->GetByteOffset());
 				PartInfo->ThePartition = File->ReadPartition();
-			}
 
-			if(!PartInfo->ThePartition)
-			{
-				error("BodyReader::Seek(%d, 0x%s) failed to read the partition\n", BodySID, Int64toHexString(Pos).c_str());
-				return -1;
+				if(PartInfo->ThePartition)
+				{
+					StreamOffset = PartInfo->ThePartition->GetInt64(BodyOffset_UL);
+					PartInfo->SetStreamOffset(StreamOffset);
+				}
 			}
 
-			if(!(PartInfo->ThePartition->SeekEssence()))
+			Position EssenceStart = PartInfo->GetEssenceStart();
+			if(EssenceStart == -1)
 			{
-				error("BodyReader::Seek(%d, 0x%s) failed to locate essence in the predicted partition\n", BodySID, Int64toHexString(Pos).c_str());
-				return -1;
-			}
+				if(!PartInfo->ThePartition)
+				{
+					File->Seek(PartInfo->GetByteOffset());
+					PartInfo->ThePartition = File->ReadPartition();
+				}
 
-			EssenceStart = File->Tell();
-			PartInfo->SetEssenceStart(EssenceStart);
-		}
+				if(!PartInfo->ThePartition)
+				{
+					error("BodyReader::Seek(%d, 0x%s) failed to read the partition\n", BodySID, Int64toHexString(Pos).c_str());
+					return -1;
+				}
 
-		// Predict the requested stream position - this will be correct as long as it is not beyond the end of this partition
-		PredictedPos = EssenceStart + (Pos - StreamOffset);
+				if(!(PartInfo->ThePartition->SeekEssence()))
+				{
+					error("BodyReader::Seek(%d, 0x%s) failed to locate essence in the predicted partition\n", BodySID, Int64toHexString(Pos).c_str());
+					return -1;
+				}
 
-		// Some broken files can hang by always going round the same point, quit if we find this
-		if(PredictedPos == LastPredictedPos) return -1;
-		LastPredictedPos = PredictedPos;
+				EssenceStart = File->Tell();
+				PartInfo->SetEssenceStart(EssenceStart);
+			}
 
-		/* Check if this took us beyond the end of the partition */
+			// Predict the requested stream position - this will be correct as long as it is not beyond the end of this partition
+			PredictedPos = EssenceStart + (Pos - StreamOffset);
 
-		// Locate the partition pack at or before this point (if all went well this will be the predicted partition pack)
-		// DRAGONS: We do this by looking for the next one, then subtracting one
-		// DRAGONS: Scan beyond end of file is a silent failure as this may be an incomplete file
+			// Some broken files can hang by always going round the same point, quit if we find this
+			if(PredictedPos == LastPredictedPos) return -1;
+			LastPredictedPos = PredictedPos;
 
-		RIP::iterator it = File->FileRIP.lower_bound(PredictedPos+1);
-		if(it == File->FileRIP.end())
-			return (Position) nullptr;
-		if(it != File->FileRIP.begin())
-			it--;
+			/* Check if this took us beyond the end of the partition */
 
-		// So, is this the same partition? If se, exit the loop as we have found the essence
-		if((*it).second->GetByteOffset() == PartInfo->GetByteOffset()) break;
+			// Locate the partition pack at or before this point (if all went well this will be the predicted partition pack)
+			// DRAGONS: We do this by looking for the next one, then subtracting one
+			// DRAGONS: Scan beyond end of file is a silent failure as this may be an incomplete file
 
-		/* Beyond the end of the partition - scan for the next partition of this BodySID and try again */
+			// DRAGONS: If there is no later partition the position is in the last partition - which may still be growing
+			RIP::iterator it = File->FileRIP.lower_bound(PredictedPos+1);
+			if(it != File->FileRIP.begin())
+				it--;
 
-		// DRAGONS: We have just ended up in the next partition pack already, so *it may be the desired 'next partition'
-		while ((*it).second->GetBodySID() != BodySID)
-		{
-			// Get the next partition pack
-			// DRAGONS: Scan beyond end of file is a silent failure as this may be an incomplete file
-			if(++it == File->FileRIP.end())
+			// So, is this the same partition? If se, exit the loop as we have found the essence
+			if((*it).second->GetByteOffset() == PartInfo->GetByteOffset()) break;
+
+			/* Beyond the end of the partition - scan for the next partition of this BodySID and try again */
+
+			// DRAGONS: We have just ended up in the next partition pack already, so *it may be the desired 'next partition'
+			while ((*it).second->GetBodySID() != BodySID)
 			{
-				return -1;
+				// Get the next partition pack
+				// DRAGONS: Scan beyond end of file is a silent failure as this may be an incomplete file
+				if(++it == File->FileRIP.end())
+				{
+					return -1;
+				}
 			}
-		}
 
-		// Set this as the new predicted partition, and try again
-		PartInfo = (*it).second;
+			// Set this as the new predicted partition, and try again
+			PartInfo = (*it).second;
+		}
 	}
 
 	// Seek to the requested location
@@ -1980,7 +2525,118 @@ bool BodyReader::ReSync()
  *  various structures - seeking is not always possible!!
  *  \return False if seeking could not be initialized (perhaps because the file is not seekable)
  */
-// bool BodyReader::InitSeek(void);
+bool BodyReader::InitSeek(void)
+{
+	SeekInited = true;
+	SeekTables.clear();
+
+	// We <b>need</b> a RIP for this to work
+	if(File->FileRIP.empty()) File->GetRIP();
+	if(File->FileRIP.empty()) return false;
+
+	// Building the table moves the file pointer, so put it back afterwards
+	Position OldPos = File->Tell();
+
+	RIP::iterator it = File->FileRIP.begin();
+	while(it != File->FileRIP.end())
+	{
+		PartitionInfoPtr PartInfo = (*it).second;
+		it++;
+
+		UInt32 BodySID = PartInfo->GetBodySID();
+		if((BodySID == 0) && PartInfo->SIDsKnown()) continue;
+
+		// Read the partition pack if we don't know enough about this partition already
+		if((!PartInfo->ThePartition) && ((BodySID == 0) || (PartInfo->GetStreamOffset() == -1) || (PartInfo->GetEssenceStart() == -1)))
+		{
+			File->Seek(PartInfo->GetByteOffset());
+			PartInfo->ThePartition = File->ReadPartition();
+			if(!PartInfo->ThePartition) continue;
+		}
+
+		if(PartInfo->ThePartition)
+		{
+			BodySID = PartInfo->ThePartition->GetUInt(BodySID_UL);
+			PartInfo->SetSIDs(BodySID, PartInfo->ThePartition->GetUInt(IndexSID_UL));
+			if(BodySID == 0) continue;
+
+			if(PartInfo->GetStreamOffset() == -1) PartInfo->SetStreamOffset(PartInfo->ThePartition->GetInt64(BodyOffset_UL));
+		}
+
+		SeekEntry Entry;
+		Entry.StreamOffset = PartInfo->GetStreamOffset();
+		Entry.PartitionStart = PartInfo->GetByteOffset();
+
+		Entry.EssenceStart = PartInfo->GetEssenceStart();
+		if(Entry.EssenceStart == -1)
+		{
+			if(!PartInfo->ThePartition->SeekEssence()) continue;
+
+			Entry.EssenceStart = File->Tell();
+			PartInfo->SetEssenceStart(Entry.EssenceStart);
+		}
+
+		// The essence runs up to the next partition pack, whatever its BodySID
+		if(it == File->FileRIP.end()) Entry.EssenceLength = -1;
+		else
+		{
+			Entry.EssenceLength = (*it).second->GetByteOffset() - Entry.EssenceStart;
+			if(Entry.EssenceLength <= 0) continue;
+		}
+
+		SeekTables[BodySID].push_back(Entry);
+	}
+
+	// Partitions are normally in stream order already, but broken or rewrapped files may not be
+	std::map<UInt32, std::vector<SeekEntry> >::iterator Table_it = SeekTables.begin();
+	while(Table_it != SeekTables.end())
+	{
+		std::stable_sort((*Table_it).second.begin(), (*Table_it).second.end(), SeekEntryBefore);
+		Table_it++;
+	}
+
+	File->Seek(OldPos);
+
+	return true;
+}
+
+
+//! Find the file position of a byte offset in a given stream using the seek table
+/*! \return The file position, or -1 if the offset is not covered by the table
+ */
+Position BodyReader::LookupSeekTable(UInt32 BodySID, Position Pos)
+{
+	std::map<UInt32, std::vector<SeekEntry> >::iterator Table_it = SeekTables.find(BodySID);
+	if(Table_it == SeekTables.end()) return -1;
+
+	std::vector<SeekEntry> &Table = (*Table_it).second;
+
+	// Find the last partition starting at or before this stream offset
+	SeekEntry Target;
+	Target.StreamOffset = Pos;
+	std::vector<SeekEntry>::iterator it = std::upper_bound(Table.begin(), Table.end(), Target, SeekEntryBefore);
+	if(it == Table.begin()) return -1;
+	it--;
+
+	Position Offset = Pos - (*it).StreamOffset;
+	Position Ret = (*it).EssenceStart + Offset;
+
+	if((*it).EssenceLength >= 0)
+	{
+		if(Offset >= (*it).EssenceLength) return -1;
+	}
+	else
+	{
+		// DRAGONS: The last partition may have been followed by new partitions since the table was built (if the file is growing)
+		//          so check with the RIP which does not involve any file reads
+		RIP::iterator RIP_it = File->FileRIP.lower_bound(Ret + 1);
+		if(RIP_it == File->FileRIP.begin()) return -1;
+		RIP_it--;
+		if((*RIP_it).second->GetByteOffset() != (*it).PartitionStart) return -1;
+	}
+
+	return Ret;
+}
 
 
 //! Register an essence key to be treated as a GC essence key
@@ -2025,13 +2681,8 @@ GCElementKind mxflib::GetGCElementKind(const ULPtr TheUL)
 	// Assume it's not a valid key
 	ret.IsValid = false;
 
-	// Note that we first test the 11th byte as this where "Application = MXF Generic Container Keys"
-	// is set and so is the same for all GC keys and different in the majority of non-CG keys
-	// also, avoid testing the 8th byte (version number)
-	if( ( TheUL->GetValue()[10] == GetGCEssenceKey()[10] )
-	 && ( TheUL->GetValue()[9]  == GetGCEssenceKey()[9]  )
-	 && ( TheUL->GetValue()[8]  == GetGCEssenceKey()[8]  )
-	 && ( memcmp(TheUL->GetValue(), GetGCEssenceKey(), 7 ) == 0) )
+	// Note that we avoid testing the 8th byte (version number)
+	if(GCEssencePattern.Matches(TheUL->GetValue()))
 	{
 		ret.IsValid = true;
 	}
@@ -2162,12 +2813,27 @@ bool mxflib::IsGStreamItem(const ULPtr TheUL)
  */
 UInt32 mxflib::GetGCTrackNumber(const ULPtr TheUL)
 {
-	GCElementKind Info = GetGCElementKind(TheUL);
+	// Only build the full GCElementKind if this may be an alternative GC key
+	if(!GCEssencePattern.Matches(TheUL->GetValue()))
+	{
+		if(GCEssenceKeyAlternatives.empty()) return 0;
+
+		GCElementKind Info = GetGCElementKind(TheUL);
+		if(!Info.IsValid) return 0;
+	}
+
+	return GetU32(&TheUL->GetValue()[12]);
+}
+
 
-	if(!Info.IsValid) return 0;
+//! Classify a key by the class of KLV it starts
+GCKeyClass mxflib::ClassifyGCKey(const UInt8 *Key)
+{
+	if(GCEssencePattern.Matches(Key)) return GCKeyEssence;
+	if(FillerPattern.Matches(Key)) return GCKeyFiller;
+	if(EncryptedPattern.Matches(Key)) return GCKeyEncrypted;
 
-	return    (static_cast<UInt32>(TheUL->GetValue()[12]) << 24) | (static_cast<UInt32>(TheUL->GetValue()[13]) << 16)
-			| (static_cast<UInt32>(TheUL->GetValue()[14]) << 8)  | static_cast<UInt32>(TheUL->GetValue()[15]);
+	return GCKeyOther;
 }
 
 
@@ -2558,8 +3224,51 @@ Position BodyStream::GetPosition(void)
 	// DRAGONS: We also do a check for an empty BodyStream to prevent an error, we will end up with position 0 if empty
 	if(PrechargeSize) return 0 - PrechargeSize;
 
-	// Return the position as reported by the master stream
-	return (*begin())->GetCurrentPosition();
+	// Return the position as reported by the master stream, less anything it has read ahead that we have not yet used
+	return (*begin())->GetCurrentPosition() - GetReadAheadCount((*begin()).GetPtr());
+}
+
+
+//! Get the next wrapping unit of essence data from one of the sub-streams of this stream
+/*! If nothing has already been read ahead from this sub-stream, up to BatchSize wrapping units are read
+ *  in one go with GetEssenceDataBatch(), the first is returned and the rest are held for later calls.
+ *  \return As for EssenceSource::GetEssenceData()
+ */
+DataChunkPtr BodyStream::GetSubStreamData(EssenceSourcePtr &SubStream, size_t BatchSize /*=1*/)
+{
+	std::map<EssenceSource *, DataChunkList>::iterator it = ReadAhead.find(SubStream.GetPtr());
+
+	// Nothing waiting - read more
+	if((it == ReadAhead.end()) || (*it).second.empty())
+	{
+		// Not batching, so read a single wrapping unit
+		if(BatchSize <= 1) return SubStream->GetEssenceData();
+
+		DataChunkVector Batch = SubStream->GetEssenceDataBatch(BatchSize);
+		if(Batch.empty()) return NULL;
+
+		// If this sub-stream is encrypted the whole batch can be encrypted while it waits to be written
+		if(StreamWriter)
+		{
+			DataChunkVector::iterator Batch_it = Batch.begin();
+			while(Batch_it != Batch.end())
+			{
+				if(*Batch_it) StreamWriter->PreEncrypt(SubStream->GetStreamID(), *Batch_it);
+				Batch_it++;
+			}
+		}
+
+		// No need to hold on to a single item
+		if(Batch.size() == 1) return Batch.front();
+
+		if(it == ReadAhead.end()) it = ReadAhead.insert(std::pair<EssenceSource *, DataChunkList>(SubStream.GetPtr(), DataChunkList())).first;
+		(*it).second.insert((*it).second.end(), Batch.begin(), Batch.end());
+	}
+
+	DataChunkPtr Ret = (*it).second.front();
+	(*it).second.pop_front();
+
+	return Ret;
 }
 
 
@@ -2682,12 +3391,24 @@ Length BodyWriter::WriteEssence(StreamInfoPtr &Info, Length Duration /*=0*/, Len
 		bool ExitNow = false;					//!< Exit this iteration - no further checks required
 		bool ExitASAP = false;					//!< Exit at the earliest valid time (for example the next edit point)
 
+		// Work out how many wrapping units we may read from each sub-stream in one go
+		// DRAGONS: Reading ahead moves the parser on, so we don't do it when building VBR index tables (the parser offers
+		//          index entries as it reads) or when edit aligning (the edit point flag would be for the wrong edit unit).
+		//          Anything read ahead but not written in this partition is held by the BodyStream for the next one.
+		size_t MaxBatchSize = ReadBatchSize;
+		if(VBRIndex || Stream->GetEditAlign()) MaxBatchSize = 1;
+
 		// Loop for each frame, or field, or other wrapping-chunk
 		while(!ExitNow)
 		{
 			// We can allow some sub-streams to finish first and still write the others, but we stop when all ended
 			bool DataWrittenThisCP = false;
 
+			// Don't read ahead beyond where this stream is due to stop
+			size_t BatchSize = MaxBatchSize;
+			if(Duration && (RemainingDuration < static_cast<Length>(BatchSize))) BatchSize = static_cast<size_t>(RemainingDuration);
+			if(Info->StopAfter && (Info->StopAfter < static_cast<Length>(BatchSize))) BatchSize = static_cast<size_t>(Info->StopAfter);
+
 			// Add a chunk of essence data - unless there is already some pending
 			if(!Stream->HasPendingData())
 			{
@@ -2742,7 +3463,7 @@ Length BodyWriter::WriteEssence(StreamInfoPtr &Info, Length Duration /*=0*/, Len
 						else
 						{
 							// Read the next data for this sub-stream
-							Dat = (*it)->GetEssenceData();
+							Dat = Stream->GetSubStreamData(*it, PrechargeSize ? 1 : BatchSize);
 						}
 
 						// Get the stream ID for this sub-stream
@@ -3375,6 +4096,8 @@ void mxflib::BodyWriter::WriteBody(Length Duration /*=0*/, Length MaxPartitionSi
  */
 Length mxflib::BodyWriter::WritePartition(Length Duration /*=0*/, Length MaxPartitionSize /*=0*/, bool ClosePartition /*=true*/)
 {
+	MXFLIB_TRACE_SPAN("BodyWriter::WritePartition");
+
 	// Number of edit units processed
 	Length Ret = 0;
 
@@ -3599,8 +4322,20 @@ Length mxflib::BodyWriter::WritePartition(Length Duration /*=0*/, Length MaxPart
 				// Note: The partition will be written by the call to WriteEssence
 			}
 
+			// If scheduling within an interleave budget, limit this partition to this stream's share of the round
+			Length UseDuration = Duration;
+			Length UseMaxSize = MaxPartitionSize;
+			if(InterleaveBudget)
+			{
+				Length ScheduledSize;
+				Length ScheduledDuration = GetScheduledDuration(Stream, ScheduledSize);
+
+				if((!UseDuration) || (ScheduledDuration < UseDuration)) UseDuration = ScheduledDuration;
+				if(ScheduledSize && ((!UseMaxSize) || (ScheduledSize < UseMaxSize))) UseMaxSize = ScheduledSize;
+			}
+
 			// Write the Essence
-			Ret += WriteEssence((*CurrentStream), Duration, MaxPartitionSize, ClosePartition);
+			Ret += WriteEssence((*CurrentStream), UseDuration, UseMaxSize, ClosePartition);
 
 			// Check the new state for this stream
 			StreamState = Stream->GetState();
@@ -4061,6 +4796,9 @@ void mxflib::BodyWriter::SetNextStream(void)
 			{
 				if((StreamState != BodyStream::BodyStreamHeadIndex) && (StreamState != BodyStream::BodyStreamFootIndex))
 				{
+					// If scheduling, the stream that is furthest behind goes next rather than the next in the list
+					if(InterleaveBudget) SelectScheduledStream();
+
 					// Set the BodySID and stop looking
 					CurrentBodySID = (*CurrentStream)->Stream->GetBodySID();
 					return;
@@ -4096,6 +4834,136 @@ void mxflib::BodyWriter::SetNextStream(void)
 }
 
 
+//! Select the active body stream that is furthest behind in time, when scheduling within an interleave budget
+/*! CurrentStream must already be a valid body stream, it is only changed if another stream is further behind.
+ *  Ties go to the earliest stream in the list so that, with equal rates, the streams are written in the order they were added.
+ */
+void mxflib::BodyWriter::SelectScheduledStream(void)
+{
+	StreamInfoList::iterator Best = StreamList.end();
+	double BestTime = 0.0;
+
+	StreamInfoList::iterator it = StreamList.begin();
+	while(it != StreamList.end())
+	{
+		if((*it)->Active)
+		{
+			BodyStream::StateType StreamState = (*it)->Stream->GetState();
+
+			// DRAGONS: Finished streams are not deactivated here, SetNextStream() will do that when it next finds them
+			if((StreamState != BodyStream::BodyStreamDone) && (StreamState != BodyStream::BodyStreamHeadIndex) && (StreamState != BodyStream::BodyStreamFootIndex))
+			{
+				double ThisTime = GetStreamTime((*it)->Stream);
+				if((Best == StreamList.end()) || (ThisTime < BestTime))
+				{
+					Best = it;
+					BestTime = ThisTime;
+				}
+			}
+		}
+		it++;
+	}
+
+	if(Best != StreamList.end()) CurrentStream = Best;
+}
+
+
+//! Get the position of a stream in seconds
+double mxflib::BodyWriter::GetStreamTime(BodyStreamPtr &Stream)
+{
+	EssenceSourcePtr &Source = Stream->GetSource();
+	if(!Source) return 0.0;
+
+	Rational EditRate = Source->GetEditRate();
+	if((EditRate.Numerator == 0) || (EditRate.Denominator == 0)) return 0.0;
+
+	return static_cast<double>(Stream->GetPosition()) * EditRate.Denominator / EditRate.Numerator;
+}
+
+
+//! Get the number of essence bytes per second written for a stream, or 0 if not yet known
+/*! Once some essence has been written the measured rate is used, including keys, lengths and filler.
+ *  Before that only a CBR stream has a known rate.
+ */
+double mxflib::BodyWriter::GetStreamByteRate(BodyStreamPtr &Stream)
+{
+	EssenceSourcePtr &Source = Stream->GetSource();
+	if(!Source) return 0.0;
+
+	Rational EditRate = Source->GetEditRate();
+	if((EditRate.Numerator == 0) || (EditRate.Denominator == 0)) return 0.0;
+
+	double EditUnitsPerSecond = static_cast<double>(EditRate.Numerator) / EditRate.Denominator;
+
+	Position EditUnits = Stream->GetPosition();
+	Position StreamOffset = Stream->GetWriter() ? Stream->GetWriter()->GetStreamOffset() : 0;
+	if((EditUnits > 0) && (StreamOffset > 0)) return (static_cast<double>(StreamOffset) / EditUnits) * EditUnitsPerSecond;
+
+	// Nothing written yet, so sum the sizes of each CBR sub-stream
+	UInt32 UseKAG = Stream->GetKAG() ? Stream->GetKAG() : KAG;
+	double Bytes = 0.0;
+	BodyStream::iterator it = Stream->begin();
+	while(it != Stream->end())
+	{
+		UInt32 ThisSize = (*it)->GetBytesPerEditUnit(UseKAG ? UseKAG : 1);
+		if(ThisSize == 0) return 0.0;
+
+		Bytes += ThisSize;
+		it++;
+	}
+
+	return Bytes * EditUnitsPerSecond;
+}
+
+
+//! Get the number of edit units and bytes to write for a stream in the current interleave round
+/*! The round lasts as long as the combined data rate of all the active body streams allows within InterleaveBudget.
+ *  MaxSize is twice this stream's share of the budget, so a VBR stream is only cut short by a burst of much larger
+ *  than average edit units rather than leaving a small remainder for the next round.
+ *  If the rate of any stream is not yet known the minimum duration is used, and MaxSize is set to zero
+ *  \return The duration in edit units, MaxSize is set to the number of bytes
+ */
+Length mxflib::BodyWriter::GetScheduledDuration(BodyStreamPtr &Stream, Length &MaxSize)
+{
+	MaxSize = 0;
+
+	double TotalRate = 0.0;
+	StreamInfoList::iterator it = StreamList.begin();
+	while(it != StreamList.end())
+	{
+		if((*it)->Active)
+		{
+			BodyStream::StateType StreamState = (*it)->Stream->GetState();
+			if((StreamState != BodyStream::BodyStreamDone) && (StreamState != BodyStream::BodyStreamFootIndex))
+			{
+				double ThisRate = GetStreamByteRate((*it)->Stream);
+				if(ThisRate <= 0.0) return MinInterleaveDuration;
+
+				TotalRate += ThisRate;
+			}
+		}
+		it++;
+	}
+
+	if(TotalRate <= 0.0) return MinInterleaveDuration;
+
+	// The length of the round in seconds, and this stream's share of the budget
+	double RoundTime = static_cast<double>(InterleaveBudget) / TotalRate;
+	MaxSize = static_cast<Length>(2.0 * RoundTime * GetStreamByteRate(Stream));
+
+	Rational EditRate = Stream->GetSource()->GetEditRate();
+	Length Ret = static_cast<Length>(RoundTime * EditRate.Numerator / EditRate.Denominator);
+	if(Ret < MinInterleaveDuration)
+	{
+		// The minimum duration overrides the budget
+		Ret = MinInterleaveDuration;
+		MaxSize = 0;
+	}
+
+	return Ret;
+}
+
+
 //! Add a stream to the list of those to write
 /*! \param Stream - The stream to write
  *  \param StopAfter - If > 0 the writer will stop writing this stream at the earliest opportunity after (at least) this number of edit units have been written
@@ -193,6 +193,28 @@ namespace mxflib
 		 */
 		virtual DataChunkPtr GetEssenceData(size_t Size = 0, size_t MaxSize = 0) = 0;
 
+		//! Get up to the next Count wrapping units of essence data in a single operation
+		/*! Each entry in the returned list is what would have been returned by a call to GetEssenceData(), so each
+		 *  holds a whole wrapping unit (or the rest of a part-read one). Sources that are able to read several wrapping
+		 *  units in one go return views of a single buffer rather than a separate buffer for each.
+		 *  \return A list of up to Count chunks, fewer if the end of the data is reached or no more is currently available
+		 *	\note The current position of the source will move on by the number of wrapping units returned
+		 *	\note The returned list is only empty if GetEssenceData() would have returned NULL
+		 *	\note This default version only returns a single chunk, as sources that follow the position of another stream
+		 *		  (such as VBI or system items) are not able to read ahead
+		 */
+		virtual DataChunkVector GetEssenceDataBatch(size_t Count)
+		{
+			UNUSED_PARAMETER(Count);
+
+			DataChunkVector Ret;
+
+			DataChunkPtr Data = GetEssenceData();
+			if(Data) Ret.push_back(Data);
+
+			return Ret;
+		}
+
 		//! Did the last call to GetEssenceData() return the end of a wrapping item
 		/*! \return true if the last call to GetEssenceData() returned an entire wrapping unit.
 		 *  \return true if the last call to GetEssenceData() returned the last chunk of a wrapping unit.
@@ -792,6 +814,12 @@ namespace mxflib
 		UInt32 WriteOrder;					//!< The (default) write order for this stream
 											/*!< Elements with a lower WriteOrder are written first when the
 											 *   content package is written */
+		EncryptPtr Encrypt;					//!< If this stream is written as AS-DCP encrypted KLVs the encryption wrapper, else NULL
+		HashPtr Hasher;						//!< If encrypting this stream the hasher for the Message Integrity Code, or NULL for no MIC
+		UUIDPtr ContextID;					//!< If encrypting this stream the cryptographic context ID
+		UUIDPtr TrackFileID;				//!< If encrypting this stream the TrackFile ID for each footer, or NULL to omit it
+		Length PlaintextOffset;				//!< If encrypting this stream the number of bytes at the start of each value that are not encrypted
+		UInt64 SequenceNumber;				//!< If encrypting this stream the sequence number of the last encrypted KLV added
 	};
 
 	//! Class that manages writing of generic container essence
@@ -961,6 +989,23 @@ namespace mxflib
 		//! Add an essence item to the current CP with the essence to be read from a KLVObject
 		void AddEssenceData(GCStreamID ID, KLVObjectPtr Source, bool FastClipWrap = false, BodyStreamPtr BStream = NULL);
 
+		//! Write all items of the specified stream as AS-DCP encrypted KLVs
+		/*! Each item is written as its own encrypted triplet with a new Initialization Vector, and items are given
+		 *  sequence numbers starting at 1. If built with MXFLIB_THREADS, and the encryption wrapper supports
+		 *  CanEncryptSections(), items are encrypted on the thread pool and only waited for when they are written.
+		 *  \param Hasher Keyed hasher for the Message Integrity Code, or NULL for no MIC. If Hasher->MakeNew() is
+		 *                supported the MIC is calculated along with the encryption, otherwise while writing
+		 *  \note Only buffered essence data may be encrypted
+		 */
+		void SetEncryption(GCStreamID ID, EncryptPtr Encrypt, UUIDPtr ContextID, HashPtr Hasher = NULL, UUIDPtr TrackFileID = NULL, Length PlaintextOffset = 0);
+
+		//! Start encrypting an item of essence for an encrypted stream before it is added to a content package
+		/*! This allows several items to be encrypted at once. The result is used by the next AddEssenceData() call
+		 *  for this stream with the same buffer, which must not be changed until then.
+		 *  \note Does nothing if the stream is not encrypted or the items would not be encrypted on the thread pool
+		 */
+		void PreEncrypt(GCStreamID ID, DataChunkPtr &Chunk);
+
 
 		//! Calculate how many bytes would be written if the specified object were written with WriteRaw()
 		Length CalcRawSize(KLVObjectPtr Object);
@@ -969,6 +1014,9 @@ namespace mxflib
 		void WriteRaw(KLVObjectPtr Object);
 
 
+		//! An item of encrypted essence being built, possibly on another thread
+		struct EncryptJob;
+
 		//! Structure for items to be written
 		struct WriteBlock
 		{
@@ -984,6 +1032,7 @@ namespace mxflib
 			bool IndexClip;				//!< True if indexing clip-wrapped essence
 			bool WriteEncrypted;		//!< True if the data is to be written as encrypted data (via a KLVEObject)
 			bool FastClipWrap;			//!< True if this KLV is to be "FastClipWrapped"
+			EncryptJob *Encrypted;		//!< The encrypted KLV to write in place of Buffer, or NULL
 		};
 
 		//! Type for holding the write queue in write order
@@ -1004,6 +1053,22 @@ namespace mxflib
 
 		//! Read the count of streams
 		int GetStreamCount(void) { return StreamCount; };
+
+	protected:
+		//! Encrypted items started by PreEncrypt() that have not yet been added to a content package
+		std::list<EncryptJob *> PendingEncryption;
+
+		//! Build the essence key for the specified stream
+		void MakeEssenceKey(GCStreamID ID, UInt8 *Key);
+
+		//! Add encrypted essence data to the current CP
+		void AddEncryptedEssenceData(GCStreamID ID, UInt64 Size, const UInt8 *Data, BodyStreamPtr &BStream);
+
+		//! Start encrypting an item for the specified stream, taking a copy of Data or a reference to Chunk
+		EncryptJob *StartEncryption(GCStreamID ID, UInt64 Size, const UInt8 *Data, DataChunkPtr Chunk);
+
+		//! Wait for an encrypted item to be complete and finish its Message Integrity Code
+		void FinishEncryption(EncryptJob *Job);
 	};
 }
 
@@ -1176,6 +1241,33 @@ namespace mxflib
 				return Data;
 			}
 
+			//! Split a buffer holding a batch of consecutive wrapping units into a view of each
+			/*! If the buffer is shorter than the total of the sizes (for example if the file ended early) the last view is truncated
+			 *  and any following sizes are ignored
+			 */
+			static DataChunkVector SplitBatch(const DataChunkPtr &Buffer, const std::vector<size_t> &Sizes)
+			{
+				DataChunkVector Ret;
+				if(!Buffer) return Ret;
+
+				Ret.reserve(Sizes.size());
+
+				size_t Offset = 0;
+				std::vector<size_t>::const_iterator it = Sizes.begin();
+				while((it != Sizes.end()) && (Offset < Buffer->Size))
+				{
+					size_t Bytes = *it;
+					if(Bytes > (Buffer->Size - Offset)) Bytes = Buffer->Size - Offset;
+
+					Ret.push_back(new DataChunkView(Buffer, Offset, Bytes));
+
+					Offset += Bytes;
+					it++;
+				}
+
+				return Ret;
+			}
+
 			//! Did the last call to GetEssenceData() return the end of a wrapping item
 			/*! \return true if the last call to GetEssenceData() returned an entire wrapping unit.
 			 *  \return true if the last call to GetEssenceData() returned the last chunk of a wrapping unit.
@@ -2947,6 +3039,27 @@ namespace mxflib
 
 		std::map<UInt32, GCReadHandlerPtr> Handlers;	//!< Map of read handlers indexed by track number
 
+		std::vector<UInt32> HandlerKeys;				//!< Track number of the handler in each slot of HandlerTable, or 0 if the slot is empty
+		std::vector<GCReadHandler_Base *> HandlerTable;	//!< Perfect hash table of the handlers in Handlers, rebuilt by BuildHandlerTable()
+		int HandlerShift;								//!< Shift to apply to the hashed track number to give the HandlerTable slot, or -1 if Handlers must be searched
+
+		//! Rebuild HandlerTable after Handlers has changed
+		void BuildHandlerTable(void);
+
+		//! Find the handler registered for a given non-zero track number
+		/*! \return NULL if no handler is registered for this track */
+		GCReadHandler_Base *FindHandler(UInt32 TrackNumber)
+		{
+			if(HandlerShift >= 0)
+			{
+				size_t Slot = static_cast<UInt32>(TrackNumber * 0x9e3779b1) >> HandlerShift;
+				return (HandlerKeys[Slot] == TrackNumber) ? HandlerTable[Slot] : NULL;
+			}
+
+			std::map<UInt32, GCReadHandlerPtr>::iterator it = Handlers.find(TrackNumber);
+			return (it == Handlers.end()) ? NULL : (*it).second.GetPtr();
+		}
+
 	public:
 		//! Create a new GCReader, optionally with a given default item handler and filler handler
 		/*! \note The default handler receives all KLVs without a specific handler (except fillers)
@@ -2994,6 +3107,8 @@ namespace mxflib
 			{
 				Handlers.erase(TrackNumber);
 			}
+
+			BuildHandlerTable();
 		}
 
 		//! Read from file - and specify a start location
@@ -3047,6 +3162,12 @@ namespace mxflib
 		 */
 		Position GetFileOffset(void) { return FileOffset; }
 
+		//! Get the I/O and parsing statistics of the file being read
+		/*! Time spent in ReadFromFile() is counted as essence time.
+		 *  \note Statistics are only collected once MXFFile::EnableStatistics() has been called for the file
+		 */
+		const MXFFileStatistics &GetStatistics(void) { return File->GetStatistics(); }
+
 
 		/*** Functions for use by read handlers ***/
 
@@ -3093,6 +3214,21 @@ namespace mxflib
 
 		std::map<UInt32, GCReaderPtr> Readers;	//!< Map of GCReaders indexed by BodySID
 
+		//! Location of the essence in one partition of a stream, used by Seek(BodySID, Pos)
+		struct SeekEntry
+		{
+			Position StreamOffset;				//!< Stream offset of the first essence byte in this partition
+			Position EssenceStart;				//!< File position of the first essence byte
+			Length EssenceLength;				//!< Number of bytes before the next partition pack, or -1 if this is the last partition in the file
+			Position PartitionStart;			//!< File position of the partition pack
+		};
+
+		//! Comparison of seek table entries by stream offset, for sorting and binary searching
+		static bool SeekEntryBefore(const SeekEntry &Left, const SeekEntry &Right) { return Left.StreamOffset < Right.StreamOffset; }
+
+		//! The essence partitions of each stream, sorted by stream offset and indexed by BodySID
+		std::map<UInt32, std::vector<SeekEntry> > SeekTables;
+
 	public:
 		//! Construct a body reader and associate it with an MXF file
 		BodyReader(MXFFilePtr File);
@@ -3173,6 +3309,12 @@ namespace mxflib
 		//! Are we currently at the end of the file?
 		bool Eof(void);
 
+		//! Get the I/O and parsing statistics of the file being read
+		/*! This includes the essence time of all GCReaders, and any seeks made to build the per SID seek tables.
+		 *  \note Statistics are only collected once MXFFile::EnableStatistics() has been called for the file
+		 */
+		const MXFFileStatistics &GetStatistics(void) { return File->GetStatistics(); }
+
 
 		/*** Functions for use by read handlers ***/
 
@@ -3187,6 +3329,11 @@ namespace mxflib
 		 *  \return False if seeking could not be initialized (perhaps because the file is not seekable)
 		 */
 		bool InitSeek(void);
+
+		//! Find the file position of a byte offset in a given stream using the seek table
+		/*! \return The file position, or -1 if the offset is not covered by the table
+		 */
+		Position LookupSeekTable(UInt32 BodySID, Position Pos);
 	};
 
 	//! Smart pointer to a BodyReader
@@ -3237,6 +3384,19 @@ namespace mxflib
 	//! Get a GCElementKind structure from a key
 	GCElementKind GetGCElementKind(const ULPtr TheUL);
 
+	//! Classes of key recognised by ClassifyGCKey()
+	enum GCKeyClass
+	{
+		GCKeyOther = 0,				//!< Not one of the keys below (may still be a registered alternative GC essence key)
+		GCKeyEssence,				//!< A standard GC essence element key, with the track number in the last 4 bytes
+		GCKeyFiller,				//!< A KLV fill key, of any version
+		GCKeyEncrypted				//!< An encrypted triplet key
+	};
+
+	//! Classify a key by the class of KLV it starts
+	/*! This compares the key as two 64-bit words against each class, so is quick enough to use for every KLV read */
+	GCKeyClass ClassifyGCKey(const UInt8 *Key);
+
 	//! Determine if this is a system item
 	bool IsGCSystemItem(const ULPtr TheUL);
 
@@ -3500,6 +3660,9 @@ namespace mxflib
 		/*! \note Only the master stream is (currently) edit aligned, not all sub-streams */
 		bool EditAlign;
 
+		//! Wrapping units read ahead from each sub-stream by GetEssenceDataBatch() but not yet written, indexed by sub-stream
+		std::map<EssenceSource *, DataChunkList> ReadAhead;
+
 
 		//! Prevent NULL construction
 		BodyStream();
@@ -3736,6 +3899,21 @@ namespace mxflib
 		//! Get the position of the stream in edit units since the start of the stream
 		Position GetPosition(void);
 
+		//! Get the next wrapping unit of essence data from one of the sub-streams of this stream
+		/*! If nothing has already been read ahead from this sub-stream, up to BatchSize wrapping units are read
+		 *  in one go with GetEssenceDataBatch(), the first is returned and the rest are held for later calls.
+		 *  \return As for EssenceSource::GetEssenceData()
+		 */
+		DataChunkPtr GetSubStreamData(EssenceSourcePtr &SubStream, size_t BatchSize = 1);
+
+		//! Get the number of wrapping units read ahead from the given sub-stream but not yet returned by GetSubStreamData()
+		size_t GetReadAheadCount(EssenceSource *SubStream)
+		{
+			std::map<EssenceSource *, DataChunkList>::iterator it = ReadAhead.find(SubStream);
+			if(it == ReadAhead.end()) return 0;
+			return (*it).second.size();
+		}
+
 		//! Set or clear the fixed position for this stream
 		/*! This allows the position to be fixed at the start of processing an edit unit, then unfixed at the end */
 		void SetFixedPosition(Position Pos = (0 - 0x7fffffff))
@@ -3886,6 +4064,15 @@ namespace mxflib
 		 */
 		UInt32 PartitionBodySID;
 
+		//! The maximum number of wrapping units to read from each sub-stream in a single operation
+		size_t ReadBatchSize;
+
+		//! Number of essence bytes that may be written for all streams in one interleave round, or 0 for simple round-robin
+		Length InterleaveBudget;
+
+		//! Minimum number of edit units in each scheduled body partition
+		Length MinInterleaveDuration;
+
 		//! Prevent NULL construction
 		BodyWriter();
 
@@ -3918,6 +4105,11 @@ namespace mxflib
 			PendingMetadata = false;
 			PartitionBodySID = 0;
 			PendingGeneric = false;
+
+			ReadBatchSize = 8;
+
+			InterleaveBudget = 0;
+			MinInterleaveDuration = 1;
 		}
 
 		//! Clear any stream details ready to call AddStream()
@@ -3950,6 +4142,38 @@ namespace mxflib
 		//! Get flag stating whether BER lengths should be forced to 4-byte (where possible)
 		bool GetForceBER4(void) { return ForceBER4; }
 
+		//! Set the maximum number of wrapping units to read from each sub-stream in a single operation
+		/*! Reading several frames at once from a parser can greatly reduce the number of file reads. Set to 1 to disable
+		 *  \note Read-ahead is never used for streams with VBR index tables or edit aligned partitions
+		 */
+		void SetReadBatchSize(size_t Size) { ReadBatchSize = Size ? Size : 1; }
+
+		//! Get the maximum number of wrapping units to read from each sub-stream in a single operation
+		size_t GetReadBatchSize(void) { return ReadBatchSize; }
+
+		//! Schedule body partitions for many concurrent streams within a memory budget
+		/*! When writing many body streams the simple round-robin writes one small partition per stream each time
+		 *  the streams alternate. With a budget set, each pass through the streams (an "interleave round") covers
+		 *  the same period of time for every stream, and that period is made as long as possible while the essence
+		 *  written for all streams in one round fits in Budget bytes. This is the amount a reader, or a writer
+		 *  buffering live essence, must hold to keep all streams in step, and gives one partition per stream per round.
+		 *  The next stream written is always the one that is furthest behind in time, so streams with different
+		 *  edit rates or partition durations stay aligned.
+		 *  \param Budget The number of essence bytes in one round, or 0 to restore simple round-robin
+		 *  \param MinDuration The minimum number of edit units in each partition, this is also used for the first
+		 *                     round as the data rate of a VBR stream is not known until some of it has been written
+		 *  \note The Duration and MaxPartitionSize parameters of WriteBody() and WritePartition() still apply, the
+		 *        smaller limit is used
+		 */
+		void SetInterleaveBudget(Length Budget, Length MinDuration = 1)
+		{
+			InterleaveBudget = Budget;
+			MinInterleaveDuration = MinDuration > 0 ? MinDuration : 1;
+		}
+
+		//! Get the number of essence bytes that may be written for all streams in one interleave round, or 0 if not scheduling
+		Length GetInterleaveBudget(void) { return InterleaveBudget; }
+
 		//! Set what sort of data may share with header metadata
 		void SetMetadataSharing(bool IndexMayShare = true, bool EssenceMayShare = false)
 		{
@@ -4061,6 +4285,20 @@ namespace mxflib
 
 		//! Write a partition pack for the current partition - but do not flag it as "ended"
 		void WritePartitionPack(void);
+
+		//! Select the active body stream that is furthest behind in time, when scheduling within an interleave budget
+		void SelectScheduledStream(void);
+
+		//! Get the position of a stream in seconds
+		double GetStreamTime(BodyStreamPtr &Stream);
+
+		//! Get the number of essence bytes per second written for a stream, or 0 if not yet known
+		double GetStreamByteRate(BodyStreamPtr &Stream);
+
+		//! Get the number of edit units and bytes to write for a stream in the current interleave round
+		/*! \return The duration in edit units, MaxSize is set to the number of bytes
+		 */
+		Length GetScheduledDuration(BodyStreamPtr &Stream, Length &MaxSize);
 	};
 
 	//! Smart pointer to a BodyWriter
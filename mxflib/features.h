@@ -83,6 +83,7 @@ namespace mxflib
 	const UInt64 FeatureStreamZeroBase    = UINT64_C(1) << 3;	//!< MXFLib feature: Set GC Essence Element Key StreamBase = 0, not 1
 	const UInt64 FeatureForceAES		  = UINT64_C(1) << 4;	//!< MXFLib feature: Force PCM to act like AES
 	const UInt64 FeatureAlignAllStreams	  = UINT64_C(1) << 5;	//!< MXFLib feature: Add alignment between GC Elements of same Type
+	const UInt64 FeatureMPEGPreScan		  = UINT64_C(1) << 6;	//!< MXFLib feature: Pre-scan MPEG-2 video when identifying it to find the GOP structure and index details
 
 	/* This sub-range is currently used by temporary fixes (bits 16 to 30) */
 
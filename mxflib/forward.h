@@ -51,6 +51,17 @@ namespace mxflib
 	//! A smart pointer to a KLVObject object
 	typedef SmartPtr<KLVObject> KLVObjectPtr;
 
+	// Forward declare the crypto wrappers so that essence writers can hold them
+	class Encrypt_Base;
+
+	//! A smart pointer to an encryption wrapper object
+	typedef SmartPtr<Encrypt_Base> EncryptPtr;
+
+	class Hash_Base;
+
+	//! A smart pointer to a hash function wrapper object
+	typedef SmartPtr<Hash_Base> HashPtr;
+
 
 	/* Forward refs for index tables */
 
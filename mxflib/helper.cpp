@@ -253,6 +253,96 @@ int mxflib::EncodeOID( UInt8* presult, UInt64 subid, int length )
 }
 
 
+#ifndef DISALLOW_RFC4122
+
+#ifdef _MSC_VER
+#define MXFLIB_THREAD_LOCAL __declspec(thread)
+#else
+#define MXFLIB_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	//! State of the per-thread UUID generator (xoshiro256**), all zero until first used
+	/*! DRAGONS: Must remain a POD type to be thread-local with __thread or __declspec(thread) */
+	struct RandomUUIDState
+	{
+		UInt64 s[4];
+	};
+
+	MXFLIB_THREAD_LOCAL RandomUUIDState UUIDState;
+
+	//! Rotate a 64-bit value left
+	inline UInt64 Rotate64(UInt64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+	//! Get the next value from the per-thread generator
+	inline UInt64 NextRandom64(RandomUUIDState &State)
+	{
+		UInt64 Ret = Rotate64(State.s[1] * 5, 7) * 9;
+		UInt64 t = State.s[1] << 17;
+
+		State.s[2] ^= State.s[0];
+		State.s[3] ^= State.s[1];
+		State.s[1] ^= State.s[2];
+		State.s[0] ^= State.s[3];
+		State.s[2] ^= t;
+		State.s[3] = Rotate64(State.s[3], 45);
+
+		return Ret;
+	}
+
+	//! Seed the per-thread generator from the system UUID generator
+	void SeedRandomUUID(RandomUUIDState &State)
+	{
+		UInt8 Seed[32];
+		MakeUUID(Seed);
+		MakeUUID(&Seed[16]);
+
+		// Mix in something that differs between threads, in case the system generator is weak
+		UInt64 Mix = static_cast<UInt64>(reinterpret_cast<size_t>(&State)) ^ static_cast<UInt64>(time(NULL));
+
+		// Spread each seed word through the whole state word (splitmix64), this also ensures the state is not all zero
+		for(int i = 0; i < 4; i++)
+		{
+			Mix += GetU64(&Seed[i * 8]) + UINT64_C(0x9e3779b97f4a7c15);
+
+			UInt64 z = Mix;
+			z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+			z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+			State.s[i] = z ^ (z >> 31);
+		}
+
+		if(!(State.s[0] | State.s[1] | State.s[2] | State.s[3])) State.s[0] = 1;
+	}
+}
+
+//! Generate a random (RFC 4122 version 4) UUID
+/*! DRAGONS: A process forked after generating UUIDs continues the same sequence as its parent in the forking thread
+ */
+void mxflib::MakeRandomUUID(UInt8 *Buffer)
+{
+	RandomUUIDState &State = UUIDState;
+	if(!(State.s[0] | State.s[1] | State.s[2] | State.s[3])) SeedRandomUUID(State);
+
+	PutU64(NextRandom64(State), Buffer);
+	PutU64(NextRandom64(State), &Buffer[8]);
+
+	// Set the version (4 = random) and the variant (RFC 4122)
+	Buffer[6] = (Buffer[6] & 0x0f) | 0x40;
+	Buffer[8] = (Buffer[8] & 0x3f) | 0x80;
+}
+
+#else // DISALLOW_RFC4122
+
+//! Generate a UUID - version 4 UUIDs are not allowed so use the system generator
+void mxflib::MakeRandomUUID(UInt8 *Buffer)
+{
+	MakeUUID(Buffer);
+}
+
+#endif // DISALLOW_RFC4122
+
+
 //! Build a new UMID from given values
 //!AssetID is 16 bytes with the desired UUID
 UMIDPtr mxflib::MakeUMIDFromUUID(  int Type, const UInt8* AssetID )
@@ -318,7 +408,7 @@ UMIDPtr mxflib::MakeUMID(int Type, const UUID *AssetID)
 	if( ( !AssetID ) || ( AssetID->Size() != 16 ) )
 	{
 		UInt8 UUIDbuffer[16];
-		MakeUUID(UUIDbuffer);
+		MakeRandomUUID(UUIDbuffer);
 		memcpy( &Buffer[16], &UUIDbuffer[0], 16 );
 	}
 	else
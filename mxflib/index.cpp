@@ -133,6 +133,8 @@ bool IndexTable::AddIndexEntry(Position EditUnit, Int8 TemporalOffset, Int8 KeyF
  */
 IndexPosPtr IndexTable::Lookup(Position EditUnit, int SubItem /* =0 */, bool Reorder /* =true */)
 {
+	MXFLIB_TRACE_SPAN("IndexTable::Lookup");
+
 	IndexPosPtr Ret = new IndexPos;
 
 	// Deal with CBR first
@@ -511,7 +513,7 @@ void IndexTable::AddSegments(DataChunkPtr &IndexChunk)
 	UInt8 const *pData = IndexChunk->Data;
 	Length Size = IndexChunk->Size;
 
-	debug("In IndexTable::AddSegments() - 0x%s bytes at %p\n", Int64toHexString(Size, 4).c_str(), pData);
+	mxflib_debug("In IndexTable::AddSegments() - 0x%s bytes at %p\n", Int64toHexString(Size, 4).c_str(), pData);
 	while(Size > 17)
 	{
 		UL SetKey(pData);
@@ -531,7 +533,7 @@ void IndexTable::AddSegments(DataChunkPtr &IndexChunk)
 
 		if(SetKey.Matches(IndexTableSegment_UL))
 		{
-			debug("%s is 0x%s bytes at %p\n", SetKey.GetString().c_str(), Int64toHexString(SetLength, 4).c_str(), pData);
+			mxflib_debug("%s is 0x%s bytes at %p\n", SetKey.GetString().c_str(), Int64toHexString(SetLength, 4).c_str(), pData);
 			AddSegment(pData, SetLength, 2);
 		}
 		else if(!SetKey.Matches(KLVFill_UL))
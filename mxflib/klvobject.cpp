@@ -29,6 +29,11 @@
 
 #include "mxflib.h"
 
+#ifdef MXFLIB_THREADS
+#include <IlmThread.h>
+#include <IlmThreadPool.h>
+#endif // MXFLIB_THREADS
+
 using namespace mxflib;
 
 //! Build a new KLVObject
@@ -247,3 +252,245 @@ size_t KLVObject::Base_WriteDataTo(const UInt8 *Buffer, Position Offset, size_t
 	return Dest.File->Write(Buffer, Size);
 }
 
+
+//! Build a map for audio at a given sample rate
+ClipWrapMap::ClipWrapMap(Rational EditRate, UInt32 SampleRate, UInt32 BlockAlign)
+	: EditUnitByteCount(0), SamplesNum(0), SamplesDen(0), BlockAlign(BlockAlign)
+{
+	if((EditRate.Numerator <= 0) || (EditRate.Denominator <= 0) || (SampleRate == 0))
+	{
+		error("Invalid edit rate or sample rate for ClipWrapMap\n");
+		return;
+	}
+
+	// The number of samples per edit unit is SamplesNum / SamplesDen
+	SamplesNum = static_cast<UInt64>(EditRate.Denominator) * SampleRate;
+	SamplesDen = static_cast<UInt64>(EditRate.Numerator);
+
+	// Keep the fraction small to give the most headroom before overflow
+	UInt64 Divisor = SamplesNum;
+	UInt64 Remainder = SamplesDen;
+	while(Remainder)
+	{
+		UInt64 Temp = Divisor % Remainder;
+		Divisor = Remainder;
+		Remainder = Temp;
+	}
+	SamplesNum /= Divisor;
+	SamplesDen /= Divisor;
+}
+
+
+//! Get the offset within the value of the first byte of an edit unit
+Position ClipWrapMap::GetOffset(Position EditUnit) const
+{
+	if(EditUnitByteCount) return EditUnit * EditUnitByteCount;
+	if(!SamplesDen) return 0;
+
+	// Each edit unit ends at the whole sample nearest to its exact end
+	UInt64 Sample = ((2 * static_cast<UInt64>(EditUnit) * SamplesNum) + SamplesDen) / (2 * SamplesDen);
+
+	return static_cast<Position>(Sample * BlockAlign);
+}
+
+
+//! Get the number of complete edit units in a value of the given length
+Length ClipWrapMap::GetDuration(Length ValueLength) const
+{
+	if(EditUnitByteCount) return ValueLength / EditUnitByteCount;
+	if((!SamplesNum) || (!BlockAlign)) return 0;
+
+	// Start from the exact value, which is never more than one edit unit out after rounding
+	Length Ret = static_cast<Length>(((ValueLength / BlockAlign) * SamplesDen) / SamplesNum);
+
+	while((Ret > 0) && (GetOffset(Ret) > ValueLength)) Ret--;
+	while(GetOffset(Ret + 1) <= ValueLength) Ret++;
+
+	return Ret;
+}
+
+
+//! Details of a window being read on the thread pool
+struct KLVValueReader::ReadAheadJob
+{
+	MXFFilePtr File;					//!< The file being read
+	Position Location;					//!< The position in the file of the first byte
+	Position Offset;					//!< The offset within the value of the first byte
+	DataChunkPtr Buffer;				//!< The buffer being filled, sized to the number of bytes requested
+	size_t Bytes;						//!< The number of bytes actually read
+#ifdef MXFLIB_THREADS
+	IlmThread::TaskGroup *Group;		//!< Group holding the task running Execute()
+#endif // MXFLIB_THREADS
+
+	ReadAheadJob() : Bytes(0)
+	{
+#ifdef MXFLIB_THREADS
+		Group = NULL;
+#endif // MXFLIB_THREADS
+	}
+
+	~ReadAheadJob() { Wait(); }
+
+	//! Read the window
+	void Execute(void) { Bytes = File->ReadAt(Location, Buffer->Data, Buffer->Size); }
+
+	//! Wait for Execute() to complete
+	void Wait(void)
+	{
+#ifdef MXFLIB_THREADS
+		// DRAGONS: The TaskGroup destructor waits for all its tasks to complete
+		delete Group;
+		Group = NULL;
+#endif // MXFLIB_THREADS
+	}
+};
+
+
+#ifdef MXFLIB_THREADS
+namespace
+{
+	//! Task to read one window of a KLV value
+	class ReadAheadTask : public IlmThread::Task
+	{
+	public:
+		ReadAheadTask(IlmThread::TaskGroup *Group, KLVValueReader::ReadAheadJob *Job) : Task(Group), Job(Job) {}
+
+		virtual void execute() { Job->Execute(); }
+
+	private:
+		KLVValueReader::ReadAheadJob *Job;		//!< The window to read
+	};
+}
+#endif // MXFLIB_THREADS
+
+
+//! Construct a reader for the value of a KLVObject
+/*! \param Object The object to read, which must have had its key and length read
+ *  \param WindowSize The number of bytes returned by each ReadNext()
+ *  \param ReadAhead True to read the next window on the thread pool, if possible
+ */
+KLVValueReader::KLVValueReader(KLVObjectPtr Object, size_t WindowSize /*=1024*1024*/, bool ReadAhead /*=false*/)
+	: Object(Object), ValueStart(-1), WindowSize(WindowSize ? WindowSize : 1), Current(0), ReadAhead(false), Pending(NULL)
+{
+	ValueLength = Object->GetLength();
+	ValueStart = Object->GetValueLocation();
+	if(ValueStart >= 0) File = Object->GetSourceFile();
+
+#ifdef MXFLIB_THREADS
+	// Only read ahead if the file can be read without disturbing other users
+	if(ReadAhead && File && File->CanReadAt()) this->ReadAhead = true;
+#else // MXFLIB_THREADS
+	UNUSED_PARAMETER(ReadAhead);
+#endif // MXFLIB_THREADS
+}
+
+
+//! Destructor, waits for any read-ahead to complete
+KLVValueReader::~KLVValueReader()
+{
+	delete Pending;
+}
+
+
+//! Read the next window of the value
+/*! \return The data, which is shorter than the window size at the end of the value, or NULL once the end has been reached
+ */
+DataChunkPtr KLVValueReader::ReadNext(void)
+{
+	if(Current >= ValueLength) return NULL;
+
+	DataChunkPtr Ret;
+
+	// Use the read-ahead window if it is the one we want - it won't be if Seek() has been called
+	if(Pending)
+	{
+		if(Pending->Offset == Current)
+		{
+			Pending->Wait();
+			Ret = Pending->Buffer;
+			if(Pending->Bytes != Ret->Size) Ret->Resize(Pending->Bytes);
+		}
+
+		delete Pending;
+		Pending = NULL;
+	}
+
+	if(!Ret) Ret = Read(Current, WindowSize);
+
+	if(Ret->Size == 0)
+	{
+		error("Unable to read the value of KLV at %s from offset 0x%s\n", Object->GetSourceLocation().c_str(), Int64toHexString(Current, 8).c_str());
+
+		// Don't keep trying to read past the problem
+		Current = ValueLength;
+		return NULL;
+	}
+
+	Current += Ret->Size;
+
+	if(ReadAhead && (Current < ValueLength)) StartReadAhead();
+
+	return Ret;
+}
+
+
+//! Start reading the window at Current on the thread pool
+void KLVValueReader::StartReadAhead(void)
+{
+#ifdef MXFLIB_THREADS
+	Length Size = ValueLength - Current;
+	if(Size > static_cast<Length>(WindowSize)) Size = static_cast<Length>(WindowSize);
+
+	Pending = new ReadAheadJob;
+	Pending->File = File;
+	Pending->Location = ValueStart + Current;
+	Pending->Offset = Current;
+	Pending->Buffer = new DataChunk(static_cast<size_t>(Size));
+
+	Pending->Group = new IlmThread::TaskGroup;
+	IlmThread::ThreadPool::addGlobalTask(new ReadAheadTask(Pending->Group, Pending));
+#endif // MXFLIB_THREADS
+}
+
+
+//! Read a range of the value, without changing the position of the next window
+/*! \return The data, which is shorter than Size if the range extends beyond the end of the value
+ */
+DataChunkPtr KLVValueReader::Read(Position Offset, size_t Size)
+{
+	DataChunkPtr Ret = new DataChunk;
+
+	if((Offset < 0) || (Offset >= ValueLength)) return Ret;
+	if(static_cast<Length>(Size) > (ValueLength - Offset)) Size = static_cast<size_t>(ValueLength - Offset);
+
+	if(File)
+	{
+		Ret->Resize(Size);
+		size_t Bytes = File->ReadAt(ValueStart + Offset, Ret->Data, Size);
+		if(Bytes != Size) Ret->Resize(Bytes);
+	}
+	else
+	{
+		Object->ReadDataFrom(Offset, Size);
+		Ret->TakeBuffer(Object->GetData(), true);
+	}
+
+	return Ret;
+}
+
+
+//! Read a run of edit units from a clip wrapped value
+DataChunkPtr KLVValueReader::ReadEditUnits(const ClipWrapMap &Map, Position EditUnit, Length Count /*=1*/)
+{
+	Position Start = Map.GetOffset(EditUnit);
+	Length Size = Map.GetOffset(EditUnit + Count) - Start;
+
+	// Sanity check the size of this read
+	if((sizeof(size_t) < 8) && (Size > 0xffffffff))
+	{
+		error("Tried to read > 4GBytes, but this platform can only handle <= 4GByte chunks\n");
+		return new DataChunk;
+	}
+
+	return Read(Start, static_cast<size_t>(Size));
+}
@@ -237,6 +237,18 @@ namespace mxflib
 		//! Get text that describes where this item came from
 		virtual std::string GetSource(void);
 
+		//! Get the file this item was read from, or NULL if not read from a file
+		MXFFilePtr GetSourceFile(void) { return Source.File; }
+
+		//! Get the position of the first byte of the value in the source file, so that it can be read directly
+		/*! \return -1 if the value can only be read with ReadDataFrom(), such as when a read handler is set
+		 */
+		virtual Position GetValueLocation(void)
+		{
+			if(ReadHandler || (!Source.File) || (Source.Offset < 0) || (Source.KLSize < 0)) return -1;
+			return Source.Offset + Source.KLSize;
+		}
+
 		//! Get text that describes exactly where this item came from
 		std::string GetSourceLocation(void) 
 		{
@@ -430,6 +442,114 @@ namespace mxflib
 		//! Get a reference to the data chunk
 		virtual DataChunk& GetData(void) { return Data; }
 	};
+
+
+	//! Maps edit units to byte ranges within the value of a clip wrapped KLV
+	/*! Either every edit unit is the same size, or the essence is audio where each edit unit holds the
+	 *  whole number of samples nearest to its exact end, which gives the same sample sequences as the
+	 *  WAVE PCM essence parser (such as 1602, 1601, 1602, 1601, 1602 for 48kHz at 30000/1001)
+	 */
+	class ClipWrapMap
+	{
+	protected:
+		UInt32 EditUnitByteCount;			//!< Size of each edit unit, or 0 if calculated from the sample rate
+		UInt64 SamplesNum;					//!< Numerator of the number of samples per edit unit
+		UInt64 SamplesDen;					//!< Denominator of the number of samples per edit unit
+		UInt32 BlockAlign;					//!< Size of one sample for all channels
+
+	public:
+		//! Build a map for edit units of a constant size, such as from IndexTable::EditUnitByteCount
+		ClipWrapMap(UInt32 EditUnitByteCount = 0) : EditUnitByteCount(EditUnitByteCount), SamplesNum(0), SamplesDen(0), BlockAlign(0) {}
+
+		//! Build a map for audio at a given sample rate
+		ClipWrapMap(Rational EditRate, UInt32 SampleRate, UInt32 BlockAlign);
+
+		//! Does this map give valid ranges?
+		bool IsValid(void) const { return (EditUnitByteCount != 0) || ((BlockAlign != 0) && (SamplesDen != 0)); }
+
+		//! Get the offset within the value of the first byte of an edit unit
+		Position GetOffset(Position EditUnit) const;
+
+		//! Get the number of bytes in a run of edit units
+		Length GetSize(Position EditUnit, Length Count = 1) const { return GetOffset(EditUnit + Count) - GetOffset(EditUnit); }
+
+		//! Get the number of complete edit units in a value of the given length
+		Length GetDuration(Length ValueLength) const;
+	};
+
+
+	// Forward declare so the class can include pointers to itself
+	class KLVValueReader;
+
+	//! A smart pointer to a KLVValueReader object
+	typedef SmartPtr<KLVValueReader> KLVValueReaderPtr;
+
+	//! Reads the value of a KLVObject in windows of a fixed size, so that values of any size can be processed in constant memory
+	/*! Where the value can be read directly from the source file (see KLVObject::GetValueLocation()) each window is read with
+	 *  MXFFile::ReadAt(), so the file pointer is not disturbed. If read-ahead is enabled, and the library is built with
+	 *  MXFLIB_THREADS, the next window is read on the thread pool while the current one is processed.
+	 *  Otherwise each window is read with KLVObject::ReadDataFrom(), which also supports read handlers and encrypted values.
+	 *  \note When reading through ReadDataFrom() the KLVObject's own DataChunk is used, and is left empty
+	 */
+	class KLVValueReader : public RefCount<KLVValueReader>
+	{
+	public:
+		struct ReadAheadJob;				//!< Details of a window being read on the thread pool, defined in klvobject.cpp
+
+	protected:
+		KLVObjectPtr Object;				//!< The object whose value is read
+		MXFFilePtr File;					//!< The file to read directly, or NULL if reading through Object
+		Position ValueStart;				//!< Position of the first byte of the value in File
+		Length ValueLength;					//!< Length of the value
+		size_t WindowSize;					//!< Number of bytes read by each ReadNext()
+		Position Current;					//!< Offset within the value of the next window
+		bool ReadAhead;						//!< True if the next window is read on the thread pool
+		ReadAheadJob *Pending;				//!< The window being read ahead, or NULL
+
+	private:
+		KLVValueReader(const KLVValueReader &);			//!< Prevent copy-construction
+		KLVValueReader &operator=(const KLVValueReader &);	//!< Prevent assignment
+
+	public:
+		//! Construct a reader for the value of a KLVObject
+		/*! \param Object The object to read, which must have had its key and length read
+		 *  \param WindowSize The number of bytes returned by each ReadNext()
+		 *  \param ReadAhead True to read the next window on the thread pool, if possible
+		 */
+		KLVValueReader(KLVObjectPtr Object, size_t WindowSize = 1024 * 1024, bool ReadAhead = false);
+
+		//! Destructor, waits for any read-ahead to complete
+		~KLVValueReader();
+
+		//! Read the next window of the value
+		/*! \return The data, which is shorter than the window size at the end of the value, or NULL once the end has been reached
+		 */
+		DataChunkPtr ReadNext(void);
+
+		//! Set the offset within the value of the next window, for example to resume an interrupted pass
+		void Seek(Position Offset) { Current = (Offset < 0) ? 0 : Offset; }
+
+		//! Get the offset within the value of the next window
+		Position Tell(void) { return Current; }
+
+		//! Has the whole value been read?
+		bool Eof(void) { return Current >= ValueLength; }
+
+		//! Get the length of the value
+		Length GetLength(void) { return ValueLength; }
+
+		//! Read a range of the value, without changing the position of the next window
+		/*! \return The data, which is shorter than Size if the range extends beyond the end of the value
+		 */
+		DataChunkPtr Read(Position Offset, size_t Size);
+
+		//! Read a run of edit units from a clip wrapped value
+		DataChunkPtr ReadEditUnits(const ClipWrapMap &Map, Position EditUnit, Length Count = 1);
+
+	protected:
+		//! Start reading the window at Current on the thread pool
+		void StartReadAhead(void);
+	};
 }
 
 #endif // MXFLIB__KLVOBJECT_H
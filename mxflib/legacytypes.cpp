@@ -1163,6 +1163,7 @@ namespace
 		SymbolSpacePtr DictSymbolSpace;		//!< Default symbol space to use for all classes (in the whole dictionary)
 		ClassRecordList ClassList;			//!< Class being built at this level (one for each level in the hierarchy)
 		ClassRecordList ClassesToBuild;		//!< Top level classes that need to be built at the end of the parsing
+		Dictionary *Collect;				//!< If not NULL, types are added to this dictionary rather than being loaded as they are parsed
 	};
 }
 
@@ -1179,6 +1180,7 @@ int mxflib::LoadLegacyDictionary(const char *DictFile, SymbolSpacePtr DefaultSym
 	State.State = DictStateIdle;
 	State.DefaultSymbolSpace = DefaultSymbolSpace;
 	State.DictSymbolSpace = DefaultSymbolSpace;
+	State.Collect = NULL;
 
 	// Initialize the Types parser state
 	State.ClassState.State = StateIdle;
@@ -1214,6 +1216,46 @@ int mxflib::LoadLegacyDictionary(const char *DictFile, SymbolSpacePtr DefaultSym
 }
 
 
+//! Parse a legacy format XML dictionary without loading it
+/*! \return NULL on error
+ */
+DictionaryPtr mxflib::ParseLegacyDictionary(const char *DictFile, SymbolSpacePtr DefaultSymbolSpace)
+{
+	DictionaryPtr Ret = new Dictionary;
+
+	// State data block passed through XML parser
+	DictParserState State;
+
+	// Initialize the state
+	State.State = DictStateIdle;
+	State.DefaultSymbolSpace = DefaultSymbolSpace;
+	State.DictSymbolSpace = DefaultSymbolSpace;
+	State.Collect = Ret;
+
+	// Initialize the Types parser state
+	State.ClassState.State = StateIdle;
+	State.ClassState.DefaultSymbolSpace = DefaultSymbolSpace;
+	State.ClassState.LabelsOnly = false;
+	State.ClassState.KindType = false;
+
+	std::string XMLFilePath = LookupDictionaryPath(DictFile);
+
+	// Parse the file
+	bool result = false;
+
+	if(XMLFilePath.size()) result = XMLParserParseFile(&DictLoad_XMLHandler, &State, XMLFilePath.c_str());
+	if (!result)
+	{
+		XML_fatalError(NULL, "Failed to parse dictionary \"%s\"\n", XMLFilePath.size() ? XMLFilePath.c_str() : DictFile);
+		return NULL;
+	}
+
+	if(!State.ClassesToBuild.empty()) Ret->Classes.push_back(State.ClassesToBuild);
+
+	return Ret;
+}
+
+
 //load dictionary from a string
 int mxflib::LoadLegacyDictionaryFromXML(std::string & strXML, bool FastFail)
 {
@@ -1229,6 +1271,7 @@ int mxflib::LoadLegacyDictionaryFromXML(std::string & strXML, bool FastFail)
 	State.State = DictStateIdle;
 	State.DefaultSymbolSpace = MXFLibSymbols;
 	State.DictSymbolSpace = MXFLibSymbols;
+	State.Collect = NULL;
 
 	// Initialize the Types parser state
 	State.ClassState.State = StateIdle;
@@ -1813,8 +1856,9 @@ namespace
 			// Do a load if we have hit the end of the types
 			if(State->ClassState.State == StateDone)
 			{
-				// Load the types that were found
-				LoadTypes(State->ClassState.Types);
+				// Load the types that were found, or keep them if we are only parsing
+				if(State->Collect) State->Collect->Types.push_back(State->ClassState.Types);
+				else LoadTypes(State->ClassState.Types);
 
 				// Clear these types now they have been loaded
 				State->ClassState.Types.clear();
@@ -82,6 +82,15 @@ namespace mxflib
 	*  \return -1 on error
 	*/
 	int LoadLegacyDictionaryFromXML(std::string &strXML, bool FastFail = false);
+
+	//! Parse a legacy format XML dictionary without loading it
+	/*! The types sections are returned in file order and all classes are returned as a single list,
+	 *  matching the order in which LoadLegacyDictionary() would load them.
+	 *  \return NULL on error
+	 *  \note The types must be loaded with MXFLibSymbols as the default symbol space, as LoadLegacyDictionary() does,
+	 *        and the classes with DefaultSymbolSpace
+	 */
+	DictionaryPtr ParseLegacyDictionary(const char *DictFile, SymbolSpacePtr DefaultSymbolSpace);
 }
 
 #endif // MXFLIB__LEGACYTYPES_H
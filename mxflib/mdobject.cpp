@@ -1482,7 +1482,7 @@ warning("Entered dead code for reading old-style batches/arrays for %s\n", FullN
 
 	case PACK:
 		{
-			debug("Reading pack at 0x%s\n", Int64toHexString(GetLocation(), 8).c_str());
+			mxflib_debug("Reading pack at 0x%s\n", Int64toHexString(GetLocation(), 8).c_str());
 
 			if( Type->GetLenFormat() == DICT_LEN_NONE )
 			{
@@ -1622,7 +1622,7 @@ warning("Entered dead code for reading old-style batches/arrays for %s\n", FullN
 
 	case SET:
 		{
-			debug("Reading set at 0x%s\n", Int64toHexString(GetLocation(), 8).c_str());
+			mxflib_debug("Reading set at 0x%s\n", Int64toHexString(GetLocation(), 8).c_str());
 
 			// Start with an empty list
 			clear();
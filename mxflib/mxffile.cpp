@@ -33,6 +33,7 @@
 #include <errno.h>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
 
 #include "mxflib.h"
 
@@ -266,15 +267,50 @@ bool mxflib::MXFFile::Crop(Position NewSize /*= -1 */)
 
 
 
+//! Get the counters as a JSON object
+std::string mxflib::MXFFileStatistics::GetJSON(void) const
+{
+	std::string Ret = "{";
+
+	Ret += "\"ReadCount\":" + UInt64toString(ReadCount);
+	Ret += ",\"ReadBytes\":" + UInt64toString(ReadBytes);
+	Ret += ",\"WriteCount\":" + UInt64toString(WriteCount);
+	Ret += ",\"WriteBytes\":" + UInt64toString(WriteBytes);
+	Ret += ",\"SeekCount\":" + UInt64toString(SeekCount);
+	Ret += ",\"BackwardSeekCount\":" + UInt64toString(BackwardSeekCount);
+	Ret += ",\"KLVCount\":" + UInt64toString(KLVCount);
+	Ret += ",\"ObjectCount\":" + UInt64toString(ObjectCount);
+	Ret += ",\"RIPPartitionCount\":" + UInt64toString(RIPPartitionCount);
+	Ret += ",\"IndexTime\":" + UInt64toString(IndexTime);
+	Ret += ",\"MetadataTime\":" + UInt64toString(MetadataTime);
+	Ret += ",\"EssenceTime\":" + UInt64toString(EssenceTime);
+
+	Ret += "}";
+
+	return Ret;
+}
+
+
+//! Get a monotonic time in microseconds
+UInt64 mxflib::StatisticsTimer::Now(void)
+{
+	return static_cast<UInt64>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
 //! Read data from the file into a DataChunk
 DataChunkPtr mxflib::MXFFile::Read(size_t Size)
 {
+	MXFLIB_TRACE_SPAN("MXFFile::Read");
+
 	DataChunkPtr Ret = new DataChunk(Size);
 
 	if(Size)
 	{
 		size_t Bytes;
 
+		if(CollectStats) Stats.ReadCount++;
+
 		if(isMemoryFile)
 		{
 			Bytes = MemoryRead(Ret->Data, Size);
@@ -291,6 +327,8 @@ DataChunkPtr mxflib::MXFFile::Read(size_t Size)
 			Bytes = 0;
 		}
 
+		if(CollectStats) Stats.ReadBytes += Bytes;
+
 		if(Bytes != Size) Ret->Resize(Bytes);
 	}
 
@@ -301,10 +339,14 @@ DataChunkPtr mxflib::MXFFile::Read(size_t Size)
 //! Read data from the file into a supplied buffer
 size_t mxflib::MXFFile::Read(UInt8 *Buffer, size_t Size)
 {
+	MXFLIB_TRACE_SPAN("MXFFile::Read");
+
 	size_t Ret = 0;
 
 	if(Size)
 	{
+		if(CollectStats) Stats.ReadCount++;
+
 		if(isMemoryFile)
 		{
 			Ret = MemoryRead(Buffer, Size);
@@ -320,12 +362,49 @@ size_t mxflib::MXFFile::Read(UInt8 *Buffer, size_t Size)
 			error("Error reading file \"%s\" at 0x%s - %s\n", Name.c_str(), Int64toHexString(Tell(), 8).c_str(), strerror(errno));
 			Ret = 0;
 		}
+
+		if(CollectStats) Stats.ReadBytes += Ret;
 	}
 
 	return Ret;
 }
 
 
+//! Read data from a given position into a supplied buffer, leaving the file pointer unchanged
+/*! If CanReadAt() is true the file pointer is not used, so this may be called from another thread
+ *  while the file is in use. Otherwise the file pointer is moved and then restored.
+ *  \return The number of bytes read
+ */
+size_t mxflib::MXFFile::ReadAt(Position Pos, UInt8 *Buffer, size_t Size)
+{
+	if(!Size) return 0;
+
+	size_t Ret;
+
+#ifdef MXFLIB_POSITIONAL_READ
+	if(!isMemoryFile)
+	{
+		Ret = FileReadAt(Handle, static_cast<UInt64>(Pos + RunInSize), Buffer, Size);
+
+		if(Ret == static_cast<size_t>(-1))
+		{
+			error("Error reading file \"%s\" at 0x%s - %s\n", Name.c_str(), Int64toHexString(Pos, 8).c_str(), strerror(errno));
+			Ret = 0;
+		}
+
+		return Ret;
+	}
+#endif // MXFLIB_POSITIONAL_READ
+
+	Position OldPos = Tell();
+	Seek(Pos);
+	Ret = Read(Buffer, Size);
+	Seek(OldPos);
+
+	return Ret;
+}
+
+
 //! Get a RIP for the open MXF
 /*! The RIP is read using ReadRIP() if possible.
  *  Otherwise it is Scanned using ScanRIP().
@@ -396,7 +475,7 @@ bool mxflib::MXFFile::ReadRIP(void)
 
 		UInt64 ByteOffset = (*it).second->Child(1)->GetUInt64();
 
-		debug("BodySID = 0x%04x, ByteOffset = %s\n", BodySID, Int64toString(ByteOffset).c_str());
+		mxflib_debug("BodySID = 0x%04x, ByteOffset = %s\n", BodySID, Int64toString(ByteOffset).c_str());
 
 		FileRIP.AddPartition(NULL, ByteOffset, BodySID);
 
@@ -503,10 +582,11 @@ bool mxflib::MXFFile::ScanRIP(Length MaxScan /* = 1024*1024 */ )
 
 		UInt32 BodySID = ThisPartition->GetUInt(BodySID_UL);
 
-		debug("Adding %s for BodySID 0x%04x at 0x%s\n", ThisPartition->Name().c_str(), BodySID, Int64toHexString(PartitionPos, 8).c_str());
+		mxflib_debug("Adding %s for BodySID 0x%04x at 0x%s\n", ThisPartition->Name().c_str(), BodySID, Int64toHexString(PartitionPos, 8).c_str());
 
 		// Add the new partition
 		FileRIP.AddPartition(ThisPartition, PartitionPos, BodySID);
+		if(CollectStats) Stats.RIPPartitionCount++;
 
 		// Stop once we have added the header
 		if(PartitionPos == 0) break;
@@ -604,7 +684,7 @@ Position MXFFile::FindFooter(Length MaxScan/*=1024*1024*/)
 						{
 							if(Type->IsA(CompleteFooter_UL) || Type->IsA(Footer_UL))
 							{
-								debug("Found %s at 0x%s\n", Type->Name().c_str(), Int64toHexString(Location, 8).c_str());
+								mxflib_debug("Found %s at 0x%s\n", Type->Name().c_str(), Int64toHexString(Location, 8).c_str());
 
 								// Flag that the footer has been found, and record its location
 								FooterPos = Location;
@@ -668,6 +748,7 @@ bool mxflib::MXFFile::BuildRIP(void)
 		if(Ptr) BodySID = Ptr->Value->GetInt();
 
 		FileRIP.AddPartition(ThisPartition, Location, BodySID);
+		if(CollectStats) Stats.RIPPartitionCount++;
 
 		Length Skip;
 
@@ -875,6 +956,208 @@ bool mxflib::MXFFile::BuildRIP(void)
 	return true;
 }
 
+//! Copy bytes from another file to the current position in this file
+/*! Where the system allows it the bytes are moved directly between the files without being read into memory,
+ *  otherwise they are copied through a single large buffer.
+ *  \return The number of bytes copied, which will be less than Size if an error occurs
+ *  \note The file pointer of Source is left at an undefined position
+ */
+Length mxflib::MXFFile::CopyFrom(MXFFilePtr Source, Position SourcePos, Length Size)
+{
+	if(Size <= 0) return 0;
+
+	Source->Seek(SourcePos);
+
+	Length Ret = 0;
+
+	// Try a direct copy between two physical files first
+	if((!isMemoryFile) && (!Source->isMemoryFile))
+	{
+		Ret = static_cast<Length>(FileCopy(Handle, Source->Handle, static_cast<UInt64>(Size)));
+		if(Ret == Size) return Ret;
+
+		// Continue from where the direct copy stopped
+		Source->Seek(SourcePos + Ret);
+	}
+
+	// Copy the rest through a buffer
+	const Length MaxBuffer = 4 * 1024 * 1024;
+	size_t BufferSize = static_cast<size_t>((Size - Ret) > MaxBuffer ? MaxBuffer : (Size - Ret));
+	DataChunk Buff(BufferSize);
+
+	while(Ret < Size)
+	{
+		size_t ThisCopy = static_cast<size_t>((Size - Ret) > static_cast<Length>(BufferSize) ? BufferSize : (Size - Ret));
+
+		size_t Bytes = Source->Read(Buff.Data, ThisCopy);
+		if(Bytes) Bytes = Write(Buff.Data, Bytes);
+
+		Ret += Bytes;
+
+		if(Bytes != ThisCopy)
+		{
+			error("Failed to copy 0x%s bytes from 0x%s in \"%s\" to \"%s\"\n", Int64toHexString(Size, 8).c_str(), Int64toHexString(SourcePos, 8).c_str(),
+				  Source->Name.c_str(), Name.c_str());
+			break;
+		}
+	}
+
+	return Ret;
+}
+
+
+//! Add any partitions that have been completed since the last call to FileRIP, for a file that is still being written
+/*! The first call scans forwards from the last partition already in FileRIP, or from the start of the file if FileRIP is empty.
+ *  Each later call continues from where the previous one stopped, so data that has already been examined is never read again.
+ *  A partition is only added once its header metadata and index table segments have been completely written.
+ *  \return The number of partitions added, or -1 on error
+ *  \note If the size of the file has not changed since the last call nothing is read
+ *  \note The file pointer is left at an undefined position
+ */
+int mxflib::MXFFile::FollowRIP(void)
+{
+	if((!isOpen) || isMemoryFile)
+	{
+		error("MXFFile::FollowRIP() can only follow an open physical file\n");
+		return -1;
+	}
+
+	// Polling is cheap if nothing has been written since the last call - the size is simply the result of a stat
+	Length CurrentSize = Size();
+	if(CurrentSize == FollowSize) return 0;
+	FollowSize = CurrentSize;
+
+	Position FileEnd = CurrentSize - RunInSize;
+
+	// Start following from the last partition that we already know about
+	if(FollowPos < 0)
+	{
+		if(FileRIP.empty()) FollowPos = 0;
+		else FollowPos = (*FileRIP.rbegin()).first;
+	}
+
+	int Ret = 0;
+	UInt8 Key[16];
+	while(FollowPos < FileEnd)
+	{
+		Position Location = FollowPos;
+		Position Next = FollowKLV(Location, FileEnd, Key);
+
+		// Stop at the first KLV that is still being written
+		if(Next == 0) break;
+
+		if(Next < 0)
+		{
+			error("Invalid KLV found at 0x%s while following growing file \"%s\"\n", Int64toHexString(Location, 8).c_str(), Name.c_str());
+			return -1;
+		}
+
+		if(IsPartitionKey(Key))
+		{
+			// If we already know about this partition we may already have read the pack
+			PartitionInfoPtr Info;
+			RIP::iterator it = FileRIP.find(Location);
+			if(it != FileRIP.end()) Info = (*it).second;
+
+			PartitionPtr ThisPartition;
+			if(Info) ThisPartition = Info->GetPartition();
+			if(!ThisPartition)
+			{
+				Seek(Location);
+				ThisPartition = ReadPartition();
+				if(!ThisPartition) return -1;
+			}
+
+			Length Skip = ThisPartition->GetInt64(HeaderByteCount_UL) + ThisPartition->GetInt64(IndexByteCount_UL);
+			if(Skip)
+			{
+				// The byte counts start after any filler that follows the partition pack
+				Position MetadataStart = Next;
+				Position AfterFill = FollowKLV(Next, FileEnd, Key);
+				if(AfterFill == 0) break;
+				if(AfterFill > 0)
+				{
+					MDOTypePtr ThisType = MDOType::Find(UL(Key));
+					if(ThisType && ThisType->IsA(KLVFill_UL)) MetadataStart = AfterFill;
+				}
+
+				// Don't add the partition until all the header metadata and index table segments are in the file
+				Next = MetadataStart + Skip;
+				if(Next > FileEnd) break;
+			}
+
+			UInt32 BodySID = ThisPartition->GetUInt(BodySID_UL);
+			UInt32 IndexSID = ThisPartition->GetUInt(IndexSID_UL);
+
+			if(!Info)
+			{
+				// Check that this partition links back to the last one we found - if not we have missed one, or this is not the file we started with
+				RIP::iterator Prev = FileRIP.lower_bound(Location);
+				if(Prev != FileRIP.begin())
+				{
+					Prev--;
+					Position PreviousPartition = ThisPartition->GetInt64(PreviousPartition_UL);
+					if(PreviousPartition != (*Prev).first)
+					{
+						warning("%s at 0x%s in growing file \"%s\" has PreviousPartition = 0x%s, but the previous partition found is at 0x%s\n",
+								ThisPartition->FullName().c_str(), Int64toHexString(Location, 8).c_str(), Name.c_str(),
+								Int64toHexString(PreviousPartition, 8).c_str(), Int64toHexString((*Prev).first, 8).c_str());
+					}
+				}
+
+				Info = FileRIP.AddPartition(ThisPartition, Location, BodySID);
+				if(CollectStats) Stats.RIPPartitionCount++;
+				FileRIP.isGenerated = true;
+				Ret++;
+			}
+			else
+				Info->SetPartition(ThisPartition);
+
+			Info->SetSIDs(BodySID, IndexSID);
+		}
+
+		FollowPos = Next;
+	}
+
+	return Ret;
+}
+
+
+//! Find the end of a KLV in a file that is still being written, provided that the KLV has been completely written
+/*! \param Key Buffer to receive the 16-byte key
+ *  \return Location of the following KLV, 0 if the KLV is not yet complete, or -1 if there is no valid KLV at Location
+ */
+Position mxflib::MXFFile::FollowKLV(Position Location, Position FileEnd, UInt8 *Key)
+{
+	// Read the key and as much of the length as has been written
+	UInt8 Buff[16 + 9];
+	Length Available = FileEnd - Location;
+	if(Available < 17) return 0;
+	if(Available > 25) Available = 25;
+
+	Seek(Location);
+	if(Read(Buff, static_cast<size_t>(Available)) != static_cast<size_t>(Available)) return 0;
+
+	if((Buff[0] != 0x06) || (Buff[1] != 0x0e) || (Buff[2] != 0x2b) || (Buff[3] != 0x34)) return -1;
+	memcpy(Key, Buff, 16);
+
+	// Check that the whole length has been written
+	int BERSize = 1;
+	if(Buff[16] > 0x80) BERSize += Buff[16] & 0x7f;
+	if(BERSize > 9) return -1;
+	if((16 + BERSize) > Available) return 0;
+
+	const UInt8 *p = &Buff[16];
+	Length Len = mxflib::ReadBER(&p, BERSize);
+	if(Len < 0) return -1;
+
+	Position Next = Location + 16 + BERSize + Len;
+	if(Next > FileEnd) return 0;
+
+	return Next;
+}
+
+
 //! Read a BER length from the open file
 /*! \return -1 on error
  */
@@ -918,6 +1201,8 @@ ULPtr mxflib::MXFFile::ReadKey(void)
 	// If we couldn't read 16-bytes then bug out (this may be valid)
 	if(Key->Size != 16) return Ret;
 
+	if(CollectStats) Stats.KLVCount++;
+
 /*
 	// Sanity check the keys
 	if((Key->Data[0] != 6) || (Key->Data[1] != 0x0e))
@@ -982,92 +1267,98 @@ UInt32 MXFFile::FillerSize(bool ForceBER4, UInt64 FillPos, UInt32 KAGSize, UInt3
 	if((Offset == 0) && (MinSize == 0)) return 0;
 
 	// Work out the required filler size
-	UInt32 Fill = KAGSize - Offset;
+	UInt64 Fill = KAGSize - Offset;
 
-	// Fix to minimum size;
-	while(Fill < MinSize) Fill += KAGSize;
-
-	// Adjust so that the filler can fit
+	// The filler must be at least the minimum size, and big enough to hold its own key and length
 	// Note that for very small KAGs the filler may be several KAGs long
-	if(ForceBER4)
-	{
-		while(Fill < 20) Fill += KAGSize;
-	}
-	else
-	{
-		while(Fill < 17) Fill += KAGSize;
-	}
+	UInt64 Needed = ForceBER4 ? 20 : 17;
+	if(MinSize > Needed) Needed = MinSize;
+
+	// Add as many whole KAGs as required
+	if(Fill < Needed) Fill += ((Needed - Fill + KAGSize - 1) / KAGSize) * KAGSize;
 
 	if(Fill > 0x00ffffff)
 	{
 		error("Maximum supported filler is 0x00ffffff bytes long, "
 			  "but attempt to fill from 0x%s to KAG of 0x%08x with "
 			  "MinSize=0x%08x requires a filler of size 0x%08x\n",
-			  Int64toHexString(FillPos, 8).c_str(), KAGSize, MinSize, Fill);
+			  Int64toHexString(FillPos, 8).c_str(), KAGSize, MinSize, (UInt32)Fill);
 		Fill = 0x00ffffff;
 	}
 
-	return Fill;
+	return static_cast<UInt32>(Fill);
+}
+
+
+namespace
+{
+	//! Number of zero bytes available for writing filler values
+	const size_t FillerZeroSize = 65536;
+
+	//! Zero bytes used as the value of every filler, so that writing a filler never needs a buffer of its own
+	const UInt8 FillerZeros[FillerZeroSize] = { 0 };
 }
 
 
 //! Write a filler to align to a specified KAG
-/*! \return The position after aligning
+/*! The key and length are built in a small local buffer and written along with the start of the value in a single write.
+ *  \return The position after aligning
  */
 UInt64 MXFFile::Align(bool ForceBER4, UInt32 KAGSize, UInt32 MinSize /*=0*/)
 {
 	if(KAGSize == 0) KAGSize = 1;
 
+	UInt64 Pos = Tell();
+
 	// Work out how big a filler we need
-	UInt32 Fill = FillerSize(ForceBER4, Tell(), KAGSize, MinSize);
+	UInt32 Fill = FillerSize(ForceBER4, Pos, KAGSize, MinSize);
 
 	// Nothing to do!
-	if(Fill == 0) return Tell();
-//if(Fill>0x10000)
-//printf("%d: Fill- %x\n",Handle, Fill );
-	if(Feature(FeatureVersion1KLVFill))
-	{
-		// Write the version 1 filler key
-		Write(KLVFill_UL.GetValue(), 7);
-		WriteU8(1);
-		Write(&KLVFill_UL.GetValue()[8], 8);
-	}
-	else
-	{
-	// Write the filler key
-		Write(KLVFill_UL.GetValue(), 16);
-	}
+	if(Fill == 0) return Pos;
+
+	// Build the key
+	UInt8 KL[20];
+	memcpy(KL, KLVFill_UL.GetValue(), 16);
+
+	// Use the version 1 filler key if required
+	if(Feature(FeatureVersion1KLVFill)) KL[7] = 1;
 
 	// Calculate filler length for shortform BER length
+	size_t KLSize;
 	Fill -= 17;
 	if((!ForceBER4) && (Fill < 3))
 	{
-		WriteU8(Fill);
+		KL[16] = static_cast<UInt8>(Fill);
+		KLSize = 17;
 	}
 	else
 	{
 		// Adjust for 4-byte BER length
 		Fill -= 3;
-		Write(*MakeBER(Fill, 4));
+		KL[16] = 0x83;
+		KL[17] = static_cast<UInt8>(Fill >> 16);
+		KL[18] = static_cast<UInt8>(Fill >> 8);
+		KL[19] = static_cast<UInt8>(Fill);
+		KLSize = 20;
 	}
 
-	// Write the filler value
-	UInt8 Buffer[256];
-	if(Fill > 256)
+	// Write the key, length and as much of the value as we can in one go
+	size_t Chunk = (Fill > FillerZeroSize) ? FillerZeroSize : Fill;
+	size_t Written = Write(KL, KLSize, FillerZeros, Chunk);
+	if(Written != KLSize + Chunk) return Tell();
+
+	// Write the rest of the value
+	Fill -= static_cast<UInt32>(Chunk);
+	while(Fill)
 	{
-		memset(Buffer, 0, 256);
-		while(Fill > 256)
-		{
-			Write(Buffer, 256);
-			Fill -= 256;
-		}
-	}
-	else
-		memset(Buffer, 0, Fill);
+		Chunk = (Fill > FillerZeroSize) ? FillerZeroSize : Fill;
+		if(Write(FillerZeros, Chunk) != Chunk) return Tell();
 
-	Write(Buffer, Fill);
+		Written += Chunk;
+		Fill -= static_cast<UInt32>(Chunk);
+	}
 
-	return Tell();
+	return Pos + Written;
 }
 
 
@@ -44,6 +44,70 @@ namespace mxflib
 
 namespace mxflib
 {
+	//! I/O and parsing statistics for an MXFFile
+	/*! These are only collected once MXFFile::EnableStatistics() has been called, and each one costs no more than an increment.
+	 *  Times are in microseconds, and include any reads made while loading the index, parsing the metadata or reading essence.
+	 *  \note Reads made with MXFFile::ReadAt() are not counted as they may be made from other threads
+	 */
+	struct MXFFileStatistics
+	{
+		UInt64 ReadCount;				//!< Number of read calls
+		UInt64 ReadBytes;				//!< Number of bytes read
+		UInt64 WriteCount;				//!< Number of write calls
+		UInt64 WriteBytes;				//!< Number of bytes written
+		UInt64 SeekCount;				//!< Number of seeks
+		UInt64 BackwardSeekCount;		//!< Number of seeks to an earlier position in the file
+		UInt64 KLVCount;				//!< Number of KLV keys read, including those parsed from a buffer of header metadata
+		UInt64 ObjectCount;				//!< Number of MDObjects created for header metadata sets
+		UInt64 RIPPartitionCount;		//!< Number of partitions visited while building or scanning for a RIP
+		UInt64 IndexTime;				//!< Time spent loading index table segments
+		UInt64 MetadataTime;			//!< Time spent reading and parsing header metadata
+		UInt64 EssenceTime;				//!< Time spent reading essence
+
+		MXFFileStatistics() { Clear(); }
+
+		//! Reset all counters to zero
+		void Clear(void)
+		{
+			ReadCount = ReadBytes = WriteCount = WriteBytes = SeekCount = BackwardSeekCount = 0;
+			KLVCount = ObjectCount = RIPPartitionCount = IndexTime = MetadataTime = EssenceTime = 0;
+		}
+
+		//! Get the counters as a JSON object
+		std::string GetJSON(void) const;
+	};
+
+
+	//! Add the time for which this object exists to a given MXFFileStatistics time counter
+	/*! If Stats is NULL, as returned by MXFFile::Statistics() when statistics are not enabled, the clock is not read
+	 */
+	class StatisticsTimer
+	{
+	protected:
+		MXFFileStatistics *Stats;							//!< The statistics to update, or NULL if not collecting
+		UInt64 MXFFileStatistics::*Counter;					//!< The time counter to add to
+		UInt64 Start;										//!< The time when constructed, in microseconds
+
+	public:
+		StatisticsTimer(MXFFileStatistics *Stats, UInt64 MXFFileStatistics::*Counter) : Stats(Stats), Counter(Counter)
+		{
+			if(Stats) Start = Now();
+		}
+
+		~StatisticsTimer()
+		{
+			if(Stats) Stats->*Counter += Now() - Start;
+		}
+
+		//! Get a monotonic time in microseconds
+		static UInt64 Now(void);
+
+	private:
+		// Prevent copying, which would count the time twice
+		StatisticsTimer(const StatisticsTimer &);
+		StatisticsTimer &operator=(const StatisticsTimer &);
+	};
+
 	
 	//! Holds data relating to an MXF file
 	class MXFFile : public RefCount<MXFFile>
@@ -65,6 +129,12 @@ namespace mxflib
 		Int32 BlockAlignEssenceOffset;	//!< Fixed distance from the block grid at which to align essence (+ve is after the grid, -ve before)
 		Int32 BlockAlignIndexOffset;	//!< Fixed distance from the block grid at which to align index (+ve is after the grid, -ve before)
 
+		Position FollowPos;				//!< Location of the next KLV to be examined by FollowRIP(), or -1 if not yet following this file
+		Length FollowSize;				//!< Size of the file when last checked by FollowRIP()
+
+		bool CollectStats;				//!< True if I/O and parsing statistics are being collected
+		MXFFileStatistics Stats;		//!< The statistics collected so far
+
 
 		//DRAGONS: There should probably be a property to say that in-memory values have changed?
 		//DRAGONS: Should we have a flush() function
@@ -74,7 +144,7 @@ namespace mxflib
 		std::string Name;
 
 	public:
-		MXFFile() : isOpen(false), isMemoryFile(false), TruncatedKnown(false), Truncated(false), BlockAlign(0) {};
+		MXFFile() : isOpen(false), isMemoryFile(false), TruncatedKnown(false), Truncated(false), BlockAlign(0), FollowPos(-1), FollowSize(-1), CollectStats(false) {};
 		virtual ~MXFFile() { if(isOpen) Close(); };
 
 		virtual bool Open(std::string FileName, bool ReadOnly = false );
@@ -93,6 +163,21 @@ namespace mxflib
 		bool BuildRIP(void);
 		bool GetRIP(Length MaxScan = 1024*1024);
 
+		//! Add any partitions that have been completed since the last call to FileRIP, for a file that is still being written
+		/*! The first call scans forwards from the last partition already in FileRIP, or from the start of the file if FileRIP is empty.
+		 *  Each later call continues from where the previous one stopped, so data that has already been examined is never read again.
+		 *  A partition is only added once its header metadata and index table segments have been completely written.
+		 *  \return The number of partitions added, or -1 on error
+		 *  \note If the size of the file has not changed since the last call nothing is read
+		 *  \note The file pointer is left at an undefined position
+		 */
+		int FollowRIP(void);
+
+		//! Get the end of the complete KLVs found so far by FollowRIP()
+		/*! Everything before this location has been completely written, including any essence in the last partition
+		 */
+		Position GetFollowEnd(void) { return FollowPos < 0 ? 0 : FollowPos; }
+
 		//! Locate and read a partition containing closed header metadata
 		/*! \ret NULL if none found
 		 */
@@ -103,6 +188,23 @@ namespace mxflib
 		 */
 		PartitionPtr ReadFooterPartition(Length MaxScan = 1024*1024);
 
+		//! Start or stop collecting I/O and parsing statistics for this file
+		/*! Counters are not cleared, so collection can be paused and resumed - use ClearStatistics() to start afresh
+		 */
+		void EnableStatistics(bool Enable = true) { CollectStats = Enable; }
+
+		//! Are I/O and parsing statistics being collected for this file?
+		bool StatisticsEnabled(void) const { return CollectStats; }
+
+		//! Get the statistics collected so far
+		const MXFFileStatistics &GetStatistics(void) const { return Stats; }
+
+		//! Reset all statistics counters to zero
+		void ClearStatistics(void) { Stats.Clear(); }
+
+		//! Get the statistics to update, or NULL if they are not being collected
+		MXFFileStatistics *Statistics(void) { return CollectStats ? &Stats : NULL; }
+
 		//! Report the position of the file pointer
 		Position Tell(void) 
 		{ 
@@ -123,6 +225,12 @@ namespace mxflib
 		int Seek(Position Pos)
 		{ 
 			if(!isOpen) return 0;
+			if(CollectStats)
+			{
+				Stats.SeekCount++;
+				if(Pos < Tell()) Stats.BackwardSeekCount++;
+			}
+
 			if(isMemoryFile)
 			{
 				BufferCurrentPos = Pos+RunInSize;
@@ -175,6 +283,31 @@ namespace mxflib
 		DataChunkPtr Read(size_t Size);
 		size_t Read(UInt8 *Buffer, size_t Size);
 
+		//! Read data from a given position into a supplied buffer, leaving the file pointer unchanged
+		/*! If CanReadAt() is true the file pointer is not used, so this may be called from another thread
+		 *  while the file is in use. Otherwise the file pointer is moved and then restored.
+		 *  \return The number of bytes read
+		 */
+		size_t ReadAt(Position Pos, UInt8 *Buffer, size_t Size);
+
+		//! Can ReadAt() be called from another thread while this file is in use?
+		bool CanReadAt(void)
+		{
+#ifdef MXFLIB_POSITIONAL_READ
+			return isOpen && !isMemoryFile;
+#else
+			return false;
+#endif
+		}
+
+		//! Copy bytes from another file to the current position in this file
+		/*! Where the system allows it the bytes are moved directly between the files without being read into memory,
+		 *  otherwise they are copied through a single large buffer.
+		 *  \return The number of bytes copied, which will be less than Size if an error occurs
+		 *  \note The file pointer of Source is left at an undefined position
+		 */
+		Length CopyFrom(MXFFilePtr Source, Position SourcePos, Length Size);
+
 //		MDObjectPtr ReadObject(void);
 //		template<class TP, class T> TP ReadObjectBase(void) { TP x; return x; };
 //		template<> MDObjectPtr ReadObjectBase<MDObjectPtr, MDObject>(void) { MDObjectPtr x; return x; };
@@ -277,6 +410,8 @@ namespace mxflib
 		//! Write raw data
 		size_t Write(const UInt8 *Buffer, size_t Size) 
 		{ 
+			MXFLIB_TRACE_SPAN("MXFFile::Write");
+			if(CollectStats) { Stats.WriteCount++; Stats.WriteBytes += Size; }
 			if(isMemoryFile) return MemoryWrite(Buffer, Size);
 
 			return FileWrite(Handle, Buffer, Size); 
@@ -285,11 +420,25 @@ namespace mxflib
 		//! Write the contents of a DataChunk by reference
 		size_t Write(const DataChunk &Data) 
 		{ 
+			MXFLIB_TRACE_SPAN("MXFFile::Write");
+			if(CollectStats) { Stats.WriteCount++; Stats.WriteBytes += Data.Size; }
 			if(isMemoryFile) return MemoryWrite(Data.Data, Data.Size);
 
 			return FileWrite(Handle, Data.Data, Data.Size); 
 		};
 
+		//! Write two buffers as a single operation
+		/*! This allows a key and length to be written along with a value held elsewhere without first copying them together
+		 */
+		size_t Write(const UInt8 *Buffer1, size_t Size1, const UInt8 *Buffer2, size_t Size2)
+		{
+			MXFLIB_TRACE_SPAN("MXFFile::Write");
+			if(CollectStats) { Stats.WriteCount++; Stats.WriteBytes += Size1 + Size2; }
+			if(isMemoryFile) return MemoryWrite(Buffer1, Size1) + MemoryWrite(Buffer2, Size2);
+
+			return FileWriteV(Handle, Buffer1, Size1, Buffer2, Size2);
+		};
+
 		void Flush()
 		{
 			FileFlush(Handle);
@@ -298,6 +447,8 @@ namespace mxflib
 		//! Write the contents of a DataChunk by SmartPtr
 		size_t Write(DataChunkPtr Data)
 		{ 
+			MXFLIB_TRACE_SPAN("MXFFile::Write");
+			if(CollectStats) { Stats.WriteCount++; Stats.WriteBytes += Data->Size; }
 			if(isMemoryFile) return MemoryWrite(Data->Data, Data->Size);
 
 			return static_cast<size_t>(FileWrite(Handle, Data->Data, Data->Size)); 
@@ -422,6 +573,12 @@ namespace mxflib
 		//! Read from a memory file buffer
 		/*! \note This can be overridden in classes derived from MXFFile to give different memory read behaviour */
 		virtual size_t MemoryRead(UInt8 *Data, size_t Size);
+
+		//! Find the end of a KLV in a file that is still being written, provided that the KLV has been completely written
+		/*! \param Key Buffer to receive the 16-byte key
+		 *  \return Location of the following KLV, 0 if the KLV is not yet complete, or -1 if there is no valid KLV at Location
+		 */
+		Position FollowKLV(Position Location, Position FileEnd, UInt8 *Key);
 	};
 }
 
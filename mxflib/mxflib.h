@@ -43,6 +43,7 @@ namespace mxflib {}
 
 #include <list>
 #include <map>
+#include <vector>
 #include <cstring>
 
 
@@ -116,6 +117,7 @@ namespace mxflib
 #include "deftypes.h"
 #include "rxiparser.h"
 #include "legacytypes.h"
+#include "dictcache.h"
 
 #include "primer.h"
 
@@ -135,6 +137,7 @@ namespace mxflib
 #include "klvobject.h"
 
 #include "crypto.h"
+#include "crypto_asdcp.h"
 
 #include "metadata.h"
 
@@ -142,6 +145,8 @@ namespace mxflib
 
 #include "audiomux.h"
 
+#include "rewrap.h"
+
 #include "sopsax.h"
 #include "xmlparser.h"
 
@@ -11,38 +11,55 @@
 #include <stdarg.h>
 #include <stdio.h>
 
+#include "debug.h"
+
 namespace mxflib
 {
 
 //#ifndef NDEBUG
 void debug(const char *Fmt, ...)
 {
+	if(!MessageEnabled(MessageLevelDebug)) return;
+
 	va_list args;
 
 	va_start(args, Fmt);
-	printf("mxflib debug: ");
-	vprintf(Fmt, args);
+	if(!SinkMessage(MessageLevelDebug, Fmt, args))
+	{
+		printf("mxflib debug: ");
+		vprintf(Fmt, args);
+	}
 	va_end(args);
 }
 //#endif
 
 void warning(const char *Fmt, ...)
 {
+	if(!MessageEnabled(MessageLevelWarning)) return;
+
 	va_list args;
 
 	va_start(args, Fmt);
-	printf("mxflib Warning: ");
-	vprintf(Fmt, args);
+	if(!SinkMessage(MessageLevelWarning, Fmt, args))
+	{
+		printf("mxflib Warning: ");
+		vprintf(Fmt, args);
+	}
 	va_end(args);
 }
 
 void error(const char *Fmt, ...)
 {
+	if(!MessageEnabled(MessageLevelError)) return;
+
 	va_list args;
 
 	va_start(args, Fmt);
-	printf("MXFLIB ERROR: ");
-	vprintf(Fmt, args);
+	if(!SinkMessage(MessageLevelError, Fmt, args))
+	{
+		printf("MXFLIB ERROR: ");
+		vprintf(Fmt, args);
+	}
 	va_end(args);
 }
 
@@ -66,13 +66,13 @@ void mxflib::Partition::AddMetadata(MDObjectPtr NewObject, bool ForceFirst /*=fa
 			{
 				has_target = true;
 
-				UUIDPtr ID = new UUID((*it).second->Value->PutData()->Data);
-				RefTargets.insert(std::map<UUID, MDObjectPtr>::value_type(*ID, NewObject));
+				UUIDValue ID((*it).second->Value->GetData().Data);
+				RefTargets.insert(std::map<UUIDValue, MDObjectPtr>::value_type(ID, NewObject));
 
 				// Try and satisfy all refs to this set
 				for(;;)
 				{
-					std::multimap<UUID, MDObjectPtr>::iterator mit = UnmatchedRefs.find(*ID);
+					std::multimap<UUIDValue, MDObjectPtr>::iterator mit = UnmatchedRefs.find(ID);
 
 					// Exit when no more refs to this object
 					if(mit == UnmatchedRefs.end()) break;
@@ -217,13 +217,13 @@ void mxflib::Partition::ProcessChildRefs(MDObjectPtr ThisObject)
 				}
 				else
 				{
-					UUIDPtr ID = new UUID((*it).second->Value->PutData()->Data);
-					std::map<UUID, MDObjectPtr>::iterator mit = RefTargets.find(*ID);
+					UUIDValue ID((*it).second->Value->GetData().Data);
+					std::map<UUIDValue, MDObjectPtr>::iterator mit = RefTargets.find(ID);
 
 					if(mit == RefTargets.end())
 					{
 						// Not matched yet, so add to the list of outstanding refs
-						UnmatchedRefs.insert(std::multimap<UUID, MDObjectPtr>::value_type(*ID, (*it).second));
+						UnmatchedRefs.insert(std::multimap<UUIDValue, MDObjectPtr>::value_type(ID, (*it).second));
 					}
 					else
 					{
@@ -360,6 +360,11 @@ Length mxflib::Partition::ReadMetadata(MXFFilePtr File, Length Size)
 	Length Bytes = 0;
 	Length FillerBytes = 0;
 
+	MXFLIB_TRACE_SPAN("Partition::ReadMetadata");
+
+	MXFFileStatistics *Stats = File->Statistics();
+	StatisticsTimer Timer(Stats, &MXFFileStatistics::MetadataTime);
+
 	// Clear any existing metadata, including the primer
 	ClearMetadata(false);
 
@@ -446,6 +451,12 @@ Length mxflib::Partition::ReadMetadata(MXFFilePtr File, Length Size)
 		MDObjectPtr NewItem = new MDObject(NewUL);
 		mxflib_assert(NewItem);
 
+		if(Stats)
+		{
+			Stats->KLVCount++;
+			Stats->ObjectCount++;
+		}
+
 		BuffPtr += 16;
 		Size -= 16;
 		Bytes += 16;
@@ -613,6 +624,8 @@ MDObjectListPtr mxflib::Partition::ReadIndex(void)
 //! Read any index table segments from a file
 MDObjectListPtr mxflib::Partition::ReadIndex(MXFFilePtr File, UInt64 Size)
 {
+	StatisticsTimer Timer(File->Statistics(), &MXFFileStatistics::IndexTime);
+
 	MDObjectListPtr Ret = new MDObjectList;
 
 	while(Size)
@@ -661,6 +674,11 @@ DataChunkPtr mxflib::Partition::ReadIndexChunk(void)
 {
 	DataChunkPtr Ret;
 
+	MXFFilePtr File = Object->GetParentFile();
+	if(!File) { error("Call to Partition::ReadIndexChunk() on a non-file partition\n"); return Ret; }
+
+	StatisticsTimer Timer(File->Statistics(), &MXFFileStatistics::IndexTime);
+
 	// Locate the index table data
 	if(!SeekIndex()) return Ret;
 
@@ -668,7 +686,7 @@ DataChunkPtr mxflib::Partition::ReadIndexChunk(void)
 	if(IndexSize == 0) return Ret;
 
 	// Read the specified number of bytes
-	Ret = Object->GetParentFile()->Read(static_cast<size_t>(IndexSize));
+	Ret = File->Read(static_cast<size_t>(IndexSize));
 
 	/* Remove any trailing filler */
 
@@ -57,8 +57,8 @@ namespace mxflib
 
 
 	private:
-		std::map<UUID, MDObjectPtr> RefTargets;				//!< Map of UUID of all reference targets to objects
-		std::multimap<UUID, MDObjectPtr> UnmatchedRefs;		//!< Map of UUID of all strong or weak refs not yet linked
+		std::map<UUIDValue, MDObjectPtr> RefTargets;				//!< Map of UUID of all reference targets to objects
+		std::multimap<UUIDValue, MDObjectPtr> UnmatchedRefs;		//!< Map of UUID of all strong or weak refs not yet linked
 
 	protected:
 		//! Common construction
@@ -127,8 +127,8 @@ namespace mxflib
 
 		// Access functions for the reference resolving properties
 		// DRAGONS: These should be const, but can't make it work!
-		std::map<UUID, MDObjectPtr>& GetRefTargets(void) { return RefTargets; };
-		std::multimap<UUID, MDObjectPtr>& GetUnmatchedRefs(void) { return UnmatchedRefs; };
+		std::map<UUIDValue, MDObjectPtr>& GetRefTargets(void) { return RefTargets; };
+		std::multimap<UUIDValue, MDObjectPtr>& GetUnmatchedRefs(void) { return UnmatchedRefs; };
 
 		//! Determine if the partition object is currently set as complete
 		bool IsComplete(void);
@@ -95,7 +95,7 @@ UInt32 Primer::ReadValue(const UInt8 *Buffer, UInt32 Size)
 		// Add this new entry to the primer
 		insert(Primer::value_type(ThisTag, ThisUL));
 
-		debug("  %s -> %s\n", Tag2String(ThisTag).c_str(), ThisUL.GetString().c_str());
+		mxflib_debug("  %s -> %s\n", Tag2String(ThisTag).c_str(), ThisUL.GetString().c_str());
 	}
 
 	// Return how many bytes we actually read
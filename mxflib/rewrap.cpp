@@ -0,0 +1,672 @@
+/*! \file	rewrap.cpp
+ *	\brief	Implementation of the KLV-level rewrap engine
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "mxflib.h"
+
+using namespace mxflib;
+
+
+namespace
+{
+	//! Largest number of bytes of index entries in one segment, as the IndexEntryArray has a 2-byte local set length
+	const int MaxSegmentEntryBytes = 0xffff - 8;
+
+	//! Compare a key with a UL, ignoring the version byte
+	bool SameKey(const UInt8 *Key, const UL &Match)
+	{
+		const UInt8 *MatchKey = Match.GetValue();
+		return (memcmp(Key, MatchKey, 7) == 0) && (memcmp(&Key[8], &MatchKey[8], 8) == 0);
+	}
+
+	//! Read the key and length of the KLV at a given location
+	/*! \return The total size of the KLV, or -1 if no valid KLV could be read
+	 */
+	Length ReadKLVHeader(MXFFilePtr &File, Position Location, UInt8 *Key)
+	{
+		UInt8 Buff[16 + 9];
+
+		File->Seek(Location);
+		size_t Bytes = File->Read(Buff, sizeof(Buff));
+		if(Bytes < 17) return -1;
+
+		memcpy(Key, Buff, 16);
+
+		const UInt8 *p = &Buff[16];
+		Length Len = ReadBER(&p, static_cast<int>(Bytes - 16));
+		if(Len < 0) return -1;
+
+		return static_cast<Length>(p - Buff) + Len;
+	}
+}
+
+
+//! Construct a rewrapper for an open source file
+Rewrapper::Rewrapper(MXFFilePtr SourceFile)
+	: Source(SourceFile), BodySID(0), IndexSID(0), SourceDuration(0), StreamEnd(0),
+	  PartitionDuration(0), PartitionSize(0), Style(IndexSprinkled), KAG(1)
+{
+}
+
+
+//! Read the source RIP, header metadata and index table
+/*! \param UseBodySID The essence container to copy, or 0 to copy the first one found
+ *  \return false if the source cannot be rewrapped
+ */
+bool Rewrapper::ReadSource(UInt32 UseBodySID /*=0*/)
+{
+	if(!Source->GetRIP())
+	{
+		error("Unable to locate the partitions in \"%s\"\n", Source->Name.c_str());
+		return false;
+	}
+
+	// Take the metadata from the best partition available
+	SourceHeader = Source->ReadMasterPartition();
+	if(!SourceHeader)
+	{
+		Source->Seek(0);
+		SourceHeader = Source->ReadPartition();
+	}
+
+	if((!SourceHeader) || (!SourceHeader->ReadMetadata()))
+	{
+		error("Unable to read the header metadata in \"%s\"\n", Source->Name.c_str());
+		return false;
+	}
+
+	SourceMetadata = SourceHeader->ParseMetadata();
+	if(!SourceMetadata)
+	{
+		error("Unable to parse the header metadata in \"%s\"\n", Source->Name.c_str());
+		return false;
+	}
+
+	BodySID = UseBodySID;
+	IndexSID = 0;
+	Ranges.clear();
+
+	// Find the end of the file, which ends the essence if there is no footer
+	Source->SeekEnd();
+	Position FileEnd = Source->Tell();
+
+	// Index segments from all partitions - we may not know which are ours until the first essence is found
+	MDObjectList Segments;
+
+	RIP::iterator it = Source->FileRIP.begin();
+	while(it != Source->FileRIP.end())
+	{
+		PartitionInfoPtr Info = (*it).second;
+		PartitionPtr ThisPartition = Info->GetPartition();
+		if(!ThisPartition)
+		{
+			Source->Seek((*it).first);
+			ThisPartition = Source->ReadPartition();
+			if(!ThisPartition)
+			{
+				error("Unable to read the partition pack at 0x%s in \"%s\"\n", Int64toHexString((*it).first, 8).c_str(), Source->Name.c_str());
+				return false;
+			}
+
+			Info->SetPartition(ThisPartition);
+		}
+
+		UInt32 ThisBodySID = ThisPartition->GetUInt(BodySID_UL);
+		if(ThisBodySID && !BodySID) BodySID = ThisBodySID;
+
+		RIP::iterator Next = it;
+		Next++;
+
+		if(ThisBodySID && (ThisBodySID == BodySID))
+		{
+			if(!ThisPartition->SeekEssence())
+			{
+				error("Unable to locate the essence in the partition at 0x%s in \"%s\"\n", Int64toHexString((*it).first, 8).c_str(), Source->Name.c_str());
+				return false;
+			}
+
+			SourceRange Range;
+			Range.StreamOffset = ThisPartition->GetInt64(BodyOffset_UL);
+			Range.Start = Source->Tell();
+			Range.End = (Next == Source->FileRIP.end()) ? FileEnd : (*Next).first;
+
+			if(Range.End > Range.Start) Ranges.push_back(Range);
+		}
+
+		if(ThisPartition->GetInt64(IndexByteCount_UL) > 0)
+		{
+			MDObjectListPtr ThisIndex = ThisPartition->ReadIndex();
+			if(ThisIndex) Segments.insert(Segments.end(), ThisIndex->begin(), ThisIndex->end());
+		}
+
+		it = Next;
+	}
+
+	if(Ranges.empty())
+	{
+		error("No essence found for BodySID 0x%x in \"%s\"\n", BodySID, Source->Name.c_str());
+		return false;
+	}
+
+	Position LastSize = Ranges.back().End - Ranges.back().Start;
+	StreamEnd = Ranges.back().StreamOffset + LastSize;
+
+	// Build the source index table from the segments for this essence
+	SourceIndex = new IndexTable;
+	SourceIndex->BodySID = BodySID;
+
+	MDObjectList::iterator Seg_it = Segments.begin();
+	while(Seg_it != Segments.end())
+	{
+		if((*Seg_it)->GetUInt(BodySID_UL) == BodySID)
+		{
+			if(!IndexSID) IndexSID = (*Seg_it)->GetUInt(IndexSID_UL);
+			SourceIndex->AddSegment(*Seg_it);
+		}
+		Seg_it++;
+	}
+
+	SourceIndex->IndexSID = IndexSID;
+
+	if(!IndexSID)
+	{
+		error("No index table found for BodySID 0x%x in \"%s\" - it cannot be rewrapped\n", BodySID, Source->Name.c_str());
+		SourceIndex = NULL;
+		return false;
+	}
+
+	if(SourceIndex->EditUnitByteCount)
+	{
+		SourceDuration = SourceIndex->IndexDuration;
+		if(SourceDuration <= 0) SourceDuration = StreamEnd / SourceIndex->EditUnitByteCount;
+	}
+	else
+		SourceDuration = SourceIndex->GetDuration();
+
+	return true;
+}
+
+
+//! Get the raw source index entry for a given edit unit, or NULL if not indexed
+const UInt8 *Rewrapper::GetSourceEntry(Position EditUnit)
+{
+	IndexSegmentMap::iterator it = SourceIndex->SegmentMap.upper_bound(EditUnit);
+	if(it == SourceIndex->SegmentMap.begin()) return NULL;
+	it--;
+
+	IndexSegmentPtr Segment = (*it).second;
+	if(EditUnit >= (Segment->StartPosition + Segment->EntryCount)) return NULL;
+
+	return &Segment->IndexEntryArray.Data[(EditUnit - Segment->StartPosition) * SourceIndex->IndexEntrySize];
+}
+
+
+//! Get the source stream offset of a given edit unit, or -1 if not indexed
+/*! The edit unit after the last one gives the end of the essence
+ */
+Position Rewrapper::GetSourceOffset(Position EditUnit)
+{
+	if(SourceIndex->EditUnitByteCount)
+	{
+		Position Ret = EditUnit * SourceIndex->EditUnitByteCount;
+		return (Ret > StreamEnd) ? StreamEnd : Ret;
+	}
+
+	if(EditUnit >= SourceDuration) return StreamEnd;
+
+	const UInt8 *Entry = GetSourceEntry(EditUnit);
+	if(!Entry) return -1;
+
+	return GetI64(&Entry[3]);
+}
+
+
+//! Find the source partition holding a given stream offset
+const Rewrapper::SourceRange *Rewrapper::FindRange(Position StreamOffset)
+{
+	// Binary search for the last range starting at or before this offset
+	size_t Low = 0;
+	size_t High = Ranges.size();
+	while(High - Low > 1)
+	{
+		size_t Mid = (Low + High) / 2;
+		if(Ranges[Mid].StreamOffset <= StreamOffset) Low = Mid; else High = Mid;
+	}
+
+	const SourceRange &Ret = Ranges[Low];
+	if((StreamOffset < Ret.StreamOffset) || (StreamOffset >= Ret.StreamOffset + (Ret.End - Ret.Start))) return NULL;
+
+	return &Ret;
+}
+
+
+//! Copy any pending run of source bytes to the new file and empty the run
+bool Rewrapper::FlushRun(MXFFilePtr Dest, CopyItem &Run)
+{
+	if(!Run.Size) return true;
+
+	Length Copied = Dest->CopyFrom(Source, Run.Start, Run.Size);
+	if(Copied != Run.Size)
+	{
+		error("Only copied %s of %s bytes from 0x%s in \"%s\" to \"%s\"\n", Int64toString(Copied).c_str(), Int64toString(Run.Size).c_str(),
+			  Int64toHexString(Run.Start, 8).c_str(), Source->Name.c_str(), Dest->Name.c_str());
+		return false;
+	}
+
+	Run.Size = 0;
+	return true;
+}
+
+
+//! Write a partition holding the given index data, if any, and the essence that follows it
+void Rewrapper::WriteBodyPartition(MXFFilePtr Dest, Position BodyOffset, DataChunkPtr IndexData)
+{
+	// Isolated index segments get a partition of their own
+	if(IndexData && (Style == IndexSprinkledIsolated))
+	{
+		PartitionPtr IndexPartition = new Partition(ClosedCompleteBodyPartition_UL);
+		IndexPartition->SetKAG(KAG);
+		IndexPartition->SetUInt(BodySID_UL, 0);
+		IndexPartition->SetUInt64(BodyOffset_UL, 0);
+		IndexPartition->SetUInt(IndexSID_UL, IndexSID);
+		Dest->WritePartitionWithIndex(IndexPartition, IndexData, false);
+
+		IndexData = NULL;
+	}
+
+	PartitionPtr Body = new Partition(ClosedCompleteBodyPartition_UL);
+	Body->SetKAG(KAG);
+	Body->SetUInt(BodySID_UL, BodySID);
+	Body->SetUInt64(BodyOffset_UL, BodyOffset);
+
+	if(IndexData)
+	{
+		Body->SetUInt(IndexSID_UL, IndexSID);
+		Dest->WritePartitionWithIndex(Body, IndexData, false);
+	}
+	else
+	{
+		Body->SetUInt(IndexSID_UL, 0);
+		Dest->WritePartition(Body, false);
+	}
+}
+
+
+//! Build the index table segments for a run of edit units
+void Rewrapper::BuildSegments(DataChunk &Buffer, Position StartPosition, int EntryCount, int EntrySize, const UInt8 *Entries, DeltaEntry *Deltas, int DeltaCount)
+{
+	IndexTablePtr Table = new IndexTable;
+	Table->IndexSID = IndexSID;
+	Table->BodySID = BodySID;
+	Table->EditRate = SourceIndex->EditRate;
+	Table->DefineDeltaArray(DeltaCount, Deltas);
+
+	int MaxEntries = MaxSegmentEntryBytes / EntrySize;
+
+	int Done = 0;
+	while(Done < EntryCount)
+	{
+		int ThisCount = EntryCount - Done;
+		if(ThisCount > MaxEntries) ThisCount = MaxEntries;
+
+		IndexSegmentPtr Segment = Table->AddSegment(StartPosition + Done);
+		Segment->AddIndexEntries(ThisCount, EntrySize, &Entries[Done * EntrySize]);
+
+		Done += ThisCount;
+	}
+
+	Table->WriteIndex(Buffer);
+}
+
+
+//! Write the new file
+/*! \param Dest A newly opened file to receive the rewrapped essence
+ *  \return true if all essence was copied
+ */
+bool Rewrapper::Write(MXFFilePtr Dest)
+{
+	if(!SourceIndex)
+	{
+		error("Rewrapper::Write() called without a successful call to ReadSource()\n");
+		return false;
+	}
+
+	bool IsCBR = (SourceIndex->EditUnitByteCount != 0);
+	bool Indexing = (Style != IndexNone);
+
+	// The header holds the (possibly modified) source metadata
+	PartitionPtr Header = new Partition(ClosedCompleteHeader_UL);
+	Header->SetKAG(KAG);
+	Header->SetUInt(BodySID_UL, 0);
+	Header->SetUInt(IndexSID_UL, 0);
+	Header->AddMetadata(SourceMetadata->Object);
+	Dest->WritePartition(Header);
+
+	// The output index layout, fixed by the first content package
+	int ElementCount = -1;
+	std::vector<DeltaEntry> Deltas;
+	int OutNSL = 0;
+	int OutNPE = 0;
+	int EntrySize = 0;
+	UInt32 EditUnitByteCount = 0;
+
+	DataChunk Entries;					// Index entries for the edit units in the current partition
+	Entries.SetGranularity(64 * 1024);
+	DataChunkPtr PendingIndex;			// Index segment waiting to be written in the next partition
+	DataChunkPtr FooterIndex = new DataChunk;
+
+	std::vector<CopyItem> Items;		// The KLVs to be copied for the current content package
+	std::vector<UInt32> ElementOffsets;	// Offset of each kept element within the content package
+	std::vector<Int8> PosTableIndexes;	// Source PosTableIndex for each kept element
+
+	CopyItem Run;						// Run of adjacent source bytes not yet copied
+	Run.Start = 0;
+	Run.Size = 0;
+
+	Position OutStream = 0;				// Output stream offset of the next content package
+	Position PartitionStream = 0;		// Output stream offset of the first content package in this partition
+	Position PartitionFilePos = 0;		// File position of the essence in this partition
+	Position PartitionEditUnit = 0;		// First edit unit in this partition
+	bool InPartition = false;
+	bool Ret = true;
+
+	UInt8 Key[16];
+
+	Position EditUnit;
+	for(EditUnit = 0; EditUnit < SourceDuration; EditUnit++)
+	{
+		Position CPStart = GetSourceOffset(EditUnit);
+		Position CPEnd = GetSourceOffset(EditUnit + 1);
+		const SourceRange *Range = (CPStart < 0) ? NULL : FindRange(CPStart);
+
+		if((!Range) || (CPEnd < CPStart))
+		{
+			error("Edit unit %s is not correctly indexed in \"%s\"\n", Int64toString(EditUnit).c_str(), Source->Name.c_str());
+			Ret = false;
+			break;
+		}
+
+		/* Plan which KLVs of this content package to copy */
+
+		Items.clear();
+		ElementOffsets.clear();
+		PosTableIndexes.clear();
+
+		Position Pos = Range->Start + (CPStart - Range->StreamOffset);
+		Position End = Range->Start + (CPEnd - Range->StreamOffset);
+		if(End > Range->End) End = Range->End;
+
+		UInt32 CPSize = 0;
+		int SourceElement = 0;
+		while(Pos < End)
+		{
+			Length KLVSize = ReadKLVHeader(Source, Pos, Key);
+			if(KLVSize < 0)
+			{
+				error("Invalid KLV at 0x%s in \"%s\"\n", Int64toHexString(Pos, 8).c_str(), Source->Name.c_str());
+				Ret = false;
+				break;
+			}
+
+			// A partition pack or RIP ends the essence in this partition
+			if(IsPartitionKey(Key) || SameKey(Key, RandomIndexMetadata_UL)) break;
+
+			// Fillers are not copied - the new file is padded to its own KAG
+			if(!SameKey(Key, KLVFill_UL))
+			{
+				UInt32 TrackNumber = GetGCTrackNumber(new UL(Key));
+				if(Tracks.empty() || (TrackNumber == 0) || (Tracks.find(TrackNumber) != Tracks.end()))
+				{
+					ElementOffsets.push_back(CPSize);
+					PosTableIndexes.push_back((SourceElement < SourceIndex->BaseDeltaCount) ? SourceIndex->BaseDeltaArray[SourceElement].PosTableIndex : 0);
+
+					CopyItem Item;
+					Item.Start = Pos;
+					Item.Size = KLVSize;
+					Items.push_back(Item);
+
+					CPSize += static_cast<UInt32>(KLVSize);
+				}
+
+				SourceElement++;
+			}
+
+			Pos += KLVSize;
+		}
+
+		if(!Ret) break;
+
+		/* Fix the index layout from the first content package, and check that the rest match */
+
+		if(ElementCount < 0)
+		{
+			ElementCount = static_cast<int>(ElementOffsets.size());
+			if(ElementCount == 0)
+			{
+				error("No essence elements left to copy from \"%s\"\n", Source->Name.c_str());
+				Ret = false;
+				break;
+			}
+
+			// For VBR each element after the first starts a new slice, so the slice offsets record its position in each content package
+			Deltas.resize(ElementCount);
+			int i;
+			for(i = 0; i < ElementCount; i++)
+			{
+				Deltas[i].PosTableIndex = IsCBR ? 0 : PosTableIndexes[i];
+				Deltas[i].Slice = IsCBR ? 0 : static_cast<UInt8>(i);
+				PutU32(IsCBR ? ElementOffsets[i] : 0, Deltas[i].ElementDelta);
+
+				if(Deltas[i].PosTableIndex > OutNPE) OutNPE = Deltas[i].PosTableIndex;
+			}
+
+			if(!IsCBR) OutNSL = ElementCount - 1;
+			EntrySize = 11 + 4 * OutNSL + 8 * OutNPE;
+		}
+		else if(static_cast<int>(ElementOffsets.size()) != ElementCount)
+		{
+			error("Edit unit %s in \"%s\" has %d elements to copy, the first edit unit had %d\n", Int64toString(EditUnit).c_str(),
+				  Source->Name.c_str(), static_cast<int>(ElementOffsets.size()), ElementCount);
+			Ret = false;
+			break;
+		}
+
+		/* Start a new partition if required */
+
+		bool NewPartition = !InPartition;
+		if(PartitionDuration && ((EditUnit - PartitionEditUnit) >= PartitionDuration)) NewPartition = true;
+		if(PartitionSize && (EditUnit > PartitionEditUnit) && ((OutStream - PartitionStream + CPSize) > PartitionSize)) NewPartition = true;
+
+		if(NewPartition)
+		{
+			if(!FlushRun(Dest, Run))
+			{
+				Ret = false;
+				break;
+			}
+
+			// Build the index segment for the partition just completed
+			if(InPartition && Indexing && !IsCBR)
+			{
+				if(Style == IndexFooter)
+				{
+					BuildSegments(*FooterIndex, PartitionEditUnit, static_cast<int>(EditUnit - PartitionEditUnit), EntrySize, Entries.Data, &Deltas[0], ElementCount);
+				}
+				else
+				{
+					PendingIndex = new DataChunk;
+					BuildSegments(*PendingIndex, PartitionEditUnit, static_cast<int>(EditUnit - PartitionEditUnit), EntrySize, Entries.Data, &Deltas[0], ElementCount);
+				}
+			}
+			Entries.Resize(0);
+
+			WriteBodyPartition(Dest, OutStream, PendingIndex);
+			PendingIndex = NULL;
+
+			PartitionFilePos = Dest->Tell();
+			PartitionStream = OutStream;
+			PartitionEditUnit = EditUnit;
+			InPartition = true;
+		}
+
+		/* Copy the content package, merging adjacent KLVs into a single copy */
+
+		std::vector<CopyItem>::iterator it = Items.begin();
+		while(it != Items.end())
+		{
+			if(Run.Size && ((Run.Start + Run.Size) == (*it).Start))
+			{
+				Run.Size += (*it).Size;
+			}
+			else
+			{
+				if(!FlushRun(Dest, Run))
+				{
+					Ret = false;
+					break;
+				}
+				Run = *it;
+			}
+			it++;
+		}
+
+		if(!Ret) break;
+
+		// Pad the content package to the KAG
+		UInt32 FillSize = 0;
+		if(KAG > 1)
+		{
+			Position EndPos = PartitionFilePos + (OutStream - PartitionStream) + CPSize;
+			FillSize = Dest->FillerSize(static_cast<UInt64>(EndPos), KAG);
+			if(FillSize)
+			{
+				if(!FlushRun(Dest, Run))
+				{
+					Ret = false;
+					break;
+				}
+
+				Dest->Align(KAG);
+			}
+		}
+
+		UInt32 CPTotal = CPSize + FillSize;
+
+		/* Add the index entry for this edit unit, built from the source entry */
+
+		if(IsCBR)
+		{
+			if(!EditUnitByteCount) EditUnitByteCount = CPTotal;
+			else if(Indexing && (CPTotal != EditUnitByteCount))
+			{
+				error("Edit unit %s in \"%s\" is %u bytes after rewrapping, the first edit unit was %u bytes - no index table will be written\n",
+					  Int64toString(EditUnit).c_str(), Source->Name.c_str(), CPTotal, EditUnitByteCount);
+				Indexing = false;
+			}
+		}
+		else if(Indexing)
+		{
+			const UInt8 *SourceEntry = GetSourceEntry(EditUnit);
+
+			size_t EntryPos = Entries.Size;
+			Entries.Resize(EntryPos + EntrySize);
+			UInt8 *p = &Entries.Data[EntryPos];
+
+			// Temporal offset, key frame offset and flags are unchanged
+			p[0] = SourceEntry[0];
+			p[1] = SourceEntry[1];
+			p[2] = SourceEntry[2];
+			PutI64(OutStream, &p[3]);
+			p += 11;
+
+			int i;
+			for(i = 1; i < ElementCount; i++)
+			{
+				PutU32(ElementOffsets[i], p);
+				p += 4;
+			}
+
+			// The PosTable entries follow the source slice offsets
+			if(OutNPE) memcpy(p, &SourceEntry[11 + 4 * SourceIndex->NSL], 8 * OutNPE);
+		}
+
+		OutStream += CPTotal;
+	}
+
+	if(Ret && !FlushRun(Dest, Run)) Ret = false;
+
+	/* Build the final index table */
+
+	if(Indexing && (ElementCount > 0))
+	{
+		if(IsCBR)
+		{
+			IndexTablePtr Table = new IndexTable;
+			Table->IndexSID = IndexSID;
+			Table->BodySID = BodySID;
+			Table->EditRate = SourceIndex->EditRate;
+			Table->EditUnitByteCount = EditUnitByteCount;
+			Table->IndexDuration = EditUnit;
+			Table->DefineDeltaArray(ElementCount, &Deltas[0]);
+
+			Table->WriteIndex(*FooterIndex);
+		}
+		else if(EditUnit > PartitionEditUnit)
+		{
+			// The last segment always goes in the footer
+			BuildSegments(*FooterIndex, PartitionEditUnit, static_cast<int>(EditUnit - PartitionEditUnit), EntrySize, Entries.Data, &Deltas[0], ElementCount);
+		}
+	}
+
+	/* Finish the file */
+
+	PartitionPtr Footer = new Partition(CompleteFooter_UL);
+	Footer->SetKAG(KAG);
+
+	if(FooterIndex->Size)
+	{
+		Footer->SetUInt(IndexSID_UL, IndexSID);
+		Dest->WritePartitionWithIndex(Footer, FooterIndex, false);
+	}
+	else
+	{
+		Footer->SetUInt(IndexSID_UL, 0);
+		Dest->WritePartition(Footer, false);
+	}
+
+	if(KAG > 1) Dest->Align(KAG);
+	Dest->WriteRIP();
+
+	// Now that we know where the footer is, update the header
+	Header->SetInt64(FooterPartition_UL, Footer->GetInt64(ThisPartition_UL));
+	Dest->Seek(0);
+	if(!Dest->ReWritePartition(Header))
+	{
+		warning("Unable to update the header partition of \"%s\" with the footer location\n", Dest->Name.c_str());
+	}
+
+	return Ret;
+}
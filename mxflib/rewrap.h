@@ -0,0 +1,178 @@
+/*! \file	rewrap.h
+ *	\brief	Definition of the KLV-level rewrap engine
+ *
+ *			The Rewrapper copies the essence of an existing MXF file into a new
+ *			file with a different partition layout, index style, KAG or subset of
+ *			tracks. Essence values are copied between the files without being
+ *			parsed, and where possible without being read into memory at all.
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+#ifndef MXFLIB__REWRAP_H
+#define MXFLIB__REWRAP_H
+
+#include <set>
+
+
+namespace mxflib
+{
+	// Forward declare the Rewrapper class
+	class Rewrapper;
+
+	// A Smart pointer to a Rewrapper object
+	typedef SmartPtr<Rewrapper> RewrapperPtr;
+
+
+	//! Copies one frame wrapped essence container from an MXF file into a new file with a new layout
+	/*! The source RIP and index table are used to locate each content package, and each KLV in it is
+	 *  copied as-is, so the essence is never parsed. Runs of KLVs that are kept together are moved with
+	 *  a single MXFFile::CopyFrom() so that an unchanged partition becomes one copy.
+	 *  The output index table is built from the source index entries, with only the stream offsets and
+	 *  slice offsets recalculated for the new layout.
+	 *
+	 *  Typical use:
+	 *  - Construct with the open source file
+	 *  - Call ReadSource()
+	 *  - Set the required layout, and edit GetMetadata() if required (for example to remove the dropped tracks)
+	 *  - Call Write() with a newly opened destination file
+	 *
+	 *  DRAGONS: Only frame wrapped essence is supported, and any other essence or generic streams in the source are not copied
+	 */
+	class Rewrapper : public RefCount<Rewrapper>
+	{
+	public:
+		//! Where index table segments are written in the new file
+		enum IndexStyle
+		{
+			IndexNone,						//!< No index table is written
+			IndexFooter,					//!< The complete index table is written in the footer
+			IndexSprinkled,					//!< Each body partition holds the index segment for the essence of the previous partition, the last segment is in the footer
+			IndexSprinkledIsolated			//!< As IndexSprinkled, but each segment is written in its own partition before the next body partition
+		};
+
+	protected:
+		//! Location of the essence in one source partition
+		struct SourceRange
+		{
+			Position StreamOffset;			//!< Stream offset of the first essence byte in this partition
+			Position Start;					//!< File position of the first essence byte
+			Position End;					//!< File position after the last essence byte
+		};
+
+		//! One KLV, or run of adjacent KLVs, to be copied to the new file
+		struct CopyItem
+		{
+			Position Start;					//!< Location in the source file
+			Length Size;					//!< Number of bytes to copy
+		};
+
+		MXFFilePtr Source;					//!< The file being rewrapped
+		PartitionPtr SourceHeader;			//!< The partition holding the source metadata
+		MetadataPtr SourceMetadata;			//!< The header metadata that will be written to the new file
+
+		UInt32 BodySID;						//!< BodySID of the essence being copied
+		UInt32 IndexSID;					//!< IndexSID of the table indexing that essence
+		IndexTablePtr SourceIndex;			//!< The complete source index table
+		Length SourceDuration;				//!< Number of edit units in the source essence
+		Position StreamEnd;					//!< Stream offset of the end of the source essence
+
+		std::vector<SourceRange> Ranges;	//!< The source partitions holding essence, in stream order
+
+		Length PartitionDuration;			//!< Maximum edit units per body partition, or 0 for no limit
+		Length PartitionSize;				//!< Maximum essence bytes per body partition, or 0 for no limit
+		IndexStyle Style;					//!< Where index table segments are written
+		UInt32 KAG;							//!< KAG to use in the new file
+		std::set<UInt32> Tracks;			//!< GC track numbers of essence elements to keep, or empty to keep all
+
+	public:
+		//! Construct a rewrapper for an open source file
+		Rewrapper(MXFFilePtr SourceFile);
+
+		//! Read the source RIP, header metadata and index table
+		/*! \param UseBodySID The essence container to copy, or 0 to copy the first one found
+		 *  \return false if the source cannot be rewrapped
+		 */
+		bool ReadSource(UInt32 UseBodySID = 0);
+
+		//! Get the header metadata that will be written to the new file
+		/*! Any changes made to this metadata before calling Write() will be included in the new file
+		 */
+		MetadataPtr GetMetadata(void) { return SourceMetadata; }
+
+		//! Get the number of edit units that will be copied
+		Length GetDuration(void) { return SourceDuration; }
+
+		//! Start a new body partition at least every Duration edit units (0 for no limit)
+		void SetPartitionDuration(Length Duration) { PartitionDuration = Duration; }
+
+		//! Start a new body partition before the essence in a partition would exceed Size bytes (0 for no limit)
+		/*! \note A partition always holds at least one content package, even if that is bigger than Size
+		 */
+		void SetPartitionSize(Length Size) { PartitionSize = Size; }
+
+		//! Set where the index table is written
+		/*! \note A CBR index table is always written in the footer, unless the style is IndexNone
+		 */
+		void SetIndexStyle(IndexStyle NewStyle) { Style = NewStyle; }
+
+		//! Set the KAG for the new file, each content package will be padded to a multiple of this size
+		void SetKAG(UInt32 NewKAG) { KAG = NewKAG ? NewKAG : 1; }
+
+		//! Keep the essence elements with the given GC track number
+		/*! If this is never called all essence elements are kept, otherwise only the elements of tracks given are kept.
+		 *  System items, and any KLVs that are not GC essence elements, are always kept.
+		 *  \note The header metadata is not changed, the caller should remove any dropped tracks from GetMetadata()
+		 */
+		void KeepTrack(UInt32 TrackNumber) { Tracks.insert(TrackNumber); }
+
+		//! Write the new file
+		/*! \param Dest A newly opened file to receive the rewrapped essence
+		 *  \return true if all essence was copied
+		 */
+		bool Write(MXFFilePtr Dest);
+
+	protected:
+		//! Get the raw source index entry for a given edit unit, or NULL if not indexed
+		const UInt8 *GetSourceEntry(Position EditUnit);
+
+		//! Get the source stream offset of a given edit unit, or -1 if not indexed
+		Position GetSourceOffset(Position EditUnit);
+
+		//! Find the source partition holding a given stream offset
+		const SourceRange *FindRange(Position StreamOffset);
+
+		//! Copy any pending run of source bytes to the new file and empty the run
+		/*! \return false if the run could not be copied in full
+		 */
+		bool FlushRun(MXFFilePtr Dest, CopyItem &Run);
+
+		//! Write a partition holding the given index data, if any, and the essence that follows it
+		void WriteBodyPartition(MXFFilePtr Dest, Position BodyOffset, DataChunkPtr IndexData);
+
+		//! Build the index table segments for a run of edit units
+		void BuildSegments(DataChunk &Buffer, Position StartPosition, int EntryCount, int EntrySize, const UInt8 *Entries, DeltaEntry *Deltas, int DeltaCount);
+	};
+}
+
+#endif // MXFLIB__REWRAP_H
@@ -0,0 +1,138 @@
+/*! \file	simd.cpp
+ *	\brief	Run-time detection of processor features used by vectorized code paths
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#include "mxflib.h"
+
+#include "simd.h"
+
+#ifdef MXFLIB_X86_SIMD
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif // MXFLIB_X86_SIMD
+
+using namespace mxflib;
+
+
+namespace
+{
+	//! Mask of features that may be reported
+	UInt32 FeatureMask = ~static_cast<UInt32>(0);
+
+#ifdef MXFLIB_X86_SIMD
+	//! Execute the CPUID instruction for a given leaf and sub-leaf
+	/*! \return false if the leaf is not supported */
+	bool CPUID(UInt32 Leaf, UInt32 SubLeaf, UInt32 *Regs)
+	{
+#ifdef _MSC_VER
+		int Info[4];
+		__cpuid(Info, 0);
+		if(static_cast<UInt32>(Info[0]) < Leaf) return false;
+
+		__cpuidex(Info, static_cast<int>(Leaf), static_cast<int>(SubLeaf));
+		Regs[0] = Info[0]; Regs[1] = Info[1]; Regs[2] = Info[2]; Regs[3] = Info[3];
+		return true;
+#else
+		if(__get_cpuid_max(0, NULL) < Leaf) return false;
+
+		__cpuid_count(Leaf, SubLeaf, Regs[0], Regs[1], Regs[2], Regs[3]);
+		return true;
+#endif
+	}
+
+	//! Determine if the OS saves the AVX (YMM) register state on context switch
+	bool OSSupportsAVX(UInt32 Leaf1ECX)
+	{
+		// Require OSXSAVE and AVX
+		if((Leaf1ECX & ((1 << 27) | (1 << 28))) != ((1 << 27) | (1 << 28))) return false;
+
+#ifdef _MSC_VER
+		UInt64 XCR0 = _xgetbv(0);
+#else
+		UInt32 Low, High;
+		__asm__ __volatile__ ("xgetbv" : "=a" (Low), "=d" (High) : "c" (0));
+		UInt64 XCR0 = (static_cast<UInt64>(High) << 32) | Low;
+#endif
+
+		// Both XMM and YMM state must be enabled
+		return (XCR0 & 6) == 6;
+	}
+#endif // MXFLIB_X86_SIMD
+
+	//! Query the processor for its features
+	UInt32 DetectCPUFeatures(void)
+	{
+		UInt32 Ret = 0;
+
+#ifdef MXFLIB_X86_SIMD
+		UInt32 Regs[4];
+		if(!CPUID(1, 0, Regs)) return 0;
+
+		UInt32 Leaf1ECX = Regs[2];
+		UInt32 Leaf1EDX = Regs[3];
+
+		if(Leaf1EDX & (1 << 26)) Ret |= CPU_SSE2;
+		if(Leaf1ECX & (1 << 9)) Ret |= CPU_SSSE3;
+		if(Leaf1ECX & (1 << 19)) Ret |= CPU_SSE41;
+		if(Leaf1ECX & (1 << 25)) Ret |= CPU_AESNI;
+		if(Leaf1ECX & (1 << 1)) Ret |= CPU_PCLMUL;
+
+		if(CPUID(7, 0, Regs))
+		{
+			if((Regs[1] & (1 << 5)) && OSSupportsAVX(Leaf1ECX)) Ret |= CPU_AVX2;
+			if(Regs[1] & (1 << 29)) Ret |= CPU_SHA;
+		}
+#endif // MXFLIB_X86_SIMD
+
+		return Ret;
+	}
+}
+
+
+//! Get a bitmap of the CPU_xxx features supported by this processor
+/*! The processor is only queried on the first call, the result is cached for later calls.
+ *  \note Always returns 0 if MXFLIB_NO_SIMD is defined, or this is not an x86 family processor
+ */
+UInt32 mxflib::GetCPUFeatures(void)
+{
+	// DRAGONS: If two threads race here they will both detect the same value, so no locking is required
+	static UInt32 Detected = DetectCPUFeatures();
+
+	return Detected & FeatureMask;
+}
+
+
+//! Limit the CPU features that will be used (for testing portable code paths or comparing performance)
+/*! Features not in the mask will be reported as unsupported by later calls to GetCPUFeatures()
+ *  \note Code that has already selected a vectorized path will not be affected
+ */
+void mxflib::SetCPUFeatureMask(UInt32 Mask)
+{
+	FeatureMask = Mask;
+}
@@ -0,0 +1,82 @@
+/*! \file	simd.h
+ *	\brief	Compile-time and run-time support for optional SIMD code paths
+ *
+ *			Code that has a vectorized implementation should always also have a
+ *			portable implementation. The vectorized version is selected at run-time
+ *			using CPUSupports() so that a single build works on all processors.
+ *
+ *	\note	All SIMD code paths can be disabled by defining MXFLIB_NO_SIMD
+ *
+ *	\version $Id$
+ *
+ */
+/*
+ *  This software is provided 'as-is', without any express or implied warranty.
+ *  In no event will the authors be held liable for any damages arising from
+ *  the use of this software.
+ *
+ *  Permission is granted to anyone to use this software for any purpose,
+ *  including commercial applications, and to alter it and redistribute it
+ *  freely, subject to the following restrictions:
+ *
+ *   1. The origin of this software must not be misrepresented; you must
+ *      not claim that you wrote the original software. If you use this
+ *      software in a product, you must include an acknowledgment of the
+ *      authorship in the product documentation.
+ *
+ *   2. Altered source versions must be plainly marked as such, and must
+ *      not be misrepresented as being the original software.
+ *
+ *   3. This notice may not be removed or altered from any source
+ *      distribution.
+ */
+
+#ifndef MXFLIB__SIMD_H
+#define MXFLIB__SIMD_H
+
+// Only x86 family processors currently have vectorized code paths
+#if !defined(MXFLIB_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define MXFLIB_X86_SIMD
+#endif
+
+#ifdef MXFLIB_X86_SIMD
+#include <immintrin.h>
+
+// Allow a single function to be compiled for a specific instruction set extension
+// DRAGONS: MSVC allows all intrinsics in all functions, so no attribute is required
+#ifdef _MSC_VER
+#define MXFLIB_TARGET(x)
+#else
+#define MXFLIB_TARGET(x) __attribute__((target(x)))
+#endif
+#endif // MXFLIB_X86_SIMD
+
+namespace mxflib
+{
+	/* Processor features that may be used by vectorized code paths */
+
+	const UInt32 CPU_SSE2		= 0x0001;		//!< SSE2 integer instructions
+	const UInt32 CPU_SSSE3		= 0x0002;		//!< Supplemental SSE3 (including pshufb)
+	const UInt32 CPU_SSE41		= 0x0004;		//!< SSE4.1
+	const UInt32 CPU_AVX2		= 0x0008;		//!< AVX2 (with OS support for saving the YMM registers)
+	const UInt32 CPU_AESNI		= 0x0010;		//!< AES New Instructions
+	const UInt32 CPU_PCLMUL		= 0x0020;		//!< Carry-less multiply
+	const UInt32 CPU_SHA		= 0x0040;		//!< SHA extensions
+
+	//! Get a bitmap of the CPU_xxx features supported by this processor
+	/*! The processor is only queried on the first call, the result is cached for later calls.
+	 *  \note Always returns 0 if MXFLIB_NO_SIMD is defined, or this is not an x86 family processor
+	 */
+	UInt32 GetCPUFeatures(void);
+
+	//! Determine if the processor supports all of the given CPU_xxx features
+	inline bool CPUSupports(UInt32 FeatureSet) { return (GetCPUFeatures() & FeatureSet) == FeatureSet; }
+
+	//! Limit the CPU features that will be used (for testing portable code paths or comparing performance)
+	/*! Features not in the mask will be reported as unsupported by later calls to GetCPUFeatures()
+	 *  \note Code that has already selected a vectorized path will not be affected
+	 */
+	void SetCPUFeatureMask(UInt32 Mask);
+}
+
+#endif // MXFLIB__SIMD_H
@@ -27,44 +27,48 @@
 
 
 
-#include <string.h>		/* strcpy */
+#include <string.h>		/* strcmp, memchr */
+
+#include <vector>
 
 
 #include "mxflib.h"
 #include "sopsax.h"
+#include "simd.h"
 
 using namespace mxflib;
 
 
-/* Local Prototypes */
-static int sopSkipToClose(FILE *xmlFile);
-static int sopGetCharNonQ(FILE *xmlFile);
-static int sopGetChar(FILE *xmlFile);
-static void sopSkipSpace(FILE *xmlFile);
-static void sopGetItem(FILE *xmlFile, char *Buffer, int Max);
+/* Function to find the first of three characters in a buffer, returning End if none found */
+typedef const char *(*sopFindFunc)(const char *Start, const char *End, char c1, char c2, char c3);
 
+/* The part of the XML buffer still to be parsed */
+struct sopBuffer
+{
+	char *Pos;						/* The next character to parse */
+	char *End;						/* The end of the XML, where there is a terminating '\0' */
+	sopFindFunc Find;				/* Search function for this processor */
+};
+
+
+/* Local Prototypes */
+static bool sopSAXParseBuffer(sopSAXHandlerPtr sax, void *UserData, char *Data, size_t Size);
+static sopFindFunc sopSelectFind(void);
+static bool sopSkipComment(sopBuffer &Buffer);
+static int sopSkipToClose(sopBuffer &Buffer, bool *EndsWithSlash = NULL);
+static void sopSkipSpace(sopBuffer &Buffer);
+static size_t sopGetName(sopBuffer &Buffer);
+static char *sopGetValue(sopBuffer &Buffer);
 
-#define MAXTAGDEPTH 32
-#define MAXTAGLENGTH 256
-#define MAXATTRIBS 128
-#define ATTRIBBUFFERSIZE 20480
 
 /*
-** sopSAXParseFile() - Parse an XML file (not re-entrant due to static data)
+** sopSAXParseFile() - Parse an XML file
+**
+** The whole file is read into memory and parsed in place
 */
 
 bool mxflib::sopSAXParseFile(sopSAXHandlerPtr sax, void *UserData, const char *filename)
 {
-	FILE *xmlFile;
-	int ElementNesting;
-	char ThisTag[MAXTAGLENGTH+1];
-
-	/* NOTE: These are static because they are quite large */
-	/*       For re-entrant use they can be made auto */
-	static char TagName[MAXTAGDEPTH][MAXTAGLENGTH+1];
-	static char AttribBuffer[ATTRIBBUFFERSIZE];
-	static char *Attribs[(MAXATTRIBS+1)*2];
-
 	/* Validate the handler */
 	if(sax == NULL)
 	{
@@ -76,9 +80,9 @@ bool mxflib::sopSAXParseFile(sopSAXHandlerPtr sax, void *UserData, const char *f
 	if (filename == NULL)
 		return false;
 
-	xmlFile = fopen(filename, "rb");
+	FileHandle xmlFile = FileOpenRead(filename);
 
-	if(xmlFile == NULL)
+	if(!FileValid(xmlFile))
 	{
 		if(sax->fatalError != NULL) sax->fatalError(UserData,
 			"Cannot open file %s", filename);
@@ -86,203 +90,251 @@ bool mxflib::sopSAXParseFile(sopSAXHandlerPtr sax, void *UserData, const char *f
 		return false;
 	}
 
-	ElementNesting = 0;
-	while(!feof(xmlFile))
+	/* Read the whole file, in one go if we know its size */
+	std::vector<char> Data;
+	Int64 FileBytes = FileSize(xmlFile);
+	size_t Chunk = (FileBytes > 0) ? static_cast<size_t>(FileBytes) + 1 : 65536;
+	size_t Used = 0;
+
+	for(;;)
 	{
-		int c;
-		int attrib;
-		int closed;
-		int AttribBufferFree;
-		char *CurrentAttrib;
+		Data.resize(Used + Chunk);
 
-		/* Assume elements are open (have separate end tag) */
-		closed = 0;
+		size_t Bytes = static_cast<size_t>(FileRead(xmlFile, reinterpret_cast<unsigned char *>(&Data[Used]), Chunk));
+		if((Bytes == 0) || (Bytes > Chunk)) break;
+
+		Used += Bytes;
+		Chunk = 65536;
+	}
+
+	FileClose(xmlFile);
+
+	/* Terminate the buffer so that the last name or value can be used as a C string */
+	Data.resize(Used + 1);
+	Data[Used] = '\0';
+
+	return sopSAXParseBuffer(sax, UserData, &Data[0], Used);
+}
+
+
+/*
+** sopSAXParseString() - Parse XML held in memory
+**
+** The XML is copied so that it can be parsed in place
+*/
+
+bool mxflib::sopSAXParseString(sopSAXHandlerPtr sax, void *UserData, const char *XML, size_t Size)
+{
+	/* Validate the handler */
+	if(sax == NULL)
+	{
+		// Note that this is far from ideal - but we don't have a valid error handler now!
+		fprintf(stderr, "Cannot parse XML with no handler\n");
+		return false;
+	}
 
+	if((XML == NULL) && Size)
+		return false;
+
+	std::vector<char> Data(Size + 1);
+	if(Size) memcpy(&Data[0], XML, Size);
+	Data[Size] = '\0';
+
+	return sopSAXParseBuffer(sax, UserData, &Data[0], Size);
+}
+
+
+/*
+** sopSAXParseBuffer() - Parse XML in a writable buffer
+**
+** Names and values are passed to the handlers as pointers into the buffer,
+** terminated by overwriting the character that follows them, so the buffer
+** must hold a '\0' at Data[Size] and must remain valid until the parse ends
+*/
+
+bool sopSAXParseBuffer(sopSAXHandlerPtr sax, void *UserData, char *Data, size_t Size)
+{
+	sopBuffer Buffer;
+	Buffer.Pos = Data;
+	Buffer.End = Data + Size;
+	Buffer.Find = sopSelectFind();
+
+	/* Names of the currently open elements */
+	std::vector<const char *> TagName;
+
+	/* Attribute name and value pairs of the current element, followed by two NULLs */
+	std::vector<const char *> Attribs;
+
+	/* Places in the buffer to terminate once the current tag has been scanned */
+	std::vector<char *> Terminators;
+
+	for(;;)
+	{
 		/* Scan for start of tag */
-		do
+		Buffer.Pos = const_cast<char *>(static_cast<const char *>(memchr(Buffer.Pos, '<', Buffer.End - Buffer.Pos)));
+		if(Buffer.Pos == NULL) break;
+		Buffer.Pos++;
+
+		/* Skip comments */
+		if(sopSkipComment(Buffer)) continue;
+
+		/* Skip character data sections, as we don't report text */
+		if(strncmp(Buffer.Pos, "![CDATA[", 8) == 0)
 		{
-			c = sopGetChar(xmlFile);
-			if(c == EOF) break;
-		} while( c != '<' );
-		if(c == EOF) break;
+			const char *p = Buffer.Pos + 8;
+			for(;;)
+			{
+				p = Buffer.Find(p, Buffer.End, '>', '>', '>');
+				if((p == Buffer.End) || ((p[-1] == ']') && (p[-2] == ']') && (p - 2 >= Buffer.Pos + 8))) break;
+				p++;
+			}
 
-		/* Get name of element (tag) */
-		sopGetItem(xmlFile, ThisTag, MAXTAGLENGTH);
+			Buffer.Pos = const_cast<char *>((p == Buffer.End) ? p : p + 1);
+			continue;
+		}
 
-		/* Make no attempt to parse "?xml" etc. */
-		if(ThisTag[0] == '?')
+		/* Make no attempt to parse "?xml", "!DOCTYPE" etc. */
+		if((*Buffer.Pos == '?') || (*Buffer.Pos == '!'))
 		{
-			sopSkipToClose(xmlFile);
+			sopSkipToClose(Buffer);
 			continue;
 		}
 
+		/* Get name of element (tag) */
+		char *ThisTag = Buffer.Pos;
+		size_t TagLength = sopGetName(Buffer);
+
 		if(ThisTag[0] == '/')
 		{
-			if(ElementNesting == 0)
+			const char *EndName = &ThisTag[1];
+			size_t EndLength = TagLength - 1;
+
+			if(TagName.empty())
 			{
 				if(sax->error != NULL) sax->error(UserData,
-					"Unexpected end tag \"%s\"", ThisTag);
+					"Unexpected end tag \"%s\"", std::string(ThisTag, TagLength).c_str());
 
-				sopSkipToClose(xmlFile);
+				sopSkipToClose(Buffer);
 				continue;
 			}
 
-			if(strcmp(&ThisTag[1], TagName[ElementNesting-1]) != 0)
+			const char *Expected = TagName.back();
+			if((strncmp(Expected, EndName, EndLength) != 0) || (Expected[EndLength] != '\0'))
 			{
 				if(sax->error != NULL) sax->error(UserData,
-					"Expecting end tag \"%s\", found \"%s\"", TagName[ElementNesting-1], ThisTag);
+					"Expecting end tag \"%s\", found \"%s\"", Expected, std::string(ThisTag, TagLength).c_str());
 
-				sopSkipToClose(xmlFile);
+				sopSkipToClose(Buffer);
 				continue;
 			}
 
 			/* Pop up a level */
-			ElementNesting--;
+			TagName.pop_back();
 
 			/* Skip to the end of the tag */
-			if(sopSkipToClose(xmlFile))
+			int Unwanted = sopSkipToClose(Buffer);
+
+			/* The name can now be terminated as the rest of the tag has been scanned */
+			ThisTag[TagLength] = '\0';
+
+			if(Unwanted)
 			{
 				if(sax->warning != NULL) sax->warning(UserData,
-					"Unwanted characters in close tag for element \"%s\"", &ThisTag[1]);
+					"Unwanted characters in close tag for element \"%s\"", EndName);
 			}
 
 			/* Call the handler (if there is one) */
 			if(sax->endElement != NULL)
 			{
-				sax->endElement(UserData, &ThisTag[1]);
+				sax->endElement(UserData, EndName);
 			}
 
 			/* Go find the next */
 			continue;
 		}
 
-		/* Copy the name for validation of close tags */
-		strcpy(TagName[ElementNesting], ThisTag);
+		/* Assume elements are open (have separate end tag) */
+		bool closed = false;
 
-		/* Move down a level */
-		if(ElementNesting < (MAXTAGDEPTH-1))
-		{
-			ElementNesting++;
-		}
-		else
-		{
-			if(sax->error != NULL) sax->error(UserData,
-					"Error processing element \"%s\" too deeply nested",
-					ThisTag);
-		}
+		Attribs.clear();
+		Terminators.clear();
+		Terminators.push_back(&ThisTag[TagLength]);
 
-		attrib = 0;
-		AttribBufferFree = ATTRIBBUFFERSIZE - 1;
-		CurrentAttrib = &AttribBuffer[0];
-		while(attrib < MAXATTRIBS)
+		for(;;)
 		{
-			size_t i;
-
-			/* Index current attribute's starting point in buffer */
-			Attribs[attrib*2] = CurrentAttrib;
-
-			/* Get attribute name */
-			sopSkipSpace(xmlFile);
-			sopGetItem(xmlFile, Attribs[attrib*2], AttribBufferFree);
-
-			/* Work out how much buffer is now free */
-			i = strlen(Attribs[attrib*2]) + 1;
-			AttribBufferFree -= static_cast<int>(i);
-			CurrentAttrib += i;
+			sopSkipSpace(Buffer);
 
-			if(AttribBufferFree < 3)
+			/* Open end of element */
+			if((*Buffer.Pos == '>') || (Buffer.Pos == Buffer.End))
 			{
-				int last_c = 0;
-
-				if(sax->error != NULL) sax->error(UserData,
-						"Error processing element \"%s\" out of attribute buffer",
-						ThisTag);
-
-				/* Skip to the end of this element here, but continue parsing file */
-				while(!feof(xmlFile))
-				{
-					c = sopGetCharNonQ(xmlFile);
-					if(c=='>')
-					{
-						if(last_c == '/') closed = 1;
-						break;
-					}
-
-					last_c = c;
-				}
+				if(Buffer.Pos != Buffer.End) Buffer.Pos++;
+				break;
+			}
 
+			/* Closed end of element */
+			if(*Buffer.Pos == '/')
+			{
+				closed = true;
+				sopSkipToClose(Buffer);
 				break;
 			}
 
-			/* Open end of element */
-			if(Attribs[attrib*2][0] == 0) break;
+			/* Get attribute name */
+			char *Name = Buffer.Pos;
+			size_t NameLength = sopGetName(Buffer);
 
-			/* Closed end of element */
-			if(Attribs[attrib*2][0] == '/')
+			/* Open end of element, but with unexpected characters such as ';' */
+			if(NameLength == 0)
 			{
-				closed = 1;
+				sopSkipToClose(Buffer, &closed);
 				break;
 			}
 
 			/* Check for '=' after attribute name */
-			sopSkipSpace(xmlFile);
-			c = sopGetChar(xmlFile);
+			sopSkipSpace(Buffer);
 
-			if(c != '=')
+			if(*Buffer.Pos != '=')
 			{
-				int last_c = 0;
-
 				if(sax->error != NULL) sax->error(UserData,
 						"Error processing attribute \"%s\" of element \"%s\" '=' not found where expected",
-						Attribs[attrib*2], ThisTag);
-
-				/* Push back the rouge char (in case is is a quote) */
-				ungetc(c, xmlFile);
+						std::string(Name, NameLength).c_str(), std::string(ThisTag, TagLength).c_str());
 
 				/* Skip to the end of this element here, but continue parsing file */
-				while(!feof(xmlFile))
-				{
-					c = sopGetCharNonQ(xmlFile);
-					if(c=='>')
-					{
-						if(last_c == '/') closed = 1;
-						break;
-					}
-
-					last_c = c;
-				}
+				sopSkipToClose(Buffer, &closed);
 
 				break;
 			}
 
-			/* Index current value's starting point in buffer */
-			Attribs[attrib*2+1] = CurrentAttrib;
+			Buffer.Pos++;
 
 			/* Get attribute value */
-			sopSkipSpace(xmlFile);
-			sopGetItem(xmlFile, Attribs[attrib*2+1], AttribBufferFree);
+			sopSkipSpace(Buffer);
+			char *Value = Buffer.Pos;
+			char *ValueEnd = sopGetValue(Buffer);
+
+			Attribs.push_back(Name);
+			Attribs.push_back(Value);
+			Terminators.push_back(&Name[NameLength]);
+			Terminators.push_back(ValueEnd);
+		}
 
-			/* Work out how much buffer is now free */
-			i = strlen(Attribs[attrib*2+1]) + 1;
-			AttribBufferFree -= static_cast<int>(i);
-			CurrentAttrib += i;
+		/* Now that the whole tag has been scanned terminate the name and each attribute */
+		for(std::vector<char *>::iterator it = Terminators.begin(); it != Terminators.end(); it++) **it = '\0';
 
-			attrib++;
-		}
+		/* Move down a level */
+		if(!closed) TagName.push_back(ThisTag);
 
 		/* Call the handler (if there is one) */
 		if(sax->startElement != NULL)
 		{
-			Attribs[attrib*2] = NULL;
-			Attribs[attrib*2+1] = NULL;
-			sax->startElement(UserData, ThisTag, (const char**)Attribs);
+			Attribs.push_back(NULL);
+			Attribs.push_back(NULL);
+			sax->startElement(UserData, ThisTag, &Attribs[0]);
 		}
 
 		/* Call the close handler (if required and there is one) */
 		if(closed)
 		{
-			if(ElementNesting) ElementNesting--;
-
 			if(sax->endElement != NULL)
 			{
 				sax->endElement(UserData, ThisTag);
@@ -290,218 +342,363 @@ bool mxflib::sopSAXParseFile(sopSAXHandlerPtr sax, void *UserData, const char *f
 		}
 	}
 
-	fclose(xmlFile);
-
 	return true;
 }
 
 
 /*
-** sopGetChar() - Get character from XML file, skipping comments
+** sopFindChars() - Find the first of three characters in a buffer
 */
-int sopGetChar(FILE *xmlFile)
+static const char *sopFindChars(const char *Start, const char *End, char c1, char c2, char c3)
 {
-	int c;
-	int c2, c3;
-	long pos;
-
-	/* Get the next character */
-	c = fgetc(xmlFile);
-	/* return it if safe */
-	if(c != '<') return c;
-
-	pos = ftell(xmlFile);
-	/* Else sniff the next chars for '!--' */
-	c = fgetc(xmlFile);
-	if(c != '!')
+	while(Start < End)
 	{
-		/* We're safe, move back and continue */
-		fseek(xmlFile, pos, SEEK_SET);
-		return '<';
+		char c = *Start;
+		if((c == c1) || (c == c2) || (c == c3)) return Start;
+		Start++;
 	}
 
-	c2 = fgetc(xmlFile);
-	if(c2 != '-')
+	return End;
+}
+
+
+#ifdef MXFLIB_X86_SIMD
+
+/*
+** sopFirstBit() - Get the index of the lowest set bit in a non-zero mask
+*/
+static inline int sopFirstBit(UInt32 Mask)
+{
+#ifdef _MSC_VER
+	unsigned long Index;
+	_BitScanForward(&Index, Mask);
+	return static_cast<int>(Index);
+#else
+	return __builtin_ctz(Mask);
+#endif
+}
+
+
+/*
+** sopFindChars_SSE2() - Find the first of three characters in a buffer, 16 bytes at a time
+*/
+MXFLIB_TARGET("sse2") static const char *sopFindChars_SSE2(const char *Start, const char *End, char c1, char c2, char c3)
+{
+	__m128i Match1 = _mm_set1_epi8(c1);
+	__m128i Match2 = _mm_set1_epi8(c2);
+	__m128i Match3 = _mm_set1_epi8(c3);
+
+	while((End - Start) >= 16)
 	{
-		/* We're safe, move back and continue */
-		fseek(xmlFile, pos, SEEK_SET);
-		return '<';
+		__m128i Data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Start));
+		__m128i Found = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Data, Match1), _mm_cmpeq_epi8(Data, Match2)), _mm_cmpeq_epi8(Data, Match3));
+
+		UInt32 Mask = static_cast<UInt32>(_mm_movemask_epi8(Found));
+		if(Mask) return Start + sopFirstBit(Mask);
+
+		Start += 16;
 	}
 
-	c3 = fgetc(xmlFile);
-	if(c3 != '-')
+	return sopFindChars(Start, End, c1, c2, c3);
+}
+
+
+/*
+** sopFindChars_AVX2() - Find the first of three characters in a buffer, 32 bytes at a time
+*/
+MXFLIB_TARGET("avx2") static const char *sopFindChars_AVX2(const char *Start, const char *End, char c1, char c2, char c3)
+{
+	__m256i Match1 = _mm256_set1_epi8(c1);
+	__m256i Match2 = _mm256_set1_epi8(c2);
+	__m256i Match3 = _mm256_set1_epi8(c3);
+
+	while((End - Start) >= 32)
 	{
-		/* We're safe, move back and continue */
-		fseek(xmlFile, pos, SEEK_SET);
-		return '<';
+		__m256i Data = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(Start));
+		__m256i Found = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(Data, Match1), _mm256_cmpeq_epi8(Data, Match2)), _mm256_cmpeq_epi8(Data, Match3));
+
+		UInt32 Mask = static_cast<UInt32>(_mm256_movemask_epi8(Found));
+		if(Mask) return Start + sopFirstBit(Mask);
+
+		Start += 32;
 	}
 
+	return sopFindChars_SSE2(Start, End, c1, c2, c3);
+}
+
+#endif // MXFLIB_X86_SIMD
+
+
+/*
+** sopSelectFind() - Select the fastest search function for this processor
+*/
+sopFindFunc sopSelectFind(void)
+{
+#ifdef MXFLIB_X86_SIMD
+	if(CPUSupports(CPU_AVX2)) return sopFindChars_AVX2;
+	if(CPUSupports(CPU_SSE2)) return sopFindChars_SSE2;
+#endif // MXFLIB_X86_SIMD
+
+	return sopFindChars;
+}
+
+
+/*
+** sopSkipComment() - Skip a comment, if there is one after the '<' just read
+**
+** Returns: true if a comment was skipped
+*/
+bool sopSkipComment(sopBuffer &Buffer)
+{
+	if((Buffer.Pos[0] != '!') || (Buffer.Pos[1] != '-') || (Buffer.Pos[2] != '-')) return false;
+
+	const char *Start = Buffer.Pos + 3;
+	const char *p = Start;
+
 	/* Scan for end of comment */
-	c3 = 0;
-	c2 = 0;
-	while(!feof(xmlFile))
+	for(;;)
 	{
-		c = fgetc(xmlFile);
-		if((c=='>') && (c2=='-') && (c3=='-'))
+		p = Buffer.Find(p, Buffer.End, '>', '>', '>');
+
+		/* Fell out of scan! */
+		if(p == Buffer.End) break;
+
+		if(((p - Start) >= 2) && (p[-1] == '-') && (p[-2] == '-'))
 		{
-			return sopGetChar(xmlFile);
+			p++;
+			break;
 		}
 
-		c3 = c2;
-		c2 = c;
+		p++;
 	}
 
-	/* Fell out of scan! */
-	return EOF;
+	Buffer.Pos = const_cast<char *>(p);
+
+	return true;
 }
 
 
 /*
-** sopSkipSpace() - Skip any whitespace or newline characters in XML file
+** sopSkipSpace() - Skip any whitespace or newline characters
+*/
+void sopSkipSpace(sopBuffer &Buffer)
+{
+	char *p = Buffer.Pos;
+
+	while((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n')) p++;
+
+	Buffer.Pos = p;
+}
+
+
+/*
+** sopSkipToClose() - Skips past the next '>' that is not in a quoted string
+**
+** Returns: 0 if '>' found after nothing but whitespace and '\n'
+**			1 if anything else found
+**
+** Note: '?' is permitted before the '>' and is discarded
+**
+** If EndsWithSlash is supplied it is set true if the '>' follows a '/'
 */
-void sopSkipSpace(FILE *xmlFile)
+int sopSkipToClose(sopBuffer &Buffer, bool *EndsWithSlash /*=NULL*/)
 {
-	int c;
+	const char *Start = Buffer.Pos;
+
+	/* Skip any leading whitespace and '?' */
+	while((*Buffer.Pos == '?') || (*Buffer.Pos == ' ') || (*Buffer.Pos == '\t') || (*Buffer.Pos == '\r') || (*Buffer.Pos == '\n')) Buffer.Pos++;
 
+	/* Found '>' straight away */
+	if(*Buffer.Pos == '>')
+	{
+		Buffer.Pos++;
+		return 0;
+	}
+
+	/* Other characters found - skip them, and any quoted strings */
+	const char *p = Buffer.Pos;
 	for(;;)
 	{
-		c = sopGetChar(xmlFile);
-		if((c!=' ') && (c!='\t') && (c!='\r') && (c!='\n'))
+		p = Buffer.Find(p, Buffer.End, '>', '"', '\'');
+		if(p == Buffer.End) break;
+
+		if(*p == '>')
 		{
-			ungetc(c, xmlFile);
-			return;
+			if(EndsWithSlash && (p > Start) && (p[-1] == '/')) *EndsWithSlash = true;
+			p++;
+			break;
 		}
+
+		/* In quotes - skip to end */
+		const char *Quote = static_cast<const char *>(memchr(p + 1, *p, Buffer.End - (p + 1)));
+		if(Quote == NULL)
+		{
+			p = Buffer.End;
+			break;
+		}
+
+		p = Quote + 1;
 	}
+
+	Buffer.Pos = const_cast<char *>(p);
+
+	return 1;
 }
 
 
 /*
-** sopGetCharNonQ() - Get character from XML file, skipping quoted strings
+** sopGetName() - Read the name of an element or attribute
+**
+** The name is the chunk that ends in whitespace, a return, '=', '>', ';'
+** or '/' (other than a leading '/' on an end tag)
+**
+** Returns: The length of the name, which is not terminated
 */
-int sopGetCharNonQ(FILE *xmlFile)
+size_t sopGetName(sopBuffer &Buffer)
 {
-	int c;
+	char *Start = Buffer.Pos;
+	char *p = Start;
+
+	if(*p == '/') p++;
 
 	for(;;)
 	{
-		c = sopGetChar(xmlFile);
-		if(c != '"') return c;
-
-		/* In quotes - skip to end */
-		do
-		{
-			c = sopGetChar(xmlFile);
-			if(c == EOF) return c;
-		} while(c != '"');
+		char c = *p;
+		if((c==' ') || (c=='\t') || (c=='=') || (c=='>') || (c=='\n') || (c=='\r') || (c==';') || (c=='/') || (c=='\0' && p == Buffer.End)) break;
+		p++;
 	}
+
+	Buffer.Pos = p;
+
+	return static_cast<size_t>(p - Start);
 }
 
 
 /*
-** sopSkipToClose() - Skips to the next '>' in an XML file
-**
-** Returns: 0 if '>' found after nothing but whitespace and '\n'
-**			1 if anything else found
+** sopGetEntity() - Decode a character or entity reference, such as "&amp;" or "&#x20;"
 **
-** Note: '?' is permitted before the '>' and is discarded
+** Returns: The number of characters written to Dest (at most 4) or 0 if not a valid reference
 **
+** Text is updated to follow the reference if valid
 */
-int sopSkipToClose(FILE *xmlFile)
+static int sopGetEntity(const char *&Text, const char *End, char *Dest)
 {
-	int c;
+	const char *Start = Text + 1;
 
-	do
-	{
-		sopSkipSpace(xmlFile);
-		c = sopGetChar(xmlFile);
-	} while(c == '?');
+	/* References are short - so give up if no ';' is found soon */
+	size_t Max = End - Start;
+	if(Max > 32) Max = 32;
 
-	/* Found '>' straight away */
-	if(c == '>') return 0;
+	const char *Semicolon = static_cast<const char *>(memchr(Start, ';', Max));
+	if(Semicolon == NULL) return 0;
 
-	/* Other characters found - skip them */
+	std::string Tag(Start, Semicolon - Start);
+	Text = Semicolon + 1;
 
-	/* Push back the rouge char (in case is is a quote) */
-	ungetc(c, xmlFile);
+	if(strcasecmp(Tag.c_str(), "amp")==0)			{ *Dest = '&'; return 1; }
+	else if(strcasecmp(Tag.c_str(), "apos")==0)		{ *Dest = '\''; return 1; }
+	else if(strcasecmp(Tag.c_str(), "quot")==0)		{ *Dest = '"'; return 1; }
+	else if(strcasecmp(Tag.c_str(), "lt")==0)		{ *Dest = '<'; return 1; }
+	else if(strcasecmp(Tag.c_str(), "gt")==0)		{ *Dest = '>'; return 1; }
 
-	while(!feof(xmlFile))
+	/* Numeric character reference, output as UTF-8 */
+	if((Tag.size() > 1) && (Tag[0] == '#'))
 	{
-		c = sopGetCharNonQ(xmlFile);
-		if(c=='>') break;
+		char *NumEnd;
+		unsigned long Code;
+		if((Tag[1] == 'x') || (Tag[1] == 'X')) Code = strtoul(&Tag[2], &NumEnd, 16);
+		else Code = strtoul(&Tag[1], &NumEnd, 10);
+
+		if((*NumEnd == '\0') && (Code != 0) && (Code <= 0x10ffff))
+		{
+			if(Code < 0x80) { Dest[0] = static_cast<char>(Code); return 1; }
+			if(Code < 0x800) { Dest[0] = static_cast<char>(0xc0 | (Code >> 6)); Dest[1] = static_cast<char>(0x80 | (Code & 0x3f)); return 2; }
+			if(Code < 0x10000)
+			{
+				Dest[0] = static_cast<char>(0xe0 | (Code >> 12));
+				Dest[1] = static_cast<char>(0x80 | ((Code >> 6) & 0x3f));
+				Dest[2] = static_cast<char>(0x80 | (Code & 0x3f));
+				return 3;
+			}
+			Dest[0] = static_cast<char>(0xf0 | (Code >> 18));
+			Dest[1] = static_cast<char>(0x80 | ((Code >> 12) & 0x3f));
+			Dest[2] = static_cast<char>(0x80 | ((Code >> 6) & 0x3f));
+			Dest[3] = static_cast<char>(0x80 | (Code & 0x3f));
+			return 4;
+		}
 	}
 
+	// Should error here!!
+	*Dest = '?';
 	return 1;
 }
 
 
 /*
-** sopGetItem() - Read next 'item' in an XML file
+** sopGetValue() - Read an attribute value
 **
-** If the first character is a quote, the whole quoted
-** string is returned, otherwise the first chunk that
-** ends in a whitespace, or a return, or '>'
+** If the first character is a quote, the whole quoted string is the value,
+** with any references decoded in place and the value moved back over the
+** opening quote, otherwise the value is the first chunk that ends in
+** whitespace, a return, '=', '>' or ';'
 **
+** Returns: The end of the value, which is not terminated
 */
-void sopGetItem(FILE *xmlFile, char *Buffer, int Max)
+char *sopGetValue(sopBuffer &Buffer)
 {
-	int c;
-
-	c = sopGetChar(xmlFile);
+	char *p = Buffer.Pos;
 
 	/* Quoted or other token? */
-	if(c=='"')
+	if((*p == '"') || (*p == '\''))
 	{
-		/* Copy quoted string */
+		char Quote = *p;
+
+		/* The decoded value is written starting at the opening quote - it is never longer than the source */
+		char *Dest = p;
+		const char *Src = p + 1;
+
 		for(;;)
 		{
-			c = sopGetChar(xmlFile);
-			if((c=='"') || c==EOF) break;
+			const char *Next = Buffer.Find(Src, Buffer.End, Quote, '&', Quote);
 
-			if(c=='&')
-			{
-				char Tag[32];
-				sopGetItem(xmlFile, Tag, 31);
-
-				c = sopGetChar(xmlFile);
-				// Should validate for ';' here!!
-
-				if(strcasecmp(Tag, "amp")==0)			c='&';
-				else if(strcasecmp(Tag, "apos")==0)		c='\'';
-				else if(strcasecmp(Tag, "quot")==0)		c='"';
-				else if(strcasecmp(Tag, "lt")==0)		c='<';
-				else if(strcasecmp(Tag, "gt")==0)		c='>';
-				else
-				{
-					// Should error here!!
-					c = '?';
-				}
-			}
+			/* Copy the run of plain characters */
+			size_t Run = Next - Src;
+			if(Run) memmove(Dest, Src, Run);
+			Dest += Run;
+			Src = Next;
+
+			if((Src == Buffer.End) || (*Src == Quote)) break;
 
-			if(Max)
+			/* Decode the reference, or copy the '&' if it isn't valid */
+			char Decoded[4];
+			int Count = sopGetEntity(Src, Buffer.End, Decoded);
+			if(Count == 0)
 			{
-				Max--;
-				*Buffer++ = c;
+				*Dest++ = '&';
+				Src++;
 			}
-		}
-	}
-	else if(c != EOF)
-	{
-		/* Copy chunk up to next separator */
-		while((c!=' ') && (c!='\t') && (c!='=') && (c!='>') && (c!='\n') && (c!='\r') && (c!=';'))
-		{
-			if(Max)
+			else
 			{
-				Max--;
-				*Buffer++ = c;
+				memcpy(Dest, Decoded, Count);
+				Dest += Count;
 			}
-			c = sopGetChar(xmlFile);
-			if(c==EOF) break;
 		}
 
-		/* Push back the separator */
-		ungetc(c, xmlFile);
+		/* Skip the closing quote */
+		Buffer.Pos = const_cast<char *>((Src == Buffer.End) ? Src : Src + 1);
+
+		return Dest;
+	}
+
+	/* Copy chunk up to next separator */
+	for(;;)
+	{
+		char c = *p;
+		if((c==' ') || (c=='\t') || (c=='=') || (c=='>') || (c=='\n') || (c=='\r') || (c==';') || (c=='\0' && p == Buffer.End)) break;
+		p++;
 	}
 
-	/* Terminate the string */
-	*Buffer = '\0';
+	Buffer.Pos = p;
+
+	return p;
 }
@@ -55,6 +55,7 @@ namespace mxflib
 
 	/* Function Prototypes */
 	bool sopSAXParseFile(sopSAXHandlerPtr sax, void *UserData, const char *filename);
+	bool sopSAXParseString(sopSAXHandlerPtr sax, void *UserData, const char *XML, size_t Size);
 }
 
 #endif /* _SOPSAX_H */
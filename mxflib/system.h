@@ -275,6 +275,14 @@ namespace mxflib
 	inline bool DirectoryExists(const char *filename) { struct _stat buf; return (_stat(filename, &buf) == 0) ? ((buf.st_mode & _S_IFDIR) != 0) : false; }
 	inline int FileDelete(const char *filename) { return _unlink(filename); }
 	inline Int64 FileSize(FileHandle file) { struct _stat64 buf; return _fstat64(file, &buf) != 0 ? -1 : buf.st_size; }
+	inline UInt64 FileCopy(FileHandle /*dest*/, FileHandle /*source*/, UInt64 /*size*/) { return 0; }		// No direct copy - caller copies through a buffer
+	inline size_t FileWriteV(FileHandle file, const unsigned char *first, size_t firstsize, const unsigned char *second, size_t secondsize)
+	{
+		size_t Ret = FileWrite(file, first, firstsize);
+		if(Ret != firstsize) return Ret;
+		size_t Ret2 = FileWrite(file, second, secondsize);
+		return (Ret2 == static_cast<size_t>(-1)) ? Ret : Ret + Ret2;
+	}
 
 	// List all files that match the given spec (returned list is filenames excluding path)
 	inline StringList FileList(std::string FileSpec)
@@ -461,6 +469,7 @@ namespace mxflib
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <dirent.h>
 #include <unistd.h>
 
@@ -570,6 +579,9 @@ namespace mxflib
 
 	/******** 64-bit file-I/O ********/
 #ifndef MXFLIB_NO_FILE_IO
+#if defined(__linux__) && defined(_GNU_SOURCE) && defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 27)))
+#define MXFLIB_COPY_FILE_RANGE			// copy_file_range() is available to copy between files without reading into memory
+#endif
 #ifdef MXFLIB_LOWLEVEL_FILEIO
 	typedef int FileHandle;
 	const FileHandle FileInvalid = -1;
@@ -588,6 +600,40 @@ namespace mxflib
 	inline void FileFlush(FileHandle file) { fsync(file); }
 	inline void FileTruncate(FileHandle file, Int64 newsize =-1 ) { ftruncate(file, (newsize!=-1)?((UInt64)newsize):FileTell(file) ); }
 	inline Int64 FileSize(FileHandle file) { struct stat buf; return fstat(file, &buf) != 0 ? -1 : buf.st_size; }
+#ifdef MXFLIB_COPY_FILE_RANGE
+	//! Copy bytes from the current position in one file to the current position in another, without reading them into memory
+	/*! Both file offsets are left after the copied bytes.
+	 *  \return The number of bytes copied, which is less than size if the system can't copy directly between these files - the caller must copy the rest
+	 */
+	inline UInt64 FileCopy(FileHandle dest, FileHandle source, UInt64 size)
+	{
+		UInt64 Ret = 0;
+		while(Ret < size)
+		{
+			size_t Chunk = (size - Ret) > 0x40000000 ? 0x40000000 : (size_t)(size - Ret);
+			ssize_t Bytes = copy_file_range(source, NULL, dest, NULL, Chunk, 0);
+
+			// Not supported for these files (e.g. different file systems on older kernels) or end of the source
+			if(Bytes <= 0) break;
+
+			Ret += Bytes;
+		}
+
+		return Ret;
+	}
+#else // MXFLIB_COPY_FILE_RANGE
+	inline UInt64 FileCopy(FileHandle /*dest*/, FileHandle /*source*/, UInt64 /*size*/) { return 0; }		// No direct copy - caller copies through a buffer
+#endif // MXFLIB_COPY_FILE_RANGE
+	inline size_t FileReadAt(FileHandle file, UInt64 offset, unsigned char *dest, size_t size) { ssize_t Ret = pread64(file, dest, size, offset); return (Ret < 0) ? static_cast<size_t>(-1) : Ret; }
+	inline size_t FileWriteV(FileHandle file, const unsigned char *first, size_t firstsize, const unsigned char *second, size_t secondsize)
+	{
+		struct iovec Vec[2];
+		Vec[0].iov_base = const_cast<unsigned char *>(first); Vec[0].iov_len = firstsize;
+		Vec[1].iov_base = const_cast<unsigned char *>(second); Vec[1].iov_len = secondsize;
+		ssize_t Ret = writev(file, Vec, 2);
+		return (Ret < 0) ? static_cast<size_t>(-1) : Ret;
+	}
+#define MXFLIB_POSITIONAL_READ
 #else // MXFLIB_LOWLEVEL_FILEIO
 	typedef FILE *FileHandle;
 	const FileHandle FileInvalid = NULL;
@@ -606,6 +652,59 @@ namespace mxflib
 	inline void FileFlush(FileHandle file) { fflush(file); }
 	inline void FileTruncate(FileHandle file, Int64 newsize =-1 ) { ftruncate(fileno(file), (newsize!=-1)?((UInt64)newsize):FileTell(file) ); }
 	inline Int64 FileSize(FileHandle file) { struct stat buf; return fstat(fileno(file), &buf) != 0 ? -1 : buf.st_size; }
+
+	//! Copy bytes from the current position in one file to the current position in another, without reading them into memory
+	/*! Both file pointers are left after the copied bytes.
+	 *  \return The number of bytes copied, which is less than size if the system can't copy directly between these files - the caller must copy the rest
+	 */
+#ifdef MXFLIB_COPY_FILE_RANGE
+	inline UInt64 FileCopy(FileHandle dest, FileHandle source, UInt64 size)
+	{
+		// copy_file_range works below the stdio buffers, so flush and use the real positions
+		if(fflush(dest) != 0) return 0;
+		loff_t In = ftello(source);
+		loff_t Out = ftello(dest);
+		if((In < 0) || (Out < 0)) return 0;
+
+		UInt64 Ret = 0;
+		while(Ret < size)
+		{
+			size_t Chunk = (size - Ret) > 0x40000000 ? 0x40000000 : (size_t)(size - Ret);
+			ssize_t Bytes = copy_file_range(fileno(source), &In, fileno(dest), &Out, Chunk, 0);
+
+			// Not supported for these files (e.g. different file systems on older kernels) or end of the source
+			if(Bytes <= 0) break;
+
+			Ret += Bytes;
+		}
+
+		// Move the stdio positions past the copied bytes
+		fseeko(source, In, SEEK_SET);
+		fseeko(dest, Out, SEEK_SET);
+
+		return Ret;
+	}
+#else // MXFLIB_COPY_FILE_RANGE
+	inline UInt64 FileCopy(FileHandle /*dest*/, FileHandle /*source*/, UInt64 /*size*/) { return 0; }
+#endif // MXFLIB_COPY_FILE_RANGE
+
+	//! Read bytes from a given position in a file without using or moving the file pointer, so that other threads can read at the same time
+	/*! \note This bypasses the stdio buffers, so bytes written but not yet flushed will not be seen
+	 */
+	inline size_t FileReadAt(FileHandle file, UInt64 offset, unsigned char *dest, size_t size)
+	{
+		ssize_t Ret = pread(fileno(file), dest, size, static_cast<off_t>(offset));
+		return (Ret < 0) ? static_cast<size_t>(-1) : Ret;
+	}
+#define MXFLIB_POSITIONAL_READ
+
+	//! Write two buffers as if they were one, for example a header and a block of data held separately
+	/*! \note stdio already gathers small writes in its own buffer, so this is simply two writes
+	 */
+	inline size_t FileWriteV(FileHandle file, const unsigned char *first, size_t firstsize, const unsigned char *second, size_t secondsize)
+	{
+		return fwrite(first, 1, firstsize, file) + fwrite(second, 1, secondsize, file);
+	}
 #endif // MXFLIB_LOWLEVEL_FILEIO
 
 	inline bool FileExists(const char *filename) { struct stat buf; return stat(filename, &buf) == 0; }
@@ -735,6 +834,19 @@ namespace mxflib
 }
 
 
+namespace mxflib
+{
+	//! Generate a random (RFC 4122 version 4) UUID
+	/*! Values come from a generator held per-thread, seeded once from MakeUUID(), so no system calls or locks are
+	 *  needed for each UUID. This is the generator used for instance UIDs and other new UUIDs.
+	 *  \note If DISALLOW_RFC4122 is defined this simply calls MakeUUID()
+	 *  DRAGONS: The values are not suitable for cryptographic use, such as IVs or keys - use MakeUUID() for these
+	 *  DRAGONS: Implemented in helper.cpp
+	 */
+	void MakeRandomUUID(UInt8 *Buffer);
+}
+
+
 /*****************************************************/
 /*     Declarations for client supplied file-I/O     */
 /*****************************************************/
@@ -750,6 +862,7 @@ namespace mxflib
 	int FileSeekEnd(FileHandle file);
 	UInt64 FileRead(FileHandle file, unsigned char *dest, UInt64 size);
 	UInt64 FileWrite(FileHandle file, const unsigned char *source, UInt64 size);
+	size_t FileWriteV(FileHandle file, const unsigned char *first, size_t firstsize, const unsigned char *second, size_t secondsize);
 	int FileGetc(FileHandle file);
 	FileHandle FileOpen(const char *filename);
 	FileHandle FileOpenRead(const char *filename);
@@ -763,6 +876,9 @@ namespace mxflib
 	int FileDelete(const char *filename);
 	void FileTruncate(FileHandle file, Int64 newsize =-1 );
 	Int64 FileSize(FileHandle file);
+
+	//! Client supplied file-I/O has no direct copy between files, the caller copies through a buffer
+	inline UInt64 FileCopy(FileHandle /*dest*/, FileHandle /*source*/, UInt64 /*size*/) { return 0; }
 }
 #endif // MXFLIB_NO_FILE_IO
 
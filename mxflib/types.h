@@ -345,7 +345,7 @@ namespace mxflib
 		//! Construct a new UUID with a new unique value
 		UUID() 
 		{ 
-			MakeUUID(Ident); 
+			MakeRandomUUID(Ident); 
 		}
 
 		//! Construct a UUID from a sequence of bytes
@@ -562,6 +562,135 @@ namespace mxflib
 }
 
 
+namespace mxflib
+{
+	//! Identifier held by value, compared and hashed as 64-bit words
+	/*! Unlike Identifier and its derived classes this is not reference counted and has no virtual functions,
+	 *  so it is cheap to copy, store in containers by value and use as a map key.
+	 *  Ordering is the same as for Identifier (byte-by-byte, as memcmp).
+	 */
+	template <int SIZE> class IdentifierValue
+	{
+	protected:
+		union
+		{
+			UInt64 Words[SIZE / 8];						//!< The value as native-endian words, for comparisons
+			UInt8 Ident[SIZE];							//!< The value as bytes
+		};
+
+	public:
+		//! Construct from a sequence of bytes, or as all zeros
+		IdentifierValue(const UInt8 *ID = NULL) { if(ID == NULL) memset(Ident, 0, SIZE); else memcpy(Ident, ID, SIZE); }
+
+		//! Set the value, or clear it to all zeros
+		void Set(const UInt8 *ID = NULL) { if(ID == NULL) memset(Ident, 0, SIZE); else memcpy(Ident, ID, SIZE); }
+
+		//! Get a read-only pointer to the identifier value
+		const UInt8 *GetValue(void) const { return Ident; }
+
+		//! Get the size of the identifier
+		int Size(void) const { return SIZE; }
+
+		//! Is this identifier all zeros?
+		bool operator!(void) const
+		{
+			UInt64 Any = 0;
+			for(int i = 0; i < SIZE / 8; i++) Any |= Words[i];
+			return Any == 0;
+		}
+
+		bool operator==(const IdentifierValue &Other) const
+		{
+			UInt64 Diff = 0;
+			for(int i = 0; i < SIZE / 8; i++) Diff |= Words[i] ^ Other.Words[i];
+			return Diff == 0;
+		}
+
+		bool operator!=(const IdentifierValue &Other) const { return !operator==(Other); }
+
+		bool operator<(const IdentifierValue &Other) const
+		{
+			for(int i = 0; i < SIZE / 8; i++)
+			{
+				// Only the first differing word needs to be read big-endian to give the byte order
+				if(Words[i] != Other.Words[i]) return GetU64(&Ident[i * 8]) < GetU64(&Other.Ident[i * 8]);
+			}
+			return false;
+		}
+
+		//! Get a hash of the value, for use in hashed containers
+		size_t Hash(void) const
+		{
+			UInt64 Ret = 0;
+			for(int i = 0; i < SIZE / 8; i++) Ret = (Ret ^ Words[i]) * UINT64_C(0x9e3779b97f4a7c15);
+			return static_cast<size_t>(Ret ^ (Ret >> 32));
+		}
+
+		//! Hash function object, for use with hashed containers
+		struct Hasher
+		{
+			size_t operator()(const IdentifierValue &Value) const { return Value.Hash(); }
+		};
+	};
+
+	//! UUID held by value
+	/*! Converts to and from UUID and UUIDPtr so it can be used with existing APIs */
+	class UUIDValue : public IdentifierValue<16>
+	{
+	public:
+		//! Construct from a sequence of bytes, or as a nil UUID
+		UUIDValue(const UInt8 *ID = NULL) : IdentifierValue<16>(ID) {}
+
+		//! Construct from a UUID
+		UUIDValue(const UUID &ID) : IdentifierValue<16>(ID.GetValue()) {}
+
+		//! Construct from a UUIDPtr, a NULL pointer gives a nil UUID
+		UUIDValue(const UUIDPtr &ID) : IdentifierValue<16>(ID ? ID->GetValue() : NULL) {}
+
+		//! Generate a new random UUID
+		static UUIDValue Generate(void)
+		{
+			UUIDValue Ret;
+			MakeRandomUUID(Ret.Ident);
+			return Ret;
+		}
+
+		//! Build a reference counted UUID with this value
+		UUIDPtr GetUUID(void) const { return new UUID(Ident); }
+
+		//! Allow use where a UUIDPtr is expected
+		operator UUIDPtr() const { return GetUUID(); }
+
+		//! Produce a human-readable string in one of the "standard" formats
+		std::string GetString(OutputFormatEnum Format = -1) const { return UUID::FormatString(Ident, Format); }
+	};
+
+	//! UMID held by value
+	/*! Converts to and from UMID and UMIDPtr so it can be used with existing APIs */
+	class UMIDValue : public IdentifierValue<32>
+	{
+	public:
+		//! Construct from a sequence of bytes, or as a NULL UMID (32 zero bytes)
+		UMIDValue(const UInt8 *ID = NULL) : IdentifierValue<32>(ID) {}
+
+		//! Construct from a UMID
+		UMIDValue(const UMID &ID) : IdentifierValue<32>(ID.GetValue()) {}
+
+		//! Construct from a UMIDPtr, a NULL pointer gives a NULL UMID
+		UMIDValue(const UMIDPtr &ID) : IdentifierValue<32>(ID ? ID->GetValue() : NULL) {}
+
+		//! Build a reference counted UMID with this value
+		UMIDPtr GetUMID(void) const { return new UMID(Ident); }
+
+		//! Allow use where a UMIDPtr is expected
+		operator UMIDPtr() const { return GetUMID(); }
+
+		//! Produce a human-readable string in one of the "standard" formats
+		std::string GetString(OutputFormatEnum Format = -1) const { return UMID::FormatString(Ident, Format); }
+	};
+}
+
+
 namespace mxflib
 {
 	//! Structure for holding fractions
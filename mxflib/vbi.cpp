@@ -108,7 +108,11 @@ int ANCVBISource::Field2Offset(void)
 //! Build the data for this frame in SMPTE-436M format
 DataChunkPtr ANCVBISource::BuildChunk(void)
 {
-	/* Fill lines from line sources */
+	/* Fill lines from line sources, packing their data into the line arena */
+
+	// DRAGONS: Both of these keep their buffers, so once the first frame has been built there is no more allocation here
+	Lines.clear();
+	LineArena.Resize(0);
 
 	ANCVBILineSourceList::iterator LS_it = Sources.begin();
 	while(LS_it != Sources.end())
@@ -116,86 +120,59 @@ DataChunkPtr ANCVBISource::BuildChunk(void)
 		int LineNumber = (*LS_it)->GetLineNumber();
 		if((*LS_it)->GetField() == 2) LineNumber += Field2Offset();
 
-		Lines.insert(ANCLineMap::value_type(
-				LineNumber,
-				new ANCLine(LineNumber,
-				(*LS_it)->GetWrappingType(),
-				(*LS_it)->GetSampleCoding(),
-				(*LS_it)->GetLineData(),
-				(*LS_it)->GetDID(),
-				(*LS_it)->GetSDID())));
+		// Read the data even if we don't use it, so that the line source stays in step
+		DataChunkPtr LineData = (*LS_it)->GetLineData();
 
-		LS_it++;
-	}
+		// Find where this line belongs - if we already have this line number the first one is kept
+		ANCVBIFrameLineList::iterator it = Lines.begin();
+		while((it != Lines.end()) && ((*it).LineNumber < LineNumber)) it++;
 
+		if((it == Lines.end()) || ((*it).LineNumber != LineNumber))
+		{
+			int DID = (*LS_it)->GetDID();
 
-	/* Now build the chunk from line data */
+			ANCVBIFrameLine Line;
+			Line.LineNumber = LineNumber;
+			Line.WrappingType = (*LS_it)->GetWrappingType();
+			Line.SampleCoding = (*LS_it)->GetSampleCoding();
+			Line.Offset = LineArena.Size;
+			Line.Size = ANCVBILine::PackedSize(LineData->Size, DID);
 
-	/* First we handle the special case of no lines this frame (should be quite common) */
-	if(Lines.empty())
-	{
-		// Simply return "Number of Lines = 0"
-		DataChunkPtr Ret = new DataChunk(2);
-		PutU16(0, Ret->Data);
+			// DRAGONS: DataChunk::Resize() allocates exactly, so we grow the arena geometrically ourselves
+			if(Line.Offset + Line.Size > LineArenaAllocated)
+			{
+				LineArenaAllocated = (LineArenaAllocated * 2 > Line.Offset + Line.Size) ? LineArenaAllocated * 2 : Line.Offset + Line.Size + 4096;
+				LineArena.ResizeBuffer(LineArenaAllocated);
+			}
 
-		return Ret;
-	}
+			LineArena.Resize(Line.Offset + Line.Size);
+			Line.SampleCount = ANCVBILine::PackData(&LineArena.Data[Line.Offset], *LineData, DID, (*LS_it)->GetSDID());
 
-	VBILineMap::iterator it = Lines.begin();
+			Lines.insert(it, Line);
+		}
+
+		LS_it++;
+	}
 
-	// Guess the buffer size by assuming that all the lines are the same size, then add 2 bytes for the line count
-	// DRAGONS: If the line sizes do vary this is a bottle-neck
-	// DRAGONS: We will use this as a remaining-bytes counter while writing the data
-	size_t BufferSize = ((*it).second->GetFullDataSize() * Lines.size()) + 2;
 
-	// Get a buffer of this size
-	DataChunkPtr Ret = new DataChunk(BufferSize);
+	/* Now build the chunk from line data - the size is known exactly so this is a single pass */
 
-	// Index the start of the buffer
-	UInt8 *pBuffer = Ret->Data;
+	DataChunkPtr Ret = new DataChunk(2 + (14 * Lines.size()) + LineArena.Size);
 
 	// Write in the number of lines
 	PutU16(static_cast<UInt16>(Lines.size()), Ret->Data);
-	pBuffer += 2;
-	BufferSize -= 2;
+	UInt8 *pBuffer = &Ret->Data[2];
 
+	ANCVBIFrameLineList::iterator it = Lines.begin();
 	while(it != Lines.end())
 	{
-		// Get the number of bytes required to add this line to the buffer
-		size_t RequiredBytes = (*it).second->GetFullDataSize();
-
-		// If we don't have enough space we must increase the buffer size - can only happen if lines differ in size
-		if(RequiredBytes > BufferSize)
-		{
-			// Work out how far through the buffer we currently are
-			size_t CurrentPos = pBuffer - Ret->Data;
-
-			// Make the buffer big enough for this line
-			Ret->Resize(static_cast<UInt32>(CurrentPos + RequiredBytes));
-
-			// Flag that we now have just enough bytes left
-			BufferSize = RequiredBytes;
-
-			// Set the buffer pointer in the (possibly re-allocated) buffer
-			pBuffer = &Ret->Data[CurrentPos];
-		}
-
-		// Write the data into the buffer (formatted by the VBILine itself)
-		(*it).second->WriteData(pBuffer);
-
-		// Update the buffer pointer and bytes-remaining count
-		pBuffer += RequiredBytes;
-		BufferSize -= RequiredBytes;
+		ANCVBILine::WriteHeader(pBuffer, (*it).LineNumber, (*it).WrappingType, (*it).SampleCoding, (*it).SampleCount, (*it).Size);
+		memcpy(&pBuffer[14], &LineArena.Data[(*it).Offset], (*it).Size);
 
+		pBuffer += 14 + (*it).Size;
 		it++;
 	}
 
-	// Resize the buffer to the actual number of bytes that we wrote
-	Ret->Resize(static_cast<UInt32>(pBuffer - Ret->Data));
-
-	// Clear the list of pending lines
-	Lines.clear();
-
 	// Return the finished data
 	return Ret;
 }
@@ -206,30 +183,66 @@ DataChunkPtr ANCVBISource::BuildChunk(void)
  */
 void ANCVBILine::WriteData(UInt8 *Buffer)
 {
-	// Write the line number
-	PutU16( LineNumber, Buffer);
+	WriteHeader(Buffer, LineNumber, WrappingType, SampleCoding, SampleCount, Data.Size);
 
-	// Add the wrapping type
-	Buffer[2] = static_cast<UInt8>(WrappingType);
+	// Then copy in all the line data (assuming we have some)
+	if(Data.Data) memcpy(&Buffer[14], Data.Data, Data.Size);
+}
 
-	// Add the sample coding
-	Buffer[3] = static_cast<UInt8>(SampleCoding);
 
-	// And the sample count
-	PutU16(static_cast<UInt16>(SampleCount), &Buffer[4]);
+//! Pack line data as per SMPTE-436M into a buffer of PackedSize() bytes
+/*! \return The sample count for the line
+ */
+UInt16 ANCVBILine::PackData(UInt8 *Buffer, const DataChunk &LineData, int DID /*=-1*/, int SDID /*=-1*/)
+{
+	size_t Size = PackedSize(LineData.Size, DID);
+	size_t Used = LineData.Size;
 
-	// Then copy in all the line data (assuming we have some) including the array header
-	if(Data.Data)
+	if(DID == -1)
 	{
-		PutU32(static_cast<UInt32>(Data.Size), &Buffer[6]);
-		PutU32(1, &Buffer[10]);
-		memcpy(&Buffer[14], Data.Data, Data.Size);
+		// Set the line data
+		if(LineData.Size) memcpy(Buffer, LineData.Data, LineData.Size);
 	}
 	else
 	{
-		PutU32(0, &Buffer[6]);
-		PutU32(1, &Buffer[10]);
+		// ANC packets need to start DID, SDID, DataCount
+		Buffer[0] = static_cast<UInt8>(DID);
+		Buffer[1] = static_cast<UInt8>(SDID);
+		Buffer[2] = static_cast<UInt8>(LineData.Size);
+
+		// Set the rest of the buffer from LineData
+		if(LineData.Size) memcpy(&Buffer[3], LineData.Data, LineData.Size);
+
+		// Increase the line size by DID, SDID, DataCount
+		Used += 3;
 	}
+
+	// Pad with zeros if required
+	if(Used < Size) memset(&Buffer[Used], 0, Size - Used);
+
+	// DRAGONS: For VBI data we count one sample per byte supplied
+	return static_cast<UInt16>(Used);
+}
+
+
+//! Write the line number, wrapping type, sample coding, sample count and array header for a line of DataSize bytes of packed data
+void ANCVBILine::WriteHeader(UInt8 *Buffer, int LineNumber, ANCWrappingType Wrapping, ANCSampleCoding Coding, UInt16 SampleCount, size_t DataSize)
+{
+	// Write the line number
+	PutU16(static_cast<UInt16>(LineNumber), Buffer);
+
+	// Add the wrapping type
+	Buffer[2] = static_cast<UInt8>(Wrapping);
+
+	// Add the sample coding
+	Buffer[3] = static_cast<UInt8>(Coding);
+
+	// And the sample count
+	PutU16(SampleCount, &Buffer[4]);
+
+	// Then the array header for the line data
+	PutU32(static_cast<UInt32>(DataSize), &Buffer[6]);
+	PutU32(1, &Buffer[10]);
 }
 
 
@@ -270,15 +283,15 @@ bool ANCVBISource::EndSignalled(void)
 size_t ANCVBISource::GetEssenceDataSize(void)
 {
 	// If we don't yet have any data prepared, prepare some (even if this will be an "empty" chunk)
-	if(BufferedData.empty())
+	if(!BufferedData)
 	{
 		if(EndSignalled()) return 0;
 
-		BufferedData.push_back(BuildChunk());
+		BufferedData = BuildChunk();
 	}
 
 	// Return the size of the next available chunk
-	return static_cast<size_t>(BufferedData.front()->Size);
+	return static_cast<size_t>(BufferedData->Size);
 }
 
 
@@ -300,11 +313,11 @@ DataChunkPtr ANCVBISource::GetEssenceData(size_t Size /*=0*/, size_t MaxSize /*=
 	else if(MasterSource) CurrentPosition = MasterSource->GetCurrentPosition() - 1;
 
 	// If we don't yet have any data prepared, prepare some (even if this will be an "empty" chunk)
-	if(BufferedData.empty())
+	if(!BufferedData)
 	{
 		if(EndSignalled()) return NULL;
 
-		BufferedData.push_back(BuildChunk());
+		BufferedData = BuildChunk();
 	}
 
 	// If we are indexing, set simple index flags
@@ -318,32 +331,27 @@ DataChunkPtr ANCVBISource::GetEssenceData(size_t Size /*=0*/, size_t MaxSize /*=
 	 * - We are not already part way through a buffer
 	 * - We are permitted to return the whole buffer in one go
 	 */
-	if(/*(Size == 0) && */(BufferOffset == 0) && ((MaxSize == 0) || (BufferedData.front()->Size <= MaxSize)))
+	if(/*(Size == 0) && */(BufferOffset == 0) && ((MaxSize == 0) || (BufferedData->Size <= MaxSize)))
 	{
-		// We will return the head item
-		DataChunkPtr Ret = BufferedData.front();
-
-		// Remove this item from the list of buffers
-		BufferedData.pop_front();
+		// We will return the prepared data, and no longer hold it
+		DataChunkPtr Ret = BufferedData;
+		BufferedData = NULL;
 
 		// Return it
 		return Ret;
 	}
 
 	// First see how many bytes remain
-	size_t Bytes = BufferedData.front()->Size - BufferOffset;
+	size_t Bytes = BufferedData->Size - BufferOffset;
 
 	// If we can return all these now, do so
-	if(Bytes <= MaxSize)
+	if((MaxSize == 0) || (Bytes <= MaxSize))
 	{
-		// Build a new buffer to hold the reduced data
-		DataChunkPtr Ret = new DataChunk(Bytes);
-
-		// Copy in the remaining bytes
-		Ret->Set(static_cast<UInt32>(Bytes), BufferedData.front()->Data);
+		// Build a new buffer holding the remaining bytes
+		DataChunkPtr Ret = new DataChunk(Bytes, &BufferedData->Data[BufferOffset]);
 
-		// Remove this item from the list of buffers
-		BufferedData.pop_front();
+		// We no longer hold any data
+		BufferedData = NULL;
 
 		// Clear the buffer offset as we will start at the beginning of the next chunk
 		BufferOffset = 0;
@@ -352,14 +360,11 @@ DataChunkPtr ANCVBISource::GetEssenceData(size_t Size /*=0*/, size_t MaxSize /*=
 		return Ret;
 	}
 
-	// Build a new buffer to hold the reduced data
-	DataChunkPtr Ret = new DataChunk(MaxSize);
-
-	// Copy in as many bytes as permitted
-	Ret->Set(static_cast<UInt32>(MaxSize), BufferedData.front()->Data);
+	// Build a new buffer holding as many bytes as permitted
+	DataChunkPtr Ret = new DataChunk(MaxSize, &BufferedData->Data[BufferOffset]);
 
 	// Update the offset
-	BufferOffset -= MaxSize;
+	BufferOffset += MaxSize;
 
 	// Return the data
 	return Ret;
@@ -91,11 +91,11 @@ namespace mxflib
 	public:
 		//! Construct a VBILine with no data
 		ANCVBILine(int LineNumber, ANCWrappingType Wrapping, ANCSampleCoding Coding)
-			: LineNumber(LineNumber), WrappingType(Wrapping), SampleCoding(Coding) {};
+			: LineNumber(LineNumber), WrappingType(Wrapping), SampleCoding(Coding), SampleCount(0) {};
 
 		//! Construct a VBILine with no data, for an interlaced frame
 		ANCVBILine(int Field, int LineNumber, ANCWrappingType Wrapping, ANCSampleCoding Coding)
-			: WrappingType(Wrapping), SampleCoding(Coding) 
+			: WrappingType(Wrapping), SampleCoding(Coding), SampleCount(0)
 		{
 			if(Field == 2) this->LineNumber = 0x4000 + LineNumber;
 			else this->LineNumber = LineNumber;
@@ -121,41 +121,8 @@ namespace mxflib
 		//! Set (or replace) the current line data
 		void SetData(DataChunkPtr &LineData, int DID = -1, int  SDID = -1)
 		{
-			if(DID == -1)
-			{
-				// Round to next UInt32 boundary
-				size_t Size = ((LineData->Size + 3) / 4) * 4;
-				Data.Resize(Size);
-				
-				// Set the line data
-				Data.Set(LineData);
-
-				// Pad with zeros if required
-				if(LineData->Size < Size) memset(&Data.Data[LineData->Size], 0, Size - LineData->Size);
-			}
-			else
-			{
-				// ANC packets need to start DID, SDID, DataCount
-				size_t Size = 3 + LineData->Size;
-				
-				// Round to next UInt32 boundary
-				Size = ((Size + 3) / 4) * 4;
-				Data.Resize(Size);
-
-				// Set the DID, SDID and DataCount
-				Data.Data[0] = static_cast<UInt8>(DID);
-				Data.Data[1] = static_cast<UInt8>(SDID);
-				Data.Data[2] = static_cast<UInt8>(LineData->Size);
-
-				// Increase the VBI line size by DID, SDID, DataCount
-				SampleCount = 3 + static_cast<UInt16>(LineData->Size);
-
-				// Set the rest of the buffer from LineData
-				Data.Set(LineData, 3);
-
-				// Pad with zeros if required
-				if((LineData->Size + 3)< Size) memset(&Data.Data[LineData->Size + 3], 0, Size - (LineData->Size + 3));
-			}
+			Data.Resize(PackedSize(LineData->Size, DID));
+			SampleCount = PackData(Data.Data, *LineData, DID, SDID);
 		}
 
 		//! Get the size of the data buffer, excluding the line number, wrapping type, sample coding, sample count bytes and array header
@@ -168,6 +135,22 @@ namespace mxflib
 		/*! \note It is the caller's responsibility to ensure that the buffer has enough space - the number of bytes written <b>will be</b> GetFullDataSize()
 		 */
 		void WriteData(UInt8 *Buffer);
+
+		//! Get the size of line data once packed as per SMPTE-436M, including any DID, SDID and DataCount and padding to a UInt32 boundary
+		static size_t PackedSize(size_t LineDataSize, int DID = -1)
+		{
+			if(DID != -1) LineDataSize += 3;
+			return ((LineDataSize + 3) / 4) * 4;
+		}
+
+		//! Pack line data as per SMPTE-436M into a buffer of PackedSize() bytes
+		/*! \return The sample count for the line
+		 */
+		static UInt16 PackData(UInt8 *Buffer, const DataChunk &LineData, int DID = -1, int SDID = -1);
+
+		//! Write the line number, wrapping type, sample coding, sample count and array header for a line of DataSize bytes of packed data
+		/*! The number of bytes written is always 14 */
+		static void WriteHeader(UInt8 *Buffer, int LineNumber, ANCWrappingType Wrapping, ANCSampleCoding Coding, UInt16 SampleCount, size_t DataSize);
 	};
 
 	//! Alias for ANC usage of ANCVBILine
@@ -196,6 +179,21 @@ namespace mxflib
 	//! Alias for VBI usage of ANCVBILineMap
 	typedef ANCVBILineMap VBILineMap;
 
+	//! A line of ANC or VBI data built by an ANCVBISource for the current frame
+	/*! The packed line data is held in the line arena of the ANCVBISource rather than in a buffer of its own */
+	struct ANCVBIFrameLine
+	{
+		int LineNumber;					//!< The line number of this line in the frame
+		ANCWrappingType WrappingType;	//!< The wrapping type for this line
+		ANCSampleCoding SampleCoding;	//!< SampleCoding for this line
+		UInt16 SampleCount;				//!< Number of samples in this line
+		size_t Offset;					//!< Offset of the packed line data in the line arena
+		size_t Size;					//!< Size of the packed line data
+	};
+
+	//! List of lines built for a frame, sorted by line number
+	typedef std::vector<ANCVBIFrameLine> ANCVBIFrameLineList;
+
 	//! Superclass for objects that supply data to be wrapped by an ANCVBISource
 	class ANCVBILineSource : public RefCount<ANCVBILineSource>
 	{
@@ -263,9 +261,13 @@ namespace mxflib
 	protected:
 		ANCVBILineSourceList Sources;		//!< List of line sources used to build lines
 
-		ANCVBILineMap Lines;				//!< Map of lines built for this frame
+		ANCVBIFrameLineList Lines;			//!< Lines built for this frame, sorted by line number (kept between frames to prevent allocation)
+
+		DataChunk LineArena;				//!< Packed data for all the lines built for this frame (kept between frames to prevent allocation)
+
+		size_t LineArenaAllocated;			//!< Number of bytes allocated for LineArena, which may be more than its Size
 
-		DataChunkList BufferedData;			//!< List of data items prepared and ready to be supplied in response to GetEssenceData() - next to be supplied is the head
+		DataChunkPtr BufferedData;			//!< Data prepared and ready to be supplied in response to GetEssenceData(), or NULL if none
 
 		size_t BufferOffset;				//!< An offset into the current data buffer if we are returning a partial chunk in GetEssenceData()
 
@@ -277,7 +279,7 @@ namespace mxflib
 
 	public:
 		//! Base constructor
-		ANCVBISource(EssenceSource *Master = NULL) : EssenceSubSource(Master), BufferOffset(0), CurrentPosition(0), F2Offset(-1), EndAtPosition(-1) {};
+		ANCVBISource(EssenceSource *Master = NULL) : EssenceSubSource(Master), LineArenaAllocated(0), BufferOffset(0), CurrentPosition(0), F2Offset(-1), EndAtPosition(-1) {};
 
 		//! Virtual destructor to allow polymorphism
 		virtual ~ANCVBISource() {};
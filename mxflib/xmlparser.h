@@ -97,6 +97,27 @@ namespace mxflib
 		return XMLParserParseFile(NULL, Hand, UserData, filename, ParseNamespaces);
 	}
 
+	//! Use the sopSAX parser to parse a string
+	inline bool XMLParserParseString(XML_Parser *pParser, XMLParserHandlerPtr Hand, void *UserData, std::string & strXML, bool ParseNamespaces = false)
+	{
+		if(pParser)
+		{
+			error("XMLParserParseString() must have NULL as first parameter if Expat XML parser not used\n");
+			return false;
+		}
+		if(ParseNamespaces)
+		{
+			error("Unable to parse namespaces in XML string without Expat parser\n");
+			return false;
+		}
+		return sopSAXParseString(Hand, UserData, strXML.data(), strXML.size());
+	}
+
+	inline bool XMLParserParseString(XMLParserHandlerPtr Hand, void *UserData, std::string & strXML, bool ParseNamespaces = false)
+	{
+		return XMLParserParseString(NULL, Hand, UserData, strXML, ParseNamespaces);
+	}
+
 }
 
 #endif // HAVE_EXPAT